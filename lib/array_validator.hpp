@@ -1,5 +1,8 @@
 #ifndef CJSON_VALIDATOR_ARRAY_VALIDATOR_HPP
 #define CJSON_VALIDATOR_ARRAY_VALIDATOR_HPP
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
 #include <set>
 #include <string>
 #include <cstring>
@@ -10,37 +13,95 @@
 #include <cstdint>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "json_adapters/adapter.hpp"
+#include "subtree_memo.hpp"
 #include "validator.hpp"
 #include "string_validator.hpp"
 #include "int_validator.hpp"
 #include "object_validator.hpp"
+#include "work_stealing_pool.hpp"
 
 namespace json_validator {
 using std::set;
 using std::string;
 using std::stringstream;
+using std::vector;
 
 /**
  * Array validator is used to validate json keys that contains arrays as
  * value.
  *
  * Currently, this validator verifies:
- *  1) unique
+ *  1) unique (equal objects, arrays and scalars are duplicates)
  *  2) length
  *  3) min length
  *  4) max length
  *  5) any other validation that can be provided by an implementation of the
  *    Validator interface
  */
-template<typename AdapterType>
-class Array_validator : public Validator<AdapterType> {
+template<typename AdapterType, typename Instrumentation = No_instrumentation>
+class Array_validator : public Validator<AdapterType, Instrumentation> {
   public:
   using JSON_token = json_adapters::JSON_adapter<AdapterType>;
+  using Validator_t = Validator<AdapterType, Instrumentation>;
+
+  using size_validation_func_t =
+    std::function<Validation_result_ptr(uint64_t size,
+                                        Validation_result_ptr result)>;
+
+  using revalidation_func_t =
+    std::function<Validation_result_ptr(const JSON_token& token,
+                                        const Touched_nodes& touched,
+                                        uint8_t flags,
+                                        Validation_result_ptr result)>;
 
   private:
-  Validator<AdapterType>* _values_validator;
+  friend class Iterative_validator<AdapterType, Instrumentation>;
+
+  Validator_t* _values_validator;
+  size_t _items_step;                 //  validate_valid_items in _valdations
+  bool _memoize;
+  Work_stealing_pool* _pool;
+  size_t _parallel_min_items;
+  size_t _parallel_grain;
+  bool _unique;
+  uint64_t _minimum_length;
+  uint64_t _maximum_length;
+
+  /**
+   * Size checks (length, min and max) are also kept apart from _valdations
+   *  so that they can be applied when only the number of items is known
+   *  (eg: by the Streaming_validator)
+   */
+  vector<size_validation_func_t> _size_validations;
+
+  /**
+   * Same checks as _valdations, in the same order, for revalidate(): the
+   *  type can't have changed, sizes only change with the members
+   */
+  vector<revalidation_func_t> _revalidations;
+
+  void add_size_validation(const size_validation_func_t& validation) {
+    this->_size_validations.push_back(validation);
+    this->_valdations.push_back([validation] (const JSON_token& token,
+                                Validation_result_ptr result) {
+      return validation((uint64_t)token.get_array_size(), std::move(result));
+    });
+
+    this->_revalidations.push_back([validation] (const JSON_token& token,
+                                   const Touched_nodes& touched,
+                                   uint8_t flags,
+                                   Validation_result_ptr result) {
+      if (!(flags & Touched_nodes::MEMBERS)) {
+        result->reset();
+        return result;
+      }
+
+      return validation((uint64_t)token.get_array_size(), std::move(result));
+    });
+  }
 
   protected:
   Validation_result_ptr validate_type(const JSON_token& token,
@@ -49,62 +110,99 @@ class Array_validator : public Validator<AdapterType> {
 
 
     if (!token.is_array()) {
-      result->set_error("must be an array");
+      result->set_error(VALIDATION_WRONG_TYPE, "must be an array", this,
+                        "array", token.type_name());
     }
 
     return result;
   }
 
-  Validation_result_ptr validate_length(const JSON_token& token,
+  Validation_result_ptr validate_length(uint64_t size,
                                         uint64_t length,
                                         Validation_result_ptr result) {
     result->reset();
 
-    if ((uint64_t)token.get_array_size() != length) {
-      result->set_error("length must be " + std::to_string(length));
+    if (size != length) {
+      result->set_error(VALIDATION_WRONG_LENGTH,
+                        "length must be " + std::to_string(length), this,
+                        std::to_string(length) + " items",
+                        std::to_string(size) + " items");
     }
 
     return result;
   }
 
-  Validation_result_ptr validate_min(const JSON_token& token,
-                                        uint64_t length,
-                                        Validation_result_ptr result) {
+  Validation_result_ptr validate_min(uint64_t size,
+                                     uint64_t length,
+                                     Validation_result_ptr result) {
     result->reset();
 
-    if ((uint64_t)token.get_array_size() < length) {
-      result->set_error("length must be greater then " +
-                        std::to_string(length));
+    if (size < length) {
+      result->set_error(VALIDATION_BELOW_MINIMUM,
+                        "length must be greater then " +
+                        std::to_string(length), this,
+                        ">= " + std::to_string(length) + " items",
+                        std::to_string(size) + " items");
     }
 
     return result;
   }
 
-  Validation_result_ptr validate_max(const JSON_token& token,
-                                        uint64_t length,
+  Validation_result_ptr validate_max(uint64_t size,
+                                     uint64_t length,
+                                     Validation_result_ptr result) {
+    result->reset();
+
+    if (size > length) {
+      result->set_error(VALIDATION_ABOVE_MAXIMUM,
+                        "length must be less then " + std::to_string(length),
+                        this, "<= " + std::to_string(length) + " items",
+                        std::to_string(size) + " items");
+    }
+
+    return result;
+  }
+
+  Validation_result_ptr validate_unique(const JSON_token& token,
                                         Validation_result_ptr result) {
     result->reset();
 
-    if ((uint64_t)token.get_array_size() > length) {
-      result->set_error("length must be less then " + std::to_string(length));
+    int item_index = 0;
+    Validation_budget* budget = result->budget();
+    if (!has_unique_items(token, &item_index, budget)) {
+      if (budget != nullptr && budget->exceeded()) {
+        budget->set_error(result.get());
+      } else {
+        result->set_error(VALIDATION_DUPLICATED_ITEM, "duplicated item", this,
+                          "unique items", "a repeated item");
+      }
+      result->add_index(item_index);
     }
 
     return result;
   }
 
   Validation_result_ptr validate_valid_items(const JSON_token& token,
-                                             Validator<AdapterType>* validator,
+                                             Validator_t* validator,
                                              Validation_result_ptr result) {
     result->reset();
+    if (_memoize && result->memo() == nullptr) {
+      return validate_items_memoized(token, validator, std::move(result));
+    }
+
+    if (_pool != nullptr && result->memo() == nullptr &&
+        (size_t)token.get_array_size() >= _parallel_min_items) {
+      return validate_items_parallel(token, validator, std::move(result));
+    }
 
     int item_index = 0;
     for (auto array_itr = token.array_begin(); array_itr != token.array_end();
          ++array_itr) {
-      result = validator->validate(json_adapter_factory(array_itr),
-                                   std::move(result));
+      result = validator->validate_memoized(json_adapter_factory(array_itr),
+                                            std::move(result));
 
       if (!result->success()) {
-        result->set_error(std::to_string(item_index));
+        result->add_index(item_index);
         break;
       }
 
@@ -114,12 +212,128 @@ class Array_validator : public Validator<AdapterType> {
     return result;
   }
 
+  /**
+   * Same result as validate_valid_items, the items being validated in
+   *  chunks of _parallel_grain by tasks of _pool: the error reported is the
+   *  one of the first failing index, items after a known failure are
+   *  skipped and the results of the others ignored.
+   */
+  Validation_result_ptr validate_items_parallel(const JSON_token& token,
+                                                Validator_t* validator,
+                                                Validation_result_ptr result) {
+    vector<AdapterType> items;
+    items.reserve(token.get_array_size());
+    for (auto array_itr = token.array_begin(); array_itr != token.array_end();
+         ++array_itr) {
+      items.push_back(json_adapter_factory(array_itr));
+    }
+
+    vector<Validation_result_ptr> failures(items.size());
+    std::atomic<size_t> first_failure(items.size());
+    _pool->parallel_for(0, items.size(), _parallel_grain,
+                        [&](size_t first, size_t last) {
+      Validation_result_ptr item_result(new Validation_result());
+      for (size_t i = first; i < last; ++i) {
+        if (first_failure.load(std::memory_order_relaxed) < i) {
+          return;
+        }
+
+        item_result->reset();
+        item_result = validator->validate(items[i], std::move(item_result));
+        if (!item_result->success()) {
+          failures[i] = std::move(item_result);
+          size_t failure = first_failure.load(std::memory_order_relaxed);
+          while (i < failure &&
+                 !first_failure.compare_exchange_weak(failure, i)) {
+          }
+
+          return;
+        }
+      }
+    });
+
+    size_t failure = first_failure.load();
+    if (failure < items.size()) {
+      result = std::move(failures[failure]);
+      result->add_index(failure);
+      return result;
+    }
+
+    result->reset();
+    return result;
+  }
+
+  /**
+   * The memo lives as long as this call: nested arrays reuse it
+   */
+  Validation_result_ptr validate_items_memoized(
+      const JSON_token& token, Validator_t* validator,
+      Validation_result_ptr result) {
+    Subtree_memo memo;
+    result->memo(&memo);
+    result = validate_valid_items(token, validator, std::move(result));
+    result->memo(nullptr);
+    return result;
+  }
+
+  Validation_result_ptr revalidate_items(const JSON_token& token,
+                                         const Touched_nodes& touched,
+                                         Validator_t* validator,
+                                         Validation_result_ptr result) {
+    result->reset();
+
+    int item_index = 0;
+    for (auto array_itr = token.array_begin(); array_itr != token.array_end();
+         ++array_itr) {
+      result = validator->revalidate(json_adapter_factory(array_itr), touched,
+                                     std::move(result));
+
+      if (!result->success()) {
+        result->add_index(item_index);
+        break;
+      }
+
+      item_index++;
+    }
+
+    return result;
+  }
+
+  Validation_result_ptr revalidate_members(const JSON_token& token,
+                                           const Touched_nodes& touched,
+                                           uint8_t flags,
+                                           Validation_result_ptr result)
+      override {
+    result->reset();
+    for (auto& revalidation_func : this->_revalidations) {
+      result = revalidation_func(token, touched, flags, std::move(result));
+      if (!result->success()) {
+        break;
+      }
+    }
+
+    return result;
+  }
+
   public:
-  Array_validator() : _values_validator(nullptr) {
+  Array_validator()
+      : _values_validator(nullptr), _items_step(SIZE_MAX), _memoize(false),
+        _pool(nullptr), _parallel_min_items(0), _parallel_grain(0),
+        _unique(false),
+        _minimum_length(0),
+        _maximum_length(std::numeric_limits<uint64_t>::max()) {
     this->_valdations.push_back([this] (const JSON_token& token,
                                 Validation_result_ptr result) {
       return this->validate_type(token, std::move(result));
     });
+
+    this->_revalidations.push_back([] (const JSON_token& token,
+                                   const Touched_nodes& touched,
+                                   uint8_t flags,
+                                   Validation_result_ptr result) {
+      result->reset();
+      return result;
+    });
   }
 
   ~Array_validator() {
@@ -127,50 +341,238 @@ class Array_validator : public Validator<AdapterType> {
   }
 
   Array_validator* unique(bool unique) {
+    if (!unique) {
+      return this;
+    }
+
+    _unique = true;
     this->_valdations.push_back([this] (const JSON_token& token,
                                 Validation_result_ptr result) {
-      return result;
+      return this->validate_unique(token, std::move(result));
+    });
+
+    //  Any change below the array can make two items equal
+    this->_revalidations.push_back([this] (const JSON_token& token,
+                                   const Touched_nodes& touched,
+                                   uint8_t flags,
+                                   Validation_result_ptr result) {
+      return this->validate_unique(token, std::move(result));
     });
 
     return this;
   }
 
   Array_validator* length(uint64_t length) {
-    this->_valdations.push_back([this, length] (const JSON_token& token,
-                                Validation_result_ptr result) {
-      return this->validate_length(token, length, std::move(result));
+    _minimum_length = std::max(_minimum_length, length);
+    _maximum_length = std::min(_maximum_length, length);
+    this->add_size_validation([this, length] (uint64_t size,
+                              Validation_result_ptr result) {
+      return this->validate_length(size, length, std::move(result));
     });
 
     return this;
   }
 
   Array_validator* min(uint64_t length) {
-    this->_valdations.push_back([this, length] (const JSON_token& token,
-                                Validation_result_ptr result) {
-      return this->validate_min(token, length, std::move(result));
+    _minimum_length = std::max(_minimum_length, length);
+    this->add_size_validation([this, length] (uint64_t size,
+                              Validation_result_ptr result) {
+      return this->validate_min(size, length, std::move(result));
     });
 
     return this;
   }
 
   Array_validator* max(uint64_t length) {
-    this->_valdations.push_back([this, length] (const JSON_token& token,
-                                Validation_result_ptr result) {
-      return this->validate_max(token, length, std::move(result));
+    _maximum_length = std::min(_maximum_length, length);
+    this->add_size_validation([this, length] (uint64_t size,
+                              Validation_result_ptr result) {
+      return this->validate_max(size, length, std::move(result));
     });
 
     return this;
   }
 
-  Array_validator* items(Validator<AdapterType>* validator) {
+  Array_validator* items(Validator_t* validator) {
     this->_values_validator = validator;
+    this->_items_step = this->_valdations.size();
     this->_valdations.push_back([this, validator] (const JSON_token& token,
                                 Validation_result_ptr result) {
       return this->validate_valid_items(token, validator, std::move(result));
     });
 
+    this->_revalidations.push_back([this, validator] (const JSON_token& token,
+                                   const Touched_nodes& touched,
+                                   uint8_t flags,
+                                   Validation_result_ptr result) {
+      return this->revalidate_items(token, touched, validator,
+                                    std::move(result));
+    });
+
     return this;
   }
+
+  /**
+   * Opt-in memoisation of the items: subtrees repeated across the items
+   *  (at any depth) are validated once per call of this validator, with
+   *  the same results. Worth it when items share large identical values;
+   *  hashing stops by itself for the schema nodes where it doesn't pay.
+   *
+   * @see Subtree_memo
+   */
+  Array_validator* memoize(bool memoize) {
+    _memoize = memoize;
+    return this;
+  }
+
+  /**
+   * Opt-in fork-join validation of the items: arrays with at least
+   *  min_items items are split in chunks of 'grain' items validated by
+   *  tasks of 'pool' (which must outlive the validator) with
+   *  Work_stealing_pool::parallel_for. nullptr turns it off.
+   *
+   * Results are the same as sequential ones, except that defaults may also
+   * be added to items after the first failing one. Memoised arrays, and
+   * validations handed a Subtree_memo, stay sequential.
+   */
+  Array_validator* parallel(Work_stealing_pool* pool,
+                            size_t min_items = 1024, size_t grain = 128) {
+    _pool = pool;
+    _parallel_min_items = min_items;
+    _parallel_grain = grain;
+    return this;
+  }
+
+  /**
+   * Appends to 'out' a representation of 'token' that is the same for equal
+   *  json values (object members are sorted by key)
+   */
+  static void canonical_value(const JSON_token& token, string* out) {
+    if (token.is_object()) {
+      vector<std::pair<string, string>> members;
+      for (auto it = token.object_begin(); it != token.object_end(); ++it) {
+        string member;
+        canonical_value(json_adapter_factory(it), &member);
+        members.push_back({it.get_name(), std::move(member)});
+      }
+
+      std::sort(members.begin(), members.end());
+      out->push_back('{');
+      for (auto& member : members) {
+        *out += std::to_string(member.first.size()) + ":" + member.first;
+        *out += member.second;
+      }
+
+      out->push_back('}');
+    } else if (token.is_array()) {
+      out->push_back('[');
+      for (auto it = token.array_begin(); it != token.array_end(); ++it) {
+        canonical_value(json_adapter_factory(it), out);
+      }
+
+      out->push_back(']');
+    } else if (token.is_boolean()) {
+      out->push_back(token.get_boolean() ? 't' : 'f');
+    } else if (token.is_string()) {
+      string value = token.get_string();
+      out->push_back('s');
+      out->append(std::to_string(value.size()));
+      out->push_back(':');
+      out->append(value);
+    } else if (token.is_number()) {
+      char number[32];
+      snprintf(number, sizeof(number), "n%.17g;", token.get_double());
+      *out += number;
+    } else {
+      out->push_back('z');
+    }
+  }
+
+  /**
+   * Checks that all items of the array are distinct. If they are not,
+   *  'duplicated_index' receives the index of the first repeated item.
+   *  Every item compared spends a node of 'budget': when it runs out, false
+   *  too, with the index of the item it stopped at (budget->exceeded()).
+   */
+  static bool has_unique_items(const JSON_token& token,
+                               int* duplicated_index,
+                               Validation_budget* budget = nullptr) {
+    //  Small arrays are compared linearly, which is cheaper than a set
+    const size_t max_linear_size = 16;
+    vector<string> values;
+    set<string> sorted_values;
+    int item_index = 0;
+    for (auto array_itr = token.array_begin(); array_itr != token.array_end();
+         ++array_itr) {
+      if (budget != nullptr && !budget->spend()) {
+        *duplicated_index = item_index;
+        return false;
+      }
+
+      string value;
+      canonical_value(json_adapter_factory(array_itr), &value);
+
+      bool duplicated = false;
+      if (sorted_values.empty()) {
+        duplicated = std::find(values.begin(), values.end(), value) !=
+                     values.end();
+        values.push_back(std::move(value));
+        if (values.size() > max_linear_size) {
+          sorted_values.insert(values.begin(), values.end());
+        }
+      } else {
+        duplicated = !sorted_values.insert(std::move(value)).second;
+      }
+
+      if (duplicated) {
+        *duplicated_index = item_index;
+        return false;
+      }
+
+      item_index++;
+    }
+
+    return true;
+  }
+
+  /**
+   * Tightest bounds of the number of items (length, min and max)
+   */
+  uint64_t minimum_length() const {
+    return _minimum_length;
+  }
+
+  uint64_t maximum_length() const {
+    return _maximum_length;
+  }
+
+  bool unique_items() const {
+    return _unique;
+  }
+
+  /**
+   *  Validator applied to every item of the array (nullptr if none was set)
+   */
+  Validator_t* items_validator() const {
+    return this->_values_validator;
+  }
+
+  /**
+   * Applies the length, min and max constraints to an array with 'size'
+   *  items, without needing the array itself.
+   */
+  Validation_result_ptr validate_size(uint64_t size,
+                                      Validation_result_ptr result) {
+    result->reset();
+    for (auto& validation_func : this->_size_validations) {
+      result = validation_func(size, std::move(result));
+      if (!result->success()) {
+        break;
+      }
+    }
+
+    return result;
+  }
 };
 }  // namespace json_validator
 #endif
@@ -0,0 +1,288 @@
+#ifndef CJSON_VALIDATOR_BATCH_VALIDATOR_HPP
+#define CJSON_VALIDATOR_BATCH_VALIDATOR_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error_handling.hpp"
+#include "compiled_schema.hpp"
+#include "validation_result.hpp"
+#include "validator.hpp"
+#include "work_stealing_pool.hpp"
+
+namespace json_validator {
+using std::unique_ptr;
+using std::vector;
+
+template<typename AdapterType>
+class Batch_validator;
+
+/**
+ * Verdicts of a batch: one pass/fail bit and one error code per document
+ *  and, only when asked for, the full result of each failed document.
+ */
+class Batch_result {
+  private:
+  template<typename AdapterType>
+  friend class Batch_validator;
+
+  size_t _size;
+  vector<uint64_t> _passed;
+  vector<Validation_error_code> _codes;
+  vector<Validation_result_ptr> _failures;
+
+  void reset(size_t size, bool keep_failures) {
+    _size = size;
+    _passed.assign((size + 63) / 64, 0);
+    _codes.assign(size, VALIDATION_OK);
+    _failures.clear();
+    if (keep_failures) {
+      _failures.resize(size);
+    }
+  }
+
+  public:
+  Batch_result() : _size(0) { }
+
+  size_t size() const {
+    return _size;
+  }
+
+  bool passed(size_t index) const {
+    return (_passed[index / 64] >> (index % 64)) & 1;
+  }
+
+  size_t passed_count() const {
+    size_t count = 0;
+    for (uint64_t word : _passed) {
+      count += __builtin_popcountll(word);
+    }
+
+    return count;
+  }
+
+  /**
+   * Bit i % 64 of word i / 64 is set if document i is valid
+   */
+  const vector<uint64_t>& bitmap() const {
+    return _passed;
+  }
+
+  Validation_error_code code(size_t index) const {
+    return _codes[index];
+  }
+
+  const vector<Validation_error_code>& codes() const {
+    return _codes;
+  }
+
+  /**
+   * @return nullptr if the document is valid or failures were not kept
+   */
+  Validation_result* failure(size_t index) const {
+    return _failures.empty() ? nullptr : _failures[index].get();
+  }
+
+  /**
+   * Appends the errors of the failed documents as a JSON array:
+   *  [{"index":3,"code":"above_maximum","pointer":"/a/0",...},...]
+   *  Without kept failures only the index and the code are known.
+   *
+   * Nothing but 'out' is allocated: keep it between batches.
+   */
+  void append_errors_json(std::string* out) const {
+    char index[32];
+    bool first = true;
+    out->push_back('[');
+    for (size_t i = 0; i < _size; ++i) {
+      if (passed(i)) {
+        continue;
+      }
+
+      snprintf(index, sizeof(index), "%s{\"index\":%zu,", first ? "" : ",",
+               i);
+      out->append(index);
+      first = false;
+      if (!_failures.empty() && _failures[i] != nullptr) {
+        _failures[i]->append_json_members(out);
+      } else {
+        out->append("\"code\":\"");
+        out->append(validation_error_name(_codes[i]));
+        out->push_back('"');
+      }
+
+      out->push_back('}');
+    }
+
+    out->push_back(']');
+  }
+};
+
+/**
+ * Batch validator validates many documents with the same validator (a
+ *  builder tree or a compiled schema) and reports them as a Batch_result.
+ *
+ * The scratch state (one result and one Compiled_schema_stack per task)
+ * is kept between documents and between batches, so valid documents don't
+ * allocate anything. Up to 'threads' tasks run on a Work_stealing_pool
+ * (the calling thread runs one of them) and take documents in chunks of
+ * CHUNK_SIZE, so each word of the bitmap is written by a single thread.
+ *
+ * A Batch_validator runs one batch at a time; the validator it uses must
+ * outlive it. Defaults are added to the documents, as validate() does.
+ *
+ *    Batch_validator<CJSON_adapter> batch(&compiled_schema, 4);
+ *    Batch_result verdicts = batch.validate_batch(documents);
+ */
+template<typename AdapterType>
+class Batch_validator {
+  public:
+  static const size_t CHUNK_SIZE = 256;
+
+  private:
+  struct Scratch {
+    Scratch() : result(new Validation_result()) { }
+
+    Validation_result_ptr result;
+    Compiled_schema_stack<AdapterType> stack;
+  };
+
+  Validator<AdapterType>* _validator;
+  const Compiled_schema* _schema;
+  Work_stealing_pool* _pool;
+  vector<unique_ptr<Scratch>> _scratch;
+
+  //  Batch in progress
+  const AdapterType* _documents;
+  size_t _count;
+  Batch_result* _result;
+  bool _keep_failures;
+  std::atomic<size_t> _next_chunk;
+
+  void validate_document(size_t index, Scratch* scratch) {
+    Validation_result_ptr result = std::move(scratch->result);
+    if (_schema != nullptr) {
+      result = _schema->validate(_documents[index], &scratch->stack,
+                                 std::move(result));
+    } else {
+      result->reset();
+      result = _validator->validate(_documents[index], std::move(result));
+    }
+
+    if (result->success()) {
+      _result->_passed[index / 64] |= (uint64_t)1 << (index % 64);
+    } else {
+      _result->_codes[index] = result->code();
+      if (_keep_failures) {
+        _result->_failures[index] = std::move(result);
+        result.reset(new Validation_result());
+      }
+    }
+
+    scratch->result = std::move(result);
+  }
+
+  void work(Scratch* scratch) {
+    for (;;) {
+      size_t first = _next_chunk.fetch_add(1) * CHUNK_SIZE;
+      if (first >= _count) {
+        return;
+      }
+
+      size_t last = first + CHUNK_SIZE < _count ? first + CHUNK_SIZE : _count;
+      for (size_t i = first; i < last; ++i) {
+        validate_document(i, scratch);
+      }
+    }
+  }
+
+  void init(size_t threads) {
+    if (threads == 0) {
+      raise_error(std::invalid_argument(
+          "Batch_validator: threads must be > 0"));
+    }
+
+    for (size_t i = 0; i < threads; ++i) {
+      _scratch.emplace_back(new Scratch());
+    }
+  }
+
+  public:
+  /**
+   * Builder validators can be shared by threads as long as nothing adds
+   *  validators to them meanwhile.
+   *
+   * @param pool pool running the tasks (nullptr: Work_stealing_pool::shared)
+   */
+  explicit Batch_validator(Validator<AdapterType>* validator,
+                           size_t threads = 1,
+                           Work_stealing_pool* pool = nullptr)
+      : _validator(validator), _schema(nullptr), _pool(pool) {
+    init(threads);
+  }
+
+  explicit Batch_validator(const Compiled_schema* schema, size_t threads = 1,
+                           Work_stealing_pool* pool = nullptr)
+      : _validator(nullptr), _schema(schema), _pool(pool) {
+    init(threads);
+  }
+
+  Batch_validator(const Batch_validator&) = delete;
+  Batch_validator& operator=(const Batch_validator&) = delete;
+
+  size_t threads() const {
+    return _scratch.size();
+  }
+
+  /**
+   * Validates documents[0..count) into result (its memory is reused).
+   *
+   * @param keep_failures also keep the full result of failed documents
+   */
+  void validate_batch(const AdapterType* documents, size_t count,
+                      Batch_result* result, bool keep_failures = false) {
+    result->reset(count, keep_failures);
+    _documents = documents;
+    _count = count;
+    _result = result;
+    _keep_failures = keep_failures;
+    _next_chunk.store(0);
+
+    size_t chunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    size_t tasks = chunks < threads() ? chunks : threads();
+    if (tasks <= 1) {
+      work(_scratch[0].get());
+      return;
+    }
+
+    if (_pool == nullptr) {
+      _pool = &Work_stealing_pool::shared();
+    }
+
+    //  The calling thread runs the first task and helps with the others
+    Work_stealing_pool::Task_group group(_pool);
+    for (size_t i = 1; i < tasks; ++i) {
+      Scratch* scratch = _scratch[i].get();
+      group.spawn([this, scratch]() { work(scratch); });
+    }
+
+    work(_scratch[0].get());
+    group.wait();
+  }
+
+  Batch_result validate_batch(const vector<AdapterType>& documents,
+                              bool keep_failures = false) {
+    Batch_result result;
+    validate_batch(documents.data(), documents.size(), &result,
+                   keep_failures);
+    return result;
+  }
+};
+}  // namespace json_validator
+#endif
@@ -14,17 +14,19 @@ namespace json_validator {
  *
  * Currently, this validator only verifies that the value is actually a boolean
  */
-template<typename AdapterType>
-class Boolean_validator : public Validator<AdapterType> {
+template<typename AdapterType, typename Instrumentation = No_instrumentation>
+class Boolean_validator : public Validator<AdapterType, Instrumentation> {
   public:
   using JSON_token = json_adapters::JSON_adapter<AdapterType>;
+  using Validator_t = Validator<AdapterType, Instrumentation>;
 
   protected:
   Validation_result_ptr validate_type(const JSON_token& token,
                                       Validation_result_ptr result) {
     result->reset();
     if (!token.is_boolean()) {
-      result->set_error("should be a boolean");
+      result->set_error(VALIDATION_WRONG_TYPE, "should be a boolean", this,
+                        "boolean", token.type_name());
     }
 
     return result;
@@ -35,18 +37,21 @@ class Boolean_validator : public Validator<AdapterType> {
                                        Validation_result_ptr result) {
     result->reset();
     if (token.get_boolean() != value) {
-      result->set_error("should have value: " + std::to_string(value));
+      result->set_error(VALIDATION_NOT_ALLOWED,
+                        "should have value: " + std::to_string(value), this,
+                        value ? "true" : "false", value ? "false" : "true");
     }
 
     return result;
   }
 
-  void set_default_value(const JSON_token& json, const string& key) override {
+  bool set_default_value(const JSON_token& json, const string& key) override {
     this->_set_default_value(json, key, _default_value);
+    return true;
   }
 
   public:
-  Boolean_validator() {
+  Boolean_validator() : _has_fixed_value(false), _fixed_value(false) {
     this->_valdations.push_back([this] (const JSON_token& token,
                                 Validation_result_ptr result) {
       return this->validate_type(token, std::move(result));
@@ -60,6 +65,8 @@ class Boolean_validator : public Validator<AdapterType> {
   }
 
   Boolean_validator* is(bool value) {
+    _has_fixed_value = true;
+    _fixed_value = value;
     this->_valdations.push_back([this, value] (const JSON_token& token,
                                 Validation_result_ptr result) {
       return this->validate_value(token, value, std::move(result));
@@ -68,8 +75,21 @@ class Boolean_validator : public Validator<AdapterType> {
     return this;
   }
 
+  /**
+   * Whether is() was called, and the value it requires
+   */
+  bool has_fixed_value() const {
+    return _has_fixed_value;
+  }
+
+  bool fixed_value() const {
+    return _fixed_value;
+  }
+
   private:
   bool _default_value;
+  bool _has_fixed_value;
+  bool _fixed_value;
 };
 
 }  // namespace json_validator
@@ -0,0 +1,1045 @@
+#ifndef CJSON_VALIDATOR_COMPILED_SCHEMA_HPP
+#define CJSON_VALIDATOR_COMPILED_SCHEMA_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error_handling.hpp"
+#include "validation_result.hpp"
+#include "validator.hpp"
+#include "array_validator.hpp"
+#include "json_adapters/adapter.hpp"
+
+namespace json_validator {
+using std::string;
+using std::vector;
+
+/**
+ * Binary layout of a compiled schema (see Schema_compiler).
+ *
+ * A compiled schema is a single position independent blob: every reference
+ * is an index or an offset inside the blob, never a pointer. It can be
+ * written to a file and mmap'ed by any number of processes, which then
+ * validate against it directly (no per-node allocation, shared pages).
+ *
+ *    [header][nodes][properties][values][strings]
+ *
+ * All integers are stored in the host byte order and every section starts
+ * 8 bytes aligned, so the blob itself must be 8 bytes aligned.
+ */
+const char COMPILED_SCHEMA_MAGIC[4] = {'J', 'V', 'S', 'C'};
+const uint32_t COMPILED_SCHEMA_VERSION = 1;
+const uint32_t COMPILED_SCHEMA_NO_NODE = 0xFFFFFFFF;
+
+enum Compiled_schema_node_type : uint32_t {
+  COMPILED_OBJECT = 1,
+  COMPILED_ARRAY,
+  COMPILED_STRING,
+  COMPILED_INT,
+  COMPILED_BOOLEAN
+};
+
+enum Compiled_schema_node_flags : uint32_t {
+  COMPILED_HAS_MIN = 1 << 0,
+  COMPILED_HAS_MAX = 1 << 1,
+  COMPILED_HAS_ENUM = 1 << 2,
+  COMPILED_UNIQUE = 1 << 3,
+  COMPILED_HAS_DEFAULT = 1 << 4,
+  COMPILED_REQUIRED = 1 << 5,
+  COMPILED_FORBIDDEN = 1 << 6
+};
+
+struct Compiled_schema_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t size;                  //  size of the whole blob
+  uint32_t root;                  //  index of the root node
+  uint32_t node_count;
+  uint32_t nodes_offset;
+  uint32_t property_count;
+  uint32_t properties_offset;
+  uint32_t value_count;
+  uint32_t values_offset;
+  uint32_t strings_size;
+  uint32_t strings_offset;
+};
+
+struct Compiled_schema_node {
+  uint32_t type;                  //  Compiled_schema_node_type
+  uint32_t flags;                 //  Compiled_schema_node_flags
+  int64_t min;                    //  int: minimum, array: minItems
+  int64_t max;                    //  int: maximum, array: maxItems,
+                                  //  string: maxLength
+  int64_t default_value;          //  int/boolean: value, string: offset
+  uint32_t first;                 //  object: first property,
+                                  //  array: items node, enum: first value
+  uint32_t count;                 //  object: properties, enum: values
+};
+
+/**
+ * Properties of an object are sorted by key, so they can be binary searched
+ */
+struct Compiled_schema_property {
+  uint32_t key;                   //  offset in the strings section
+  uint32_t node;                  //  NO_NODE for forbidden keys
+  uint32_t flags;                 //  COMPILED_REQUIRED, COMPILED_FORBIDDEN
+  uint32_t reserved;
+};
+
+const size_t COMPILED_SCHEMA_MAX_DEPTH = 1024;
+
+class Compiled_schema;
+
+/**
+ * Scratch state of Compiled_schema::validate: one frame per object/array
+ *  being validated. Frames live in vectors that only grow, so a reused
+ *  stack doesn't allocate per nesting level.
+ */
+template<typename AdapterType>
+class Compiled_schema_stack {
+  private:
+  friend class Compiled_schema;
+  using object_iterator =
+    typename json_adapters::Adapter_traits<AdapterType>::object_iterator;
+  using array_iterator =
+    typename json_adapters::Adapter_traits<AdapterType>::array_iterator;
+
+  struct Object_frame {
+    Object_frame(uint32_t node, const AdapterType& token, size_t seen)
+        : node(node), token(token), it(this->token.object_begin()),
+          end(this->token.object_end()), seen(seen), started(false) { }
+
+    uint32_t node;
+    AdapterType token;
+    object_iterator it;                   //  property being validated
+    object_iterator end;
+    size_t seen;                          //  first word in _seen
+    bool started;
+  };
+
+  struct Array_frame {
+    Array_frame(uint32_t items, const AdapterType& token)
+        : items(items), token(token), it(this->token.array_begin()),
+          end(this->token.array_end()), index(0), started(false) { }
+
+    uint32_t items;
+    AdapterType token;
+    array_iterator it;                    //  item being validated
+    array_iterator end;
+    int index;
+    bool started;
+  };
+
+  vector<Object_frame> _objects;
+  vector<Array_frame> _arrays;
+  vector<bool> _is_object;                //  kind of each frame, bottom up
+  vector<uint64_t> _seen;                 //  properties seen by each object
+  size_t _max_depth;
+
+  bool can_push(Validation_result* result) {
+    if (_is_object.size() >= _max_depth) {
+      result->set_error(VALIDATION_TOO_DEEP, "exceeds the maximum depth of " +
+                        std::to_string(_max_depth), nullptr,
+                        "depth <= " + std::to_string(_max_depth),
+                        "depth " + std::to_string(_max_depth + 1));
+      return false;
+    }
+
+    return true;
+  }
+
+  void pop() {
+    if (_is_object.back()) {
+      _seen.resize(_objects.back().seen);
+      _objects.pop_back();
+    } else {
+      _arrays.pop_back();
+    }
+
+    _is_object.pop_back();
+  }
+
+  void clear() {
+    _objects.clear();
+    _arrays.clear();
+    _is_object.clear();
+    _seen.clear();
+  }
+
+  public:
+  explicit Compiled_schema_stack(size_t max_depth = COMPILED_SCHEMA_MAX_DEPTH)
+      : _max_depth(max_depth) { }
+
+  size_t max_depth() const {
+    return _max_depth;
+  }
+};
+
+/**
+ * Read only view of a compiled schema blob.
+ *
+ * The view doesn't own the memory: it may point to a std::string returned
+ * by Schema_compiler, to a Mapped_schema_file or to any other buffer that
+ * outlives it. A view is immutable, so it can be shared between threads.
+ */
+class Compiled_schema {
+  private:
+  const char* _data;
+  const Compiled_schema_header* _header;
+  const Compiled_schema_node* _nodes;
+  const Compiled_schema_property* _properties;
+  const uint32_t* _values;
+  const char* _strings;
+
+  static bool in_range(uint64_t first, uint64_t count, uint64_t total) {
+    return first <= total && count <= total - first;
+  }
+
+  bool valid_section(uint32_t offset, uint64_t size) const {
+    return offset % 8 == 0 && in_range(offset, size, _header->size);
+  }
+
+  /**
+   * Verifies every index/offset once, so validation can trust the blob
+   *
+   * @return why the blob is invalid, nullptr if it's valid
+   */
+  const char* open(const void* data, size_t size) {
+    _data = static_cast<const char*>(data);
+    _header = reinterpret_cast<const Compiled_schema_header*>(data);
+    if (_data == nullptr || size < sizeof(Compiled_schema_header)) {
+      return "buffer too small";
+    }
+
+    _nodes = reinterpret_cast<const Compiled_schema_node*>(
+               _data + _header->nodes_offset);
+    _properties = reinterpret_cast<const Compiled_schema_property*>(
+                    _data + _header->properties_offset);
+    _values = reinterpret_cast<const uint32_t*>(_data +
+                                                _header->values_offset);
+    _strings = _data + _header->strings_offset;
+
+    if (reinterpret_cast<uintptr_t>(_data) % 8 != 0) {
+      return "buffer must be 8 bytes aligned";
+    } else if (memcmp(_header->magic, COMPILED_SCHEMA_MAGIC, 4) != 0) {
+      return "invalid magic";
+    } else if (_header->version != COMPILED_SCHEMA_VERSION) {
+      return "unknown version";
+    } else if (_header->size > size) {
+      return "truncated buffer";
+    } else if (!valid_section(_header->nodes_offset,
+                              (uint64_t)_header->node_count *
+                              sizeof(Compiled_schema_node))) {
+      return "invalid nodes section";
+    } else if (!valid_section(_header->properties_offset,
+                              (uint64_t)_header->property_count *
+                              sizeof(Compiled_schema_property))) {
+      return "invalid properties section";
+    } else if (!valid_section(_header->values_offset,
+                              (uint64_t)_header->value_count *
+                              sizeof(uint32_t))) {
+      return "invalid values section";
+    } else if (!valid_section(_header->strings_offset,
+                              _header->strings_size)) {
+      return "invalid strings section";
+    } else if (_header->strings_size == 0 ||
+               _strings[_header->strings_size - 1] != '\0') {
+      return "invalid strings";
+    } else if (_header->root >= _header->node_count) {
+      return "invalid root";
+    }
+
+    for (uint32_t i = 0; i < _header->node_count; ++i) {
+      const Compiled_schema_node& node = _nodes[i];
+      if (node.type == COMPILED_OBJECT) {
+        if (!in_range(node.first, node.count, _header->property_count)) {
+          return "invalid object node";
+        }
+      } else if (node.type == COMPILED_ARRAY) {
+        if (node.first != COMPILED_SCHEMA_NO_NODE &&
+            node.first >= _header->node_count) {
+          return "invalid array node";
+        }
+      } else if (node.type == COMPILED_STRING ||
+                 node.type == COMPILED_INT ||
+                 node.type == COMPILED_BOOLEAN) {
+        if ((node.flags & COMPILED_HAS_ENUM) &&
+            !in_range(node.first, node.count, _header->value_count)) {
+          return "invalid enum";
+        }
+      } else {
+        return "invalid node type";
+      }
+
+      if ((node.flags & COMPILED_HAS_DEFAULT) &&
+          node.type != COMPILED_STRING && node.type != COMPILED_INT &&
+          node.type != COMPILED_BOOLEAN) {
+        return "invalid default value";
+      }
+
+      if (node.type == COMPILED_STRING) {
+        for (uint32_t v = 0; (node.flags & COMPILED_HAS_ENUM) &&
+             v < node.count; ++v) {
+          if (_values[node.first + v] >= _header->strings_size) {
+            return "invalid enum string";
+          }
+        }
+
+        if ((node.flags & COMPILED_HAS_DEFAULT) &&
+            (uint64_t)node.default_value >= _header->strings_size) {
+          return "invalid default string";
+        }
+      }
+    }
+
+    for (uint32_t i = 0; i < _header->property_count; ++i) {
+      const Compiled_schema_property& property = _properties[i];
+      if (property.key >= _header->strings_size ||
+          ((property.flags & COMPILED_FORBIDDEN) ?
+            property.node != COMPILED_SCHEMA_NO_NODE ||
+            (property.flags & COMPILED_REQUIRED) :
+            property.node >= _header->node_count)) {
+        return "invalid property";
+      }
+    }
+
+    return nullptr;
+  }
+
+  Compiled_schema() { }
+
+  const Compiled_schema_property* find_property(const Compiled_schema_node&
+                                                node, const char* key) const {
+    const Compiled_schema_property* first = _properties + node.first;
+    const Compiled_schema_property* last = first + node.count;
+    while (first < last) {
+      const Compiled_schema_property* middle = first + (last - first) / 2;
+      int comparison = strcmp(string_at(middle->key), key);
+      if (comparison == 0) {
+        return middle;
+      } else if (comparison < 0) {
+        first = middle + 1;
+      } else {
+        last = middle;
+      }
+    }
+
+    return nullptr;
+  }
+
+  bool has_int_value(const Compiled_schema_node& node, int value) const {
+    const uint32_t* first = _values + node.first;
+    const uint32_t* last = first + node.count;
+    while (first < last) {
+      const uint32_t* middle = first + (last - first) / 2;
+      int middle_value = (int32_t)*middle;
+      if (middle_value == value) {
+        return true;
+      } else if (middle_value < value) {
+        first = middle + 1;
+      } else {
+        last = middle;
+      }
+    }
+
+    return false;
+  }
+
+  bool has_string_value(const Compiled_schema_node& node,
+                        const char* value) const {
+    const uint32_t* first = _values + node.first;
+    const uint32_t* last = first + node.count;
+    while (first < last) {
+      const uint32_t* middle = first + (last - first) / 2;
+      int comparison = strcmp(string_at(*middle), value);
+      if (comparison == 0) {
+        return true;
+      } else if (comparison < 0) {
+        first = middle + 1;
+      } else {
+        last = middle;
+      }
+    }
+
+    return false;
+  }
+
+  /**
+   * Expected value of enum errors, as the builder validators write it
+   */
+  string one_of(const Compiled_schema_node& node, bool strings) const {
+    string expected = "one of [";
+    for (uint32_t i = 0; i < node.count; ++i) {
+      expected += i == 0 ? "" : ", ";
+      if (strings) {
+        expected += string("\"") + string_at(_values[node.first + i]) + "\"";
+      } else {
+        expected += std::to_string((int32_t)_values[node.first + i]);
+      }
+    }
+
+    return expected + "]";
+  }
+
+  /**
+   * Error messages are the same ones reported by the builder validators
+   */
+  template<typename AdapterType>
+  bool validate_int(const Compiled_schema_node& node,
+                    const json_adapters::JSON_adapter<AdapterType>& token,
+                    Validation_result* result) const {
+    if (!token.is_number()) {
+      result->set_error(VALIDATION_WRONG_TYPE, "should be an int", &node,
+                        "integer", token.type_name());
+      return false;
+    }
+
+    int64_t value = token.get_integer();
+    if ((node.flags & COMPILED_HAS_ENUM) && !has_int_value(node, value)) {
+      result->set_error(VALIDATION_NOT_ALLOWED,
+                        "Value " + std::to_string(value) + " not allowed",
+                        &node, one_of(node, false), std::to_string(value));
+      return false;
+    }
+
+    if ((node.flags & COMPILED_HAS_MIN) && value < node.min) {
+      result->set_error(VALIDATION_BELOW_MINIMUM,
+                        "min_value = " + std::to_string(node.min) +
+                        " received = " + std::to_string(value), &node,
+                        ">= " + std::to_string(node.min),
+                        std::to_string(value));
+      return false;
+    }
+
+    if ((node.flags & COMPILED_HAS_MAX) && value > node.max) {
+      result->set_error(VALIDATION_ABOVE_MAXIMUM,
+                        "max_value = " + std::to_string(node.max) +
+                        " received = " + std::to_string(value), &node,
+                        "<= " + std::to_string(node.max),
+                        std::to_string(value));
+      return false;
+    }
+
+    return true;
+  }
+
+  template<typename AdapterType>
+  bool validate_string(const Compiled_schema_node& node,
+                       const json_adapters::JSON_adapter<AdapterType>& token,
+                       Validation_result* result) const {
+    if (!token.is_string()) {
+      result->set_error(VALIDATION_WRONG_TYPE, "must be a string", &node,
+                        "string", token.type_name());
+      return false;
+    }
+
+    string value = token.get_string();
+    if ((node.flags & COMPILED_HAS_ENUM) &&
+        !has_string_value(node, value.c_str())) {
+      result->set_error(VALIDATION_NOT_ALLOWED,
+                        "Value \"" + value + "\" not allowed", &node,
+                        one_of(node, true), "\"" + value + "\"");
+      return false;
+    }
+
+    if ((node.flags & COMPILED_HAS_MAX) && (int64_t)value.size() > node.max) {
+      result->set_error(VALIDATION_ABOVE_MAXIMUM,
+                        "has length " + std::to_string(value.size()) +
+                        " but max_length is " + std::to_string(node.max),
+                        &node, "length <= " + std::to_string(node.max),
+                        "length " + std::to_string(value.size()));
+      return false;
+    }
+
+    return true;
+  }
+
+  template<typename AdapterType>
+  bool validate_boolean(const Compiled_schema_node& node,
+                        const json_adapters::JSON_adapter<AdapterType>& token,
+                        Validation_result* result) const {
+    if (!token.is_boolean()) {
+      result->set_error(VALIDATION_WRONG_TYPE, "should be a boolean", &node,
+                        "boolean", token.type_name());
+      return false;
+    }
+
+    if ((node.flags & COMPILED_HAS_ENUM) && node.count == 1 &&
+        token.get_boolean() != (_values[node.first] != 0)) {
+      result->set_error(VALIDATION_NOT_ALLOWED, "should have value: " +
+                        std::to_string(_values[node.first]), &node,
+                        _values[node.first] ? "true" : "false",
+                        _values[node.first] ? "false" : "true");
+      return false;
+    }
+
+    return true;
+  }
+
+  template<typename AdapterType>
+  bool begin_array(uint32_t index, const AdapterType& token,
+                   Compiled_schema_stack<AdapterType>* stack,
+                   Validation_result* result) const {
+    const Compiled_schema_node& node = _nodes[index];
+    if (!token.is_array()) {
+      result->set_error(VALIDATION_WRONG_TYPE, "must be an array", &node,
+                        "array", token.type_name());
+      return false;
+    }
+
+    int64_t size = token.get_array_size();
+    if ((node.flags & COMPILED_HAS_MIN) && size < node.min) {
+      result->set_error(VALIDATION_BELOW_MINIMUM,
+                        "length must be greater then " +
+                        std::to_string(node.min), &node,
+                        ">= " + std::to_string(node.min) + " items",
+                        std::to_string(size) + " items");
+      return false;
+    }
+
+    if ((node.flags & COMPILED_HAS_MAX) && size > node.max) {
+      result->set_error(VALIDATION_ABOVE_MAXIMUM,
+                        "length must be less then " +
+                        std::to_string(node.max), &node,
+                        "<= " + std::to_string(node.max) + " items",
+                        std::to_string(size) + " items");
+      return false;
+    }
+
+    int duplicated_index = 0;
+    Validation_budget* budget = result->budget();
+    if ((node.flags & COMPILED_UNIQUE) &&
+        !Array_validator<AdapterType>::has_unique_items(token,
+                                                        &duplicated_index,
+                                                        budget)) {
+      if (budget != nullptr && budget->exceeded()) {
+        budget->set_error(result);
+      } else {
+        result->set_error(VALIDATION_DUPLICATED_ITEM, "duplicated item",
+                          &node, "unique items", "a repeated item");
+      }
+      result->add_index(duplicated_index);
+      return false;
+    }
+
+    if (node.first == COMPILED_SCHEMA_NO_NODE || size == 0) {
+      return true;
+    }
+
+    if (!stack->can_push(result)) {
+      return false;
+    }
+
+    stack->_arrays.emplace_back(node.first, token);
+    stack->_is_object.push_back(false);
+    return true;
+  }
+
+  /**
+   * Validates the next item of the array on top of the stack
+   */
+  template<typename AdapterType>
+  bool step_array(Compiled_schema_stack<AdapterType>* stack,
+                  Validation_result* result) const {
+    auto& frame = stack->_arrays.back();
+    if (frame.started) {
+      ++frame.it;
+      frame.index++;
+    }
+
+    if (frame.it == frame.end) {
+      stack->pop();
+      return true;
+    }
+
+    frame.started = true;
+    return validate_node(frame.items, json_adapter_factory(frame.it), stack,
+                         result);
+  }
+
+  template<typename AdapterType>
+  void set_default_value(const Compiled_schema_property& property,
+                         AdapterType* token) const {
+    const Compiled_schema_node& node = _nodes[property.node];
+    string key = string_at(property.key);
+    if (node.type == COMPILED_INT) {
+      token->add_field(key, static_cast<int>(node.default_value));
+    } else if (node.type == COMPILED_BOOLEAN) {
+      token->add_field(key, node.default_value != 0);
+    } else {
+      token->add_field(key, string(string_at(node.default_value)));
+    }
+  }
+
+  template<typename AdapterType>
+  bool begin_object(uint32_t index, const AdapterType& token,
+                    Compiled_schema_stack<AdapterType>* stack,
+                    Validation_result* result) const {
+    if (!token.is_object()) {
+      result->set_error(VALIDATION_WRONG_TYPE, "field must be an object",
+                        &_nodes[index], "object", token.type_name());
+      return false;
+    }
+
+    if (_nodes[index].count == 0) {
+      return true;
+    }
+
+    if (!stack->can_push(result)) {
+      return false;
+    }
+
+    //  One bit per declared property, to find missing ones at the end
+    size_t seen = stack->_seen.size();
+    stack->_seen.resize(seen + (_nodes[index].count + 63) / 64, 0);
+    stack->_objects.emplace_back(index, token, seen);
+    stack->_is_object.push_back(true);
+    return true;
+  }
+
+  /**
+   * Validates the next declared property of the object on top of the stack
+   *  and, once all of them were seen, the required ones and the defaults
+   */
+  template<typename AdapterType>
+  bool step_object(Compiled_schema_stack<AdapterType>* stack,
+                   Validation_result* result) const {
+    auto& frame = stack->_objects.back();
+    const Compiled_schema_node& node = _nodes[frame.node];
+    uint64_t* seen = &stack->_seen[frame.seen];
+    if (frame.started) {
+      ++frame.it;
+      frame.started = false;
+    }
+
+    for (; frame.it != frame.end; ++frame.it) {
+      string key = frame.it.get_name();
+      const Compiled_schema_property* property =
+        find_property(node, key.c_str());
+      if (property == nullptr) {
+        continue;
+      }
+
+      if (property->flags & COMPILED_FORBIDDEN) {
+        result->set_error(VALIDATION_FORBIDDEN_KEY,
+                          "'" + key + "' key is not allowed", &node,
+                          "no key '" + key + "'", "key '" + key + "'");
+        stack->pop();
+        return false;
+      }
+
+      uint32_t position = property - (_properties + node.first);
+      seen[position / 64] |= (uint64_t)1 << (position % 64);
+      frame.started = true;
+      return validate_node(property->node, json_adapter_factory(frame.it),
+                           stack, result);
+    }
+
+    for (uint32_t i = 0; i < node.count; ++i) {
+      if ((seen[i / 64] >> (i % 64)) & 1) {
+        continue;
+      }
+
+      const Compiled_schema_property& property = _properties[node.first + i];
+      if (property.flags & COMPILED_FORBIDDEN) {
+        continue;
+      } else if (_nodes[property.node].flags & COMPILED_HAS_DEFAULT) {
+        set_default_value(property, &frame.token);
+      } else if (property.flags & COMPILED_REQUIRED) {
+        string key = string_at(property.key);
+        result->set_error(VALIDATION_REQUIRED, key + " is required", &node,
+                          "key '" + key + "'", "no such key");
+        stack->pop();
+        return false;
+      }
+    }
+
+    stack->pop();
+    return true;
+  }
+
+  /**
+   * Scalars are validated right away, containers are pushed on the stack
+   */
+  template<typename AdapterType>
+  bool validate_node(uint32_t index, const AdapterType& token,
+                     Compiled_schema_stack<AdapterType>* stack,
+                     Validation_result* result) const {
+    Validation_budget* budget = result->budget();
+    if (budget != nullptr && !budget->spend()) {
+      budget->set_error(result);
+      return false;
+    }
+
+    const Compiled_schema_node& node = _nodes[index];
+    switch (node.type) {
+      case COMPILED_OBJECT:
+        return begin_object(index, token, stack, result);
+      case COMPILED_ARRAY:
+        return begin_array(index, token, stack, result);
+      case COMPILED_STRING:
+        return validate_string(node, token, result);
+      case COMPILED_INT:
+        return validate_int(node, token, result);
+      default:
+        return validate_boolean(node, token, result);
+    }
+  }
+
+  /**
+   * Adds the position of the failed value inside each open container
+   *  (innermost first, like the builder validators do)
+   */
+  template<typename AdapterType>
+  void set_error_path(Compiled_schema_stack<AdapterType>* stack,
+                      Validation_result* result) const {
+    size_t objects = stack->_objects.size();
+    size_t arrays = stack->_arrays.size();
+    for (size_t i = stack->_is_object.size(); i-- > 0;) {
+      if (stack->_is_object[i]) {
+        string key = stack->_objects[--objects].it.get_name();
+        if (key != "") {
+          result->add_key(key);
+        }
+      } else {
+        result->add_index(stack->_arrays[--arrays].index);
+      }
+    }
+  }
+
+  public:
+  /**
+   * @throws std::invalid_argument if data doesn't hold a valid blob
+   */
+  Compiled_schema(const void* data, size_t size) {
+    const char* error = open(data, size);
+    if (error != nullptr) {
+      raise_error(std::invalid_argument(string("Compiled_schema: ") + error));
+    }
+  }
+
+  explicit Compiled_schema(const string& blob)
+      : Compiled_schema(blob.data(), blob.size()) { }
+
+  /**
+   * Checks a blob without raising (blobs read from a file or the network
+   *  can be rejected without exceptions)
+   *
+   * @param error receives why it's invalid, if not null
+   */
+  static bool is_valid(const void* data, size_t size,
+                       string* error = nullptr) {
+    Compiled_schema schema;
+    const char* reason = schema.open(data, size);
+    if (reason != nullptr && error != nullptr) {
+      *error = string("Compiled_schema: ") + reason;
+    }
+
+    return reason == nullptr;
+  }
+
+  static bool is_valid(const string& blob, string* error = nullptr) {
+    return is_valid(blob.data(), blob.size(), error);
+  }
+
+  /**
+   * Validates a document from an explicit stack: recursive schemas ($ref)
+   *  can't overflow the C++ stack, documents nested deeper than
+   *  stack->max_depth() are rejected.
+   *
+   * A stack can be reused by consecutive validations (it keeps its memory)
+   * but not shared between threads.
+   */
+  template<typename AdapterType>
+  Validation_result_ptr validate(
+      const json_adapters::JSON_adapter<AdapterType>& token,
+      Compiled_schema_stack<AdapterType>* stack) const {
+    return validate(token, stack,
+                    Validation_result_ptr(new Validation_result()));
+  }
+
+  /**
+   * Same as above, but reuses (after a reset) a previous result
+   */
+  template<typename AdapterType>
+  Validation_result_ptr validate(
+      const json_adapters::JSON_adapter<AdapterType>& token,
+      Compiled_schema_stack<AdapterType>* stack,
+      Validation_result_ptr result) const {
+    result->reset();
+    stack->clear();
+    bool success = validate_node(_header->root,
+                                 static_cast<const AdapterType&>(token),
+                                 stack, result.get());
+    while (success && !stack->_is_object.empty()) {
+      success = stack->_is_object.back() ? step_object(stack, result.get())
+                                         : step_array(stack, result.get());
+    }
+
+    if (!success) {
+      set_error_path(stack, result.get());
+    }
+
+    return result;
+  }
+
+  template<typename AdapterType>
+  Validation_result_ptr validate(
+      const json_adapters::JSON_adapter<AdapterType>& token) const {
+    Compiled_schema_stack<AdapterType> stack;
+    return validate(token, &stack);
+  }
+
+  const char* string_at(uint64_t offset) const {
+    return _strings + offset;
+  }
+
+  const Compiled_schema_header& header() const {
+    return *_header;
+  }
+
+  const Compiled_schema_node& node(uint32_t index) const {
+    return _nodes[index];
+  }
+
+  const Compiled_schema_property& property(uint32_t index) const {
+    return _properties[index];
+  }
+
+  uint32_t value(uint32_t index) const {
+    return _values[index];
+  }
+
+  const void* data() const {
+    return _data;
+  }
+
+  size_t size() const {
+    return _header->size;
+  }
+};
+
+/**
+ * A bundle stores many compiled schemas (eg: one per tenant) in a single
+ *  blob, so a whole service can be started with a single mmap.
+ *
+ *    [header][entries sorted by name][names][schemas]
+ */
+const char SCHEMA_BUNDLE_MAGIC[4] = {'J', 'V', 'S', 'B'};
+
+struct Schema_bundle_header {
+  char magic[4];
+  uint32_t version;
+  uint64_t size;
+  uint32_t entry_count;
+  uint32_t reserved;
+};
+
+struct Schema_bundle_entry {
+  uint64_t name;                  //  offset of the name from the bundle start
+  uint64_t schema;                //  offset of the schema from the bundle start
+  uint32_t schema_size;
+  uint32_t reserved;
+};
+
+/**
+ * Builds a bundle blob from compiled schemas
+ */
+class Schema_bundle_writer {
+  private:
+  vector<std::pair<string, string>> _schemas;
+
+  static void align(string* blob) {
+    blob->resize((blob->size() + 7) & ~(size_t)7, '\0');
+  }
+
+  public:
+  void add(const string& name, const string& compiled_schema) {
+    _schemas.push_back({name, compiled_schema});
+  }
+
+  string write() {
+    std::sort(_schemas.begin(), _schemas.end());
+    for (size_t i = 1; i < _schemas.size(); ++i) {
+      if (_schemas[i].first == _schemas[i - 1].first) {
+        raise_error(std::invalid_argument(
+            "Schema_bundle_writer: duplicated name '" + _schemas[i].first +
+            "'"));
+      }
+    }
+
+    vector<Schema_bundle_entry> entries(_schemas.size());
+    string blob(sizeof(Schema_bundle_header) +
+                entries.size() * sizeof(Schema_bundle_entry), '\0');
+    for (size_t i = 0; i < _schemas.size(); ++i) {
+      entries[i].name = blob.size();
+      blob.append(_schemas[i].first.c_str(), _schemas[i].first.size() + 1);
+    }
+
+    for (size_t i = 0; i < _schemas.size(); ++i) {
+      align(&blob);
+      entries[i].schema = blob.size();
+      entries[i].schema_size = _schemas[i].second.size();
+      blob.append(_schemas[i].second);
+    }
+
+    align(&blob);
+    Schema_bundle_header header;
+    memcpy(header.magic, SCHEMA_BUNDLE_MAGIC, 4);
+    header.version = COMPILED_SCHEMA_VERSION;
+    header.size = blob.size();
+    header.entry_count = entries.size();
+    header.reserved = 0;
+    memcpy(&blob[0], &header, sizeof(header));
+    if (!entries.empty()) {
+      memcpy(&blob[sizeof(header)], entries.data(),
+             entries.size() * sizeof(Schema_bundle_entry));
+    }
+
+    return blob;
+  }
+};
+
+/**
+ * Read only view of a bundle. Schemas are looked up by name with a binary
+ * search and only checked (Compiled_schema constructor) when found.
+ */
+class Schema_bundle {
+  private:
+  const char* _data;
+  const Schema_bundle_header* _header;
+  const Schema_bundle_entry* _entries;
+
+  public:
+  Schema_bundle(const void* data, size_t size)
+      : _data(static_cast<const char*>(data)),
+        _header(reinterpret_cast<const Schema_bundle_header*>(data)),
+        _entries(reinterpret_cast<const Schema_bundle_entry*>(
+                   _data + sizeof(Schema_bundle_header))) {
+    if (_data == nullptr || size < sizeof(Schema_bundle_header) ||
+        reinterpret_cast<uintptr_t>(_data) % 8 != 0 ||
+        memcmp(_header->magic, SCHEMA_BUNDLE_MAGIC, 4) != 0 ||
+        _header->version != COMPILED_SCHEMA_VERSION ||
+        _header->size > size ||
+        (_header->size - sizeof(Schema_bundle_header)) /
+          sizeof(Schema_bundle_entry) < _header->entry_count) {
+      raise_error(std::invalid_argument("Schema_bundle: invalid bundle"));
+    }
+
+    for (uint32_t i = 0; i < _header->entry_count; ++i) {
+      if (_entries[i].name >= _header->size ||
+          memchr(_data + _entries[i].name, '\0',
+                 _header->size - _entries[i].name) == nullptr ||
+          _entries[i].schema > _header->size ||
+          _entries[i].schema_size > _header->size - _entries[i].schema) {
+        raise_error(std::invalid_argument("Schema_bundle: invalid entry"));
+      }
+    }
+  }
+
+  explicit Schema_bundle(const string& blob)
+      : Schema_bundle(blob.data(), blob.size()) { }
+
+  size_t size() const {
+    return _header->entry_count;
+  }
+
+  const char* name(size_t index) const {
+    return _data + _entries[index].name;
+  }
+
+  Compiled_schema schema(size_t index) const {
+    return Compiled_schema(_data + _entries[index].schema,
+                           _entries[index].schema_size);
+  }
+
+  /**
+   * @throws std::out_of_range if there is no schema with this name
+   */
+  Compiled_schema find(const char* name) const {
+    size_t first = 0;
+    size_t last = _header->entry_count;
+    while (first < last) {
+      size_t middle = first + (last - first) / 2;
+      int comparison = strcmp(this->name(middle), name);
+      if (comparison == 0) {
+        return schema(middle);
+      } else if (comparison < 0) {
+        first = middle + 1;
+      } else {
+        last = middle;
+      }
+    }
+
+    raise_error(std::out_of_range(string("Schema_bundle: no schema named ") +
+                                  name));
+  }
+};
+
+/**
+ * Read only, shared memory map of a file holding a compiled schema or a
+ *  bundle. Processes mapping the same file share its pages.
+ */
+class Mapped_schema_file {
+  private:
+  void* _data;
+  size_t _size;
+
+  public:
+  explicit Mapped_schema_file(const string& path)
+      : _data(MAP_FAILED), _size(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      raise_error(std::runtime_error("Mapped_schema_file: can't open " +
+                                     path));
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+      _size = file_stat.st_size;
+      _data = mmap(nullptr, _size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+
+    close(fd);
+    if (_data == MAP_FAILED) {
+      raise_error(std::runtime_error("Mapped_schema_file: can't map " +
+                                     path));
+    }
+  }
+
+  ~Mapped_schema_file() {
+    munmap(_data, _size);
+  }
+
+  Mapped_schema_file(const Mapped_schema_file&) = delete;
+  Mapped_schema_file& operator=(const Mapped_schema_file&) = delete;
+
+  const void* data() const {
+    return _data;
+  }
+
+  size_t size() const {
+    return _size;
+  }
+
+  Compiled_schema schema() const {
+    return Compiled_schema(_data, _size);
+  }
+
+  Schema_bundle bundle() const {
+    return Schema_bundle(_data, _size);
+  }
+};
+}  // namespace json_validator
+#endif
@@ -0,0 +1,743 @@
+#ifndef CJSON_VALIDATOR_DOCUMENT_GENERATOR_HPP
+#define CJSON_VALIDATOR_DOCUMENT_GENERATOR_HPP
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error_handling.hpp"
+#include "validator.hpp"
+#include "object_validator.hpp"
+#include "array_validator.hpp"
+#include "string_validator.hpp"
+#include "int_validator.hpp"
+#include "boolean_validator.hpp"
+#include "schema_loader.hpp"
+#include "json_adapters/cjson_adapter.hpp"
+
+namespace json_validator {
+using std::pair;
+using std::set;
+using std::string;
+using std::vector;
+
+/**
+ * What the generated documents look like, where the schema leaves a choice:
+ *  the schema always wins (an array of minItems 10 gets at least 10 items
+ *  whatever max_items is).
+ */
+struct Generator_options {
+  uint64_t seed = 0;
+  uint64_t min_items = 0;             //  arrays
+  uint64_t max_items = 8;
+  size_t min_string_length = 1;       //  strings without enum
+  size_t max_string_length = 16;
+  int min_integer = 0;
+  int max_integer = 1000000;
+  double optional_keys = 1;           //  chance of each key not required
+};
+
+/**
+ * How an invalid document breaks its schema. MUTATE_ANY picks one of the
+ *  kinds that apply to the value chosen.
+ */
+enum Mutation_kind {
+  MUTATE_ANY,
+  MUTATE_WRONG_TYPE,
+  MUTATE_ABOVE_MAXIMUM,       //  integer, string length or array length
+  MUTATE_BELOW_MINIMUM,       //  integer or array length
+  MUTATE_NOT_ALLOWED,         //  outside of the enum
+  MUTATE_DUPLICATED_ITEM,     //  of an array of unique items
+  MUTATE_MISSING_REQUIRED,    //  key of an object
+  MUTATE_FORBIDDEN_KEY,       //  added to an object
+  MUTATION_KINDS
+};
+
+/**
+ * Where an invalid document breaks: among the values 'depth' levels below
+ *  the root (0 is the root itself) whose validator 'kind' applies to, in
+ *  document order, the one at 'position' (0 the first, 1 the last).
+ */
+struct Mutation {
+  size_t depth;
+  double position;
+  Mutation_kind kind;
+};
+
+/**
+ * Generates json documents from a validator tree (or a json-schema, loaded
+ * by Schema_loader first): valid ones, and invalid ones breaking a single
+ * value chosen by a Mutation, so benchmark corpora follow real schemas.
+ *
+ *  Document_generator generator(json_schema, options);
+ *  string corpus;
+ *  for (uint64_t i = 0; i < documents; ++i) {
+ *    generator.append_valid(i, &corpus);
+ *    corpus.push_back('\n');
+ *  }
+ *
+ * Document i only depends on the options, the seed and i (not on the
+ * documents generated before), so corpora can be generated in parallel
+ * and regenerated on any machine: the random numbers come from splitmix64,
+ * not from the implementation defined <random> distributions.
+ *
+ * Documents are written as text, without building a tree. Keys come in
+ * the order of the validators (sorted), values are integers, strings of
+ * [a-zA-Z0-9_-] (no escapes) or enum values, booleans, objects and
+ * arrays. Items of arrays without an items validator are integers.
+ * Unique items are drawn again when they repeat; an array whose items
+ * can't be unique enough stops growing (below minItems if it has to).
+ */
+class Document_generator {
+  enum Type { OBJECT, ARRAY, STRING, INTEGER, BOOLEAN };
+
+  static const size_t NONE = static_cast<size_t>(-1);
+
+  //  Longest value a mutation writes on purpose (strings, arrays)
+  static const uint64_t MAX_MUTATION_SIZE = 1 << 16;
+
+  struct Property {
+    string key;           //  "name": as it is written
+    string segment;       //  /name as a json pointer segment
+    size_t node;
+    bool required;        //  always written
+    bool missing_fails;   //  required without default value
+  };
+
+  /**
+   * What the generator keeps of a validator: everything it needs, with
+   *  the ranges of the options already applied
+   */
+  struct Node {
+    Type type;
+    vector<Property> properties;
+    vector<string> forbidden_keys;        //  written
+    size_t items;
+    uint64_t shortest;                    //  lengths to draw from (arrays
+    uint64_t longest;                     //   and strings)
+    uint64_t minimum_length;              //  of the schema
+    uint64_t maximum_length;
+    bool unique;
+    vector<string> strings;               //  enum, written
+    set<string> allowed_strings;
+    vector<int> integers;                 //  enum
+    int64_t minimum;                      //  of the schema
+    int64_t maximum;
+    int64_t low;                          //  valid values to draw from
+    int64_t high;
+    int fixed;                            //  boolean: -1 if any
+  };
+
+  /**
+   * splitmix64 (http://prng.di.unimi.it/splitmix64.c)
+   */
+  class Random {
+    uint64_t _state;
+
+    public:
+    explicit Random(uint64_t seed) : _state(seed) { }
+
+    uint64_t next() {
+      uint64_t z = (_state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      return z ^ (z >> 31);
+    }
+
+    /**
+     * In [low, high]
+     */
+    uint64_t between(uint64_t low, uint64_t high) {
+      uint64_t range = high - low + 1;
+      return range == 0 ? next() : low + next() % range;
+    }
+
+    bool chance(double probability) {
+      return (next() >> 11) * (1.0 / 9007199254740992.0) < probability;
+    }
+  };
+
+  /**
+   * A value a mutation can replace: [begin, end) of the output
+   */
+  struct Target {
+    size_t node;
+    size_t begin;
+    size_t end;
+    string pointer;
+  };
+
+  /**
+   * State of one document. Targets are only collected, and the pointer
+   *  only kept, for invalid documents.
+   */
+  struct Walk {
+    Random random;
+    bool tracking;
+    size_t depth;
+    Mutation_kind kind;
+    string pointer;
+    vector<Target> targets;
+  };
+
+  Generator_options _options;
+  vector<Node> _nodes;
+
+  static void error(const string& path, const string& message) {
+    raise_error(std::invalid_argument("document generator error at '" +
+                                      path + "': " + message));
+  }
+
+  static void append_json_string(const string& value, string* out) {
+    out->push_back('"');
+    for (char c : value) {
+      if (c == '"' || c == '\\') {
+        out->push_back('\\');
+        out->push_back(c);
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+        out->append(escaped);
+      } else {
+        out->push_back(c);
+      }
+    }
+
+    out->push_back('"');
+  }
+
+  /**
+   * Most of what is written: much faster than snprintf
+   */
+  static void append_integer(int64_t value, string* out) {
+    char number[24];
+    char* end = number + sizeof(number);
+    char* digits = end;
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) :
+                                     static_cast<uint64_t>(value);
+    do {
+      *--digits = static_cast<char>('0' + magnitude % 10);
+      magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (value < 0) {
+      *--digits = '-';
+    }
+
+    out->append(digits, end - digits);
+  }
+
+  /**
+   * [low, high] of the options within [minimum, maximum] of the schema,
+   *  or the schema bound closest to them when they don't overlap
+   */
+  template<typename T>
+  static pair<T, T> intersect(T low, T high, T minimum, T maximum) {
+    if (high < minimum) {
+      return {minimum, minimum};
+    } else if (low > maximum) {
+      return {maximum, maximum};
+    }
+
+    return {std::max(low, minimum), std::min(high, maximum)};
+  }
+
+  template<typename AdapterType, typename Instrumentation>
+  size_t add(Validator<AdapterType, Instrumentation>* validator,
+             const string& path) {
+    using Object = Object_validator<AdapterType, Instrumentation>;
+    using Array = Array_validator<AdapterType, Instrumentation>;
+    using String = String_validator<AdapterType, Instrumentation>;
+    using Int = Int_validator<AdapterType, Instrumentation>;
+    using Boolean = Boolean_validator<AdapterType, Instrumentation>;
+
+    size_t index = _nodes.size();
+    _nodes.push_back(Node());
+    Node node = Node();
+    node.items = NONE;
+    node.fixed = -1;
+    if (auto object = dynamic_cast<Object*>(validator)) {
+      node.type = OBJECT;
+      for (auto& it : object->validators()) {
+        Property property;
+        append_json_string(it.first, &property.key);
+        property.key.push_back(':');
+        property.segment = "/";
+        for (char c : it.first) {
+          property.segment += c == '~' ? "~0" : c == '/' ? "~1" : string(1, c);
+        }
+
+        property.node = add(it.second, path + property.segment);
+        property.required = it.second->required();
+        property.missing_fails = property.required &&
+                                 !it.second->has_default_value();
+        node.properties.push_back(std::move(property));
+      }
+
+      for (auto& key : object->forbidden_keys()) {
+        string written;
+        append_json_string(key, &written);
+        node.forbidden_keys.push_back(written + ":null");
+      }
+    } else if (auto array = dynamic_cast<Array*>(validator)) {
+      node.type = ARRAY;
+      node.minimum_length = array->minimum_length();
+      node.maximum_length = array->maximum_length();
+      node.unique = array->unique_items();
+      auto items = intersect(_options.min_items, _options.max_items,
+                             node.minimum_length, node.maximum_length);
+      node.shortest = items.first;
+      node.longest = items.second;
+      if (array->items_validator() != nullptr) {
+        node.items = add(array->items_validator(), path + "/items");
+      }
+    } else if (auto string_validator = dynamic_cast<String*>(validator)) {
+      node.type = STRING;
+      node.maximum_length = string_validator->maximum_length();
+      node.allowed_strings = string_validator->possible_values();
+      for (auto& value : node.allowed_strings) {
+        if (value.size() <= node.maximum_length) {
+          node.strings.push_back(string());
+          append_json_string(value, &node.strings.back());
+        }
+      }
+
+      auto lengths = intersect<uint64_t>(_options.min_string_length,
+                                         _options.max_string_length, 0,
+                                         node.maximum_length);
+      node.shortest = lengths.first;
+      node.longest = lengths.second;
+    } else if (auto int_validator = dynamic_cast<Int*>(validator)) {
+      node.type = INTEGER;
+      node.minimum = int_validator->minimum();
+      node.maximum = int_validator->maximum();
+      for (int value : int_validator->possible_values()) {
+        if (value >= node.minimum && value <= node.maximum) {
+          node.integers.push_back(value);
+        }
+      }
+
+      auto values = intersect<int64_t>(_options.min_integer,
+                                       _options.max_integer, node.minimum,
+                                       node.maximum);
+      node.low = values.first;
+      node.high = values.second;
+    } else if (auto boolean = dynamic_cast<Boolean*>(validator)) {
+      node.type = BOOLEAN;
+      node.fixed = boolean->has_fixed_value() ? boolean->fixed_value() : -1;
+    } else {
+      error(path, "unsupported validator");
+    }
+
+    _nodes[index] = std::move(node);
+    return index;
+  }
+
+  static bool required_key(const Node& node) {
+    for (auto& property : node.properties) {
+      if (property.missing_fails) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool applies(const Node& node, Mutation_kind kind) const {
+    switch (kind) {
+      case MUTATE_ANY:
+      case MUTATE_WRONG_TYPE:
+        return true;
+      case MUTATE_ABOVE_MAXIMUM:
+        return node.type == INTEGER ?
+            node.maximum < std::numeric_limits<int>::max() :
+            (node.type == STRING || node.type == ARRAY) &&
+            node.maximum_length < MAX_MUTATION_SIZE;
+      case MUTATE_BELOW_MINIMUM:
+        return node.type == INTEGER ?
+            node.minimum > std::numeric_limits<int>::min() :
+            node.type == ARRAY && node.minimum_length > 0 &&
+            node.minimum_length <= MAX_MUTATION_SIZE;
+      case MUTATE_NOT_ALLOWED:
+        return (node.type == STRING && !node.allowed_strings.empty()) ||
+               (node.type == INTEGER && !node.integers.empty()) ||
+               (node.type == BOOLEAN && node.fixed != -1);
+      case MUTATE_DUPLICATED_ITEM:
+        return node.type == ARRAY && node.unique && node.maximum_length >= 2;
+      case MUTATE_MISSING_REQUIRED:
+        return node.type == OBJECT && required_key(node);
+      case MUTATE_FORBIDDEN_KEY:
+        return node.type == OBJECT && !node.forbidden_keys.empty();
+      default:
+        return false;
+    }
+  }
+
+  static void append_string(size_t length, Walk* walk, string* out) {
+    static const char alphabet[] =
+        "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_-";
+    out->push_back('"');
+    uint64_t bits = 0;
+    for (size_t i = 0; i < length; ++i) {
+      if (i % 10 == 0) {
+        bits = walk->random.next();
+      }
+
+      out->push_back(alphabet[bits & 63]);
+      bits >>= 6;
+    }
+
+    out->push_back('"');
+  }
+
+  /**
+   * Takes back what was written from 'size' on
+   */
+  static void rewind(size_t size, Walk* walk, string* out) {
+    out->resize(size);
+    while (!walk->targets.empty() && walk->targets.back().end > size) {
+      walk->targets.pop_back();
+    }
+  }
+
+  /**
+   * Items of an array, 'count' of them unless they are 'distinct': those
+   *  are drawn again (up to 8 times) when they repeat a previous one, and
+   *  the array ends when they still do. Returns how many were written;
+   *  'first_end' receives where the first one ends.
+   */
+  uint64_t append_items(const Node& node, uint64_t count, bool distinct,
+                        size_t depth, Walk* walk, string* out,
+                        size_t* first_end = nullptr) const {
+    set<string> seen;
+    size_t mark = walk->pointer.size();
+    uint64_t i = 0;
+    for (; i < count; ++i) {
+      size_t begin = out->size() + (i > 0);
+      bool unique = false;
+      for (int attempt = 0; attempt < 8 && !unique; ++attempt) {
+        rewind(begin - (i > 0), walk, out);
+        if (i > 0) {
+          out->push_back(',');
+        }
+
+        if (walk->tracking && depth < walk->depth) {
+          char index[24];
+          snprintf(index, sizeof(index), "/%" PRIu64, i);
+          walk->pointer.resize(mark);
+          walk->pointer += index;
+        }
+
+        if (node.items == NONE) {
+          append_integer(walk->random.between(_options.min_integer,
+                                              _options.max_integer), out);
+        } else {
+          append_value(node.items, depth + 1, walk, out);
+        }
+
+        unique = !distinct ||
+                 seen.insert(out->substr(begin, out->size() - begin)).second;
+      }
+
+      if (!unique) {
+        rewind(begin - (i > 0), walk, out);
+        break;
+      }
+
+      if (i == 0 && first_end != nullptr) {
+        *first_end = out->size();
+      }
+    }
+
+    walk->pointer.resize(mark);
+    return i;
+  }
+
+  void append_value(size_t index, size_t depth, Walk* walk,
+                    string* out) const {
+    const Node& node = _nodes[index];
+    size_t begin = out->size();
+    switch (node.type) {
+      case OBJECT: {
+        out->push_back('{');
+        size_t mark = walk->pointer.size();
+        bool first = true;
+        for (auto& property : node.properties) {
+          if (!property.required &&
+              (_options.optional_keys <= 0 ||
+               !walk->random.chance(_options.optional_keys))) {
+            continue;
+          }
+
+          if (!first) {
+            out->push_back(',');
+          }
+
+          first = false;
+          out->append(property.key);
+          if (walk->tracking && depth < walk->depth) {
+            walk->pointer.resize(mark);
+            walk->pointer += property.segment;
+          }
+
+          append_value(property.node, depth + 1, walk, out);
+        }
+
+        walk->pointer.resize(mark);
+        out->push_back('}');
+        break;
+      }
+      case ARRAY:
+        out->push_back('[');
+        append_items(node, walk->random.between(node.shortest, node.longest),
+                     node.unique, depth, walk, out);
+        out->push_back(']');
+        break;
+      case STRING:
+        if (!node.allowed_strings.empty()) {
+          //  No value fits when all of them are too long
+          out->append(node.strings.empty() ? "\"\"" :
+                      node.strings[walk->random.next() % node.strings.size()]);
+        } else {
+          append_string(walk->random.between(node.shortest, node.longest),
+                        walk, out);
+        }
+
+        break;
+      case INTEGER:
+        if (!node.integers.empty()) {
+          append_integer(node.integers[walk->random.next() %
+                                       node.integers.size()], out);
+        } else {
+          append_integer(node.low + static_cast<int64_t>(walk->random.between(
+              0, static_cast<uint64_t>(node.high - node.low))), out);
+        }
+
+        break;
+      case BOOLEAN:
+        out->append((node.fixed == -1 ? walk->random.next() & 1 : node.fixed) ?
+                    "true" : "false");
+        break;
+    }
+
+    if (walk->tracking && depth == walk->depth &&
+        applies(node, walk->kind)) {
+      walk->targets.push_back({index, begin, out->size(), walk->pointer});
+    }
+  }
+
+  /**
+   * Writes a value of node 'index' breaking it in the way 'kind' says (its
+   *  descendants are valid). Returns what to add to its pointer to get the
+   *  one of the failure: duplicates are reported at their index.
+   */
+  string append_mutation(size_t index, Mutation_kind kind, Walk* walk,
+                         string* out) const {
+    static const char* const wrong_types[] = {
+      "[]", "{}", "0", "\"0\"", "null"
+    };
+
+    const Node& node = _nodes[index];
+    switch (kind) {
+      case MUTATE_ABOVE_MAXIMUM:
+        if (node.type == INTEGER) {
+          append_integer(node.maximum + 1, out);
+        } else if (node.type == STRING) {
+          append_string(node.maximum_length + 1, walk, out);
+        } else {
+          //  Repeated items could be reported before the length
+          string items = "[";
+          uint64_t count = node.maximum_length + 1;
+          bool long_enough = append_items(node, count, node.unique, 0, walk,
+                                          &items) == count;
+          out->append(long_enough ? items + "]" : wrong_types[node.type]);
+        }
+
+        break;
+      case MUTATE_BELOW_MINIMUM:
+        if (node.type == INTEGER) {
+          append_integer(node.minimum - 1, out);
+        } else {
+          out->push_back('[');
+          append_items(node, node.minimum_length - 1, node.unique, 0, walk,
+                       out);
+          out->push_back(']');
+        }
+
+        break;
+      case MUTATE_NOT_ALLOWED:
+        if (node.type == STRING) {
+          string value;
+          do {
+            value.clear();
+            append_string(walk->random.between(1, 16), walk, &value);
+          } while (node.allowed_strings.count(
+              value.substr(1, value.size() - 2)) != 0);
+          out->append(value);
+        } else if (node.type == INTEGER) {
+          append_integer(static_cast<int64_t>(node.integers.back()) + 1, out);
+        } else {
+          out->append(node.fixed ? "false" : "true");
+        }
+
+        break;
+      case MUTATE_DUPLICATED_ITEM: {
+        //  Distinct items, then a copy of the first one
+        uint64_t count = std::max<uint64_t>(
+            2, walk->random.between(node.shortest, node.longest));
+        count = std::min(count, node.maximum_length);
+        string items = "[";
+        size_t first_end = 0;
+        uint64_t copy = append_items(node, count - 1, true, 0, walk, &items,
+                                     &first_end);
+        out->append(items);
+        out->push_back(',');
+        out->append(items, 1, first_end - 1);
+        out->push_back(']');
+
+        char suffix[24];
+        snprintf(suffix, sizeof(suffix), "/%" PRIu64, copy);
+        return suffix;
+      }
+      case MUTATE_MISSING_REQUIRED:
+      case MUTATE_FORBIDDEN_KEY: {
+        vector<size_t> required;
+        for (size_t i = 0; i < node.properties.size(); ++i) {
+          if (node.properties[i].missing_fails) {
+            required.push_back(i);
+          }
+        }
+
+        size_t missing = kind == MUTATE_MISSING_REQUIRED ?
+            required[walk->random.next() % required.size()] : NONE;
+        out->push_back('{');
+        if (kind == MUTATE_FORBIDDEN_KEY) {
+          out->append(node.forbidden_keys[walk->random.next() %
+                                          node.forbidden_keys.size()]);
+        }
+
+        for (size_t i = 0; i < node.properties.size(); ++i) {
+          const Property& property = node.properties[i];
+          if (i == missing || (!property.required &&
+                               !walk->random.chance(_options.optional_keys))) {
+            continue;
+          }
+
+          if (out->back() != '{') {
+            out->push_back(',');
+          }
+
+          out->append(property.key);
+          append_value(property.node, 1, walk, out);
+        }
+
+        out->push_back('}');
+        break;
+      }
+      default:
+        out->append(wrong_types[node.type]);
+        break;
+    }
+
+    return string();
+  }
+
+  Random random(uint64_t index) const {
+    //  Neighbouring indexes and seeds give unrelated sequences
+    Random mixer(_options.seed);
+    return Random(mixer.next() ^ (index * 0xd1b54a32d192ed03ULL));
+  }
+
+  public:
+  /**
+   * Reads the tree once: it isn't kept. Any validator but Object, Array,
+   *  String, Int and Boolean ones throws std::invalid_argument.
+   */
+  template<typename AdapterType, typename Instrumentation>
+  explicit Document_generator(Validator<AdapterType, Instrumentation>* root,
+                              const Generator_options& options =
+                                  Generator_options())
+      : _options(options) {
+    add(root, "#");
+  }
+
+  /**
+   * From a json-schema, with the keywords Schema_loader supports
+   */
+  explicit Document_generator(const string& json_schema,
+                              const Generator_options& options =
+                                  Generator_options())
+      : _options(options) {
+    add(Schema_loader<json_adapters::CJSON_adapter>::load(json_schema).get(),
+        "#");
+  }
+
+  const Generator_options& options() const {
+    return _options;
+  }
+
+  /**
+   * Appends valid document 'index' to 'out'
+   */
+  void append_valid(uint64_t index, string* out) const {
+    Walk walk = {random(index), false, 0, MUTATE_ANY, string(), {}};
+    append_value(0, 0, &walk, out);
+  }
+
+  /**
+   * Appends document 'index' with one value broken as 'mutation' says.
+   *  Validator trees report the failure at 'pointer' (a json pointer,
+   *  duplicated items at the index of the copy). Nothing
+   *  is appended, and false returned, when no value of the document
+   *  matches the mutation.
+   */
+  bool append_invalid(uint64_t index, const Mutation& mutation, string* out,
+                      string* pointer = nullptr) const {
+    Walk walk = {random(index), true, mutation.depth, mutation.kind,
+                 string(), {}};
+    size_t begin = out->size();
+    append_value(0, 0, &walk, out);
+    if (walk.targets.empty()) {
+      out->resize(begin);
+      return false;
+    }
+
+    double position = std::min(1.0, std::max(0.0, mutation.position));
+    Target target = std::move(walk.targets[static_cast<size_t>(
+        std::floor(position * (walk.targets.size() - 1) + 0.5))]);
+    walk.targets.clear();
+    Mutation_kind kind = mutation.kind;
+    if (kind == MUTATE_ANY) {
+      vector<Mutation_kind> kinds;
+      for (int k = MUTATE_WRONG_TYPE; k < MUTATION_KINDS; ++k) {
+        if (applies(_nodes[target.node], static_cast<Mutation_kind>(k))) {
+          kinds.push_back(static_cast<Mutation_kind>(k));
+        }
+      }
+
+      kind = kinds[walk.random.next() % kinds.size()];
+    }
+
+    walk.tracking = false;
+    string value;
+    string suffix = append_mutation(target.node, kind, &walk, &value);
+    out->replace(target.begin, target.end - target.begin, value);
+    if (pointer != nullptr) {
+      *pointer = target.pointer + suffix;
+    }
+
+    return true;
+  }
+};
+
+}  // namespace json_validator
+
+#endif
@@ -0,0 +1,362 @@
+#ifndef CJSON_VALIDATOR_DOCUMENT_LIMITS_HPP
+#define CJSON_VALIDATOR_DOCUMENT_LIMITS_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "validation_result.hpp"
+#include "validator.hpp"
+#include "json_adapters/adapter.hpp"
+
+namespace json_validator {
+using std::string;
+using std::vector;
+
+/**
+ * Hard limits on the shape of untrusted documents, so one payload can't
+ *  monopolise a worker (or overflow its stack) with 100k nested arrays, a
+ *  50MB string or millions of items. Each limit has its own error code:
+ *
+ *  max_depth          VALIDATION_TOO_DEEP         nested objects and arrays
+ *  max_nodes          VALIDATION_TOO_MANY_NODES   values, containers included
+ *  max_string_bytes   VALIDATION_STRING_TOO_LONG  of a string or key, as
+ *                                                 written (escapes included)
+ *  max_array_length   VALIDATION_ARRAY_TOO_LONG   items of an array
+ *  max_object_keys    VALIDATION_TOO_MANY_KEYS    keys of an object
+ *
+ * Everything is unlimited by default. They are enforced on the text before
+ *  it's parsed (Document_scanner, Validation_pipeline::Options::limits),
+ *  while it's streamed (Streaming_validator) and on parsed documents
+ *  (check(), Limited_validator). All of them stop at the first value past a
+ *  limit, so the time spent on a document is bounded by the limits, not by
+ *  its size.
+ */
+struct Document_limits {
+  Document_limits()
+      : max_depth(SIZE_MAX), max_nodes(SIZE_MAX), max_string_bytes(SIZE_MAX),
+        max_array_length(SIZE_MAX), max_object_keys(SIZE_MAX) { }
+
+  size_t max_depth;
+  size_t max_nodes;
+  size_t max_string_bytes;
+  size_t max_array_length;
+  size_t max_object_keys;
+
+  bool unlimited() const {
+    return max_depth == SIZE_MAX && max_nodes == SIZE_MAX &&
+           max_string_bytes == SIZE_MAX && max_array_length == SIZE_MAX &&
+           max_object_keys == SIZE_MAX;
+  }
+
+  /**
+   * Limit of a VALIDATION_TOO_DEEP, ..., VALIDATION_TOO_MANY_KEYS error
+   */
+  size_t limit(Validation_error_code code) const {
+    switch (code) {
+      case VALIDATION_TOO_DEEP: return max_depth;
+      case VALIDATION_TOO_MANY_NODES: return max_nodes;
+      case VALIDATION_STRING_TOO_LONG: return max_string_bytes;
+      case VALIDATION_ARRAY_TOO_LONG: return max_array_length;
+      default: return max_object_keys;
+    }
+  }
+
+  /**
+   * Sets the error of exceeding the limit of 'code' (the pointer is left to
+   *  the caller), eg: "exceeds the limit of 64 nested containers",
+   *  expected "<= 64 nested containers", actual "more than 64"
+   */
+  void set_error(Validation_error_code code, Validation_result* result,
+                 const string& where = "") const {
+    static const char* const units[] = {
+      "nested containers", "nodes", "string bytes", "array items",
+      "object keys"
+    };
+
+    const char* unit = units[code == VALIDATION_TOO_DEEP ? 0 :
+                             code - VALIDATION_TOO_MANY_NODES + 1];
+    string limit = std::to_string(this->limit(code));
+    result->set_error(code, "exceeds the limit of " + limit + " " + unit +
+                      where, nullptr, "<= " + limit + " " + unit,
+                      "more than " + limit);
+  }
+
+  /**
+   * Checks a parsed document. The walk is recursive, but never goes deeper
+   *  than max_depth.
+   *
+   * @return false with the error (and the pointer to the value past the
+   *  limit) in 'result'
+   */
+  template<typename AdapterType>
+  bool check(const json_adapters::JSON_adapter<AdapterType>& token,
+             Validation_result* result) const {
+    uint64_t nodes = 0;
+    return check(token, 0, &nodes, result);
+  }
+
+  private:
+  template<typename AdapterType>
+  bool check(const json_adapters::JSON_adapter<AdapterType>& token,
+             size_t depth, uint64_t* nodes, Validation_result* result) const {
+    if (++*nodes > max_nodes) {
+      set_error(VALIDATION_TOO_MANY_NODES, result);
+      return false;
+    }
+
+    if (token.is_string()) {
+      if (token.get_string().size() > max_string_bytes) {
+        set_error(VALIDATION_STRING_TOO_LONG, result);
+        return false;
+      }
+
+      return true;
+    }
+
+    if (!token.is_object() && !token.is_array()) {
+      return true;
+    }
+
+    if (depth >= max_depth) {
+      set_error(VALIDATION_TOO_DEEP, result);
+      return false;
+    }
+
+    uint64_t members = 0;
+    if (token.is_object()) {
+      for (auto it = token.object_begin(); it != token.object_end(); ++it) {
+        auto member = json_adapter_factory(it);
+        string key = member.get_name();
+        if (++members > max_object_keys || key.size() > max_string_bytes) {
+          set_error(members > max_object_keys ? VALIDATION_TOO_MANY_KEYS :
+                    VALIDATION_STRING_TOO_LONG, result);
+          return false;
+        }
+
+        if (!check(member, depth + 1, nodes, result)) {
+          result->add_key(key);
+          return false;
+        }
+      }
+    } else {
+      for (auto it = token.array_begin(); it != token.array_end(); ++it) {
+        if (++members > max_array_length) {
+          set_error(VALIDATION_ARRAY_TOO_LONG, result);
+          return false;
+        }
+
+        if (!check(json_adapter_factory(it), depth + 1, nodes, result)) {
+          result->add_index(members - 1);
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+};
+
+/**
+ * Checks the text of a document against Document_limits before it's
+ *  parsed (cJSON_Parse recurses once per nesting level and allocates every
+ *  value whatever its size). Syntax isn't checked, that's left to the
+ *  parser. One scan is linear in the bytes read and stops at the first one
+ *  past a limit; a scanner reused across documents doesn't allocate once
+ *  its stack has grown.
+ *
+ *    Document_scanner scanner(limits);
+ *    if (!scanner.check(text, &result)) {
+ *      // result says which limit and at which byte
+ *    }
+ */
+class Document_scanner {
+  private:
+  struct Container {
+    bool is_object;
+    bool expects_key;
+    uint64_t members;
+  };
+
+  Document_limits _limits;
+  vector<Container> _open;
+  uint64_t _nodes;
+
+  bool fail(Validation_error_code code, size_t offset,
+            Validation_result* result) {
+    _limits.set_error(code, result, " at byte " + std::to_string(offset));
+    return false;
+  }
+
+  /**
+   * A value (not a key) starts at 'offset'
+   */
+  bool value(size_t offset, Validation_result* result) {
+    if (++_nodes > _limits.max_nodes) {
+      return fail(VALIDATION_TOO_MANY_NODES, offset, result);
+    }
+
+    if (!_open.empty() && !_open.back().is_object &&
+        ++_open.back().members > _limits.max_array_length) {
+      return fail(VALIDATION_ARRAY_TOO_LONG, offset, result);
+    }
+
+    return true;
+  }
+
+  public:
+  explicit Document_scanner(const Document_limits& limits = Document_limits())
+      : _limits(limits), _nodes(0) { }
+
+  const Document_limits& limits() const {
+    return _limits;
+  }
+
+  /**
+   * @return false with the error in 'result' if the text has a value past
+   *  a limit
+   */
+  bool check(const char* text, size_t size, Validation_result* result) {
+    _open.clear();
+    _nodes = 0;
+    bool in_scalar = false;
+    for (size_t i = 0; i < size; ++i) {
+      char c = text[i];
+      switch (c) {
+        case '"': {
+          in_scalar = false;
+          if (!_open.empty() && _open.back().expects_key) {
+            _open.back().expects_key = false;
+            if (++_open.back().members > _limits.max_object_keys) {
+              return fail(VALIDATION_TOO_MANY_KEYS, i, result);
+            }
+          } else if (!value(i, result)) {
+            return false;
+          }
+
+          //  Reads one byte past the limit at most
+          size_t start = ++i;
+          size_t end = size - start > _limits.max_string_bytes ?
+                       start + _limits.max_string_bytes + 1 : size;
+          for (; i < end && text[i] != '"'; ++i) {
+            i += text[i] == '\\';
+          }
+
+          if (i - start > _limits.max_string_bytes) {
+            return fail(VALIDATION_STRING_TOO_LONG, start - 1, result);
+          }
+
+          break;
+        }
+        case '{':
+        case '[':
+          in_scalar = false;
+          if (!value(i, result)) {
+            return false;
+          }
+
+          if (_open.size() >= _limits.max_depth) {
+            return fail(VALIDATION_TOO_DEEP, i, result);
+          }
+
+          _open.push_back({c == '{', c == '{', 0});
+          break;
+        case '}':
+        case ']':
+          in_scalar = false;
+          if (!_open.empty()) {
+            _open.pop_back();
+          }
+
+          break;
+        case ',':
+          in_scalar = false;
+          if (!_open.empty() && _open.back().is_object) {
+            _open.back().expects_key = true;
+          }
+
+          break;
+        case ':':
+        case ' ':
+        case '\t':
+        case '\n':
+        case '\r':
+          in_scalar = false;
+          break;
+        default:
+          //  First byte of a number or literal
+          if (!in_scalar && !value(i, result)) {
+            return false;
+          }
+
+          in_scalar = true;
+      }
+    }
+
+    return true;
+  }
+
+  bool check(const string& text, Validation_result* result) {
+    return check(text.data(), text.size(), result);
+  }
+};
+
+/**
+ * Checks the limits of every document before the validator it wraps (and
+ *  owns) sees it. It's meant for the root: documents are checked as a
+ *  whole, so their time is bounded by the limits whatever the schema.
+ *
+ *  Limited_validator<CJSON_adapter> validator(root_validator, limits);
+ */
+template<typename AdapterType, typename Instrumentation = No_instrumentation>
+class Limited_validator : public Validator<AdapterType, Instrumentation> {
+  public:
+  using JSON_token = json_adapters::JSON_adapter<AdapterType>;
+  using Validator_t = Validator<AdapterType, Instrumentation>;
+
+  private:
+  Validator_t* _validator;
+  Document_limits _limits;
+
+  public:
+  Limited_validator(Validator_t* validator, const Document_limits& limits)
+      : _validator(validator), _limits(limits) {
+    this->_valdations.push_back([this] (const JSON_token& token,
+                                Validation_result_ptr result) {
+      if (!this->_limits.check(token, result.get())) {
+        return result;
+      }
+
+      return this->_validator->validate(token, std::move(result));
+    });
+  }
+
+  Limited_validator(const Limited_validator&) = delete;
+  Limited_validator& operator=(const Limited_validator&) = delete;
+
+  ~Limited_validator() {
+    delete _validator;
+  }
+
+  Validator_t* required(bool required) override {
+    _validator->required(required);
+    return this;
+  }
+
+  bool required() override {
+    return _validator->required();
+  }
+
+  Validator_t* validator() const {
+    return _validator;
+  }
+
+  const Document_limits& limits() const {
+    return _limits;
+  }
+};
+
+}  // namespace json_validator
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef CJSON_VALIDATOR_ERROR_HANDLING_HPP
+#define CJSON_VALIDATOR_ERROR_HANDLING_HPP
+
+#include <cstdio>
+#include <cstdlib>
+
+/**
+ * Built with -fno-exceptions, the library doesn't throw: errors a
+ *  validation can carry (a validator without default values asked for
+ *  one, a malformed patch, a null cJSON*) are returned through the
+ *  Validation_result, and the others (a misuse, threads that can't be
+ *  created) print their message and abort. Malformed schemas and blobs
+ *  abort too, unless they are checked by the overloads reporting errors
+ *  (Schema_loader::load(json, result), Schema_compiler::compile(json,
+ *  error), Compiled_schema::is_valid, Schema_registry::publish(..., error)).
+ *
+ * Detected from the compiler; it can be defined to 0 to get the same
+ * behaviour with exceptions enabled (in every translation unit).
+ */
+#ifndef JSON_VALIDATOR_EXCEPTIONS
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+#define JSON_VALIDATOR_EXCEPTIONS 1
+#else
+#define JSON_VALIDATOR_EXCEPTIONS 0
+#endif
+#endif
+
+namespace json_validator {
+
+/**
+ * Throws 'error', or prints it and aborts without exceptions: for errors
+ *  no result can carry
+ */
+template<typename Exception>
+[[noreturn]] void raise_error(const Exception& error) {
+#if JSON_VALIDATOR_EXCEPTIONS
+  throw error;
+#else
+  fprintf(stderr, "json_validator: %s\n", error.what());
+  std::abort();
+#endif
+}
+
+/**
+ * Throws 'error', or returns false without exceptions for the caller to
+ *  report it through its result
+ */
+template<typename Exception>
+bool raise_error_or_fail(const Exception& error) {
+#if JSON_VALIDATOR_EXCEPTIONS
+  throw error;
+#else
+  return false;
+#endif
+}
+
+}  // namespace json_validator
+
+#endif
@@ -1,8 +1,10 @@
 #ifndef CJSON_VALIDATOR_INT_VALIDATOR_HPP
 #define CJSON_VALIDATOR_INT_VALIDATOR_HPP
 
+#include <algorithm>
 #include <sstream>
 #include <limits>
+#include <set>
 #include <string>
 #include <vector>
 #include <utility>
@@ -11,8 +13,11 @@
 #include "json_adapters/adapter.hpp"
 
 namespace json_validator {
+using std::set;
 using std::stringstream;
 
+using Int_validator_possible_values_t = set<int>;
+
 /**
  * Int validator is used to validate json keys that contains ints as
  * value.
@@ -20,11 +25,13 @@ using std::stringstream;
  * Currently, this validator verifies:
  *  1) max_value
  *  2) min_value
+ *  3) possible values for the int
  */
-template<typename AdapterType>
-class Int_validator : public Validator<AdapterType> {
+template<typename AdapterType, typename Instrumentation = No_instrumentation>
+class Int_validator : public Validator<AdapterType, Instrumentation> {
   public:
   using JSON_token = json_adapters::JSON_adapter<AdapterType>;
+  using Validator_t = Validator<AdapterType, Instrumentation>;
 
   protected:
   Validation_result_ptr validate_type(const JSON_token& token,
@@ -32,7 +39,8 @@ class Int_validator : public Validator<AdapterType> {
     result->reset();
 
     if (!token.is_number()) {
-      result->set_error("should be an int");
+      result->set_error(VALIDATION_WRONG_TYPE, "should be an int", this,
+                        "integer", token.type_name());
     }
 
     return result;
@@ -49,7 +57,9 @@ class Int_validator : public Validator<AdapterType> {
           std::to_string(max_value) + " received = " +
           std::to_string(token_value);
 
-      result->set_error(error_message);
+      result->set_error(VALIDATION_ABOVE_MAXIMUM, error_message, this,
+                        "<= " + std::to_string(max_value),
+                        std::to_string(token_value));
     }
 
     return result;
@@ -66,18 +76,38 @@ class Int_validator : public Validator<AdapterType> {
           std::to_string(min_value) + " received = " +
           std::to_string(token_value);
 
-      result->set_error(error_message);
+      result->set_error(VALIDATION_BELOW_MINIMUM, error_message, this,
+                        ">= " + std::to_string(min_value),
+                        std::to_string(token_value));
     }
 
     return result;
   }
 
-  void set_default_value(const JSON_token& json, const string& key) override {
+  Validation_result_ptr validate_possible_values(const JSON_token& token,
+                      const Int_validator_possible_values_t& possible_values,
+                                                 Validation_result_ptr result) {
+    result->reset();
+
+    auto token_value = token.get_integer();
+    if (possible_values.find(token_value) == possible_values.end()) {
+      result->set_error(VALIDATION_NOT_ALLOWED,
+                        "Value " + std::to_string(token_value) +
+                        " not allowed", this, this->one_of(possible_values),
+                        std::to_string(token_value));
+    }
+
+    return result;
+  }
+
+  bool set_default_value(const JSON_token& json, const string& key) override {
     this->_set_default_value(json, key, _default_value);
+    return true;
   }
 
   public:
-  Int_validator() {
+  Int_validator() : _minimum(std::numeric_limits<int>::min()),
+                    _maximum(std::numeric_limits<int>::max()) {
     this->_valdations.push_back([this] (const JSON_token& token,
                                 Validation_result_ptr result) {
       return this->validate_type(token, std::move(result));
@@ -85,6 +115,7 @@ class Int_validator : public Validator<AdapterType> {
   }
 
   Int_validator* max_value(int max_value) {
+    _maximum = std::min(_maximum, max_value);
     this->_valdations.push_back([this, max_value] (const JSON_token& token,
                                 Validation_result_ptr result) {
       return this->validate_max_value(token, max_value, std::move(result));
@@ -94,6 +125,7 @@ class Int_validator : public Validator<AdapterType> {
   }
 
   Int_validator* min_value(int min_value) {
+    _minimum = std::max(_minimum, min_value);
     this->_valdations.push_back([this, min_value] (const JSON_token& token,
                                 Validation_result_ptr result) {
       return this->validate_min_value(token, min_value, std::move(result));
@@ -102,14 +134,47 @@ class Int_validator : public Validator<AdapterType> {
     return this;
   }
 
+  Int_validator* valid(const Int_validator_possible_values_t&
+  possible_values) {
+    this->_possible_values = possible_values;
+    this->_valdations.push_back([this] (const JSON_token& token,
+                                Validation_result_ptr result) {
+      return this->validate_possible_values(token, this->_possible_values,
+                                            std::move(result));
+    });
+
+    return this;
+  }
+
   Int_validator* default_value(int default_value) {
     this->_has_default_value = true;
     this->_default_value = default_value;
     return this;
   }
 
+  /**
+   * Tightest bounds set (the limits of int when none was)
+   */
+  int minimum() const {
+    return _minimum;
+  }
+
+  int maximum() const {
+    return _maximum;
+  }
+
+  /**
+   * Values set by valid() (empty if any value is)
+   */
+  const Int_validator_possible_values_t& possible_values() const {
+    return _possible_values;
+  }
+
   private:
     int _default_value;
+    int _minimum;
+    int _maximum;
+    Int_validator_possible_values_t _possible_values;
 };
 }  // namespace json_validator
 #endif
@@ -0,0 +1,336 @@
+#ifndef CJSON_VALIDATOR_ITERATIVE_VALIDATOR_HPP
+#define CJSON_VALIDATOR_ITERATIVE_VALIDATOR_HPP
+
+#include <cstdint>
+#include <string>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "validation_budget.hpp"
+#include "validation_result.hpp"
+#include "validator.hpp"
+#include "object_validator.hpp"
+#include "array_validator.hpp"
+#include "json_adapters/adapter.hpp"
+
+namespace json_validator {
+using std::string;
+using std::vector;
+
+const size_t ITERATIVE_VALIDATOR_MAX_DEPTH = 1024;
+
+/**
+ * Validates documents against a tree of builder validators from an explicit
+ *  stack of (validator, value, iterator) frames instead of the C++ stack,
+ *  so nesting is only bounded by max_depth: deeper documents are rejected
+ *  with VALIDATION_TOO_DEEP (pointing at the first container past it).
+ *
+ *  Iterative_validator<CJSON_adapter> iterative(&root_validator);
+ *  auto result = iterative.validate(token);
+ *
+ * Results (paths, defaults, budgets and instrumentation included) are the
+ * ones of root_validator.validate(). Object_validators and
+ * Array_validators are walked by the stack; any other validator (scalars,
+ * parallel objects and arrays, memoized arrays, subclasses) is validated by a plain
+ * validate() call from its frame, as is the whole document if the result
+ * hands down a Subtree_memo.
+ *
+ * The validator isn't owned. Frames live in vectors that only grow, so a
+ * reused Iterative_validator doesn't allocate per nesting level; it can't be
+ * shared between threads (the validators can).
+ */
+template<typename AdapterType, typename Instrumentation>
+class Iterative_validator {
+  public:
+  using JSON_token = json_adapters::JSON_adapter<AdapterType>;
+  using Validator_t = Validator<AdapterType, Instrumentation>;
+  using Object_validator_t = Object_validator<AdapterType, Instrumentation>;
+  using Array_validator_t = Array_validator<AdapterType, Instrumentation>;
+
+  private:
+  using object_iterator =
+    typename json_adapters::Adapter_traits<AdapterType>::object_iterator;
+  using array_iterator =
+    typename json_adapters::Adapter_traits<AdapterType>::array_iterator;
+  using Probe = typename Instrumentation::Probe;
+
+  struct Object_frame {
+    Object_frame(Object_validator_t* validator, const AdapterType& token,
+                 size_t seen, const Probe& probe)
+        : validator(validator), token(token), it(this->token.object_begin()),
+          end(this->token.object_end()), seen(seen), started(false),
+          probe(probe) { }
+
+    Object_validator_t* validator;
+    AdapterType token;
+    object_iterator it;                   //  key being validated
+    object_iterator end;
+    size_t seen;                          //  first validator in _seen
+    bool started;
+    Probe probe;
+  };
+
+  struct Array_frame {
+    Array_frame(Array_validator_t* validator, const AdapterType& token,
+                const Probe& probe)
+        : validator(validator), token(token), it(this->token.array_begin()),
+          end(this->token.array_end()), index(0), started(false),
+          probe(probe) { }
+
+    Array_validator_t* validator;
+    AdapterType token;
+    array_iterator it;                    //  item being validated
+    array_iterator end;
+    int index;
+    bool started;
+    Probe probe;
+  };
+
+  Validator_t* _validator;
+  size_t _max_depth;
+  vector<Object_frame> _objects;
+  vector<Array_frame> _arrays;
+  vector<bool> _is_object;                //  kind of each frame, bottom up
+  vector<const Validator_t*> _seen;       //  validators of the keys present
+  vector<const Validator_t*> _absent;     //  scratch of validate_absent
+
+  /**
+   * Object_validator without a pool, or Array_validator with items and
+   *  without memoisation or a pool: validators whose members go on the
+   *  stack
+   */
+  Object_validator_t* as_object(Validator_t* validator) const {
+    if (typeid(*validator) != typeid(Object_validator_t)) {
+      return nullptr;
+    }
+
+    auto object = static_cast<Object_validator_t*>(validator);
+    return object->_pool == nullptr ? object : nullptr;
+  }
+
+  Array_validator_t* as_array(Validator_t* validator) const {
+    if (typeid(*validator) != typeid(Array_validator_t)) {
+      return nullptr;
+    }
+
+    auto array = static_cast<Array_validator_t*>(validator);
+    return array->_items_step != SIZE_MAX && !array->_memoize &&
+           array->_pool == nullptr ? array : nullptr;
+  }
+
+  /**
+   * Runs validations [first, last) of 'validator', as Validator::validate
+   *  does
+   */
+  static bool run(Validator_t* validator, size_t first, size_t last,
+                  const AdapterType& token, Validation_result_ptr* result) {
+    for (size_t i = first; i < last; ++i) {
+      *result = validator->_valdations[i](token, std::move(*result));
+      if (!(*result)->success()) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * Starts validating 'token': containers run the validations before their
+   *  members and are pushed on the stack, anything else is validated
+   *  right away. Frame references don't survive a call (the vectors may
+   *  grow).
+   */
+  bool enter(Validator_t* validator, const AdapterType& token,
+             Validation_result_ptr* result) {
+    Object_validator_t* object = as_object(validator);
+    Array_validator_t* array = object == nullptr ? as_array(validator) :
+                                                   nullptr;
+    if (object == nullptr && array == nullptr) {
+      *result = validator->validate(token, std::move(*result));
+      return (*result)->success();
+    }
+
+    Validation_budget* budget = (*result)->budget();
+    if (budget != nullptr && !budget->spend()) {
+      budget->set_error(result->get());
+      return false;
+    }
+
+    Probe probe(&validator->_instrumentation);
+    size_t members = object != nullptr ? Object_validator_t::MEMBERS_STEP :
+                                         array->_items_step;
+    if (!run(validator, 0, members, token, result)) {
+      probe.finish(false);
+      return false;
+    }
+
+    if (_is_object.size() >= _max_depth) {
+      (*result)->set_error(VALIDATION_TOO_DEEP, "exceeds the maximum depth "
+                           "of " + std::to_string(_max_depth), validator,
+                           "depth <= " + std::to_string(_max_depth),
+                           "depth " + std::to_string(_max_depth + 1));
+      probe.finish(false);
+      return false;
+    }
+
+    if (object != nullptr) {
+      (*result)->reset();
+      _objects.emplace_back(object, token, _seen.size(), probe);
+    } else {
+      _arrays.emplace_back(array, token, probe);
+    }
+
+    _is_object.push_back(object != nullptr);
+    return true;
+  }
+
+  /**
+   * Pops the frame on top of the stack once its validator is done with it
+   */
+  bool leave(bool success) {
+    if (_is_object.back()) {
+      _objects.back().probe.finish(success);
+      _seen.resize(_objects.back().seen);
+      _objects.pop_back();
+    } else {
+      _arrays.back().probe.finish(success);
+      _arrays.pop_back();
+    }
+
+    _is_object.pop_back();
+    return success;
+  }
+
+  /**
+   * Validates the next key of the object on top of the stack and, after
+   *  the last one, the required keys and the defaults
+   */
+  bool step_object(Validation_result_ptr* result) {
+    Object_frame& frame = _objects.back();
+    Object_validator_t* validator = frame.validator;
+    if (frame.started) {
+      ++frame.it;
+      frame.started = false;
+    }
+
+    for (; frame.it != frame.end; ++frame.it) {
+      string key(frame.it.get_name());
+      if (validator->is_forbidden_key(key)) {
+        (*result)->set_error(VALIDATION_FORBIDDEN_KEY,
+                             "'" + key + "' key is not allowed", validator,
+                             "no key '" + key + "'", "key '" + key + "'");
+        return leave(false);
+      }
+
+      auto it = validator->_validators.find(key);
+      if (it != validator->_validators.end()) {
+        _seen.push_back(it->second);
+        frame.started = true;
+        return enter(it->second, json_adapter_factory(frame.it), result);
+      }
+    }
+
+    _absent.assign(_seen.begin() + frame.seen, _seen.end());
+    *result = validator->validate_absent(frame.token, &_absent,
+                                         std::move(*result));
+    return leave((*result)->success());
+  }
+
+  /**
+   * Validates the next item of the array on top of the stack and, after
+   *  the last one, the validations that follow the items
+   */
+  bool step_array(Validation_result_ptr* result) {
+    Array_frame& frame = _arrays.back();
+    if (frame.started) {
+      ++frame.it;
+      frame.index++;
+      frame.started = false;
+    }
+
+    if (frame.it != frame.end) {
+      frame.started = true;
+      return enter(frame.validator->_values_validator,
+                   json_adapter_factory(frame.it), result);
+    }
+
+    Array_validator_t* validator = frame.validator;
+    return leave(run(validator, validator->_items_step + 1,
+                     validator->_valdations.size(), frame.token, result));
+  }
+
+  /**
+   * A member failed: adds its position inside each open container
+   *  (innermost first) and closes them
+   */
+  void unwind(Validation_result* result) {
+    while (!_is_object.empty()) {
+      if (_is_object.back()) {
+        string key(_objects.back().it.get_name());
+        if (key != "") {
+          result->add_key(key);
+        }
+      } else {
+        result->add_index(_arrays.back().index);
+      }
+
+      leave(false);
+    }
+  }
+
+  void clear() {
+    _objects.clear();
+    _arrays.clear();
+    _is_object.clear();
+    _seen.clear();
+  }
+
+  public:
+  explicit Iterative_validator(Validator_t* validator,
+                               size_t max_depth =
+                                   ITERATIVE_VALIDATOR_MAX_DEPTH)
+      : _validator(validator), _max_depth(max_depth) { }
+
+  Validation_result_ptr validate(const JSON_token& token) {
+    return validate(token, Validation_result_ptr(new Validation_result()));
+  }
+
+  /**
+   * Same as above, reusing 'result' and whatever it hands down (a
+   *  Validation_budget, or a Subtree_memo: then the validation is
+   *  recursive)
+   */
+  Validation_result_ptr validate(const JSON_token& token,
+                                 Validation_result_ptr result) {
+    if (result->memo() != nullptr) {
+      return _validator->validate(token, std::move(result));
+    }
+
+    clear();
+    bool success = enter(_validator, static_cast<const AdapterType&>(token),
+                         &result);
+    while (success && !_is_object.empty()) {
+      success = _is_object.back() ? step_object(&result) :
+                                    step_array(&result);
+    }
+
+    if (!success) {
+      unwind(result.get());
+    }
+
+    return result;
+  }
+
+  Validator_t* validator() const {
+    return _validator;
+  }
+
+  size_t max_depth() const {
+    return _max_depth;
+  }
+};
+
+}  // namespace json_validator
+
+#endif
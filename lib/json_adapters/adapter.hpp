@@ -44,6 +44,27 @@ class JSON_adapter {
     return is_integer() || is_double();
   }
 
+  /**
+   *  JSON type of the value, for error reports
+   */
+  const char* type_name() const {
+    if (is_object()) {
+      return "object";
+    } else if (is_array()) {
+      return "array";
+    } else if (is_string()) {
+      return "string";
+    } else if (is_integer()) {
+      return "integer";
+    } else if (is_double()) {
+      return "number";
+    } else if (is_boolean()) {
+      return "boolean";
+    }
+
+    return "null";
+  }
+
   /**
    *  Getters
    */
@@ -54,6 +75,14 @@ class JSON_adapter {
   virtual string get_string() const = 0;
   virtual int get_array_size() const = 0;
 
+  /**
+   *  Address of the underlying node, the same for every adapter of that
+   *   node (nullptr if the adapter can't tell nodes apart)
+   */
+  virtual const void* identity() const {
+    return nullptr;
+  }
+
   /**
    *  Setters
    */
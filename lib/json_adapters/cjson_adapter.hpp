@@ -5,6 +5,7 @@
 #include <string>
 
 #include "adapter.hpp"
+#include "../error_handling.hpp"
 #include "cJSON/cJSON.h"
 
 namespace json_validator {
@@ -125,9 +126,16 @@ class CJSON_adapter : public JSON_adapter<CJSON_adapter> {
   typedef Adapter_traits<CJSON_adapter>::object_iterator object_iterator;
   typedef Adapter_traits<CJSON_adapter>::array_iterator array_iterator;
 
+  /**
+   * A null 'json' (eg: cJSON_Parse failed) throws std::invalid_argument or,
+   *  without exceptions, is a value of no type that every type check
+   *  rejects (VALIDATION_WRONG_TYPE)
+   */
   explicit CJSON_adapter(cJSON* json) : _json(json) {
-    if (_json == nullptr) {
-      throw std::invalid_argument("CJSON_adapter: received a null cJSON*");
+    if (_json == nullptr &&
+        !raise_error_or_fail(std::invalid_argument(
+            "CJSON_adapter: received a null cJSON*"))) {
+      _json = no_value();
     }
   }
   explicit CJSON_adapter(object_iterator itr) : _json(itr.operator ->()) { }
@@ -193,6 +201,10 @@ class CJSON_adapter : public JSON_adapter<CJSON_adapter> {
     return cJSON_GetArraySize(_json);
   }
 
+  const void* identity() const override {
+    return _json;
+  }
+
   /**
    *  Setters
    */
@@ -239,24 +251,29 @@ class CJSON_adapter : public JSON_adapter<CJSON_adapter> {
 
   private:
   cJSON* _json;
+
+  static cJSON* no_value() {
+    static cJSON value = cJSON();
+    return &value;
+  }
 };
 
 /**
  * @brief Factory method for json_adapters
  * @param json
  */
-CJSON_adapter json_adapter_factory(cJSON* json) {
+inline CJSON_adapter json_adapter_factory(cJSON* json) {
   return CJSON_adapter(json);
 }
 
 using object_iterator_t =
   typename Adapter_traits<CJSON_adapter>::object_iterator;
-CJSON_adapter json_adapter_factory(object_iterator_t itr) {
+inline CJSON_adapter json_adapter_factory(object_iterator_t itr) {
   return CJSON_adapter(itr);
 }
 
 using array_iterator_t = typename Adapter_traits<CJSON_adapter>::array_iterator;
-CJSON_adapter json_adapter_factory(array_iterator_t itr) {
+inline CJSON_adapter json_adapter_factory(array_iterator_t itr) {
   return CJSON_adapter(itr);
 }
 
@@ -0,0 +1,212 @@
+#ifndef CJSON_VALIDATOR_JSON_SCHEMA_READER_HPP
+#define CJSON_VALIDATOR_JSON_SCHEMA_READER_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include "error_handling.hpp"
+#include "cJSON/cJSON.h"
+
+namespace json_validator {
+using std::string;
+
+/**
+ * Helpers shared by the classes that read json-schema documents
+ *  (Schema_loader and Schema_compiler), so both accept exactly the same
+ *  keywords and report the same errors.
+ */
+class Json_schema_reader {
+  protected:
+  static string*& error_sink() {
+    static thread_local string* sink = nullptr;
+    return sink;
+  }
+
+  /**
+   * While it lives, the errors of the schemas read by this thread are
+   *  written to 'error' (the first one) instead of being raised
+   */
+  class Error_sink {
+    string* _previous;
+
+    public:
+    explicit Error_sink(string* error) : _previous(error_sink()) {
+      error->clear();
+      error_sink() = error;
+    }
+
+    ~Error_sink() {
+      error_sink() = _previous;
+    }
+  };
+
+  /**
+   * Raises the error, or records it if there is an Error_sink: readers then
+   *  go on skipping what's malformed, and what they return is thrown away
+   */
+  static void error(const string& path, const string& message) {
+    string text = "json-schema error at '" + path + "': " + message;
+    string* sink = error_sink();
+    if (sink == nullptr) {
+      raise_error(std::invalid_argument(text));
+    }
+
+    if (sink->empty()) {
+      *sink = text;
+    }
+  }
+
+  static bool failed() {
+    return error_sink() != nullptr && !error_sink()->empty();
+  }
+
+  static bool is_keyword(const cJSON* keyword, const char* name) {
+    return strcmp(keyword->string, name) == 0;
+  }
+
+  /**
+   * cJSON_GetObjectItem is case insensitive, json-schema keywords are not
+   */
+  static const cJSON* find_keyword(const cJSON* schema, const char* name) {
+    for (const cJSON* keyword = schema->child; keyword != nullptr;
+         keyword = keyword->next) {
+      if (is_keyword(keyword, name)) {
+        return keyword;
+      }
+    }
+
+    return nullptr;
+  }
+
+  /**
+   * Path of a property: its name escaped as a json pointer token (RFC 6901),
+   *  so it reads back the way '$ref' pointers are resolved
+   */
+  static string property_path(const string& path, const char* name) {
+    string token(name);
+    for (size_t i = 0; i < token.size(); ++i) {
+      if (token[i] == '~') {
+        token.replace(i++, 1, "~0");
+      } else if (token[i] == '/') {
+        token.replace(i++, 1, "~1");
+      }
+    }
+
+    return path + "/properties/" + token;
+  }
+
+  static bool is_number(const cJSON* value) {
+    return value->type == cJSON_Number;
+  }
+
+  static bool is_boolean(const cJSON* value) {
+    return value->type == cJSON_True || value->type == cJSON_False;
+  }
+
+  /**
+   * A number Int_validator can compare without truncating it
+   */
+  static bool is_integer(const cJSON* value) {
+    return is_number(value) &&
+           value->valuedouble == static_cast<double>(value->valueint);
+  }
+
+  static int get_int(const cJSON* keyword, const string& path) {
+    if (!is_integer(keyword)) {
+      error(path, string("'") + keyword->string + "' must be an integer");
+    }
+
+    return keyword->valueint;
+  }
+
+  static uint64_t get_size(const cJSON* keyword, const string& path) {
+    if (!is_number(keyword) || keyword->valuedouble < 0) {
+      error(path, string("'") + keyword->string +
+                  "' must be a non negative number");
+    }
+
+    return (uint64_t)keyword->valuedouble;
+  }
+
+  static bool get_boolean(const cJSON* keyword, const string& path) {
+    if (!is_boolean(keyword)) {
+      error(path, string("'") + keyword->string + "' must be a boolean");
+    }
+
+    return keyword->type == cJSON_True;
+  }
+
+  static const cJSON* get_array(const cJSON* keyword, const string& path) {
+    if (keyword->type != cJSON_Array) {
+      error(path, string("'") + keyword->string + "' must be an array");
+      static const cJSON no_items = {};
+      return &no_items;
+    }
+
+    return keyword;
+  }
+
+  /**
+   * Values of an integer 'enum' (its items have no name to report)
+   */
+  static std::set<int> get_int_enum(const cJSON* keyword,
+                                    const string& path) {
+    std::set<int> values;
+    for (const cJSON* value = get_array(keyword, path)->child;
+         value != nullptr; value = value->next) {
+      if (!is_integer(value)) {
+        error(path, "'enum' must contain only integers");
+      }
+
+      values.insert(value->valueint);
+    }
+
+    return values;
+  }
+
+  /**
+   * Reads a boolean 'enum': only a single allowed value restricts a boolean
+   *
+   * @return whether it does, and sets 'value' if so
+   */
+  static bool get_boolean_enum(const cJSON* keyword, const string& path,
+                               bool* value) {
+    const cJSON* values = get_array(keyword, path);
+    for (const cJSON* item = values->child; item != nullptr;
+         item = item->next) {
+      if (!is_boolean(item)) {
+        error(path, "'enum' must contain only booleans");
+      }
+    }
+
+    if (values->child == nullptr || values->child->next != nullptr) {
+      return false;
+    }
+
+    *value = values->child->type == cJSON_True;
+    return true;
+  }
+
+  /**
+   * Returns the value of the 'type' keyword of a schema
+   */
+  static const char* get_type(const cJSON* schema, const string& path) {
+    if (schema == nullptr || schema->type != cJSON_Object) {
+      error(path, "schema must be an object");
+      return "";
+    }
+
+    const cJSON* type = find_keyword(schema, "type");
+    if (type == nullptr || type->type != cJSON_String) {
+      error(path, "'type' must be a string");
+      return "";
+    }
+
+    return type->valuestring;
+  }
+};
+}  // namespace json_validator
+#endif
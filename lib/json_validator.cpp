@@ -0,0 +1,15 @@
+/**
+ * Compiled library: the explicit instantiations declared by
+ *  json_validator.hpp, for the targets built with
+ *  JSON_VALIDATOR_COMPILED_LIBRARY
+ */
+#include "json_validator.hpp"
+
+namespace json_validator {
+template class Object_validator<json_adapters::CJSON_adapter>;
+template class Array_validator<json_adapters::CJSON_adapter>;
+template class String_validator<json_adapters::CJSON_adapter>;
+template class Int_validator<json_adapters::CJSON_adapter>;
+template class Boolean_validator<json_adapters::CJSON_adapter>;
+template class Schema_loader<json_adapters::CJSON_adapter>;
+}  // namespace json_validator
@@ -6,6 +6,27 @@
 #include "string_validator.hpp"
 #include "int_validator.hpp"
 #include "boolean_validator.hpp"
+#include "schema_loader.hpp"
 #include "json_adapters/cjson_adapter.hpp"
 
+/**
+ * Linked against the compiled library (lib/json_validator.cpp, the
+ * JSON_VALIDATOR_COMPILED_LIBRARY cmake option), the validators of the
+ * shipped adapters are instantiated once there instead of in every
+ * translation unit including this header. Functions defined in the class
+ * bodies can still be inlined. Validator itself is left to every
+ * translation unit, which devirtualise the calls through it with its vtable
+ * in sight (GCC speculates on targets that can't be, otherwise).
+ */
+#ifdef JSON_VALIDATOR_COMPILED_LIBRARY
+namespace json_validator {
+extern template class Object_validator<json_adapters::CJSON_adapter>;
+extern template class Array_validator<json_adapters::CJSON_adapter>;
+extern template class String_validator<json_adapters::CJSON_adapter>;
+extern template class Int_validator<json_adapters::CJSON_adapter>;
+extern template class Boolean_validator<json_adapters::CJSON_adapter>;
+extern template class Schema_loader<json_adapters::CJSON_adapter>;
+}  // namespace json_validator
+#endif
+
 #endif
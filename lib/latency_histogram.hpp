@@ -0,0 +1,275 @@
+#ifndef CJSON_VALIDATOR_LATENCY_HISTOGRAM_HPP
+#define CJSON_VALIDATOR_LATENCY_HISTOGRAM_HPP
+
+#include <time.h>
+#include <atomic>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+#include "validator.hpp"
+
+namespace json_validator {
+using std::string;
+
+/**
+ * Histogram of latencies (or any unsigned value) in the spirit of
+ * HdrHistogram: values below 128 have their own bucket, larger ones share
+ * 64 buckets per power of two, so percentiles are within 1.6% of the
+ * recorded values, from nanoseconds to centuries, in a fixed 30KB.
+ *
+ * Lock-free: any number of threads can record into the same histogram
+ * (relaxed atomic increments). Contended histograms are better kept per
+ * thread and merged when read.
+ */
+class Latency_histogram {
+  public:
+  static const unsigned SUB_BUCKET_BITS = 7;
+  static const uint64_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const size_t BUCKETS = (64 - SUB_BUCKET_BITS + 2) * SUB_BUCKETS / 2;
+
+  private:
+  std::atomic<uint64_t> _counts[BUCKETS];
+  std::atomic<uint64_t> _count;
+  std::atomic<uint64_t> _sum;
+  std::atomic<uint64_t> _min;
+  std::atomic<uint64_t> _max;
+
+  static void keep_min(std::atomic<uint64_t>* current, uint64_t value) {
+    uint64_t seen = current->load(std::memory_order_relaxed);
+    while (value < seen &&
+           !current->compare_exchange_weak(seen, value,
+                                           std::memory_order_relaxed)) {
+    }
+  }
+
+  static void keep_max(std::atomic<uint64_t>* current, uint64_t value) {
+    uint64_t seen = current->load(std::memory_order_relaxed);
+    while (value > seen &&
+           !current->compare_exchange_weak(seen, value,
+                                           std::memory_order_relaxed)) {
+    }
+  }
+
+  public:
+  Latency_histogram() {
+    reset();
+  }
+
+  Latency_histogram(const Latency_histogram&) = delete;
+  Latency_histogram& operator=(const Latency_histogram&) = delete;
+
+  static size_t bucket(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+      return value;
+    }
+
+    unsigned shift = 63 - __builtin_clzll(value) - (SUB_BUCKET_BITS - 1);
+    return (SUB_BUCKETS / 2) * shift + (value >> shift);
+  }
+
+  static uint64_t bucket_low(size_t bucket) {
+    if (bucket < SUB_BUCKETS) {
+      return bucket;
+    }
+
+    unsigned shift = bucket / (SUB_BUCKETS / 2) - 1;
+    return (bucket % (SUB_BUCKETS / 2) + SUB_BUCKETS / 2) << shift;
+  }
+
+  static uint64_t bucket_high(size_t bucket) {
+    return bucket + 1 < BUCKETS ? bucket_low(bucket + 1) - 1 : UINT64_MAX;
+  }
+
+  /**
+   * Monotonic clock for latencies, in ns
+   */
+  static uint64_t now_ns() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+  }
+
+  void record(uint64_t value, uint64_t count = 1) {
+    _counts[bucket(value)].fetch_add(count, std::memory_order_relaxed);
+    _count.fetch_add(count, std::memory_order_relaxed);
+    _sum.fetch_add(value * count, std::memory_order_relaxed);
+    keep_min(&_min, value);
+    keep_max(&_max, value);
+  }
+
+  /**
+   * Adds the values of 'other' (eg: the histogram of another thread)
+   */
+  void merge(const Latency_histogram& other) {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+      uint64_t count = other._counts[i].load(std::memory_order_relaxed);
+      if (count != 0) {
+        _counts[i].fetch_add(count, std::memory_order_relaxed);
+      }
+    }
+
+    _count.fetch_add(other.count(), std::memory_order_relaxed);
+    _sum.fetch_add(other._sum.load(std::memory_order_relaxed),
+                   std::memory_order_relaxed);
+    keep_min(&_min, other._min.load(std::memory_order_relaxed));
+    keep_max(&_max, other._max.load(std::memory_order_relaxed));
+  }
+
+  /**
+   * Not atomic as a whole: values recorded meanwhile may survive it
+   */
+  void reset() {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+      _counts[i].store(0, std::memory_order_relaxed);
+    }
+
+    _count.store(0, std::memory_order_relaxed);
+    _sum.store(0, std::memory_order_relaxed);
+    _min.store(UINT64_MAX, std::memory_order_relaxed);
+    _max.store(0, std::memory_order_relaxed);
+  }
+
+  uint64_t count() const {
+    return _count.load(std::memory_order_relaxed);
+  }
+
+  uint64_t min() const {
+    return count() == 0 ? 0 : _min.load(std::memory_order_relaxed);
+  }
+
+  uint64_t max() const {
+    return _max.load(std::memory_order_relaxed);
+  }
+
+  double mean() const {
+    uint64_t count = this->count();
+    return count == 0 ? 0 : static_cast<double>(
+        _sum.load(std::memory_order_relaxed)) / count;
+  }
+
+  /**
+   * Highest value of the bucket reached by 'percentile' (0 to 100) of the
+   *  values, bounded by the recorded min and max
+   */
+  uint64_t value_at_percentile(double percentile) const {
+    uint64_t count = this->count();
+    if (count == 0 || percentile <= 0) {
+      return min();
+    }
+
+    double rank = percentile / 100 * count;
+    uint64_t wanted = rank < 1 ? 1 : static_cast<uint64_t>(rank + 0.999999);
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+      seen += _counts[i].load(std::memory_order_relaxed);
+      if (seen >= wanted) {
+        uint64_t value = bucket_high(i);
+        return value < min() ? min() : value > max() ? max() : value;
+      }
+    }
+
+    return max();
+  }
+
+  /**
+   * {"count":3,"min":10,"mean":15.0,"max":20,
+   *  "percentiles":{"50":15,"90":20,"99":20,"99.9":20,"99.99":20},
+   *  "buckets":[[10,10,1],[15,15,1],[20,20,1]]}
+   *
+   * Buckets are [low, high, count], the empty ones left out.
+   */
+  void append_json(string* out) const {
+    static const char* const names[] = {"50", "90", "99", "99.9", "99.99"};
+    static const double percentiles[] = {50, 90, 99, 99.9, 99.99};
+    char number[96];
+    snprintf(number, sizeof(number),
+             "{\"count\":%" PRIu64 ",\"min\":%" PRIu64 ",\"mean\":%.1f"
+             ",\"max\":%" PRIu64 ",\"percentiles\":{", count(), min(),
+             mean(), max());
+    out->append(number);
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(double); ++i) {
+      snprintf(number, sizeof(number), "%s\"%s\":%" PRIu64, i ? "," : "",
+               names[i], value_at_percentile(percentiles[i]));
+      out->append(number);
+    }
+
+    out->append("},\"buckets\":[");
+    bool first = true;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+      uint64_t count = _counts[i].load(std::memory_order_relaxed);
+      if (count != 0) {
+        snprintf(number, sizeof(number),
+                 "%s[%" PRIu64 ",%" PRIu64 ",%" PRIu64 "]", first ? "" : ",",
+                 bucket_low(i), bucket_high(i), count);
+        out->append(number);
+        first = false;
+      }
+    }
+
+    out->append("]}");
+  }
+};
+
+/**
+ * Records the latency of every validate() of the validator it wraps (and
+ *  owns) into a histogram. It can wrap a root or any subtree; defaults of
+ *  the wrapped validator itself are not added by its parent.
+ *
+ *  Latency_histogram latencies;
+ *  Timed_validator<CJSON_adapter> validator(root_validator, &latencies);
+ *  ...
+ *  latencies.value_at_percentile(99.9);
+ */
+template<typename AdapterType, typename Instrumentation = No_instrumentation>
+class Timed_validator : public Validator<AdapterType, Instrumentation> {
+  public:
+  using JSON_token = json_adapters::JSON_adapter<AdapterType>;
+  using Validator_t = Validator<AdapterType, Instrumentation>;
+
+  private:
+  Validator_t* _validator;
+  Latency_histogram* _histogram;
+
+  public:
+  Timed_validator(Validator_t* validator, Latency_histogram* histogram)
+      : _validator(validator), _histogram(histogram) {
+    this->_valdations.push_back([this] (const JSON_token& token,
+                                Validation_result_ptr result) {
+      uint64_t start = Latency_histogram::now_ns();
+      result = this->_validator->validate(token, std::move(result));
+      this->_histogram->record(Latency_histogram::now_ns() - start);
+      return result;
+    });
+  }
+
+  Timed_validator(const Timed_validator&) = delete;
+  Timed_validator& operator=(const Timed_validator&) = delete;
+
+  ~Timed_validator() {
+    delete _validator;
+  }
+
+  Validator_t* required(bool required) override {
+    _validator->required(required);
+    return this;
+  }
+
+  bool required() override {
+    return _validator->required();
+  }
+
+  Validator_t* validator() const {
+    return _validator;
+  }
+
+  Latency_histogram* histogram() const {
+    return _histogram;
+  }
+};
+
+}  // namespace json_validator
+
+#endif
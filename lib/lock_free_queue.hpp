@@ -0,0 +1,205 @@
+#ifndef CJSON_VALIDATOR_LOCK_FREE_QUEUE_HPP
+#define CJSON_VALIDATOR_LOCK_FREE_QUEUE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+
+#include "error_handling.hpp"
+
+namespace json_validator {
+
+const size_t QUEUE_CACHE_LINE_SIZE = 64;
+
+/**
+ * Bounded single producer / single consumer queue.
+ *
+ * A ring of 'capacity' (a power of two) items. The producer only writes the
+ * tail and the consumer the head, each on its own cache line; both sides
+ * keep a cached copy of the other index and only reload it when the queue
+ * looks full (or empty), so most operations touch no shared line at all.
+ */
+template<typename T>
+class Spsc_queue {
+  private:
+  std::unique_ptr<T[]> _items;
+  size_t _mask;
+  char _padding0[QUEUE_CACHE_LINE_SIZE];
+
+  std::atomic<size_t> _head;              //  written by the consumer
+  size_t _cached_tail;
+  char _padding1[QUEUE_CACHE_LINE_SIZE];
+
+  std::atomic<size_t> _tail;              //  written by the producer
+  size_t _cached_head;
+  char _padding2[QUEUE_CACHE_LINE_SIZE];
+
+  public:
+  /**
+   * @throws std::invalid_argument if capacity isn't a power of two
+   */
+  explicit Spsc_queue(size_t capacity)
+      : _items(new T[capacity]), _mask(capacity - 1), _head(0),
+        _cached_tail(0), _tail(0), _cached_head(0) {
+    if (capacity == 0 || (capacity & _mask) != 0) {
+      raise_error(std::invalid_argument(
+          "Spsc_queue: capacity must be a power of 2"));
+    }
+  }
+
+  Spsc_queue(const Spsc_queue&) = delete;
+  Spsc_queue& operator=(const Spsc_queue&) = delete;
+
+  size_t capacity() const {
+    return _mask + 1;
+  }
+
+  /**
+   * @return false if the queue is full
+   */
+  bool try_push(const T& item) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail - _cached_head > _mask) {
+      _cached_head = _head.load(std::memory_order_acquire);
+      if (tail - _cached_head > _mask) {
+        return false;
+      }
+    }
+
+    _items[tail & _mask] = item;
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @return false if the queue is empty
+   */
+  bool try_pop(T* item) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (head == _cached_tail) {
+      _cached_tail = _tail.load(std::memory_order_acquire);
+      if (head == _cached_tail) {
+        return false;
+      }
+    }
+
+    *item = _items[head & _mask];
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return _head.load(std::memory_order_acquire) ==
+           _tail.load(std::memory_order_acquire);
+  }
+};
+
+/**
+ * Bounded multi producer / multi consumer queue (D. Vyukov's algorithm).
+ *
+ * Each cell has a sequence number telling whether it is ready to be written
+ * (sequence == position) or read (sequence == position + 1) in the current
+ * lap, so producers and consumers only contend on their own index with one
+ * compare and swap per operation.
+ */
+template<typename T>
+class Mpmc_queue {
+  private:
+  struct Cell {
+    std::atomic<size_t> sequence;
+    T item;
+  };
+
+  std::unique_ptr<Cell[]> _cells;
+  size_t _mask;
+  char _padding0[QUEUE_CACHE_LINE_SIZE];
+
+  std::atomic<size_t> _enqueue;
+  char _padding1[QUEUE_CACHE_LINE_SIZE];
+
+  std::atomic<size_t> _dequeue;
+  char _padding2[QUEUE_CACHE_LINE_SIZE];
+
+  public:
+  /**
+   * @throws std::invalid_argument if capacity isn't a power of two (>= 2)
+   */
+  explicit Mpmc_queue(size_t capacity)
+      : _cells(new Cell[capacity]), _mask(capacity - 1), _enqueue(0),
+        _dequeue(0) {
+    if (capacity < 2 || (capacity & _mask) != 0) {
+      raise_error(std::invalid_argument(
+          "Mpmc_queue: capacity must be a power of 2"));
+    }
+
+    for (size_t i = 0; i < capacity; ++i) {
+      _cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  Mpmc_queue(const Mpmc_queue&) = delete;
+  Mpmc_queue& operator=(const Mpmc_queue&) = delete;
+
+  size_t capacity() const {
+    return _mask + 1;
+  }
+
+  bool try_push(const T& item) {
+    size_t position = _enqueue.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+      cell = &_cells[position & _mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+      if (difference == 0) {
+        if (_enqueue.compare_exchange_weak(position, position + 1,
+                                           std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        return false;                     //  full
+      } else {
+        position = _enqueue.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->item = item;
+    cell->sequence.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T* item) {
+    size_t position = _dequeue.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+      cell = &_cells[position & _mask];
+      size_t sequence = cell->sequence.load(std::memory_order_acquire);
+      intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+      if (difference == 0) {
+        if (_dequeue.compare_exchange_weak(position, position + 1,
+                                           std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        return false;                     //  empty
+      } else {
+        position = _dequeue.load(std::memory_order_relaxed);
+      }
+    }
+
+    *item = cell->item;
+    cell->sequence.store(position + _mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Only a hint while other threads push or pop
+   */
+  bool empty() const {
+    return _enqueue.load(std::memory_order_acquire) ==
+           _dequeue.load(std::memory_order_acquire);
+  }
+};
+}  // namespace json_validator
+#endif
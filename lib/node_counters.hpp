@@ -0,0 +1,440 @@
+#ifndef CJSON_VALIDATOR_NODE_COUNTERS_HPP
+#define CJSON_VALIDATOR_NODE_COUNTERS_HPP
+
+#include <time.h>
+#include <atomic>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "array_validator.hpp"
+#include "object_validator.hpp"
+
+namespace json_validator {
+using std::pair;
+using std::string;
+using std::vector;
+
+/**
+ * Counts of one validator, summed over the threads (see Node_counters)
+ */
+struct Node_stats {
+  uint64_t invocations;
+  uint64_t failures;
+  uint64_t samples;       //  timed invocations
+  uint64_t ticks;         //  spent in them: cycles on x86, ns elsewhere
+
+  /**
+   * Estimated cost of a call, children included
+   */
+  double ticks_per_call() const {
+    return samples == 0 ? 0 : static_cast<double>(ticks) / samples;
+  }
+};
+
+/**
+ * Instrumentation policy (see Validator) counting the calls of every
+ * validator of a tree and how many of them failed. With SAMPLE_PERIOD > 0,
+ * one call out of SAMPLE_PERIOD of each validator is also timed with the
+ * cycle counter.
+ *
+ *  using Root = Object_validator<CJSON_adapter, Node_counters<64>>;
+ *  ...
+ *  std::cout << Node_counters<64>::json(&root);
+ *
+ * Every validator gets a dense id, and every thread its own table of
+ * counters (one cache line per validator), so validations running in
+ * parallel never write to the same line; aggregate() adds the tables up.
+ * Tables outlive their thread, counts included, and are reused by the
+ * next threads: they are only freed with the process.
+ *
+ * Ids of destroyed validators are reused (their counts zeroed), so trees
+ * can be rebuilt for ever, but at most MAX_NODES validators are counted at
+ * once: the ones created past it aren't (untracked() says how many).
+ */
+template<unsigned SAMPLE_PERIOD = 0>
+class Node_counters {
+  static const size_t CACHE_LINE = 64;
+  static const uint32_t CHUNK_SIZE = 256;
+  static const uint32_t MAX_CHUNKS = 1024;
+
+  public:
+  static const uint32_t MAX_NODES = CHUNK_SIZE * MAX_CHUNKS;   //  262144
+
+  private:
+  struct Counters {
+    std::atomic<uint64_t> invocations;
+    std::atomic<uint64_t> failures;
+    std::atomic<uint64_t> samples;
+    std::atomic<uint64_t> ticks;
+    char padding[CACHE_LINE - 4 * sizeof(std::atomic<uint64_t>)];
+  };
+
+  struct Chunk {
+    Counters counters[CHUNK_SIZE];
+  };
+
+  /**
+   * Chunks are only added, by the thread owning the table
+   */
+  struct Thread_table {
+    std::atomic<Chunk*> chunks[MAX_CHUNKS];
+    std::atomic<bool> owned;
+    Thread_table* next;
+  };
+
+  struct Registry {
+    std::atomic<uint32_t> ids;              //  never used yet from there
+    std::atomic<Thread_table*> tables;
+    std::atomic<uint64_t> untracked;        //  live validators with MAX_NODES
+    std::atomic_flag free_lock;             //  validators come and go rarely
+    vector<uint32_t> free_ids;
+  };
+
+  /**
+   * Gives the table back when its thread exits
+   */
+  struct Thread_owner {
+    Thread_table* table;
+
+    ~Thread_owner() {
+      if (table != nullptr) {
+        table->owned.store(false, std::memory_order_release);
+      }
+    }
+  };
+
+  static Registry& registry() {
+    static Registry registry;
+    return registry;
+  }
+
+  static Thread_table* claim_table() {
+    Registry& tables = registry();
+    for (Thread_table* table = tables.tables.load(std::memory_order_acquire);
+         table != nullptr; table = table->next) {
+      bool owned = false;
+      if (table->owned.compare_exchange_strong(owned, true,
+                                               std::memory_order_acq_rel)) {
+        return table;
+      }
+    }
+
+    Thread_table* table = new Thread_table();
+    table->owned.store(true, std::memory_order_relaxed);
+    table->next = tables.tables.load(std::memory_order_relaxed);
+    while (!tables.tables.compare_exchange_weak(table->next, table,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed)) {
+    }
+
+    return table;
+  }
+
+  /**
+   * A free id, or MAX_NODES if all of them are taken
+   */
+  static uint32_t acquire_id() {
+    Registry& nodes = registry();
+    while (nodes.free_lock.test_and_set(std::memory_order_acquire)) { }
+    if (!nodes.free_ids.empty()) {
+      uint32_t id = nodes.free_ids.back();
+      nodes.free_ids.pop_back();
+      nodes.free_lock.clear(std::memory_order_release);
+      return id;
+    }
+    nodes.free_lock.clear(std::memory_order_release);
+
+    uint32_t id = nodes.ids.load(std::memory_order_relaxed);
+    while (id < MAX_NODES &&
+           !nodes.ids.compare_exchange_weak(id, id + 1,
+                                            std::memory_order_relaxed)) {
+    }
+
+    if (id >= MAX_NODES) {
+      nodes.untracked.fetch_add(1, std::memory_order_relaxed);
+      return MAX_NODES;
+    }
+
+    return id;
+  }
+
+  /**
+   * Zeroes the counts of 'id' (no thread counts it anymore) and makes it
+   *  available to the next validator
+   */
+  static void release_id(uint32_t id) {
+    Registry& nodes = registry();
+    if (id >= MAX_NODES) {
+      nodes.untracked.fetch_sub(1, std::memory_order_relaxed);
+      return;
+    }
+
+    for (Thread_table* table = nodes.tables.load(std::memory_order_acquire);
+         table != nullptr; table = table->next) {
+      Chunk* chunk =
+          table->chunks[id / CHUNK_SIZE].load(std::memory_order_acquire);
+      if (chunk != nullptr) {
+        clear(&chunk->counters[id % CHUNK_SIZE]);
+      }
+    }
+
+    while (nodes.free_lock.test_and_set(std::memory_order_acquire)) { }
+    nodes.free_ids.push_back(id);
+    nodes.free_lock.clear(std::memory_order_release);
+  }
+
+  static void clear(Counters* counters) {
+    counters->invocations.store(0, std::memory_order_relaxed);
+    counters->failures.store(0, std::memory_order_relaxed);
+    counters->samples.store(0, std::memory_order_relaxed);
+    counters->ticks.store(0, std::memory_order_relaxed);
+  }
+
+  static Chunk* new_chunk() {
+    char* memory = new char[sizeof(Chunk) + CACHE_LINE];
+    uintptr_t address = reinterpret_cast<uintptr_t>(memory);
+    address = (address + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1);
+    return new(reinterpret_cast<void*>(address)) Chunk();
+  }
+
+  /**
+   * Counters of validator 'id' for the calling thread
+   */
+  static Counters* counters(uint32_t id) {
+    static thread_local Thread_owner owner = {nullptr};
+    static thread_local Counters overflow;
+    if (id >= MAX_NODES) {
+      return &overflow;
+    }
+
+    if (owner.table == nullptr) {
+      owner.table = claim_table();
+    }
+
+    std::atomic<Chunk*>& slot = owner.table->chunks[id / CHUNK_SIZE];
+    Chunk* chunk = slot.load(std::memory_order_relaxed);
+    if (chunk == nullptr) {
+      chunk = new_chunk();
+      slot.store(chunk, std::memory_order_release);
+    }
+
+    return &chunk->counters[id % CHUNK_SIZE];
+  }
+
+  /**
+   * Only the owner thread writes: no read-modify-write needed
+   */
+  static void add(std::atomic<uint64_t>* counter, uint64_t value) {
+    counter->store(counter->load(std::memory_order_relaxed) + value,
+                   std::memory_order_relaxed);
+  }
+
+  static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+#endif
+  }
+
+  static void append_json_string(string* out, const string& value) {
+    out->push_back('"');
+    for (char c : value) {
+      if (c == '"' || c == '\\') {
+        out->push_back('\\');
+        out->push_back(c);
+      } else if ((unsigned char)c < 0x20) {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+        out->append(escaped);
+      } else {
+        out->push_back(c);
+      }
+    }
+
+    out->push_back('"');
+  }
+
+  template<typename AdapterType>
+  static void collect(const Validator<AdapterType, Node_counters>* validator,
+                      const string& path, const vector<Node_stats>& stats,
+                      vector<pair<string, Node_stats>>* out) {
+    using Object = Object_validator<AdapterType, Node_counters>;
+    using Array = Array_validator<AdapterType, Node_counters>;
+    if (validator == nullptr) {
+      return;
+    }
+
+    uint32_t id = validator->instrumentation().id();
+    out->push_back({path, id < stats.size() ? stats[id] : Node_stats()});
+    if (auto object = dynamic_cast<const Object*>(validator)) {
+      for (auto& it : object->validators()) {
+        string key;
+        for (char c : it.first) {
+          key += c == '~' ? "~0" : c == '/' ? "~1" : string(1, c);
+        }
+
+        collect<AdapterType>(it.second, path + "/properties/" + key, stats,
+                             out);
+      }
+    } else if (auto array = dynamic_cast<const Array*>(validator)) {
+      collect<AdapterType>(array->items_validator(), path + "/items", stats,
+                           out);
+    }
+  }
+
+  public:
+  /**
+   * Kept by every validator: its id, given back on destruction. A copy of a
+   *  validator is another validator.
+   */
+  class Node {
+    uint32_t _id;
+
+    public:
+    Node() : _id(acquire_id()) { }
+    Node(const Node&) : Node() { }
+
+    ~Node() {
+      release_id(_id);
+    }
+
+    Node& operator=(const Node&) {
+      return *this;
+    }
+
+    uint32_t id() const {
+      return _id;
+    }
+  };
+
+  class Probe {
+    Counters* _counters;
+    uint64_t _start;
+
+    public:
+    explicit Probe(Node* node) : _counters(counters(node->id())), _start(0) {
+      uint64_t calls = _counters->invocations.load(std::memory_order_relaxed);
+      _counters->invocations.store(calls + 1, std::memory_order_relaxed);
+      if (SAMPLE_PERIOD != 0 && calls % SAMPLE_PERIOD == 0) {
+        _start = now();
+      }
+    }
+
+    void finish(bool success) {
+      if (!success) {
+        add(&_counters->failures, 1);
+      }
+
+      if (SAMPLE_PERIOD != 0 && _start != 0) {
+        add(&_counters->ticks, now() - _start);
+        add(&_counters->samples, 1);
+      }
+    }
+  };
+
+  /**
+   * Counts of every validator, by id, summed over the threads. Counts
+   *  written meanwhile may or may not be seen.
+   */
+  static vector<Node_stats> aggregate() {
+    uint32_t ids = registry().ids.load(std::memory_order_relaxed);
+    vector<Node_stats> stats(ids, Node_stats());
+    for (Thread_table* table =
+             registry().tables.load(std::memory_order_acquire);
+         table != nullptr; table = table->next) {
+      for (uint32_t c = 0; c * CHUNK_SIZE < ids; ++c) {
+        Chunk* chunk = table->chunks[c].load(std::memory_order_acquire);
+        for (uint32_t i = 0; chunk != nullptr && i < CHUNK_SIZE &&
+                             c * CHUNK_SIZE + i < ids; ++i) {
+          const Counters& counters = chunk->counters[i];
+          Node_stats& node = stats[c * CHUNK_SIZE + i];
+          node.invocations +=
+              counters.invocations.load(std::memory_order_relaxed);
+          node.failures += counters.failures.load(std::memory_order_relaxed);
+          node.samples += counters.samples.load(std::memory_order_relaxed);
+          node.ticks += counters.ticks.load(std::memory_order_relaxed);
+        }
+      }
+    }
+
+    return stats;
+  }
+
+  /**
+   * Zeroes every count; increments racing with it may be lost
+   */
+  static void reset() {
+    for (Thread_table* table =
+             registry().tables.load(std::memory_order_acquire);
+         table != nullptr; table = table->next) {
+      for (uint32_t c = 0; c < MAX_CHUNKS; ++c) {
+        Chunk* chunk = table->chunks[c].load(std::memory_order_acquire);
+        for (uint32_t i = 0; chunk != nullptr && i < CHUNK_SIZE; ++i) {
+          clear(&chunk->counters[i]);
+        }
+      }
+    }
+  }
+
+  /**
+   * Live validators that aren't counted: created while MAX_NODES others
+   *  were (by_path() reports zeros for them)
+   */
+  static uint64_t untracked() {
+    return registry().untracked.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Counts of the validators of a tree, by schema path: "" for the root,
+   *  then "/properties/<key>" and "/items" as in json-schema
+   */
+  template<typename AdapterType>
+  static vector<pair<string, Node_stats>> by_path(
+      const Validator<AdapterType, Node_counters>* root) {
+    vector<pair<string, Node_stats>> nodes;
+    collect<AdapterType>(root, "", aggregate(), &nodes);
+    return nodes;
+  }
+
+  /**
+   * by_path() as a JSON array:
+   *  [{"path":"/properties/a","invocations":10,"failures":2,"samples":1,
+   *   "ticks_per_call":123.5}, ...]
+   */
+  template<typename AdapterType>
+  static string json(const Validator<AdapterType, Node_counters>* root) {
+    string out = "[";
+    char numbers[128];
+    for (auto& node : by_path<AdapterType>(root)) {
+      out += out.size() == 1 ? "{\"path\":" : ",{\"path\":";
+      append_json_string(&out, node.first);
+      snprintf(numbers, sizeof(numbers),
+               ",\"invocations\":%" PRIu64 ",\"failures\":%" PRIu64
+               ",\"samples\":%" PRIu64 ",\"ticks_per_call\":%.1f}",
+               node.second.invocations, node.second.failures,
+               node.second.samples, node.second.ticks_per_call());
+      out += numbers;
+    }
+
+    return out + "]";
+  }
+};
+
+template<unsigned SAMPLE_PERIOD>
+const uint32_t Node_counters<SAMPLE_PERIOD>::MAX_NODES;
+
+}  // namespace json_validator
+
+#endif
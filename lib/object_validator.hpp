@@ -1,15 +1,19 @@
 #ifndef CJSON_VALIDATOR_OBJECT_VALIDATOR_HPP
 #define CJSON_VALIDATOR_OBJECT_VALIDATOR_HPP
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <string>
 #include <set>
 #include <iostream>
 #include <sstream>
 #include <utility>
+#include <vector>
 #include <initializer_list>
 
 #include "validator.hpp"
+#include "work_stealing_pool.hpp"
 #include "json_adapters/adapter.hpp"
 
 namespace json_validator {
@@ -19,6 +23,7 @@ using std::set;
 using std::cout;
 using std::endl;
 using std::stringstream;
+using std::vector;
 using std::initializer_list;
 
 /**
@@ -29,35 +34,178 @@ using std::initializer_list;
  * This makes it possible to validate any types inside a json object
  */
 
-template<typename AdapterType>
-class Object_validator : public Validator<AdapterType> {
+template<typename AdapterType, typename Instrumentation>
+class Object_validator : public Validator<AdapterType, Instrumentation> {
   public:
   using JSON_token = json_adapters::JSON_adapter<AdapterType>;
-  using map_validator_t = map<string, Validator<AdapterType>*>;
+  using Validator_t = Validator<AdapterType, Instrumentation>;
+  using map_validator_t = map<string, Validator_t*>;
 
   private:
+  friend class Iterative_validator<AdapterType, Instrumentation>;
+
   /**
-   * RAII class to manager object validator state
-   *    This is needed so that the same validator can be used multiple times.
+   * Position of validate_object in _valdations (validate_type comes first)
    */
-  class Object_validation_state_manager {
-    private:
-    Object_validator* _validator;
-
-    public:
-    explicit Object_validation_state_manager(Object_validator* validator) :
-        _validator(validator) { }
-
-    ~Object_validation_state_manager() {
-      for (auto it = this->_validator->_validators.begin(); it !=
-          this->_validator->_validators.end(); ++it) {
-        it->second->used(false);
-      }
-    }
-  };
+  static const size_t MEMBERS_STEP = 1;
 
   map_validator_t _validators;
   set<string> _forbidden_keys;
+  Work_stealing_pool* _pool;
+  size_t _parallel_min_nodes;
+
+  /**
+   * Number of nodes in token's subtree; counting stops at 'limit'
+   */
+  static size_t count_nodes(const JSON_token& token, size_t limit) {
+    size_t count = 1;
+    if (token.is_object()) {
+      for (auto it = token.object_begin();
+           it != token.object_end() && count < limit; ++it) {
+        count += count_nodes(json_adapter_factory(it), limit - count);
+      }
+    } else if (token.is_array()) {
+      for (auto it = token.array_begin();
+           it != token.array_end() && count < limit; ++it) {
+        count += count_nodes(json_adapter_factory(it), limit - count);
+      }
+    }
+
+    return count;
+  }
+
+  /**
+   * Required keys missing from the object and defaults of absent keys
+   */
+  Validation_result_ptr validate_absent(
+      const JSON_token& json, vector<const Validator_t*>* seen,
+      Validation_result_ptr result) {
+    std::sort(seen->begin(), seen->end());
+
+    // Verify required fields and set defaults if they are present
+    for (auto it = this->_validators.begin(); it != this->_validators.end();
+         ++it) {
+      if (!std::binary_search(seen->begin(), seen->end(), it->second)) {
+        if (it->second->has_default_value()) {
+          if (!it->second->set_default_value(json, it->first)) {
+            result->set_error(VALIDATION_FAILED, "can't set the default "
+                              "value of " + it->first, this,
+                              "a default value for key '" + it->first + "'",
+                              "no default value");
+            break;
+          }
+        } else {
+          if (it->second->required()) {
+            string error = it->first + " is required";
+            result->set_error(VALIDATION_REQUIRED, error, this,
+                              "key '" + it->first + "'", "no such key");
+            break;
+          }
+        }
+      }
+    }
+
+    return result;
+  }
+
+  /**
+   * Same result as validate_object, but children whose subtree has at least
+   *  _parallel_min_nodes nodes are validated by tasks of _pool while the
+   *  small ones are validated inline.
+   *
+   * The error reported is the one of the first failing key, in document
+   * order, as in a sequential validation: siblings after a known failure
+   * are skipped, and their results are ignored otherwise.
+   */
+  Validation_result_ptr validate_object_parallel(const JSON_token& json,
+                                                 Validation_result_ptr result) {
+    struct Child {
+      string key;
+      Validator_t* validator;
+      AdapterType token;
+      Validation_result_ptr result;
+    };
+
+    vector<Child> children;
+    vector<const Validator_t*> seen;
+    string forbidden_key;
+    bool has_forbidden_key = false;
+    for (auto json_itr = json.object_begin(); json_itr != json.object_end();
+         ++json_itr) {
+      string current_key(json_itr.get_name());
+      if (is_forbidden_key(current_key)) {
+        forbidden_key = current_key;
+        has_forbidden_key = true;
+        break;
+      }
+
+      auto it = this->_validators.find(current_key);
+      if (it != this->_validators.end()) {
+        seen.push_back(it->second);
+        children.push_back(Child{current_key, it->second,
+                                 json_adapter_factory(json_itr), nullptr});
+      }
+    }
+
+    std::atomic<size_t> first_failure(children.size());
+    auto validate_child = [&](size_t i, Validation_result_ptr child_result)
+        -> Validation_result_ptr {
+      if (first_failure.load(std::memory_order_relaxed) < i) {
+        return child_result;
+      }
+
+      child_result = children[i].validator->validate(children[i].token,
+                                                     std::move(child_result));
+      if (child_result->success()) {
+        return child_result;
+      }
+
+      children[i].result = std::move(child_result);
+      size_t failure = first_failure.load(std::memory_order_relaxed);
+      while (i < failure && !first_failure.compare_exchange_weak(failure, i)) {
+      }
+
+      return Validation_result_ptr(new Validation_result());
+    };
+
+    {
+      Work_stealing_pool::Task_group group(_pool);
+      for (size_t i = 0; i < children.size(); ++i) {
+        if (count_nodes(children[i].token, _parallel_min_nodes) <
+            _parallel_min_nodes) {
+          result->reset();
+          result = validate_child(i, std::move(result));
+        } else {
+          group.spawn([&validate_child, i]() {
+            validate_child(i, Validation_result_ptr(new Validation_result()));
+          });
+        }
+      }
+
+      group.wait();
+    }
+
+    size_t failure = first_failure.load();
+    if (failure < children.size()) {
+      result = std::move(children[failure].result);
+      if (children[failure].key != "") {
+        result->add_key(children[failure].key);
+      }
+
+      return result;
+    }
+
+    result->reset();
+    if (has_forbidden_key) {
+      result->set_error(VALIDATION_FORBIDDEN_KEY,
+                        "'" + forbidden_key + "' key is not allowed", this,
+                        "no key '" + forbidden_key + "'",
+                        "key '" + forbidden_key + "'");
+      return result;
+    }
+
+    return validate_absent(json, &seen, std::move(result));
+  }
 
   protected:
   Validation_result_ptr validate_type(const JSON_token& json,
@@ -65,38 +213,46 @@ class Object_validator : public Validator<AdapterType> {
     result->reset();
 
     if (!json.is_object()) {
-      result->set_error("field must be an object");
+      result->set_error(VALIDATION_WRONG_TYPE, "field must be an object",
+                        this, "object", json.type_name());
     }
 
     return result;
   }
 
-  bool is_forbidden_key(const string& key) {
-    return (_forbidden_keys.size() > 0 &&
-            _forbidden_keys.find(key) != _forbidden_keys.end());
-  }
-
+  /**
+   * Validators of the keys present are collected in a local (sorted)
+   *  vector, so the same validator can be used by many threads at once.
+   */
   Validation_result_ptr validate_object(const JSON_token& json,
                                         Validation_result_ptr result) {
-    Object_validation_state_manager(this);
+    if (_pool != nullptr) {
+      return validate_object_parallel(json, std::move(result));
+    }
+
     result->reset();
 
+    vector<const Validator_t*> seen;
     for (auto json_itr = json.object_begin(); json_itr != json.object_end();
          ++json_itr) {
       string current_key(json_itr.get_name());
       if (is_forbidden_key(current_key)) {
-        result->set_error("'" + current_key + "' key is not allowed");
+        result->set_error(VALIDATION_FORBIDDEN_KEY,
+                          "'" + current_key + "' key is not allowed", this,
+                          "no key '" + current_key + "'",
+                          "key '" + current_key + "'");
         return result;
       }
 
       auto it = this->_validators.find(current_key);
       if (it != this->_validators.end()) {
-        result = it->second->validate(json_adapter_factory(json_itr),
-                                      std::move(result));
+        seen.push_back(it->second);
+        result = it->second->validate_memoized(json_adapter_factory(json_itr),
+                                               std::move(result));
 
         if (!result->success()) {
           if (current_key != "") {
-            result->set_error("'" + current_key + "'");
+            result->add_key(current_key);
           }
 
           return result;
@@ -104,27 +260,64 @@ class Object_validator : public Validator<AdapterType> {
       }
     }
 
-    // Verify required fields and set defaults if they are present
-    for (auto it = this->_validators.begin(); it != this->_validators.end();
-         ++it) {
-      if (!it->second->used()) {
-        if (it->second->has_default_value()) {
-          it->second->set_default_value(json, it->first);
-        } else {
-          if (it->second->required()) {
-            string error = it->first + " is required";
-            result->set_error(error);
-            break;
+    return validate_absent(json, &seen, std::move(result));
+  }
+
+  /**
+   * Only touched members are validated again (untouched ones are still
+   *  valid), in document order as validate_object does. Required keys and
+   *  defaults are only checked again if members were removed.
+   */
+  Validation_result_ptr revalidate_members(const JSON_token& json,
+                                           const Touched_nodes& touched,
+                                           uint8_t flags,
+                                           Validation_result_ptr result)
+      override {
+    result->reset();
+
+    bool members = flags & Touched_nodes::MEMBERS;
+    vector<const Validator_t*> seen;
+    for (auto json_itr = json.object_begin(); json_itr != json.object_end();
+         ++json_itr) {
+      AdapterType child = json_adapter_factory(json_itr);
+      if (touched.flags(child.identity()) == 0 && !members) {
+        continue;
+      }
+
+      string current_key(json_itr.get_name());
+      if (is_forbidden_key(current_key)) {
+        result->set_error(VALIDATION_FORBIDDEN_KEY,
+                          "'" + current_key + "' key is not allowed", this,
+                          "no key '" + current_key + "'",
+                          "key '" + current_key + "'");
+        return result;
+      }
+
+      auto it = this->_validators.find(current_key);
+      if (it != this->_validators.end()) {
+        seen.push_back(it->second);
+        result = it->second->revalidate(child, touched, std::move(result));
+
+        if (!result->success()) {
+          if (current_key != "") {
+            result->add_key(current_key);
           }
+
+          return result;
         }
       }
     }
 
-    return result;
+    if (!members) {
+      return result;
+    }
+
+    return validate_absent(json, &seen, std::move(result));
   }
 
   public:
-  explicit Object_validator(const map_validator_t& m) : _validators(m) {
+  explicit Object_validator(const map_validator_t& m)
+      : _validators(m), _pool(nullptr), _parallel_min_nodes(0) {
     this->_valdations.push_back([this] (const JSON_token& json,
                                 Validation_result_ptr result) {
       return this->validate_type(json, std::move(result));
@@ -143,16 +336,61 @@ class Object_validator : public Validator<AdapterType> {
     }
   }
 
-  Object_validator<AdapterType>* add_validator(const string& key,
-                                            Validator<AdapterType>* validator) {
+  Object_validator* add_validator(const string& key, Validator_t* validator) {
     this->_validators.insert({key, validator});
     return this;
   }
 
-  Object_validator<AdapterType>* forbidden_keys(initializer_list<string> keys) {
+  Object_validator* forbidden_keys(initializer_list<string> keys) {
+    _forbidden_keys = keys;
+    return this;
+  }
+
+  Object_validator* forbidden_keys(const set<string>& keys) {
     _forbidden_keys = keys;
     return this;
   }
+
+  /**
+   * Opt-in fork-join validation: children with at least min_subtree_nodes
+   *  nodes are validated in parallel by tasks of 'pool' (which must outlive
+   *  the validator); smaller ones stay inline. nullptr turns it off.
+   *
+   * Results are the same as sequential ones, except that defaults may also
+   * be added to subtrees after the first failing key. Only this object is
+   * affected: nested objects have their own setting.
+   */
+  Object_validator* parallel(Work_stealing_pool* pool,
+                             size_t min_subtree_nodes = 4096) {
+    _pool = pool;
+    _parallel_min_nodes = min_subtree_nodes;
+    return this;
+  }
+
+  const set<string>& forbidden_keys() const {
+    return _forbidden_keys;
+  }
+
+  bool is_forbidden_key(const string& key) const {
+    return (_forbidden_keys.size() > 0 &&
+            _forbidden_keys.find(key) != _forbidden_keys.end());
+  }
+
+  /**
+   *  Validator registered for 'key' (nullptr if the key is not validated)
+   */
+  Validator_t* key_validator(const string& key) const {
+    auto it = this->_validators.find(key);
+    if (it == this->_validators.end()) {
+      return nullptr;
+    }
+
+    return it->second;
+  }
+
+  const map_validator_t& validators() const {
+    return this->_validators;
+  }
 };
 }  // namespace json_validator
 #endif
@@ -0,0 +1,563 @@
+#ifndef CJSON_VALIDATOR_SCHEMA_CODEGEN_HPP
+#define CJSON_VALIDATOR_SCHEMA_CODEGEN_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "compiled_schema.hpp"
+
+namespace json_validator {
+using std::map;
+using std::string;
+using std::vector;
+
+/**
+ * Schema codegen turns compiled schemas into C++ source: one class per
+ *  schema with a function per schema node, working directly on cJSON.
+ *
+ * Keys, enums and bounds are baked in the generated code as constants
+ * (keys and string enums are matched with a switch on their length and a
+ * memcmp), so there is no std::function, no virtual call and no lookup in
+ * a std::map left. The generated classes report the same errors, apply the
+ * same defaults and have the same depth guard as Compiled_schema:
+ *
+ *    class Name {
+ *      public:
+ *      static std::unique_ptr<Validation_result> validate(cJSON* json);
+ *      static bool is_valid(cJSON* json);    //  no error message
+ *    };
+ *
+ * See tools/schema_codegen.cpp for the command line tool.
+ */
+class Schema_codegen {
+  private:
+  string _name_space;
+  vector<std::pair<string, string>> _classes;
+  bool _uses_unique_items;
+
+  /**
+   * Generation state of a single schema
+   */
+  class Class_writer {
+    private:
+    const Compiled_schema& _schema;
+    string _code;
+    bool* _uses_unique_items;
+
+    void line(int indent, const string& text) {
+      if (!text.empty()) {
+        _code.append(indent * 2, ' ');
+      }
+
+      _code.append(text);
+      _code.push_back('\n');
+    }
+
+    /**
+     * "if (result != nullptr) result->set_error(code, message, ...)" then
+     *  "return false"; expected and actual are C++ expressions
+     */
+    void fail(int indent, const string& message, const string& code,
+              const string& expected, const string& actual) {
+      line(indent, "if (result != nullptr) {");
+      line(indent + 1, "result->set_error(json_validator::" + code + ",");
+      line(indent + 3, message + ", nullptr,");
+      line(indent + 3, expected + ", " + actual + ");");
+      line(indent, "}");
+      line(indent, "");
+      line(indent, "return false;");
+    }
+
+    static string type_name() {
+      return "type_name(json)";
+    }
+
+    string one_of(const Compiled_schema_node& node, bool strings) const {
+      string expected = "one of [";
+      for (uint32_t i = 0; i < node.count; ++i) {
+        expected += i == 0 ? "" : ", ";
+        if (strings) {
+          expected += string("\"") +
+                      _schema.string_at(_schema.value(node.first + i)) + "\"";
+        } else {
+          expected += std::to_string((int32_t)_schema.value(node.first + i));
+        }
+      }
+
+      return expected + "]";
+    }
+
+    static string function(uint32_t index) {
+      return "node_" + std::to_string(index);
+    }
+
+    /**
+     * Emits "switch (strlen(value)) { case n: if (memcmp(...)) ... }" with
+     *  the code of each possible value. An empty code means no action.
+     */
+    void match(int indent, const string& value,
+               const vector<std::pair<string, string>>& cases) {
+      map<size_t, vector<const std::pair<string, string>*>> by_length;
+      for (auto& it : cases) {
+        by_length[it.first.size()].push_back(&it);
+      }
+
+      line(indent, "switch (strlen(" + value + ")) {");
+      for (auto& length : by_length) {
+        string size = std::to_string(length.first);
+        line(indent + 1, "case " + size + ":");
+        for (size_t i = 0; i < length.second.size(); ++i) {
+          line(indent + 2, string(i == 0 ? "if" : "} else if") + " (memcmp(" +
+                           value + ", " + literal(length.second[i]->first) +
+                           ", " + size + ") == 0) {");
+          _code.append(length.second[i]->second);
+        }
+
+        line(indent + 2, "}");
+        line(indent + 2, "break;");
+      }
+
+      line(indent, "}");
+    }
+
+    void check_depth(int indent) {
+      line(indent, "if (depth >= " +
+                   std::to_string(COMPILED_SCHEMA_MAX_DEPTH) + ") {");
+      fail(indent + 1, literal("exceeds the maximum depth of " +
+                               std::to_string(COMPILED_SCHEMA_MAX_DEPTH)),
+           "VALIDATION_TOO_DEEP",
+           literal("depth <= " + std::to_string(COMPILED_SCHEMA_MAX_DEPTH)),
+           literal("depth " +
+                   std::to_string(COMPILED_SCHEMA_MAX_DEPTH + 1)));
+      line(indent, "}");
+      line(indent, "");
+    }
+
+    void write_int(const Compiled_schema_node& node) {
+      line(2, "if (json->type != cJSON_Number) {");
+      fail(3, literal("should be an int"), "VALIDATION_WRONG_TYPE",
+           literal("integer"), type_name());
+      line(2, "}");
+      if (!(node.flags & (COMPILED_HAS_ENUM | COMPILED_HAS_MIN |
+                          COMPILED_HAS_MAX))) {
+        return;
+      }
+
+      line(2, "");
+      line(2, "int value = json->valueint;");
+      if (node.flags & COMPILED_HAS_ENUM) {
+        line(2, "switch (value) {");
+        for (uint32_t i = 0; i < node.count; ++i) {
+          line(3, "case " + std::to_string(
+                              (int32_t)_schema.value(node.first + i)) + ":");
+        }
+
+        line(4, "break;");
+        line(3, "default:");
+        fail(4, "\"Value \" + std::to_string(value) + \" not allowed\"",
+             "VALIDATION_NOT_ALLOWED", literal(one_of(node, false)),
+             "std::to_string(value)");
+        line(2, "}");
+      }
+
+      if (node.flags & COMPILED_HAS_MIN) {
+        line(2, "");
+        line(2, "if (value < " + std::to_string(node.min) + ") {");
+        fail(3, literal("min_value = " + std::to_string(node.min) +
+                        " received = ") + " + std::to_string(value)",
+             "VALIDATION_BELOW_MINIMUM",
+             literal(">= " + std::to_string(node.min)),
+             "std::to_string(value)");
+        line(2, "}");
+      }
+
+      if (node.flags & COMPILED_HAS_MAX) {
+        line(2, "");
+        line(2, "if (value > " + std::to_string(node.max) + ") {");
+        fail(3, literal("max_value = " + std::to_string(node.max) +
+                        " received = ") + " + std::to_string(value)",
+             "VALIDATION_ABOVE_MAXIMUM",
+             literal("<= " + std::to_string(node.max)),
+             "std::to_string(value)");
+        line(2, "}");
+      }
+    }
+
+    void write_string(const Compiled_schema_node& node) {
+      line(2, "if (json->type != cJSON_String) {");
+      fail(3, literal("must be a string"), "VALIDATION_WRONG_TYPE",
+           literal("string"), type_name());
+      line(2, "}");
+      if (!(node.flags & (COMPILED_HAS_ENUM | COMPILED_HAS_MAX))) {
+        return;
+      }
+
+      line(2, "");
+      line(2, "const char* value = json->valuestring;");
+      if (node.flags & COMPILED_HAS_ENUM) {
+        vector<std::pair<string, string>> values;
+        for (uint32_t i = 0; i < node.count; ++i) {
+          values.push_back({_schema.string_at(_schema.value(node.first + i)),
+                            "          allowed = true;\n"});
+        }
+
+        line(2, "bool allowed = false;");
+        match(2, "value", values);
+        line(2, "if (!allowed) {");
+        fail(3, "\"Value \\\"\" + std::string(value) + \"\\\" not allowed\"",
+             "VALIDATION_NOT_ALLOWED", literal(one_of(node, true)),
+             "\"\\\"\" + std::string(value) + \"\\\"\"");
+        line(2, "}");
+      }
+
+      if (node.flags & COMPILED_HAS_MAX) {
+        line(2, "");
+        line(2, "if (strlen(value) > " + std::to_string(node.max) + "u) {");
+        fail(3, "\"has length \" + std::to_string(strlen(value)) + " +
+                literal(" but max_length is " + std::to_string(node.max)),
+             "VALIDATION_ABOVE_MAXIMUM",
+             literal("length <= " + std::to_string(node.max)),
+             "\"length \" + std::to_string(strlen(value))");
+        line(2, "}");
+      }
+    }
+
+    void write_boolean(const Compiled_schema_node& node) {
+      line(2, "if (json->type != cJSON_False && json->type != cJSON_True) {");
+      fail(3, literal("should be a boolean"), "VALIDATION_WRONG_TYPE",
+           literal("boolean"), type_name());
+      line(2, "}");
+      if ((node.flags & COMPILED_HAS_ENUM) && node.count == 1) {
+        uint32_t value = _schema.value(node.first);
+        line(2, "");
+        line(2, string("if (json->type != ") +
+                (value != 0 ? "cJSON_True" : "cJSON_False") + ") {");
+        fail(3, literal("should have value: " + std::to_string(value)),
+             "VALIDATION_NOT_ALLOWED", literal(value != 0 ? "true" : "false"),
+             literal(value != 0 ? "false" : "true"));
+        line(2, "}");
+      }
+    }
+
+    void write_array(const Compiled_schema_node& node) {
+      line(2, "if (json->type != cJSON_Array &&");
+      line(2, "    json->type != (cJSON_IsReference | cJSON_Array)) {");
+      fail(3, literal("must be an array"), "VALIDATION_WRONG_TYPE",
+           literal("array"), type_name());
+      line(2, "}");
+      line(2, "");
+      if (node.flags & (COMPILED_HAS_MIN | COMPILED_HAS_MAX)) {
+        line(2, "int size = cJSON_GetArraySize(json);");
+      }
+
+      if (node.flags & COMPILED_HAS_MIN) {
+        line(2, "if (size < " + std::to_string(node.min) + ") {");
+        fail(3, literal("length must be greater then " +
+                        std::to_string(node.min)), "VALIDATION_BELOW_MINIMUM",
+             literal(">= " + std::to_string(node.min) + " items"),
+             "std::to_string(size) + \" items\"");
+        line(2, "}");
+        line(2, "");
+      }
+
+      if (node.flags & COMPILED_HAS_MAX) {
+        line(2, "if (size > " + std::to_string(node.max) + ") {");
+        fail(3, literal("length must be less then " +
+                        std::to_string(node.max)), "VALIDATION_ABOVE_MAXIMUM",
+             literal("<= " + std::to_string(node.max) + " items"),
+             "std::to_string(size) + \" items\"");
+        line(2, "}");
+        line(2, "");
+      }
+
+      if (node.flags & COMPILED_UNIQUE) {
+        *_uses_unique_items = true;
+        line(2, "int duplicated_index = 0;");
+        line(2, "if (!json_validator::Array_validator<json_validator::"
+                "json_adapters::CJSON_adapter>::has_unique_items(");
+        line(4, "json_validator::json_adapters::CJSON_adapter(json), "
+                "&duplicated_index)) {");
+        line(3, "if (result != nullptr) {");
+        line(4, "result->set_error("
+                "json_validator::VALIDATION_DUPLICATED_ITEM, "
+                "\"duplicated item\",");
+        line(6, "nullptr, \"unique items\", \"a repeated item\");");
+        line(4, "result->add_index(duplicated_index);");
+        line(3, "}");
+        line(3, "");
+        line(3, "return false;");
+        line(2, "}");
+        line(2, "");
+      }
+
+      if (node.first == COMPILED_SCHEMA_NO_NODE) {
+        return;
+      }
+
+      line(2, "if (json->child == nullptr) {");
+      line(3, "return true;");
+      line(2, "}");
+      line(2, "");
+      check_depth(2);
+      line(2, "int index = 0;");
+      line(2, "for (cJSON* item = json->child; item != nullptr;");
+      line(2, "     item = item->next, ++index) {");
+      line(3, "if (!" + function(node.first) +
+              "(item, depth + 1, result)) {");
+      line(4, "if (result != nullptr) {");
+      line(5, "result->add_index(index);");
+      line(4, "}");
+      line(4, "");
+      line(4, "return false;");
+      line(3, "}");
+      line(2, "}");
+    }
+
+    void write_object(const Compiled_schema_node& node) {
+      line(2, "if (json->type != cJSON_Object &&");
+      line(2, "    json->type != (cJSON_IsReference | cJSON_Object)) {");
+      fail(3, literal("field must be an object"), "VALIDATION_WRONG_TYPE",
+           literal("object"), type_name());
+      line(2, "}");
+      line(2, "");
+      if (node.count == 0) {
+        return;
+      }
+
+      //  Only required properties and defaults need to know what was seen
+      bool track_seen = false;
+      for (uint32_t i = 0; i < node.count; ++i) {
+        const Compiled_schema_property& property =
+          _schema.property(node.first + i);
+        track_seen |= !(property.flags & COMPILED_FORBIDDEN) &&
+                      ((property.flags & COMPILED_REQUIRED) ||
+                       (_schema.node(property.node).flags &
+                        COMPILED_HAS_DEFAULT));
+      }
+
+      check_depth(2);
+      if (track_seen) {
+        line(2, "uint64_t seen[" + std::to_string((node.count + 63) / 64) +
+                "] = {};");
+      }
+
+      line(2, "for (cJSON* item = json->child; item != nullptr;");
+      line(2, "     item = item->next) {");
+      line(3, "const char* key = item->string;");
+
+      vector<std::pair<string, string>> keys;
+      for (uint32_t i = 0; i < node.count; ++i) {
+        const Compiled_schema_property& property =
+          _schema.property(node.first + i);
+        string action;
+        if (property.flags & COMPILED_FORBIDDEN) {
+          action = "            if (result != nullptr) {\n"
+                   "              result->set_error("
+                   "json_validator::VALIDATION_FORBIDDEN_KEY,\n"
+                   "                std::string(\"'\") + "
+                   "key + \"' key is not allowed\", nullptr,\n"
+                   "                std::string(\"no key '\") + key + \"'\",\n"
+                   "                std::string(\"key '\") + key + \"'\");\n"
+                   "            }\n\n"
+                   "            return false;\n";
+        } else {
+          if (track_seen) {
+            action = "            seen[" + std::to_string(i / 64) +
+                     "] |= (uint64_t)1 << " + std::to_string(i % 64) + ";\n";
+          }
+
+          action += "            if (!" + function(property.node) +
+                   "(item, depth + 1, result)) {\n"
+                   "              if (result != nullptr && key[0] != '\\0') {\n"
+                   "                result->add_key(key, strlen(key));\n"
+                   "              }\n\n"
+                   "              return false;\n"
+                   "            }\n";
+        }
+
+        keys.push_back({_schema.string_at(property.key), action});
+      }
+
+      match(3, "key", keys);
+      line(2, "}");
+
+      for (uint32_t i = 0; i < node.count; ++i) {
+        const Compiled_schema_property& property =
+          _schema.property(node.first + i);
+        if (property.flags & COMPILED_FORBIDDEN) {
+          continue;
+        }
+
+        const Compiled_schema_node& child = _schema.node(property.node);
+        string key = literal(_schema.string_at(property.key));
+        bool has_default = child.flags & COMPILED_HAS_DEFAULT;
+        if (!has_default && !(property.flags & COMPILED_REQUIRED)) {
+          continue;
+        }
+
+        line(2, "");
+        line(2, "if (!((seen[" + std::to_string(i / 64) + "] >> " +
+                std::to_string(i % 64) + ") & 1)) {");
+        if (!has_default) {
+          fail(3, literal(string(_schema.string_at(property.key)) +
+                          " is required"), "VALIDATION_REQUIRED",
+               literal("key '" + string(_schema.string_at(property.key)) +
+                       "'"), literal("no such key"));
+        } else if (child.type == COMPILED_INT) {
+          line(3, "cJSON_AddNumberToObject(json, " + key + ", " +
+                  std::to_string(static_cast<int>(child.default_value)) +
+                  ");");
+        } else if (child.type == COMPILED_BOOLEAN) {
+          line(3, "cJSON_AddBoolToObject(json, " + key + ", " +
+                  (child.default_value != 0 ? "1" : "0") + ");");
+        } else {
+          line(3, "cJSON_AddStringToObject(json, " + key + ", " +
+                  literal(_schema.string_at(child.default_value)) + ");");
+        }
+
+        line(2, "}");
+      }
+    }
+
+    void write_node(uint32_t index) {
+      const Compiled_schema_node& node = _schema.node(index);
+      line(1, "static bool " + function(index) + "(cJSON* json, size_t depth,");
+      line(1, "    json_validator::Validation_result* result) {");
+      switch (node.type) {
+        case COMPILED_OBJECT:
+          write_object(node);
+          break;
+        case COMPILED_ARRAY:
+          write_array(node);
+          break;
+        case COMPILED_STRING:
+          write_string(node);
+          break;
+        case COMPILED_INT:
+          write_int(node);
+          break;
+        default:
+          write_boolean(node);
+      }
+
+      line(2, "");
+      line(2, "return true;");
+      line(1, "}");
+      line(0, "");
+    }
+
+    public:
+    Class_writer(const Compiled_schema& schema, bool* uses_unique_items)
+        : _schema(schema), _uses_unique_items(uses_unique_items) { }
+
+    string write(const string& class_name, const string& description) {
+      line(0, "/**");
+      line(0, " * " + description);
+      line(0, " */");
+      line(0, "class " + class_name + " {");
+      line(1, "private:");
+      line(1, "static const char* type_name(const cJSON* json) {");
+      line(2, "switch (json->type & 0xff) {");
+      const char* names[] = {"cJSON_False", "boolean", "cJSON_True", "boolean",
+                             "cJSON_NULL", "null", "cJSON_Number", "integer",
+                             "cJSON_String", "string", "cJSON_Array", "array"};
+      for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i += 2) {
+        line(3, string("case ") + names[i] + ":");
+        line(4, string("return \"") + names[i + 1] + "\";");
+      }
+
+      line(3, "default:");
+      line(4, "return \"object\";");
+      line(2, "}");
+      line(1, "}");
+      line(0, "");
+      for (uint32_t i = 0; i < _schema.header().node_count; ++i) {
+        write_node(i);
+      }
+
+      string root = function(_schema.header().root);
+      line(1, "public:");
+      line(1, "static std::unique_ptr<json_validator::Validation_result> "
+              "validate(");
+      line(1, "    cJSON* json) {");
+      line(2, "std::unique_ptr<json_validator::Validation_result> result(");
+      line(3, "new json_validator::Validation_result());");
+      line(2, root + "(json, 0, result.get());");
+      line(2, "return result;");
+      line(1, "}");
+      line(0, "");
+      line(1, "static bool is_valid(cJSON* json) {");
+      line(2, "return " + root + "(json, 0, nullptr);");
+      line(1, "}");
+      line(0, "};");
+      return _code;
+    }
+  };
+
+  public:
+  /**
+   * C++ string literal (escaped) holding 'value'
+   */
+  static string literal(const string& value) {
+    string result = "\"";
+    for (unsigned char c : value) {
+      if (c == '"' || c == '\\' || c == '?') {
+        result.push_back('\\');
+        result.push_back(c);
+      } else if (c < 0x20 || c >= 0x7F) {
+        char octal[5];
+        snprintf(octal, sizeof(octal), "\\%03o", c);
+        result.append(octal);
+      } else {
+        result.push_back(c);
+      }
+    }
+
+    return result + "\"";
+  }
+
+  explicit Schema_codegen(const string& name_space)
+      : _name_space(name_space), _uses_unique_items(false) { }
+
+  /**
+   * Adds a class named 'class_name' validating 'schema'
+   */
+  void add(const string& class_name, const Compiled_schema& schema,
+           const string& description) {
+    Class_writer writer(schema, &_uses_unique_items);
+    _classes.push_back({class_name, writer.write(class_name, description)});
+  }
+
+  /**
+   * Writes the header with every class added so far
+   */
+  string write(const string& include_guard, const string& source) const {
+    string code = "//  Generated by schema_codegen from " + source +
+                  ", do not edit.\n"
+                  "#ifndef " + include_guard + "\n"
+                  "#define " + include_guard + "\n\n"
+                  "#include <cstdint>\n"
+                  "#include <cstring>\n"
+                  "#include <memory>\n"
+                  "#include <string>\n\n"
+                  "#include \"validation_result.hpp\"\n";
+    if (_uses_unique_items) {
+      code += "#include \"array_validator.hpp\"\n"
+              "#include \"json_adapters/cjson_adapter.hpp\"\n";
+    }
+
+    code += "#include \"cJSON/cJSON.h\"\n\n"
+            "namespace " + _name_space + " {\n";
+    for (auto& it : _classes) {
+      code += it.second + "\n";
+    }
+
+    return code + "}  // namespace " + _name_space + "\n#endif\n";
+  }
+};
+}  // namespace json_validator
+#endif
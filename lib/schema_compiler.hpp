@@ -0,0 +1,450 @@
+#ifndef CJSON_VALIDATOR_SCHEMA_COMPILER_HPP
+#define CJSON_VALIDATOR_SCHEMA_COMPILER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error_handling.hpp"
+#include "compiled_schema.hpp"
+#include "json_schema_reader.hpp"
+#include "cJSON/cJSON.h"
+
+namespace json_validator {
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+/**
+ * Schema compiler turns a json-schema document into a compiled schema blob
+ *  (see Compiled_schema for the layout).
+ *
+ * It accepts the same keywords as Schema_loader and the compiled schema
+ * reports the same errors as the validators built by the loader, but the
+ * blob can be stored and later loaded (or mmap'ed) without parsing the
+ * schema or allocating one object per node.
+ *
+ * It also accepts local references ("$ref": "#" or
+ * "$ref": "#/definitions/name"), so recursive structures (comment threads,
+ * category trees...) can be described: each referenced schema is compiled
+ * once and shared by every node referring to it.
+ */
+class Schema_compiler : protected Json_schema_reader {
+  private:
+  vector<Compiled_schema_node> _nodes;
+  vector<Compiled_schema_property> _properties;
+  vector<uint32_t> _values;
+  string _strings;
+  map<string, uint32_t> _string_offsets;
+
+  const cJSON* _root;
+  map<string, uint32_t> _nodes_by_path;   //  targets of $ref
+  set<string> _resolving;                 //  $ref chains being resolved
+
+  explicit Schema_compiler(const cJSON* root)
+      : _strings(1, '\0'), _root(root) { }
+
+  uint32_t add_string(const string& value) {
+    auto it = _string_offsets.find(value);
+    if (it != _string_offsets.end()) {
+      return it->second;
+    }
+
+    uint32_t offset = _strings.size();
+    _strings.append(value.c_str(), value.size() + 1);
+    _string_offsets.insert({value, offset});
+    return offset;
+  }
+
+  void compile_object(const cJSON* schema, const string& path,
+                      Compiled_schema_node* node) {
+    map<string, Compiled_schema_property> properties;
+    const cJSON* required = nullptr;
+
+    for (const cJSON* keyword = schema->child; keyword != nullptr;
+         keyword = keyword->next) {
+      if (is_keyword(keyword, "properties")) {
+        if (keyword->type != cJSON_Object) {
+          error(path, "'properties' must be an object");
+          continue;
+        }
+
+        for (const cJSON* property = keyword->child; property != nullptr;
+             property = property->next) {
+          Compiled_schema_property compiled = {};
+          if (property->type == cJSON_True) {
+            continue;
+          } else if (property->type == cJSON_False) {
+            compiled.node = COMPILED_SCHEMA_NO_NODE;
+            compiled.flags = COMPILED_FORBIDDEN;
+          } else {
+            compiled.node = compile_node(property,
+                                         property_path(path, property->string));
+          }
+
+          if (!properties.insert({property->string, compiled}).second) {
+            error(path, string("duplicated property '") + property->string +
+                        "'");
+          }
+        }
+      } else if (is_keyword(keyword, "required")) {
+        required = get_array(keyword, path);
+      } else if (is_keyword(keyword, "default")) {
+        error(path, "'default' is not supported for objects");
+      }
+    }
+
+    for (const cJSON* key = required ? required->child : nullptr;
+         key != nullptr; key = key->next) {
+      if (key->type != cJSON_String) {
+        error(path, "'required' must contain only strings");
+        continue;
+      }
+
+      auto it = properties.find(key->valuestring);
+      if (it == properties.end() || (it->second.flags & COMPILED_FORBIDDEN)) {
+        error(path, string("required key '") + key->valuestring +
+                    "' must be declared in 'properties'");
+        continue;
+      }
+
+      it->second.flags |= COMPILED_REQUIRED;
+    }
+
+    //  std::map keeps keys in the order expected by Compiled_schema (strcmp)
+    node->first = _properties.size();
+    node->count = properties.size();
+    for (auto& it : properties) {
+      it.second.key = add_string(it.first);
+      _properties.push_back(it.second);
+    }
+  }
+
+  void compile_array(const cJSON* schema, const string& path,
+                     Compiled_schema_node* node) {
+    node->first = COMPILED_SCHEMA_NO_NODE;
+
+    for (const cJSON* keyword = schema->child; keyword != nullptr;
+         keyword = keyword->next) {
+      if (is_keyword(keyword, "items")) {
+        node->first = compile_node(keyword, path + "/items");
+      } else if (is_keyword(keyword, "minItems")) {
+        node->flags |= COMPILED_HAS_MIN;
+        node->min = get_size(keyword, path);
+      } else if (is_keyword(keyword, "maxItems")) {
+        node->flags |= COMPILED_HAS_MAX;
+        node->max = get_size(keyword, path);
+      } else if (is_keyword(keyword, "uniqueItems")) {
+        if (get_boolean(keyword, path)) {
+          node->flags |= COMPILED_UNIQUE;
+        }
+      } else if (is_keyword(keyword, "default")) {
+        error(path, "'default' is not supported for arrays");
+      }
+    }
+  }
+
+  void compile_string(const cJSON* schema, const string& path,
+                      Compiled_schema_node* node) {
+    for (const cJSON* keyword = schema->child; keyword != nullptr;
+         keyword = keyword->next) {
+      if (is_keyword(keyword, "enum")) {
+        set<string> possible_values;
+        for (const cJSON* value = get_array(keyword, path)->child;
+             value != nullptr; value = value->next) {
+          if (value->type != cJSON_String) {
+            error(path, "'enum' must contain only strings");
+            continue;
+          }
+
+          possible_values.insert(value->valuestring);
+        }
+
+        node->flags |= COMPILED_HAS_ENUM;
+        node->first = _values.size();
+        node->count = possible_values.size();
+        for (auto& value : possible_values) {
+          _values.push_back(add_string(value));
+        }
+      } else if (is_keyword(keyword, "maxLength")) {
+        node->flags |= COMPILED_HAS_MAX;
+        node->max = get_size(keyword, path);
+      } else if (is_keyword(keyword, "default")) {
+        if (keyword->type != cJSON_String) {
+          error(path, "'default' must be a string");
+          continue;
+        }
+
+        node->flags |= COMPILED_HAS_DEFAULT;
+        node->default_value = add_string(keyword->valuestring);
+      }
+    }
+  }
+
+  void compile_int(const cJSON* schema, const string& path,
+                   Compiled_schema_node* node) {
+    for (const cJSON* keyword = schema->child; keyword != nullptr;
+         keyword = keyword->next) {
+      if (is_keyword(keyword, "enum")) {
+        set<int> possible_values = get_int_enum(keyword, path);
+        node->flags |= COMPILED_HAS_ENUM;
+        node->first = _values.size();
+        node->count = possible_values.size();
+        for (int value : possible_values) {
+          _values.push_back((uint32_t)value);
+        }
+      } else if (is_keyword(keyword, "minimum")) {
+        node->flags |= COMPILED_HAS_MIN;
+        node->min = get_int(keyword, path);
+      } else if (is_keyword(keyword, "maximum")) {
+        node->flags |= COMPILED_HAS_MAX;
+        node->max = get_int(keyword, path);
+      } else if (is_keyword(keyword, "default")) {
+        node->flags |= COMPILED_HAS_DEFAULT;
+        node->default_value = get_int(keyword, path);
+      }
+    }
+  }
+
+  void compile_boolean(const cJSON* schema, const string& path,
+                       Compiled_schema_node* node) {
+    for (const cJSON* keyword = schema->child; keyword != nullptr;
+         keyword = keyword->next) {
+      if (is_keyword(keyword, "enum")) {
+        bool value;
+        if (get_boolean_enum(keyword, path, &value)) {
+          node->flags |= COMPILED_HAS_ENUM;
+          node->first = _values.size();
+          node->count = 1;
+          _values.push_back(value);
+        }
+      } else if (is_keyword(keyword, "default")) {
+        node->flags |= COMPILED_HAS_DEFAULT;
+        node->default_value = get_boolean(keyword, path);
+      }
+    }
+  }
+
+  /**
+   * Finds the schema a local json pointer ("#", "#/definitions/node"...)
+   *  refers to
+   */
+  const cJSON* resolve_pointer(const string& pointer, const string& path) {
+    if (pointer.empty() || pointer[0] != '#' ||
+        (pointer.size() > 1 && pointer[1] != '/')) {
+      error(path, "only local '$ref' (starting with '#/') are supported");
+      return nullptr;
+    }
+
+    const cJSON* schema = _root;
+    size_t position = 1;
+    while (schema != nullptr && position < pointer.size()) {
+      size_t next = pointer.find('/', position + 1);
+      if (next == string::npos) {
+        next = pointer.size();
+      }
+
+      string token = pointer.substr(position + 1, next - position - 1);
+      for (size_t i = 0; (i = token.find('~', i)) != string::npos; ++i) {
+        if (token.compare(i, 2, "~1") == 0) {
+          token.replace(i, 2, "/");
+        } else if (token.compare(i, 2, "~0") == 0) {
+          token.replace(i, 2, "~");
+        }
+      }
+
+      if (schema->type == cJSON_Object) {
+        schema = find_keyword(schema, token.c_str());
+      } else if (schema->type == cJSON_Array &&
+                 token.find_first_not_of("0123456789") == string::npos) {
+        schema = cJSON_GetArrayItem(const_cast<cJSON*>(schema),
+                                    atoi(token.c_str()));
+      } else {
+        schema = nullptr;
+      }
+
+      position = next;
+    }
+
+    if (schema == nullptr || schema->type != cJSON_Object) {
+      error(path, "can't resolve '$ref' to '" + pointer + "'");
+    }
+
+    return schema;
+  }
+
+  /**
+   * A $ref compiles to the index of its target, so recursive schemas become
+   *  cycles in the node graph instead of infinite trees
+   */
+  uint32_t compile_ref(const cJSON* ref, const string& path) {
+    if (ref->type != cJSON_String) {
+      error(path, "'$ref' must be a string");
+      return 0;
+    }
+
+    string pointer = ref->valuestring;
+    auto it = _nodes_by_path.find(pointer);
+    if (it != _nodes_by_path.end()) {
+      return it->second;
+    }
+
+    if (!_resolving.insert(pointer).second) {
+      error(path, "circular '$ref' to '" + pointer + "'");
+      return 0;
+    }
+
+    uint32_t index = compile_node(resolve_pointer(pointer, path), pointer);
+    _resolving.erase(pointer);
+    _nodes_by_path[pointer] = index;
+    return index;
+  }
+
+  uint32_t compile_node(const cJSON* schema, const string& path) {
+    if (failed()) {
+      return 0;                     //  the blob is thrown away
+    }
+
+    auto compiled = _nodes_by_path.find(path);
+    if (compiled != _nodes_by_path.end()) {
+      return compiled->second;
+    }
+
+    //  Other keywords next to $ref are ignored
+    const cJSON* ref = find_keyword(schema, "$ref");
+    if (ref != nullptr) {
+      return compile_ref(ref, path);
+    }
+
+    string type_name = get_type(schema, path);
+
+    //  Nodes are filled after their children, which may grow _nodes.
+    //  The index is known before, so children can $ref their ancestors.
+    uint32_t index = _nodes.size();
+    _nodes.push_back(Compiled_schema_node());
+    _nodes_by_path[path] = index;
+    Compiled_schema_node node = {};
+
+    if (type_name == "object") {
+      node.type = COMPILED_OBJECT;
+      compile_object(schema, path, &node);
+    } else if (type_name == "array") {
+      node.type = COMPILED_ARRAY;
+      compile_array(schema, path, &node);
+    } else if (type_name == "string") {
+      node.type = COMPILED_STRING;
+      compile_string(schema, path, &node);
+    } else if (type_name == "integer") {
+      node.type = COMPILED_INT;
+      compile_int(schema, path, &node);
+    } else if (type_name == "boolean") {
+      node.type = COMPILED_BOOLEAN;
+      compile_boolean(schema, path, &node);
+    } else {
+      error(path, "unsupported type '" + type_name + "'");
+    }
+
+    _nodes[index] = node;
+    return index;
+  }
+
+  static uint32_t append_section(string* blob, const void* data,
+                                 size_t size) {
+    blob->resize((blob->size() + 7) & ~(size_t)7, '\0');
+    uint32_t offset = blob->size();
+    blob->append(static_cast<const char*>(data), size);
+    return offset;
+  }
+
+  string write(uint32_t root) const {
+    Compiled_schema_header header = {};
+    memcpy(header.magic, COMPILED_SCHEMA_MAGIC, 4);
+    header.version = COMPILED_SCHEMA_VERSION;
+    header.root = root;
+    header.node_count = _nodes.size();
+    header.property_count = _properties.size();
+    header.value_count = _values.size();
+    header.strings_size = _strings.size();
+
+    string blob(sizeof(header), '\0');
+    header.nodes_offset = append_section(&blob, _nodes.data(),
+      _nodes.size() * sizeof(Compiled_schema_node));
+    header.properties_offset = append_section(&blob, _properties.data(),
+      _properties.size() * sizeof(Compiled_schema_property));
+    header.values_offset = append_section(&blob, _values.data(),
+      _values.size() * sizeof(uint32_t));
+    header.strings_offset = append_section(&blob, _strings.data(),
+                                           _strings.size());
+    blob.resize((blob.size() + 7) & ~(size_t)7, '\0');
+    header.size = blob.size();
+    memcpy(&blob[0], &header, sizeof(header));
+    return blob;
+  }
+
+  public:
+  /**
+   * Compiles an already parsed json-schema.
+   *
+   * @throws std::invalid_argument if the schema is malformed or unsupported
+   */
+  static string compile(const cJSON* json_schema) {
+    Schema_compiler compiler(json_schema);
+    uint32_t root = compiler.compile_node(json_schema, "#");
+    return compiler.write(root);
+  }
+
+  /**
+   * Compiles the schema found at a local json pointer of a document
+   *  (eg: "#/definitions/comment"), resolving $ref against the document
+   */
+  static string compile(const cJSON* document, const string& pointer) {
+    Schema_compiler compiler(document);
+    uint32_t root = compiler.compile_node(
+      compiler.resolve_pointer(pointer, pointer), pointer);
+    return compiler.write(root);
+  }
+
+  static string compile(const string& json_schema) {
+    std::unique_ptr<cJSON, void(*)(cJSON*)> root(
+      cJSON_Parse(json_schema.c_str()), cJSON_Delete);
+    if (root == nullptr) {
+      raise_error(std::invalid_argument("json-schema error: invalid json"));
+    }
+
+    return compile(root.get());
+  }
+
+  /**
+   * Same as above, but the schema errors are written to 'error' instead of
+   *  being raised
+   *
+   * @return the blob, "" if the schema is malformed
+   */
+  static string compile(const cJSON* json_schema, string* error) {
+    Error_sink sink(error);
+    string blob = compile(json_schema);
+    return error->empty() ? blob : string();
+  }
+
+  static string compile(const string& json_schema, string* error) {
+    std::unique_ptr<cJSON, void(*)(cJSON*)> root(
+      cJSON_Parse(json_schema.c_str()), cJSON_Delete);
+    if (root == nullptr) {
+      *error = "json-schema error: invalid json";
+      return string();
+    }
+
+    return compile(root.get(), error);
+  }
+};
+}  // namespace json_validator
+#endif
@@ -0,0 +1,329 @@
+#ifndef CJSON_VALIDATOR_SCHEMA_LOADER_HPP
+#define CJSON_VALIDATOR_SCHEMA_LOADER_HPP
+
+#include <cstring>
+#include <memory>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "error_handling.hpp"
+#include "validator.hpp"
+#include "object_validator.hpp"
+#include "array_validator.hpp"
+#include "string_validator.hpp"
+#include "int_validator.hpp"
+#include "boolean_validator.hpp"
+#include "json_schema_reader.hpp"
+#include "cJSON/cJSON.h"
+
+namespace json_validator {
+using std::set;
+using std::string;
+using std::unique_ptr;
+
+/**
+ * Schema loader builds a validator tree from a json-schema
+ *  (http://json-schema.org) document, so schemas can be changed without
+ *  rebuilding the code that uses them.
+ *
+ * Supported keywords:
+ *  - all types: type, default (string, integer and boolean only)
+ *  - object: properties (a false schema forbids the key), required
+ *  - array: items, minItems, maxItems, uniqueItems
+ *  - string: enum, maxLength
+ *  - integer: enum, minimum, maximum
+ *  - boolean: enum
+ *
+ * Int_validator compares ints, so bounds, enum values and defaults of
+ * integers must be integers, and 'number' (which allows fractions) isn't
+ * supported. Other keywords (title, description, $schema...) are ignored.
+ * Schemas using $ref must be compiled by Schema_compiler instead.
+ * A std::invalid_argument is thrown if the schema is malformed or uses a
+ * type that can't be represented by the existing validators, unless it is
+ * loaded with a Validation_result to report it.
+ */
+template<typename AdapterType, typename Instrumentation = No_instrumentation>
+class Schema_loader : protected Json_schema_reader {
+  public:
+  using Validator_t = Validator<AdapterType, Instrumentation>;
+  using Validator_ptr = unique_ptr<Validator_t>;
+
+  private:
+  using Object_validator_t = Object_validator<AdapterType, Instrumentation>;
+  using Array_validator_t = Array_validator<AdapterType, Instrumentation>;
+  using String_validator_t = String_validator<AdapterType, Instrumentation>;
+  using Int_validator_t = Int_validator<AdapterType, Instrumentation>;
+  using Boolean_validator_t = Boolean_validator<AdapterType, Instrumentation>;
+
+  static Validator_t* build_object(const cJSON* schema,
+                                   const string& path) {
+    unique_ptr<Object_validator_t> validator(
+      new Object_validator_t(typename Object_validator_t::map_validator_t()));
+    const cJSON* required = nullptr;
+    set<string> forbidden_keys;
+
+    for (const cJSON* keyword = schema->child; keyword != nullptr;
+         keyword = keyword->next) {
+      if (is_keyword(keyword, "properties")) {
+        if (keyword->type != cJSON_Object) {
+          error(path, "'properties' must be an object");
+          continue;
+        }
+
+        for (const cJSON* property = keyword->child; property != nullptr;
+             property = property->next) {
+          if (is_boolean(property)) {
+            //  false: the key must not be present, true: anything goes
+            if (property->type == cJSON_False &&
+                !forbidden_keys.insert(property->string).second) {
+              error(path, string("duplicated property '") + property->string +
+                          "'");
+            }
+
+            continue;
+          }
+
+          Validator_ptr property_validator(
+            build(property, property_path(path, property->string)));
+          if (property_validator == nullptr) {
+            return nullptr;
+          }
+
+          if (validator->key_validator(property->string) != nullptr) {
+            error(path, string("duplicated property '") + property->string +
+                        "'");
+          }
+
+          validator->add_validator(property->string,
+                                   property_validator.release());
+        }
+      } else if (is_keyword(keyword, "required")) {
+        required = get_array(keyword, path);
+      } else if (is_keyword(keyword, "default")) {
+        error(path, "'default' is not supported for objects");
+      }
+    }
+
+    for (auto& key : forbidden_keys) {
+      if (validator->key_validator(key) != nullptr) {
+        error(path, "duplicated property '" + key + "'");
+      }
+    }
+
+    if (!forbidden_keys.empty()) {
+      validator->forbidden_keys(forbidden_keys);
+    }
+
+    if (required != nullptr) {
+      for (const cJSON* key = required->child; key != nullptr;
+           key = key->next) {
+        if (key->type != cJSON_String) {
+          error(path, "'required' must contain only strings");
+          continue;
+        }
+
+        auto key_validator = validator->key_validator(key->valuestring);
+        if (key_validator == nullptr) {
+          error(path, string("required key '") + key->valuestring +
+                      "' must be declared in 'properties'");
+          continue;
+        }
+
+        key_validator->required(true);
+      }
+    }
+
+    return validator.release();
+  }
+
+  static Validator_t* build_array(const cJSON* schema,
+                                  const string& path) {
+    unique_ptr<Array_validator_t> validator(new Array_validator_t());
+
+    for (const cJSON* keyword = schema->child; keyword != nullptr;
+         keyword = keyword->next) {
+      if (is_keyword(keyword, "items")) {
+        Validator_t* items = build(keyword, path + "/items");
+        if (items == nullptr) {
+          return nullptr;
+        }
+
+        validator->items(items);
+      } else if (is_keyword(keyword, "minItems")) {
+        validator->min(get_size(keyword, path));
+      } else if (is_keyword(keyword, "maxItems")) {
+        validator->max(get_size(keyword, path));
+      } else if (is_keyword(keyword, "uniqueItems")) {
+        validator->unique(get_boolean(keyword, path));
+      } else if (is_keyword(keyword, "default")) {
+        error(path, "'default' is not supported for arrays");
+      }
+    }
+
+    return validator.release();
+  }
+
+  static Validator_t* build_string(const cJSON* schema,
+                                   const string& path) {
+    unique_ptr<String_validator_t> validator(new String_validator_t());
+
+    for (const cJSON* keyword = schema->child; keyword != nullptr;
+         keyword = keyword->next) {
+      if (is_keyword(keyword, "enum")) {
+        String_validator_possible_values_t possible_values;
+        for (const cJSON* value = get_array(keyword, path)->child;
+             value != nullptr; value = value->next) {
+          if (value->type != cJSON_String) {
+            error(path, "'enum' must contain only strings");
+            continue;
+          }
+
+          possible_values.insert(value->valuestring);
+        }
+
+        validator->valid(possible_values);
+      } else if (is_keyword(keyword, "maxLength")) {
+        validator->max_length(get_size(keyword, path));
+      } else if (is_keyword(keyword, "default")) {
+        if (keyword->type != cJSON_String) {
+          error(path, "'default' must be a string");
+          continue;
+        }
+
+        validator->default_value(keyword->valuestring);
+      }
+    }
+
+    return validator.release();
+  }
+
+  static Validator_t* build_int(const cJSON* schema,
+                                const string& path) {
+    unique_ptr<Int_validator_t> validator(new Int_validator_t());
+
+    for (const cJSON* keyword = schema->child; keyword != nullptr;
+         keyword = keyword->next) {
+      if (is_keyword(keyword, "enum")) {
+        validator->valid(get_int_enum(keyword, path));
+      } else if (is_keyword(keyword, "minimum")) {
+        validator->min_value(get_int(keyword, path));
+      } else if (is_keyword(keyword, "maximum")) {
+        validator->max_value(get_int(keyword, path));
+      } else if (is_keyword(keyword, "default")) {
+        validator->default_value(get_int(keyword, path));
+      }
+    }
+
+    return validator.release();
+  }
+
+  static Validator_t* build_boolean(const cJSON* schema,
+                                    const string& path) {
+    unique_ptr<Boolean_validator_t> validator(new Boolean_validator_t());
+
+    for (const cJSON* keyword = schema->child; keyword != nullptr;
+         keyword = keyword->next) {
+      if (is_keyword(keyword, "enum")) {
+        bool value;
+        if (get_boolean_enum(keyword, path, &value)) {
+          validator->is(value);
+        }
+      } else if (is_keyword(keyword, "default")) {
+        validator->default_value(get_boolean(keyword, path));
+      }
+    }
+
+    return validator.release();
+  }
+
+  static Validator_t* build(const cJSON* schema,
+                            const string& path) {
+    if (failed()) {
+      return nullptr;
+    }
+
+    //  Validators own their children, so they can only describe finite trees
+    if (find_keyword(schema, "$ref") != nullptr) {
+      error(path, "'$ref' is only supported by Schema_compiler");
+      return nullptr;
+    }
+
+    string type_name = get_type(schema, path);
+    if (type_name == "object") {
+      return build_object(schema, path);
+    } else if (type_name == "array") {
+      return build_array(schema, path);
+    } else if (type_name == "string") {
+      return build_string(schema, path);
+    } else if (type_name == "integer") {
+      return build_int(schema, path);
+    } else if (type_name == "boolean") {
+      return build_boolean(schema, path);
+    }
+
+    error(path, "unsupported type '" + type_name + "'");
+    return nullptr;
+  }
+
+  public:
+  /**
+   * Builds the validator described by an already parsed json-schema
+   */
+  static Validator_ptr load(const cJSON* json_schema) {
+    return Validator_ptr(build(json_schema, "#"));
+  }
+
+  /**
+   * Parses and builds the validator described by a json-schema document
+   */
+  static Validator_ptr load(const string& json_schema) {
+    unique_ptr<cJSON, void(*)(cJSON*)> root(cJSON_Parse(json_schema.c_str()),
+                                            cJSON_Delete);
+    if (root == nullptr) {
+      raise_error(std::invalid_argument("json-schema error: invalid json"));
+    }
+
+    return load(root.get());
+  }
+
+  /**
+   * Same as above, but the schema errors are reported through 'result'
+   *  instead of being raised
+   *
+   * @return the validator, null if the schema is malformed
+   */
+  static Validator_ptr load(const cJSON* json_schema,
+                            Validation_result* result) {
+    string error;
+    Validator_ptr validator;
+    {
+      Error_sink sink(&error);
+      validator.reset(build(json_schema, "#"));
+    }
+
+    result->reset();
+    if (!error.empty()) {
+      result->set_error(VALIDATION_FAILED, error);
+      validator.reset();
+    }
+
+    return validator;
+  }
+
+  static Validator_ptr load(const string& json_schema,
+                            Validation_result* result) {
+    unique_ptr<cJSON, void(*)(cJSON*)> root(cJSON_Parse(json_schema.c_str()),
+                                            cJSON_Delete);
+    if (root == nullptr) {
+      result->reset();
+      result->set_error(VALIDATION_FAILED, "json-schema error: invalid json");
+      return nullptr;
+    }
+
+    return load(root.get(), result);
+  }
+};
+}  // namespace json_validator
+#endif
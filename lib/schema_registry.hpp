@@ -0,0 +1,346 @@
+#ifndef CJSON_VALIDATOR_SCHEMA_REGISTRY_HPP
+#define CJSON_VALIDATOR_SCHEMA_REGISTRY_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error_handling.hpp"
+#include "compiled_schema.hpp"
+
+namespace json_validator {
+using std::map;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+/**
+ * Schema registry maps a schema id and version to an immutable compiled
+ *  schema and allows schemas to be (re)published while other threads are
+ *  validating with them.
+ *
+ * Readers never block: a lookup announces the current epoch in the reader's
+ * own slot, loads the current snapshot and reads from it (wait-free).
+ * Writers (publish/remove) are serialised between themselves, copy the
+ * snapshot, change the copy and publish it with a single atomic store.
+ * Replaced snapshots (and the schemas only they reference) are reclaimed
+ * once every reader that could still see them has left its read section
+ * (epoch based reclamation).
+ *
+ * Usage (each validator thread owns a Reader):
+ *    Schema_registry::Reader reader(&registry);
+ *    {
+ *      auto guard = reader.lock();
+ *      const Compiled_schema* schema = guard.find_latest("tenant");
+ *      if (schema != nullptr) {
+ *        schema->validate(json);
+ *      }
+ *    }  // schema must not be used after guard goes out of scope
+ */
+class Schema_registry {
+  private:
+  /**
+   * A compiled schema together with the blob it points to
+   */
+  struct Registered_schema {
+    explicit Registered_schema(const string& compiled_schema)
+        : blob(compiled_schema), schema(blob) { }
+
+    const string blob;
+    const Compiled_schema schema;
+  };
+
+  using Versions = map<uint32_t, shared_ptr<const Registered_schema>>;
+
+  struct Snapshot {
+    map<string, Versions> schemas;
+  };
+
+  static const uint64_t INACTIVE = 0;
+  static const size_t CACHE_LINE_SIZE = 64;
+
+  /**
+   * Epoch announced by a reader, padded to its own cache line
+   */
+  struct Reader_slot {
+    std::atomic<uint64_t> epoch;
+    std::atomic<bool> in_use;
+    char padding[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>) -
+                 sizeof(std::atomic<bool>)];
+  };
+
+  std::atomic<const Snapshot*> _snapshot;
+  std::atomic<uint64_t> _epoch;
+  std::unique_ptr<Reader_slot[]> _slots;
+  size_t _max_readers;
+
+  //  Writers are rare and short, so they just spin on this flag
+  std::atomic_flag _writer_lock;
+  vector<std::pair<uint64_t, const Snapshot*>> _retired;
+
+  class Writer_guard {
+    private:
+    std::atomic_flag* _lock;
+
+    public:
+    explicit Writer_guard(std::atomic_flag* lock) : _lock(lock) {
+      while (_lock->test_and_set(std::memory_order_acquire)) { }
+    }
+
+    ~Writer_guard() {
+      _lock->clear(std::memory_order_release);
+    }
+  };
+
+  /**
+   * Frees retired snapshots that no reader can still be using.
+   *  Must be called with the writer lock held.
+   */
+  void reclaim_retired() {
+    uint64_t oldest_reader = UINT64_MAX;
+    for (size_t i = 0; i < _max_readers; ++i) {
+      uint64_t epoch = _slots[i].epoch.load();
+      if (epoch != INACTIVE && epoch < oldest_reader) {
+        oldest_reader = epoch;
+      }
+    }
+
+    size_t kept = 0;
+    for (auto& retired : _retired) {
+      //  Readers that entered after 'retired.first' see a newer snapshot
+      if (retired.first < oldest_reader) {
+        delete retired.second;
+      } else {
+        _retired[kept++] = retired;
+      }
+    }
+
+    _retired.resize(kept);
+  }
+
+  /**
+   * Publishes 'snapshot' and retires the previous one.
+   *  Must be called with the writer lock held.
+   */
+  void replace_snapshot(const Snapshot* snapshot) {
+    const Snapshot* previous = _snapshot.exchange(snapshot);
+    uint64_t retired_epoch = _epoch.fetch_add(1);
+    _retired.push_back({retired_epoch, previous});
+    reclaim_retired();
+  }
+
+  uint64_t enter(size_t slot) {
+    uint64_t epoch = _epoch.load();
+    _slots[slot].epoch.store(epoch);
+    return epoch;
+  }
+
+  void exit(size_t slot) {
+    _slots[slot].epoch.store(INACTIVE, std::memory_order_release);
+  }
+
+  public:
+  /**
+   * Read section: schemas returned by find() and find_latest() stay valid
+   *  until the guard is destroyed.
+   */
+  class Read_guard {
+    private:
+    Schema_registry* _registry;
+    size_t _slot;
+    const Snapshot* _snapshot;
+
+    public:
+    Read_guard(Schema_registry* registry, size_t slot)
+        : _registry(registry), _slot(slot) {
+      _registry->enter(_slot);
+      _snapshot = _registry->_snapshot.load();
+    }
+
+    Read_guard(Read_guard&& other)
+        : _registry(other._registry), _slot(other._slot),
+          _snapshot(other._snapshot) {
+      other._registry = nullptr;
+    }
+
+    ~Read_guard() {
+      if (_registry != nullptr) {
+        _registry->exit(_slot);
+      }
+    }
+
+    Read_guard(const Read_guard&) = delete;
+    Read_guard& operator=(const Read_guard&) = delete;
+
+    /**
+     * @return nullptr if there is no such schema/version
+     */
+    const Compiled_schema* find(const string& id, uint32_t version) const {
+      auto schema = _snapshot->schemas.find(id);
+      if (schema == _snapshot->schemas.end()) {
+        return nullptr;
+      }
+
+      auto it = schema->second.find(version);
+      if (it == schema->second.end()) {
+        return nullptr;
+      }
+
+      return &it->second->schema;
+    }
+
+    const Compiled_schema* find_latest(const string& id,
+                                       uint32_t* version = nullptr) const {
+      auto schema = _snapshot->schemas.find(id);
+      if (schema == _snapshot->schemas.end() || schema->second.empty()) {
+        return nullptr;
+      }
+
+      auto latest = schema->second.rbegin();
+      if (version != nullptr) {
+        *version = latest->first;
+      }
+
+      return &latest->second->schema;
+    }
+  };
+
+  /**
+   * A reader owns one epoch slot. It must be used by a single thread and
+   *  can't open more than one Read_guard at a time.
+   */
+  class Reader {
+    private:
+    Schema_registry* _registry;
+    size_t _slot;
+
+    public:
+    /**
+     * @throws std::runtime_error if all max_readers slots are in use
+     */
+    explicit Reader(Schema_registry* registry) : _registry(registry) {
+      for (_slot = 0; _slot < _registry->_max_readers; ++_slot) {
+        bool in_use = false;
+        if (_registry->_slots[_slot].in_use.compare_exchange_strong(in_use,
+                                                                    true)) {
+          return;
+        }
+      }
+
+      raise_error(std::runtime_error("Schema_registry: too many readers"));
+    }
+
+    ~Reader() {
+      _registry->_slots[_slot].in_use.store(false);
+    }
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    Read_guard lock() {
+      return Read_guard(_registry, _slot);
+    }
+  };
+
+  explicit Schema_registry(size_t max_readers = 64)
+      : _snapshot(new Snapshot()), _epoch(1),
+        _slots(new Reader_slot[max_readers]), _max_readers(max_readers) {
+    _writer_lock.clear();
+    for (size_t i = 0; i < _max_readers; ++i) {
+      _slots[i].epoch.store(INACTIVE);
+      _slots[i].in_use.store(false);
+    }
+  }
+
+  /**
+   * No reader may be active when the registry is destroyed
+   */
+  ~Schema_registry() {
+    for (auto& retired : _retired) {
+      delete retired.second;
+    }
+
+    delete _snapshot.load();
+  }
+
+  Schema_registry(const Schema_registry&) = delete;
+  Schema_registry& operator=(const Schema_registry&) = delete;
+
+  /**
+   * Adds (or replaces) a version of a schema.
+   *
+   * @param compiled_schema blob returned by Schema_compiler (it is copied)
+   * @throws std::invalid_argument if compiled_schema isn't a valid blob
+   */
+  void publish(const string& id, uint32_t version,
+               const string& compiled_schema) {
+    shared_ptr<const Registered_schema> schema(
+      new Registered_schema(compiled_schema));
+
+    Writer_guard lock(&_writer_lock);
+    Snapshot* snapshot = new Snapshot(*_snapshot.load());
+    snapshot->schemas[id][version] = schema;
+    replace_snapshot(snapshot);
+  }
+
+  /**
+   * Same as above without raising: an invalid blob isn't published
+   *
+   * @param error receives why it's invalid, if not null
+   */
+  bool publish(const string& id, uint32_t version,
+               const string& compiled_schema, string* error) {
+    if (!Compiled_schema::is_valid(compiled_schema, error)) {
+      return false;
+    }
+
+    publish(id, version, compiled_schema);
+    return true;
+  }
+
+  /**
+   * @return false if there is no such schema/version
+   */
+  bool remove(const string& id, uint32_t version) {
+    Writer_guard lock(&_writer_lock);
+    const Snapshot* current = _snapshot.load();
+    auto schema = current->schemas.find(id);
+    if (schema == current->schemas.end() ||
+        schema->second.find(version) == schema->second.end()) {
+      return false;
+    }
+
+    Snapshot* snapshot = new Snapshot(*current);
+    Versions& versions = snapshot->schemas[id];
+    versions.erase(version);
+    if (versions.empty()) {
+      snapshot->schemas.erase(id);
+    }
+
+    replace_snapshot(snapshot);
+    return true;
+  }
+
+  /**
+   * Frees what can be freed now (writers already do it on every change)
+   */
+  void reclaim() {
+    Writer_guard lock(&_writer_lock);
+    reclaim_retired();
+  }
+
+  /**
+   * Number of replaced snapshots still waiting for readers to move on
+   */
+  size_t retired() {
+    Writer_guard lock(&_writer_lock);
+    return _retired.size();
+  }
+};
+}  // namespace json_validator
+#endif
@@ -0,0 +1,659 @@
+#ifndef CJSON_VALIDATOR_STREAMING_VALIDATOR_HPP
+#define CJSON_VALIDATOR_STREAMING_VALIDATOR_HPP
+
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "validator.hpp"
+#include "document_limits.hpp"
+#include "object_validator.hpp"
+#include "array_validator.hpp"
+#include "string_validator.hpp"
+#include "json_adapters/cjson_adapter.hpp"
+
+namespace json_validator {
+using std::set;
+using std::string;
+using std::vector;
+using json_adapters::CJSON_adapter;
+
+/**
+ * Streaming validator validates a json document that arrives in chunks
+ *  (eg: an HTTP body) without buffering the whole document.
+ *
+ * Usage:
+ *    Streaming_validator stream(&validator);
+ *    while (has_chunk) {
+ *      if (!stream.feed(chunk, chunk_size)) {
+ *        // rejected: stream.result() has the error
+ *      }
+ *    }
+ *    auto result = stream.finish();
+ *
+ * Parse and validation state is kept across chunk boundaries:
+ *  - containers (objects and arrays) are tracked on a stack of frames, so
+ *    memory is bounded by nesting depth;
+ *  - only the token being read (a key, string, number or literal) is
+ *    buffered, so memory is also bounded by the longest token.
+ *
+ * Scalars are validated as soon as their last byte arrives and container
+ * constraints (required keys, array sizes) as soon as the container is
+ * closed, so feed() returns false as early as possible. An array past its
+ * maximum length is rejected when the extra item starts, and a string past
+ * its max_length as soon as it has more bytes (both report the size read
+ * so far). Document_limits are
+ * checked byte by byte, which also bounds the frames and the token buffer.
+ *
+ * Limitations: the document is never materialised, so
+ *  - default values can't be added to it (keys with a default value are
+ *    simply not reported as missing);
+ *  - uniqueness of array items is not verified.
+ */
+class Streaming_validator {
+  public:
+  using Validator_t = Validator<CJSON_adapter>;
+  using Object_validator_t = Object_validator<CJSON_adapter>;
+  using Array_validator_t = Array_validator<CJSON_adapter>;
+  using String_validator_t = String_validator<CJSON_adapter>;
+  using cJSON_ptr = std::unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+  private:
+  enum class Expect {
+    VALUE,
+    VALUE_OR_END,     //  right after '['
+    KEY_OR_END,       //  right after '{'
+    KEY,              //  right after ',' inside an object
+    COLON,
+    COMMA_OR_END,
+    NOTHING           //  top level value was already read
+  };
+
+  enum class Token {
+    NONE,
+    STRING,
+    NUMBER,
+    LITERAL
+  };
+
+  /**
+   * State of an open object or array
+   */
+  struct Frame {
+    bool is_object;
+    Validator_t* validator;          //  nullptr if the value isn't validated
+    Validator_t* child_validator;    //  validator of the current key/item
+    string key;                      //  current key (objects only)
+    uint64_t index;                  //  current item, or keys read so far
+    set<const Validator_t*> seen;    //  validated keys found (objects only)
+  };
+
+  Validator_t* _validator;
+  Document_limits _limits;
+  Validation_result_ptr _result;
+  vector<Frame> _frames;
+  Expect _expect;
+  Token _token;
+  string _token_buffer;
+  bool _escaped;
+  int _unicode_digits;                  //  left in a \uXXXX escape
+  size_t _string_length;                //  decoded bytes, at least
+  String_validator_t* _string_validator;  //  of the string being read
+  bool _rejected;
+  uint64_t _offset;
+  uint64_t _nodes;
+
+  static bool is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+  }
+
+  static bool is_number_char(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' ||
+           c == 'e' || c == 'E';
+  }
+
+  static bool is_literal_char(char c) {
+    return c >= 'a' && c <= 'z';
+  }
+
+  static bool is_digit(const string& token, size_t i) {
+    return i < token.size() && token[i] >= '0' && token[i] <= '9';
+  }
+
+  static size_t skip_digits(const string& token, size_t i) {
+    while (is_digit(token, i)) {
+      ++i;
+    }
+
+    return i;
+  }
+
+  /**
+   * cJSON is lenient with numbers (eg: it accepts "-"), so number tokens are
+   *  checked against the json grammar before being parsed.
+   */
+  static bool is_valid_number(const string& token) {
+    size_t i = (token[0] == '-') ? 1 : 0;
+    if (!is_digit(token, i)) {
+      return false;
+    }
+
+    i = (token[i] == '0') ? i + 1 : skip_digits(token, i);
+    if (i < token.size() && token[i] == '.') {
+      if (!is_digit(token, ++i)) {
+        return false;
+      }
+
+      i = skip_digits(token, i);
+    }
+
+    if (i < token.size() && (token[i] == 'e' || token[i] == 'E')) {
+      ++i;
+      if (i < token.size() && (token[i] == '+' || token[i] == '-')) {
+        ++i;
+      }
+
+      if (!is_digit(token, i)) {
+        return false;
+      }
+
+      i = skip_digits(token, i);
+    }
+
+    return i == token.size();
+  }
+
+  static cJSON_ptr parse_token(const string& token) {
+    return cJSON_ptr(cJSON_ParseWithOpts(token.c_str(), nullptr, 1),
+                     cJSON_Delete);
+  }
+
+  void syntax_error(const string& error) {
+    _result->reset();
+    _result->set_error(VALIDATION_SYNTAX_ERROR, "syntax error at byte " +
+                       std::to_string(_offset) + ": " + error);
+    _rejected = true;
+  }
+
+  /**
+   * Rejects a value past a limit, 'depth' being the open containers in its
+   *  path
+   */
+  void limit_exceeded(Validation_error_code code, size_t depth) {
+    _result->reset();
+    _limits.set_error(code, _result.get());
+    reject(depth);
+  }
+
+  /**
+   * Counts a value that starts (not a key)
+   */
+  bool start_value() {
+    if (++_nodes > _limits.max_nodes) {
+      limit_exceeded(VALIDATION_TOO_MANY_NODES, _frames.size());
+      return false;
+    }
+
+    if (_frames.empty() || _frames.back().is_object) {
+      return true;
+    }
+
+    Frame& frame = _frames.back();
+    if (frame.index >= _limits.max_array_length) {
+      limit_exceeded(VALIDATION_ARRAY_TOO_LONG, _frames.size() - 1);
+      return false;
+    }
+
+    auto array = static_cast<Array_validator_t*>(frame.validator);
+    if (array != nullptr && frame.index >= array->maximum_length()) {
+      _result->reset();
+      _result = array->validate_size(frame.index + 1, std::move(_result));
+      reject(_frames.size() - 1);
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * Rejects the string being read, longer than its max_length
+   */
+  void string_too_long() {
+    string maximum = std::to_string(_string_validator->maximum_length());
+    _result->reset();
+    _result->set_error(VALIDATION_ABOVE_MAXIMUM, "has length over " + maximum +
+                       " but max_length is " + maximum, _string_validator,
+                       "length <= " + maximum, "length > " + maximum);
+    reject(_frames.size());
+  }
+
+  /**
+   * Adds the path of the open containers to the error, innermost first
+   *  (the same order used by Object_validator and Array_validator)
+   */
+  void reject(size_t depth) {
+    for (size_t i = depth; i > 0; --i) {
+      const Frame& frame = _frames[i - 1];
+      if (!frame.is_object) {
+        _result->add_index(frame.index);
+      } else if (frame.key != "") {
+        _result->add_key(frame.key);
+      }
+    }
+
+    _rejected = true;
+  }
+
+  /**
+   * Validator of a value that is about to start
+   */
+  Validator_t* value_validator() {
+    if (_frames.empty()) {
+      return _validator;
+    }
+
+    return _frames.back().child_validator;
+  }
+
+  void value_done() {
+    if (_frames.empty()) {
+      _expect = Expect::NOTHING;
+    } else {
+      _expect = Expect::COMMA_OR_END;
+    }
+  }
+
+  void validate_scalar(Validator_t* validator, const cJSON_ptr& value) {
+    if (validator == nullptr) {
+      return;
+    }
+
+    _result = validator->validate(CJSON_adapter(value.get()),
+                                  std::move(_result));
+    if (!_result->success()) {
+      reject(_frames.size());
+    }
+  }
+
+  void open_container(bool is_object) {
+    if (!start_value()) {
+      return;
+    }
+
+    if (_frames.size() >= _limits.max_depth) {
+      limit_exceeded(VALIDATION_TOO_DEEP, _frames.size());
+      return;
+    }
+
+    Validator_t* validator = value_validator();
+    if (validator != nullptr) {
+      bool matches = is_object ?
+          dynamic_cast<Object_validator_t*>(validator) != nullptr :
+          dynamic_cast<Array_validator_t*>(validator) != nullptr;
+
+      if (!matches) {
+        //  Let the validator itself report the type error
+        cJSON_ptr empty(is_object ? cJSON_CreateObject() : cJSON_CreateArray(),
+                        cJSON_Delete);
+        validate_scalar(validator, empty);
+        if (_rejected) {
+          return;
+        }
+
+        validator = nullptr;
+      }
+    }
+
+    Frame frame;
+    frame.is_object = is_object;
+    frame.validator = validator;
+    frame.child_validator = nullptr;
+    frame.index = 0;
+    if (!is_object && validator != nullptr) {
+      frame.child_validator =
+        static_cast<Array_validator_t*>(validator)->items_validator();
+    }
+
+    _frames.push_back(std::move(frame));
+    _expect = is_object ? Expect::KEY_OR_END : Expect::VALUE_OR_END;
+  }
+
+  void close_container() {
+    Frame& frame = _frames.back();
+    if (frame.validator != nullptr) {
+      _result->reset();
+      if (frame.is_object) {
+        auto validator = static_cast<Object_validator_t*>(frame.validator);
+        for (auto& it : validator->validators()) {
+          if (frame.seen.find(it.second) == frame.seen.end() &&
+              !it.second->has_default_value() && it.second->required()) {
+            _result->set_error(VALIDATION_REQUIRED, it.first + " is required",
+                               validator, "key '" + it.first + "'",
+                               "no such key");
+            break;
+          }
+        }
+      } else {
+        uint64_t size = frame.index;
+        _result = static_cast<Array_validator_t*>(frame.validator)
+                    ->validate_size(size, std::move(_result));
+      }
+
+      if (!_result->success()) {
+        reject(_frames.size() - 1);
+        return;
+      }
+    }
+
+    _frames.pop_back();
+    value_done();
+  }
+
+  void read_key() {
+    cJSON_ptr key = parse_token(_token_buffer);
+    if (key == nullptr) {
+      syntax_error("invalid key");
+      return;
+    }
+
+    Frame& frame = _frames.back();
+    frame.key = key->valuestring;
+    frame.child_validator = nullptr;
+    if (frame.validator != nullptr) {
+      auto validator = static_cast<Object_validator_t*>(frame.validator);
+      if (validator->is_forbidden_key(frame.key)) {
+        _result->reset();
+        _result->set_error(VALIDATION_FORBIDDEN_KEY,
+                           "'" + frame.key + "' key is not allowed", validator,
+                           "no key '" + frame.key + "'",
+                           "key '" + frame.key + "'");
+        reject(_frames.size() - 1);
+        return;
+      }
+
+      frame.child_validator = validator->key_validator(frame.key);
+      if (frame.child_validator != nullptr) {
+        frame.seen.insert(frame.child_validator);
+      }
+    }
+
+    _expect = Expect::COLON;
+  }
+
+  void read_scalar(Token token) {
+    cJSON_ptr value(nullptr, cJSON_Delete);
+    if (token != Token::NUMBER || is_valid_number(_token_buffer)) {
+      value = parse_token(_token_buffer);
+    }
+
+    if (value == nullptr) {
+      syntax_error("invalid value '" + _token_buffer + "'");
+      return;
+    }
+
+    validate_scalar(value_validator(), value);
+    value_done();
+  }
+
+  void token_done() {
+    Token token = _token;
+    _token = Token::NONE;
+    _string_length = 0;
+    _string_validator = nullptr;
+    if (token == Token::STRING &&
+        (_expect == Expect::KEY || _expect == Expect::KEY_OR_END)) {
+      read_key();
+    } else {
+      read_scalar(token);
+    }
+
+    _token_buffer.clear();
+  }
+
+  void start_token(Token token, char c) {
+    if (_expect != Expect::VALUE && _expect != Expect::VALUE_OR_END &&
+        !(token == Token::STRING &&
+          (_expect == Expect::KEY || _expect == Expect::KEY_OR_END))) {
+      syntax_error(string("unexpected '") + c + "'");
+      return;
+    }
+
+    if (_expect == Expect::KEY || _expect == Expect::KEY_OR_END) {
+      if (++_frames.back().index > _limits.max_object_keys) {
+        limit_exceeded(VALIDATION_TOO_MANY_KEYS, _frames.size() - 1);
+        return;
+      }
+    } else if (!start_value()) {
+      return;
+    } else if (token == Token::STRING) {
+      _string_validator = dynamic_cast<String_validator_t*>(value_validator());
+    }
+
+    _token = token;
+    _token_buffer.push_back(c);
+  }
+
+  void structural(char c) {
+    switch (c) {
+      case '{':
+      case '[':
+        if (_expect != Expect::VALUE && _expect != Expect::VALUE_OR_END) {
+          break;
+        }
+
+        open_container(c == '{');
+        return;
+      case '}':
+        if (_frames.empty() || !_frames.back().is_object ||
+            (_expect != Expect::KEY_OR_END &&
+             _expect != Expect::COMMA_OR_END)) {
+          break;
+        }
+
+        close_container();
+        return;
+      case ']':
+        if (_frames.empty() || _frames.back().is_object ||
+            (_expect != Expect::VALUE_OR_END &&
+             _expect != Expect::COMMA_OR_END)) {
+          break;
+        }
+
+        if (_expect == Expect::COMMA_OR_END) {
+          _frames.back().index++;
+        }
+
+        close_container();
+        return;
+      case ':':
+        if (_expect != Expect::COLON) {
+          break;
+        }
+
+        _expect = Expect::VALUE;
+        return;
+      case ',':
+        if (_expect != Expect::COMMA_OR_END) {
+          break;
+        }
+
+        if (_frames.back().is_object) {
+          _expect = Expect::KEY;
+        } else {
+          _frames.back().index++;
+          _expect = Expect::VALUE;
+        }
+
+        return;
+      case '"':
+        start_token(Token::STRING, c);
+        return;
+      default:
+        if (c == '-' || (c >= '0' && c <= '9')) {
+          start_token(Token::NUMBER, c);
+          return;
+        }
+
+        if (is_literal_char(c)) {
+          start_token(Token::LITERAL, c);
+          return;
+        }
+    }
+
+    syntax_error(string("unexpected '") + c + "'");
+  }
+
+  void consume(char c) {
+    switch (_token) {
+      case Token::STRING:
+        if (_escaped) {
+          _escaped = false;
+          _unicode_digits = (c == 'u') ? 4 : 0;
+        } else if (c == '\\') {
+          _escaped = true;
+          _unicode_digits = 0;
+          ++_string_length;
+        } else if (c == '"') {
+          _token_buffer.push_back(c);
+          token_done();
+          return;
+        } else if (_unicode_digits > 0) {
+          --_unicode_digits;
+        } else {
+          ++_string_length;
+        }
+
+        if (_string_validator != nullptr &&
+            _string_length > _string_validator->maximum_length()) {
+          string_too_long();
+          return;
+        }
+
+        //  The buffer starts with the opening quote
+        if (_token_buffer.size() > _limits.max_string_bytes) {
+          bool is_key = _expect == Expect::KEY ||
+                        _expect == Expect::KEY_OR_END;
+          limit_exceeded(VALIDATION_STRING_TOO_LONG,
+                         _frames.size() - is_key);
+          return;
+        }
+
+        _token_buffer.push_back(c);
+        return;
+      case Token::NUMBER:
+        if (is_number_char(c)) {
+          _token_buffer.push_back(c);
+          return;
+        }
+
+        token_done();
+        break;
+      case Token::LITERAL:
+        if (is_literal_char(c)) {
+          _token_buffer.push_back(c);
+          return;
+        }
+
+        token_done();
+        break;
+      case Token::NONE:
+        break;
+    }
+
+    if (_rejected || is_whitespace(c)) {
+      return;
+    }
+
+    structural(c);
+  }
+
+  public:
+  explicit Streaming_validator(Validator_t* validator,
+                               const Document_limits& limits =
+                                   Document_limits())
+      : _validator(validator), _limits(limits) {
+    reset();
+  }
+
+  /**
+   * Prepares the validator to receive a new document
+   */
+  void reset() {
+    _result.reset(new Validation_result());
+    _frames.clear();
+    _expect = Expect::VALUE;
+    _token = Token::NONE;
+    _token_buffer.clear();
+    _escaped = false;
+    _unicode_digits = 0;
+    _string_length = 0;
+    _string_validator = nullptr;
+    _rejected = false;
+    _offset = 0;
+    _nodes = 0;
+  }
+
+  /**
+   * Consumes the next chunk of the document.
+   *
+   * @return false as soon as the bytes read so far make the document
+   *  invalid. Further calls are ignored until reset() is called.
+   */
+  bool feed(const char* chunk, size_t size) {
+    for (size_t i = 0; i < size && !_rejected; ++i, ++_offset) {
+      consume(chunk[i]);
+    }
+
+    return !_rejected;
+  }
+
+  bool feed(const string& chunk) {
+    return feed(chunk.data(), chunk.size());
+  }
+
+  /**
+   * Signals the end of the document and returns the validation result
+   */
+  Validation_result_ptr finish() {
+    if (!_rejected && _token != Token::NONE) {
+      if (_token == Token::STRING) {
+        syntax_error("unterminated string");
+      } else {
+        token_done();
+      }
+    }
+
+    if (!_rejected && _expect != Expect::NOTHING) {
+      syntax_error("unexpected end of input");
+    }
+
+    if (!_rejected) {
+      _result->reset();
+    }
+
+    Validation_result_ptr result = std::move(_result);
+    reset();
+    return result;
+  }
+
+  bool rejected() const {
+    return _rejected;
+  }
+
+  /**
+   * Number of bytes consumed so far
+   */
+  uint64_t offset() const {
+    return _offset;
+  }
+
+  Validation_result& result() {
+    return *_result;
+  }
+};
+}  // namespace json_validator
+#endif
@@ -1,5 +1,6 @@
 #ifndef CJSON_VALIDATOR_STRING_VALIDATOR_HPP
 #define CJSON_VALIDATOR_STRING_VALIDATOR_HPP
+#include <algorithm>
 #include <set>
 #include <string>
 #include <limits>
@@ -22,13 +23,15 @@ using String_validator_possible_values_t = set<string>;
  *  1) possible values for the string
  *  2) max length of the string
  */
-template<typename AdapterType>
-class String_validator : public Validator<AdapterType> {
+template<typename AdapterType, typename Instrumentation = No_instrumentation>
+class String_validator : public Validator<AdapterType, Instrumentation> {
   public:
   using JSON_token = json_adapters::JSON_adapter<AdapterType>;
+  using Validator_t = Validator<AdapterType, Instrumentation>;
 
   private:
   String_validator_possible_values_t _possible_values;
+  size_t _maximum_length;
 
   protected:
   Validation_result_ptr validate_type(const JSON_token& token,
@@ -36,7 +39,8 @@ class String_validator : public Validator<AdapterType> {
     result->reset();
 
     if (!token.is_string()) {
-      result->set_error("must be a string");
+      result->set_error(VALIDATION_WRONG_TYPE, "must be a string", this,
+                        "string", token.type_name());
     }
 
     return result;
@@ -53,7 +57,9 @@ class String_validator : public Validator<AdapterType> {
       error_message += "has length " + std::to_string(token_value.size());
       error_message += " but max_length is " + std::to_string(max_length);
 
-      result->set_error(error_message);
+      result->set_error(VALIDATION_ABOVE_MAXIMUM, error_message, this,
+                        "length <= " + std::to_string(max_length),
+                        "length " + std::to_string(token_value.size()));
     }
 
     return result;
@@ -70,18 +76,22 @@ class String_validator : public Validator<AdapterType> {
       string error_message = "Value \"" + string(token_value);
       error_message += "\" not allowed";
 
-      result->set_error(error_message);
+      result->set_error(VALIDATION_NOT_ALLOWED, error_message, this,
+                        this->one_of(possible_values),
+                        "\"" + token_value + "\"");
     }
 
     return result;
   }
 
-  void set_default_value(const JSON_token& json, const string& key) override {
+  bool set_default_value(const JSON_token& json, const string& key) override {
     this->_set_default_value(json, key, _default_value);
+    return true;
   }
 
   public:
-  String_validator() {
+  String_validator()
+      : _maximum_length(std::numeric_limits<size_t>::max()) {
     this->_valdations.push_back([this] (const JSON_token& token,
                                 Validation_result_ptr result) {
       return this->validate_type(token, std::move(result));
@@ -101,6 +111,7 @@ class String_validator : public Validator<AdapterType> {
   }
 
   String_validator* max_length(size_t max_length) {
+    _maximum_length = std::min(_maximum_length, max_length);
     this->_valdations.push_back([this, max_length] (const JSON_token& token,
                                 Validation_result_ptr result) {
       return this->validate_max_length(token, max_length, std::move(result));
@@ -114,6 +125,20 @@ class String_validator : public Validator<AdapterType> {
     return this;
   }
 
+  /**
+   * Tightest max_length set (the limit of size_t when none was)
+   */
+  size_t maximum_length() const {
+    return _maximum_length;
+  }
+
+  /**
+   * Values set by valid() (empty if any value is)
+   */
+  const String_validator_possible_values_t& possible_values() const {
+    return _possible_values;
+  }
+
   private:
   string _default_value;
 };
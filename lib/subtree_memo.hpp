@@ -0,0 +1,243 @@
+#ifndef CJSON_VALIDATOR_SUBTREE_MEMO_HPP
+#define CJSON_VALIDATOR_SUBTREE_MEMO_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "json_adapters/adapter.hpp"
+
+namespace json_validator {
+using std::string;
+
+/**
+ * Subtrees already found valid during one validation, keyed by (schema
+ *  node, structural hash of the subtree), so that a value repeated across
+ *  a document (the same object in every item of an array) is validated
+ *  once.
+ *
+ * It is per-call scratch: Array_validator::memoize() keeps one on the stack
+ * while it validates its items and hands it down with the
+ * Validation_result. Nested objects and arrays look their members up in it
+ * (see Validator::validate_memoized). Subtrees validated by parallel tasks
+ * don't see it.
+ *
+ * Hashing isn't free. Each schema node counts the nodes it hashed and the
+ * nodes a hit spared it from validating, and it stops hashing for the rest
+ * of the call once the first outweighs the second. Only successes are
+ * remembered, and only if validation didn't add defaults to the subtree.
+ *
+ * The hash has 128 bits but isn't cryptographic: a subtree crafted to
+ * collide would take the verdict of another one.
+ */
+class Subtree_memo {
+  public:
+  struct Key {
+    const void* schema_node;
+    uint64_t low;
+    uint64_t high;
+    size_t nodes;
+
+    bool operator==(const Key& other) const {
+      return schema_node == other.schema_node && low == other.low &&
+             high == other.high && nodes == other.nodes;
+    }
+  };
+
+  /**
+   * Cost accounting of one schema node, in hashed nodes
+   */
+  struct Node {
+    size_t lookups;
+    uint64_t hashed;
+    uint64_t saved;
+    bool stopped;
+  };
+
+  /**
+   * A validated node costs about this many hashed ones (see the
+   *  performance tests)
+   */
+  static const uint64_t VALIDATION_COST = 3;
+
+  /**
+   * Lookups and nodes hashed per lookup before the accounting can stop it
+   */
+  static const size_t WARM_UP = 8;
+  static const uint64_t LOOKUP_COST = 4;
+
+  private:
+  struct Key_hash {
+    size_t operator()(const Key& key) const {
+      return (size_t)(key.low ^ reinterpret_cast<uintptr_t>(key.schema_node));
+    }
+  };
+
+  class Hasher {
+    public:
+    uint64_t low;
+    uint64_t high;
+    size_t nodes;
+
+    Hasher() : low(0x9e3779b97f4a7c15ULL), high(0x52dce729ULL), nodes(0) { }
+
+    void add(uint64_t value) {
+      value *= 0x87c37b91114253d5ULL;
+      value = rotl(value, 31);
+      value *= 0x4cf5ad432745937fULL;
+      low ^= value;
+      low = rotl(low, 27) + high;
+      low = low * 5 + 0x52dce729;
+      high ^= rotl(value, 17);
+      high = rotl(high, 31) + low;
+      high = high * 5 + 0x38495ab5;
+    }
+
+    void add(const string& value) {
+      add(value.size());
+      size_t i = 0;
+      for (; i + 8 <= value.size(); i += 8) {
+        uint64_t block;
+        memcpy(&block, value.data() + i, 8);
+        add(block);
+      }
+
+      if (i < value.size()) {
+        uint64_t block = 0;
+        memcpy(&block, value.data() + i, value.size() - i);
+        add(block);
+      }
+    }
+
+    template<typename AdapterType>
+    void add(const json_adapters::JSON_adapter<AdapterType>& token) {
+      nodes++;
+      if (token.is_object()) {
+        add('{');
+        for (auto it = token.object_begin(); it != token.object_end(); ++it) {
+          add(it.get_name());
+          add(json_adapter_factory(it));
+        }
+
+        add('}');
+      } else if (token.is_array()) {
+        add('[');
+        for (auto it = token.array_begin(); it != token.array_end(); ++it) {
+          add(json_adapter_factory(it));
+        }
+
+        add(']');
+      } else if (token.is_string()) {
+        add('s');
+        add(token.get_string());
+      } else if (token.is_number()) {
+        //  Integers and doubles pass different validators
+        double number = token.get_double();
+        uint64_t bits;
+        memcpy(&bits, &number, sizeof(bits));
+        add(token.is_integer() ? 'i' : 'd');
+        add(bits);
+      } else if (token.is_boolean()) {
+        add(token.get_boolean() ? 't' : 'f');
+      } else {
+        add('z');
+      }
+    }
+
+    private:
+    static uint64_t rotl(uint64_t value, int bits) {
+      return (value << bits) | (value >> (64 - bits));
+    }
+  };
+
+  std::unordered_set<Key, Key_hash> _valid;
+  std::unordered_map<const void*, Node> _nodes;
+  size_t _hits;
+  size_t _misses;
+
+  void account(Node* node) {
+    if (node->lookups >= WARM_UP && node->saved < node->hashed) {
+      node->stopped = true;
+    }
+  }
+
+  public:
+  Subtree_memo() : _hits(0), _misses(0) { }
+
+  Subtree_memo(const Subtree_memo&) = delete;
+  Subtree_memo& operator=(const Subtree_memo&) = delete;
+
+  template<typename AdapterType>
+  static Key key(const void* schema_node,
+                 const json_adapters::JSON_adapter<AdapterType>& token) {
+    Hasher hasher;
+    hasher.add(token);
+    return {schema_node, hasher.low, hasher.high, hasher.nodes};
+  }
+
+  template<typename AdapterType>
+  static size_t count_nodes(
+      const json_adapters::JSON_adapter<AdapterType>& token) {
+    size_t count = 1;
+    if (token.is_object()) {
+      for (auto it = token.object_begin(); it != token.object_end(); ++it) {
+        count += count_nodes(json_adapter_factory(it));
+      }
+    } else if (token.is_array()) {
+      for (auto it = token.array_begin(); it != token.array_end(); ++it) {
+        count += count_nodes(json_adapter_factory(it));
+      }
+    }
+
+    return count;
+  }
+
+  /**
+   * Accounting of 'schema_node', nullptr once hashing its subtrees stopped
+   *  paying off
+   */
+  Node* node(const void* schema_node) {
+    Node& node = _nodes[schema_node];
+    return node.stopped ? nullptr : &node;
+  }
+
+  bool find(Node* node, const Key& key) {
+    node->lookups++;
+    node->hashed += key.nodes + LOOKUP_COST;
+    bool found = _valid.count(key) != 0;
+    if (found) {
+      node->saved += key.nodes * VALIDATION_COST;
+      _hits++;
+    } else {
+      _misses++;
+    }
+
+    account(node);
+    return found;
+  }
+
+  /**
+   * Remembers a subtree found valid, which had 'nodes' nodes once
+   *  validated: more than the key's means defaults were added
+   */
+  void insert(Node* node, const Key& key, size_t nodes) {
+    node->hashed += nodes;
+    if (nodes == key.nodes) {
+      _valid.insert(key);
+    }
+
+    account(node);
+  }
+
+  size_t hits() const {
+    return _hits;
+  }
+
+  size_t misses() const {
+    return _misses;
+  }
+};
+}  // namespace json_validator
+#endif
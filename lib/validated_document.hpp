@@ -0,0 +1,236 @@
+#ifndef CJSON_VALIDATOR_VALIDATED_DOCUMENT_HPP
+#define CJSON_VALIDATOR_VALIDATED_DOCUMENT_HPP
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "error_handling.hpp"
+#include "validator.hpp"
+#include "json_adapters/cjson_adapter.hpp"
+
+extern "C" {
+#include "cJSON/cJSON_Utils.h"
+}
+
+namespace json_validator {
+using std::string;
+
+/**
+ * A cJSON document and its verdict, kept up to date across JSON Patch
+ *  (RFC 6902) edits without validating the whole document again.
+ *
+ * Each operation is applied with cJSON_Utils and the nodes it changes are
+ * marked (with their ancestors) as Touched_nodes. If the document was
+ * valid, Validator::revalidate then only visits the touched paths: new
+ * values are validated, required keys are checked in objects that lost
+ * members, length in arrays that gained or lost items and uniqueness in
+ * arrays with any change below them. The result is the one a full
+ * validate() would give; an invalid document is validated again in full.
+ *
+ * The document and the validator must outlive the Validated_document.
+ *
+ *    Validated_document stored(&validator, document);
+ *    auto result = stored.patch(patches);
+ */
+class Validated_document {
+  private:
+  using CJSON_adapter = json_adapters::CJSON_adapter;
+
+  Validator<CJSON_adapter>* _validator;
+  cJSON* _document;
+  bool _valid;
+  Touched_nodes _touched;
+
+  void mark_ancestors(const string& parent_path, uint8_t parent_flags) {
+    for (size_t slash = 0; slash < parent_path.size(); ++slash) {
+      if (parent_path[slash] == '/') {
+        string prefix = parent_path.substr(0, slash);
+        cJSON* node = cJSONUtils_GetPointer(_document, prefix.c_str());
+        if (node != nullptr) {
+          _touched.mark(node, Touched_nodes::DESCENDANTS);
+        }
+      }
+    }
+
+    cJSON* parent = cJSONUtils_GetPointer(_document, parent_path.c_str());
+    if (parent != nullptr) {
+      _touched.mark(parent, Touched_nodes::DESCENDANTS | parent_flags);
+    }
+  }
+
+  /**
+   * Marks the node an add (or replace, move, copy) put at 'path' the way
+   *  cJSON_Utils does it: appended to objects, inserted in arrays.
+   */
+  void mark_added(const string& path, bool new_member) {
+    size_t slash = path.rfind('/');
+    string parent_path = path.substr(0, slash);
+    string child = path.substr(slash + 1);
+    mark_ancestors(parent_path, new_member ? Touched_nodes::MEMBERS : 0);
+
+    cJSON* parent = cJSONUtils_GetPointer(_document, parent_path.c_str());
+    if (parent == nullptr) {
+      return;
+    }
+
+    cJSON* added = nullptr;
+    if (parent->type == cJSON_Array) {
+      added = child == "-" ? cJSON_GetArrayItem(parent,
+                                                cJSON_GetArraySize(parent) - 1)
+                           : cJSON_GetArrayItem(parent, atoi(child.c_str()));
+    } else if (parent->type == cJSON_Object) {
+      added = parent->child;
+      while (added != nullptr && added->next != nullptr) {
+        added = added->next;
+      }
+    }
+
+    //  Not found where expected: the whole parent is checked again
+    _touched.mark(added != nullptr ? added : parent, Touched_nodes::WHOLE);
+  }
+
+  void mark_removed(const string& path) {
+    mark_ancestors(path.substr(0, path.rfind('/')), Touched_nodes::MEMBERS);
+  }
+
+  /**
+   * 'name' of an operation (a pointer below the root), "" if it has none
+   */
+  static string pointer(cJSON* operation, const char* name) {
+    cJSON* item = cJSON_GetObjectItem(operation, name);
+    if (item == nullptr || item->type != cJSON_String ||
+        item->valuestring[0] != '/') {
+      return "";
+    }
+
+    return item->valuestring;
+  }
+
+  /**
+   * Throws the error of a patch, or returns it without exceptions
+   */
+  Validation_result_ptr fail(const string& error,
+                             Validation_result_ptr result) {
+    raise_error_or_fail(std::invalid_argument(error));
+    result->reset();
+    result->set_error(VALIDATION_FAILED, error);
+    return result;
+  }
+
+  /**
+   * Applies and marks one operation
+   *
+   * @return the error if the operation is malformed or fails, "" otherwise
+   */
+  string apply(cJSON* operation, size_t index) {
+    string prefix = "Validated_document: operation " + std::to_string(index);
+    cJSON* op = cJSON_GetObjectItem(operation, "op");
+    if (op == nullptr || op->type != cJSON_String) {
+      return prefix + " has no 'op'";
+    }
+
+    string name = op->valuestring;
+    string path = pointer(operation, "path");
+    string from = name == "move" || name == "copy" ?
+                  pointer(operation, "from") : "/";
+    if (path == "" || from == "") {
+      return prefix + " needs a '" + (path == "" ? "path" : "from") +
+             "' below the root";
+    }
+
+    //  Resolved first: the add of a move can shift the indices of 'from'
+    if (name == "remove") {
+      mark_removed(path);
+    } else if (name == "move") {
+      mark_removed(from);
+    }
+
+    cJSON* single = cJSON_CreateArray();
+    cJSON_AddItemReferenceToArray(single, operation);
+    int error = cJSONUtils_ApplyPatches(_document, single);
+    cJSON_Delete(single);
+    if (error != 0) {
+      return prefix + " failed (" + std::to_string(error) + ")";
+    }
+
+    if (name == "replace") {
+      mark_added(path, false);
+    } else if (name == "add" || name == "copy" || name == "move") {
+      mark_added(path, true);
+    }
+
+    return "";
+  }
+
+  public:
+  /**
+   * Validates the document in full
+   */
+  Validated_document(Validator<CJSON_adapter>* validator, cJSON* document)
+      : _validator(validator), _document(document),
+        _valid(validator->validate(CJSON_adapter(document))->success()) { }
+
+  Validated_document(const Validated_document&) = delete;
+  Validated_document& operator=(const Validated_document&) = delete;
+
+  cJSON* document() const {
+    return _document;
+  }
+
+  bool valid() const {
+    return _valid;
+  }
+
+  /**
+   * Nodes marked by the last patch
+   */
+  size_t touched_nodes() const {
+    return _touched.size();
+  }
+
+  /**
+   * Applies 'patches' (a JSON Patch array) and returns what validating the
+   *  whole document would return now.
+   *
+   * If an operation is malformed or fails, throws std::invalid_argument or,
+   * without exceptions, returns a VALIDATION_FAILED result with its error.
+   * Like cJSONUtils_ApplyPatches the patch isn't atomic: the operations
+   * before it stay applied (and valid() reflects them).
+   */
+  Validation_result_ptr patch(cJSON* patches) {
+    _touched.clear();
+    Validation_result_ptr result(new Validation_result());
+    if (patches == nullptr || patches->type != cJSON_Array) {
+      return fail("Validated_document: patches must be an array",
+                  std::move(result));
+    }
+
+    size_t index = 0;
+    for (cJSON* operation = patches->child; operation != nullptr;
+         operation = operation->next, ++index) {
+      string error = apply(operation, index);
+      if (error != "") {
+        result = _validator->validate(CJSON_adapter(_document),
+                                      std::move(result));
+        _valid = result->success();
+        return fail(error, std::move(result));
+      }
+    }
+
+    if (_valid) {
+      result = _validator->revalidate(CJSON_adapter(_document), _touched,
+                                      std::move(result));
+    } else {
+      result = _validator->validate(CJSON_adapter(_document),
+                                    std::move(result));
+    }
+
+    _valid = result->success();
+    return result;
+  }
+};
+}  // namespace json_validator
+#endif
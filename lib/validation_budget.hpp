@@ -0,0 +1,163 @@
+#ifndef CJSON_VALIDATOR_VALIDATION_BUDGET_HPP
+#define CJSON_VALIDATOR_VALIDATION_BUDGET_HPP
+
+#include <time.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "validation_result.hpp"
+
+namespace json_validator {
+
+/**
+ * Time budget of a validation: a deadline and a cancellation token, handed
+ *  down to the validators by the result (like Subtree_memo).
+ *
+ *  Validation_budget budget(2000000);        //  2ms from now
+ *  result->budget(&budget);
+ *  result = validator.validate(token, std::move(result));
+ *  if (result->code() == VALIDATION_BUDGET_EXCEEDED) {
+ *    //  result->pointer() is the value it stopped at, budget.nodes() says
+ *    //  how many were validated before it
+ *  }
+ *
+ * Every validated value spends one node, and so does every item compared
+ * by uniqueItems. The clock and the token are only looked at every
+ * 'check_every' nodes (and on the first one), so a node costs an increment
+ * and a branch. Builder validators and Compiled_schema check it; children
+ * of a parallel Object_validator or Array_validator validated by other
+ * threads don't. A budget is used by one validation at a time, but
+ * cancel() can be called from any thread.
+ *
+ * A document that exceeded its budget is neither valid nor invalid: don't
+ * cache the verdict (see Validation_cache).
+ */
+class Validation_budget {
+  public:
+  static const uint64_t NO_DEADLINE = UINT64_MAX;
+  static const uint32_t CHECK_EVERY = 256;
+
+  private:
+  uint64_t _deadline_ns;
+  uint32_t _check_every;
+  uint64_t _spent;
+  uint64_t _next_check;
+  uint64_t _validated;              //  once exceeded
+  bool _exceeded;
+  std::atomic<bool> _cancelled;
+
+  bool check() {
+    if (_exceeded) {
+      return false;
+    }
+
+    _next_check = _spent + _check_every;
+    if (_cancelled.load(std::memory_order_relaxed) ||
+        (_deadline_ns != NO_DEADLINE && now_ns() >= _deadline_ns)) {
+      _exceeded = true;
+      _validated = _spent - 1;
+      _next_check = 0;
+    }
+
+    return !_exceeded;
+  }
+
+  public:
+  /**
+   * @param timeout_ns from now, NO_DEADLINE for a cancellation token only
+   */
+  explicit Validation_budget(uint64_t timeout_ns = NO_DEADLINE,
+                             uint32_t check_every = CHECK_EVERY)
+      : _check_every(check_every == 0 ? 1 : check_every), _cancelled(false) {
+    restart(timeout_ns);
+  }
+
+  Validation_budget(const Validation_budget&) = delete;
+  Validation_budget& operator=(const Validation_budget&) = delete;
+
+  /**
+   * Monotonic clock of the deadlines, in ns
+   */
+  static uint64_t now_ns() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<uint64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+  }
+
+  /**
+   * Starts over with a new deadline (the budget can be reused by the next
+   *  validation), not cancelled
+   */
+  void restart(uint64_t timeout_ns = NO_DEADLINE) {
+    _deadline_ns = NO_DEADLINE;
+    if (timeout_ns != NO_DEADLINE) {
+      uint64_t now = now_ns();
+      _deadline_ns = timeout_ns < NO_DEADLINE - now ? now + timeout_ns :
+                                                      NO_DEADLINE - 1;
+    }
+
+    _spent = 0;
+    _next_check = 1;
+    _validated = 0;
+    _exceeded = false;
+    _cancelled.store(false, std::memory_order_relaxed);
+  }
+
+  /**
+   * Stops the validation at its next check. Thread-safe.
+   */
+  void cancel() {
+    _cancelled.store(true, std::memory_order_relaxed);
+  }
+
+  /**
+   * Spends a node
+   *
+   * @return false if the node must not be validated: the deadline passed or
+   *  the validation was cancelled (and from then on)
+   */
+  bool spend() {
+    if (++_spent < _next_check) {
+      return true;
+    }
+
+    return check();
+  }
+
+  bool exceeded() const {
+    return _exceeded;
+  }
+
+  bool cancelled() const {
+    return _cancelled.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Nodes validated, the one it stopped at excluded
+   */
+  uint64_t nodes() const {
+    return _exceeded ? _validated : _spent;
+  }
+
+  uint64_t deadline_ns() const {
+    return _deadline_ns;
+  }
+
+  /**
+   * Sets the error of a validation stopped by this budget (the pointer is
+   *  left to the containers)
+   */
+  void set_error(Validation_result* result) const {
+    string nodes = std::to_string(this->nodes());
+    result->reset();
+    result->set_error(VALIDATION_BUDGET_EXCEEDED, string(cancelled() ?
+                      "cancelled" : "deadline exceeded") + " after " + nodes +
+                      " nodes", nullptr, "validation within budget",
+                      nodes + " nodes validated");
+  }
+};
+
+}  // namespace json_validator
+
+#endif
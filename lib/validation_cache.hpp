@@ -0,0 +1,342 @@
+#ifndef CJSON_VALIDATOR_VALIDATION_CACHE_HPP
+#define CJSON_VALIDATOR_VALIDATION_CACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace json_validator {
+using std::string;
+using std::vector;
+
+/**
+ * Content hash of a raw document (MurmurHash3 x64 128), seeded with the
+ *  identity of the schema it is validated against (a hash too).
+ *
+ * A schema is identified by the hash of its compiled blob (or source), so
+ * two schemas or a version replaced in a Schema_registry never share
+ * verdicts, or else by its registry id and version, which is cheaper but
+ * needs a clear() of the cache when a version is replaced.
+ *
+ * 128 bits make an accidental collision (which would return the verdict of
+ * another document) negligible: ~1e-20 for a billion cached documents.
+ * It is not a cryptographic hash, documents crafted to collide are possible.
+ */
+struct Document_hash {
+  uint64_t low;
+  uint64_t high;
+
+  bool operator==(const Document_hash& other) const {
+    return low == other.low && high == other.high;
+  }
+
+  static Document_hash of(const char* data, size_t size,
+                          const Document_hash& schema) {
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+    uint64_t h1 = schema.low;
+    uint64_t h2 = schema.high ^ 0x9e3779b97f4a7c15ULL;
+
+    size_t blocks = size / 16;
+    for (size_t i = 0; i < blocks; ++i) {
+      uint64_t k1, k2;
+      memcpy(&k1, data + i * 16, 8);
+      memcpy(&k2, data + i * 16 + 8, 8);
+
+      k1 *= c1;
+      k1 = rotl(k1, 31);
+      k1 *= c2;
+      h1 ^= k1;
+      h1 = rotl(h1, 27) + h2;
+      h1 = h1 * 5 + 0x52dce729;
+
+      k2 *= c2;
+      k2 = rotl(k2, 33);
+      k2 *= c1;
+      h2 ^= k2;
+      h2 = rotl(h2, 31) + h1;
+      h2 = h2 * 5 + 0x38495ab5;
+    }
+
+    //  Tail (up to 15 bytes), zero padded
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    size_t tail = size & 15;
+    const char* rest = data + blocks * 16;
+    if (tail > 8) {
+      memcpy(&k2, rest + 8, tail - 8);
+      k2 *= c2;
+      k2 = rotl(k2, 33);
+      k2 *= c1;
+      h2 ^= k2;
+    }
+
+    if (tail > 0) {
+      memcpy(&k1, rest, tail > 8 ? 8 : tail);
+      k1 *= c1;
+      k1 = rotl(k1, 31);
+      k1 *= c2;
+      h1 ^= k1;
+    }
+
+    h1 ^= size;
+    h2 ^= size;
+    h1 += h2;
+    h2 += h1;
+    h1 = mix(h1);
+    h2 = mix(h2);
+    h1 += h2;
+    h2 += h1;
+    return {h1, h2};
+  }
+
+  static Document_hash of(const string& document,
+                          const Document_hash& schema) {
+    return of(document.data(), document.size(), schema);
+  }
+
+  /**
+   * Identity of a schema: its compiled blob, or its source
+   */
+  static Document_hash schema(const string& blob) {
+    return of(blob, Document_hash());
+  }
+
+  /**
+   * Identity of a schema by registry id and version
+   */
+  static Document_hash schema(const string& id, uint64_t version) {
+    string key = id;
+    key.push_back('\0');
+    key.append(reinterpret_cast<const char*>(&version), sizeof(version));
+    return of(key, Document_hash());
+  }
+
+  private:
+  static uint64_t rotl(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+  }
+
+  static uint64_t mix(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+  }
+};
+
+/**
+ * Validation cache remembers the verdict (valid or not) of documents
+ *  already validated, keyed by the hash of their raw bytes and the schema
+ *  identity (see Document_hash), so byte identical payloads (retries, heartbeats, templated
+ *  events...) skip parsing and validation.
+ *
+ * Memory is bounded: the capacity is fixed at construction and nothing is
+ * allocated afterwards. Entries are spread over shards (one spin lock each,
+ * on its own cache line) and inside a shard over 4-way buckets. A full
+ * bucket evicts with CLOCK (second chance): entries hit since the hand last
+ * passed are skipped once.
+ *
+ * Only the verdict is cached: on a hit the document is not parsed, so
+ * defaults are not applied and there is no error message.
+ *
+ *    Validation_cache cache(1 << 16);
+ *    auto schema = Document_hash::schema(blob);    //  once per schema
+ *    bool valid = cache.validate(data, size, schema,
+ *      [&](const char* data, size_t size) { return parse_and_validate(); });
+ */
+class Validation_cache {
+  private:
+  static const size_t WAYS = 4;
+  static const uint8_t USED = 1 << 0;
+  static const uint8_t VALID = 1 << 1;
+  static const uint8_t REFERENCED = 1 << 2;
+
+  struct Bucket {
+    Document_hash hashes[WAYS];
+    uint8_t flags[WAYS];
+    uint8_t hand;
+  };
+
+  struct Shard {
+    std::atomic_flag lock;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    vector<Bucket> buckets;
+    char padding[64];                     //  keeps shards on their own lines
+  };
+
+  class Shard_guard {
+    private:
+    Shard* _shard;
+
+    public:
+    explicit Shard_guard(Shard* shard) : _shard(shard) {
+      while (_shard->lock.test_and_set(std::memory_order_acquire)) { }
+    }
+
+    ~Shard_guard() {
+      _shard->lock.clear(std::memory_order_release);
+    }
+  };
+
+  std::unique_ptr<Shard[]> _shards;
+  size_t _shard_mask;
+  size_t _bucket_mask;
+
+  static size_t power_of_two(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+
+    return result;
+  }
+
+  Shard& shard(const Document_hash& hash) const {
+    return _shards[hash.low & _shard_mask];
+  }
+
+  Bucket& bucket(Shard* shard, const Document_hash& hash) const {
+    return shard->buckets[hash.high & _bucket_mask];
+  }
+
+  public:
+  struct Statistics {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+
+    double hit_rate() const {
+      return hits + misses == 0 ? 0 : hits / static_cast<double>(hits + misses);
+    }
+  };
+
+  /**
+   * @param capacity maximum number of cached verdicts (rounded up to a
+   *  power of two, 18 bytes each)
+   * @param shards number of independently locked parts (power of two)
+   */
+  explicit Validation_cache(size_t capacity, size_t shards = 64) {
+    size_t shard_count = power_of_two(shards == 0 ? 1 : shards);
+    size_t buckets = power_of_two((capacity + WAYS - 1) / WAYS);
+    if (buckets < shard_count) {
+      shard_count = buckets;
+    }
+
+    _shards.reset(new Shard[shard_count]);
+    _shard_mask = shard_count - 1;
+    _bucket_mask = buckets / shard_count - 1;
+    for (size_t i = 0; i < shard_count; ++i) {
+      _shards[i].lock.clear();
+      _shards[i].hits = 0;
+      _shards[i].misses = 0;
+      _shards[i].evictions = 0;
+      _shards[i].buckets.resize(buckets / shard_count, Bucket());
+    }
+  }
+
+  Validation_cache(const Validation_cache&) = delete;
+  Validation_cache& operator=(const Validation_cache&) = delete;
+
+  size_t capacity() const {
+    return (_shard_mask + 1) * (_bucket_mask + 1) * WAYS;
+  }
+
+  /**
+   * @return true (and the cached verdict in 'valid') on a hit
+   */
+  bool find(const Document_hash& hash, bool* valid) {
+    Shard& shard = this->shard(hash);
+    Shard_guard guard(&shard);
+    Bucket& bucket = this->bucket(&shard, hash);
+    for (size_t i = 0; i < WAYS; ++i) {
+      if ((bucket.flags[i] & USED) && bucket.hashes[i] == hash) {
+        bucket.flags[i] |= REFERENCED;
+        *valid = bucket.flags[i] & VALID;
+        shard.hits++;
+        return true;
+      }
+    }
+
+    shard.misses++;
+    return false;
+  }
+
+  void insert(const Document_hash& hash, bool valid) {
+    Shard& shard = this->shard(hash);
+    Shard_guard guard(&shard);
+    Bucket& bucket = this->bucket(&shard, hash);
+    uint8_t flags = USED | (valid ? VALID : 0);
+
+    for (size_t i = 0; i < WAYS; ++i) {
+      if (!(bucket.flags[i] & USED) || bucket.hashes[i] == hash) {
+        bucket.hashes[i] = hash;
+        bucket.flags[i] = flags;
+        return;
+      }
+    }
+
+    //  CLOCK: give referenced entries a second chance
+    while (bucket.flags[bucket.hand] & REFERENCED) {
+      bucket.flags[bucket.hand] &= ~REFERENCED;
+      bucket.hand = (bucket.hand + 1) % WAYS;
+    }
+
+    bucket.hashes[bucket.hand] = hash;
+    bucket.flags[bucket.hand] = flags;
+    bucket.hand = (bucket.hand + 1) % WAYS;
+    shard.evictions++;
+  }
+
+  /**
+   * Returns the cached verdict or calls validate(data, size) (without
+   *  holding any lock) and caches its result
+   */
+  template<typename Validate>
+  bool validate(const char* data, size_t size, const Document_hash& schema,
+                Validate validate) {
+    Document_hash hash = Document_hash::of(data, size, schema);
+    bool valid = false;
+    if (find(hash, &valid)) {
+      return valid;
+    }
+
+    valid = validate(data, size);
+    insert(hash, valid);
+    return valid;
+  }
+
+  Statistics statistics() const {
+    Statistics statistics = {0, 0, 0};
+    for (size_t i = 0; i <= _shard_mask; ++i) {
+      Shard_guard guard(&_shards[i]);
+      statistics.hits += _shards[i].hits;
+      statistics.misses += _shards[i].misses;
+      statistics.evictions += _shards[i].evictions;
+    }
+
+    return statistics;
+  }
+
+  /**
+   * Forgets every verdict (eg: after a schema identified by its id and
+   *  version changed)
+   */
+  void clear() {
+    for (size_t i = 0; i <= _shard_mask; ++i) {
+      Shard_guard guard(&_shards[i]);
+      for (auto& bucket : _shards[i].buckets) {
+        bucket = Bucket();
+      }
+    }
+  }
+};
+}  // namespace json_validator
+#endif
@@ -0,0 +1,519 @@
+#ifndef CJSON_VALIDATOR_VALIDATION_PIPELINE_HPP
+#define CJSON_VALIDATOR_VALIDATION_PIPELINE_HPP
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "error_handling.hpp"
+#include "compiled_schema.hpp"
+#include "document_limits.hpp"
+#include "json_adapters/cjson_adapter.hpp"
+#include "lock_free_queue.hpp"
+#include "validation_result.hpp"
+#include "validator.hpp"
+
+namespace json_validator {
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+/**
+ * A payload going through a Validation_pipeline
+ */
+struct Pipeline_record {
+  uint64_t id;
+  string payload;
+
+  //  nullptr if the payload isn't valid json (result says SYNTAX_ERROR) or
+  //  exceeds the limits (result says which one, see Document_limits).
+  //  Deleted once the sink returns, unless the sink takes it (sets nullptr)
+  cJSON* document;
+  Validation_result_ptr result;
+};
+
+/**
+ * Validation pipeline: payloads submitted by any number of threads are
+ *  parsed, validated and handed to a sink by three stages of threads.
+ *
+ * Stages hand records over in batches of up to 'batch_size' through
+ * bounded lock-free queues: single producer / single consumer between two
+ * single threaded stages, multi producer / multi consumer otherwise. A
+ * stage never waits for a batch to fill, it forwards whatever is there, so
+ * batches only grow under load. When a queue is full the producer waits
+ * (backpressure): a slow sink slows validation, then parsing, then submit.
+ *
+ * The sink runs on a single thread, so it needn't be thread-safe, but it
+ * must not throw. Records reach it in no particular order. With several
+ * parse threads cJSON_GetErrorPtr() (a global) means nothing.
+ *
+ *    Validation_pipeline pipeline(&schema, [](Pipeline_record* record) {
+ *      ...
+ *    });
+ *    pipeline.submit(1, payload);
+ *    pipeline.finish();
+ */
+class Validation_pipeline {
+  public:
+  typedef std::function<void(Pipeline_record* record)> Sink;
+
+  struct Options {
+    Options() : parse_threads(1), validate_threads(1), batch_size(32),
+                queue_capacity(8) { }
+
+    size_t parse_threads;
+    size_t validate_threads;
+
+    //  Records handed over between stages at once
+    size_t batch_size;
+
+    //  Batches each queue between stages holds (a power of 2); the input
+    //  queue holds queue_capacity * batch_size records. Latency under bursts
+    //  grows with the records in flight
+    size_t queue_capacity;
+
+    //  Checked on the payloads before they're parsed
+    Document_limits limits;
+  };
+
+  struct Statistics {
+    uint64_t submitted;
+    uint64_t completed;
+
+    //  Times a producer found the next queue full
+    uint64_t submit_stalls;
+    uint64_t parse_stalls;
+    uint64_t validate_stalls;
+  };
+
+  private:
+  typedef vector<Pipeline_record*> Batch;
+
+  /**
+   * Spins, then yields, then sleeps while a queue stays full or empty
+   */
+  class Backoff {
+    private:
+    unsigned _rounds;
+
+    public:
+    Backoff() : _rounds(0) { }
+
+    void pause() {
+      if (_rounds < 256) {
+        ++_rounds;
+        sched_yield();
+      } else {
+        usleep(50);
+      }
+    }
+
+    void reset() {
+      _rounds = 0;
+    }
+  };
+
+  /**
+   * Queue of batches between two stages
+   */
+  class Batch_queue {
+    private:
+    unique_ptr<Spsc_queue<Batch*>> _spsc;
+    unique_ptr<Mpmc_queue<Batch*>> _mpmc;
+
+    public:
+    Batch_queue(size_t capacity, bool single_producer_consumer) {
+      if (single_producer_consumer) {
+        _spsc.reset(new Spsc_queue<Batch*>(capacity));
+      } else {
+        _mpmc.reset(new Mpmc_queue<Batch*>(capacity));
+      }
+    }
+
+    bool try_push(Batch* batch) {
+      return _spsc ? _spsc->try_push(batch) : _mpmc->try_push(batch);
+    }
+
+    bool try_pop(Batch** batch) {
+      return _spsc ? _spsc->try_pop(batch) : _mpmc->try_pop(batch);
+    }
+
+    bool empty() const {
+      return _spsc ? _spsc->empty() : _mpmc->empty();
+    }
+  };
+
+  const Compiled_schema* _schema;
+  Validator<json_adapters::CJSON_adapter>* _validator;
+  Sink _sink;
+  Options _options;
+
+  Mpmc_queue<Pipeline_record*> _input;
+  Batch_queue _parsed;
+  Batch_queue _validated;
+  Mpmc_queue<Batch*> _free_batches;
+
+  vector<pthread_t> _threads;
+  bool _finished;
+  std::atomic<bool> _closed;
+  std::atomic<size_t> _parsing;           //  parse threads still running
+  std::atomic<size_t> _validating;        //  validate threads still running
+
+  std::atomic<uint64_t> _submitted;
+  std::atomic<uint64_t> _submit_stalls;
+  char _padding0[QUEUE_CACHE_LINE_SIZE];
+  std::atomic<uint64_t> _completed;
+  std::atomic<uint64_t> _parse_stalls;
+  std::atomic<uint64_t> _validate_stalls;
+  char _padding1[QUEUE_CACHE_LINE_SIZE];
+
+  static size_t power_of_2(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+
+    return result;
+  }
+
+  static const Options& checked(const Options& options) {
+    if (options.parse_threads == 0 || options.validate_threads == 0 ||
+        options.batch_size == 0) {
+      raise_error(std::invalid_argument(
+          "Validation_pipeline: threads and batch size must be > 0"));
+    }
+
+    return options;
+  }
+
+  Batch* take_batch() {
+    Batch* batch;
+    if (!_free_batches.try_pop(&batch)) {
+      batch = new Batch();
+      batch->reserve(_options.batch_size);
+    }
+
+    return batch;
+  }
+
+  void recycle(Batch* batch) {
+    batch->clear();
+    if (!_free_batches.try_push(batch)) {
+      delete batch;
+    }
+  }
+
+  void push(Batch_queue* queue, Batch* batch,
+            std::atomic<uint64_t>* stalls) {
+    if (queue->try_push(batch)) {
+      return;
+    }
+
+    stalls->fetch_add(1, std::memory_order_relaxed);
+    Backoff backoff;
+    while (!queue->try_push(batch)) {
+      backoff.pause();
+    }
+  }
+
+  /**
+   * Pops a batch, waiting while the queue is empty and 'producers' run.
+   *
+   * @return nullptr once the producers are done and the queue is drained
+   */
+  Batch* pop(Batch_queue* queue, const std::atomic<size_t>& producers) {
+    Backoff backoff;
+    Batch* batch;
+    while (!queue->try_pop(&batch)) {
+      //  Producers publish their last batch before they stop
+      if (producers.load(std::memory_order_acquire) == 0 && queue->empty()) {
+        return nullptr;
+      }
+
+      backoff.pause();
+    }
+
+    return batch;
+  }
+
+  void parse_stage() {
+    Document_scanner scanner(_options.limits);
+    bool limited = !_options.limits.unlimited();
+    Validation_result_ptr limit_error(new Validation_result());
+    Backoff backoff;
+    Batch* batch = take_batch();
+    for (;;) {
+      Pipeline_record* record;
+      while (batch->size() < _options.batch_size && _input.try_pop(&record)) {
+        batch->push_back(record);
+      }
+
+      if (batch->empty()) {
+        if (_closed.load(std::memory_order_acquire) && _input.empty()) {
+          break;
+        }
+
+        backoff.pause();
+        continue;
+      }
+
+      backoff.reset();
+      for (Pipeline_record* parsed : *batch) {
+        if (limited && !scanner.check(parsed->payload, limit_error.get())) {
+          parsed->result = std::move(limit_error);
+          limit_error.reset(new Validation_result());
+          continue;
+        }
+
+        parsed->document = cJSON_Parse(parsed->payload.c_str());
+        if (parsed->document == nullptr) {
+          parsed->result.reset(new Validation_result());
+          parsed->result->set_error(VALIDATION_SYNTAX_ERROR, "invalid json");
+        }
+      }
+
+      push(&_parsed, batch, &_parse_stalls);
+      batch = take_batch();
+    }
+
+    recycle(batch);
+    _parsing.fetch_sub(1, std::memory_order_acq_rel);
+  }
+
+  void validate_stage() {
+    Compiled_schema_stack<json_adapters::CJSON_adapter> stack;
+    while (Batch* batch = pop(&_parsed, _parsing)) {
+      for (Pipeline_record* record : *batch) {
+        if (record->document == nullptr) {
+          continue;
+        }
+
+        json_adapters::CJSON_adapter document(record->document);
+        if (_schema != nullptr) {
+          record->result = _schema->validate(document, &stack);
+        } else {
+          record->result = _validator->validate(document);
+        }
+      }
+
+      push(&_validated, batch, &_validate_stalls);
+    }
+
+    _validating.fetch_sub(1, std::memory_order_acq_rel);
+  }
+
+  void sink_stage() {
+    while (Batch* batch = pop(&_validated, _validating)) {
+      for (Pipeline_record* record : *batch) {
+        _sink(record);
+        if (record->document != nullptr) {
+          cJSON_Delete(record->document);
+        }
+
+        delete record;
+      }
+
+      _completed.fetch_add(batch->size(), std::memory_order_relaxed);
+      recycle(batch);
+    }
+  }
+
+  static void* parse_main(void* pipeline) {
+    static_cast<Validation_pipeline*>(pipeline)->parse_stage();
+    return nullptr;
+  }
+
+  static void* validate_main(void* pipeline) {
+    static_cast<Validation_pipeline*>(pipeline)->validate_stage();
+    return nullptr;
+  }
+
+  static void* sink_main(void* pipeline) {
+    static_cast<Validation_pipeline*>(pipeline)->sink_stage();
+    return nullptr;
+  }
+
+  /**
+   * @param running the stage's counter, lowered for threads not started
+   */
+  bool start(void* (*main)(void*), size_t count,
+             std::atomic<size_t>* running) {
+    for (size_t i = 0; i < count; ++i) {
+      pthread_t thread;
+      if (pthread_create(&thread, nullptr, main, this) != 0) {
+        if (running != nullptr) {
+          running->fetch_sub(count - i);
+        }
+
+        return false;
+      }
+
+      _threads.push_back(thread);
+    }
+
+    return true;
+  }
+
+  void start() {
+    //  Downstream stages first, so a failure leaves no stage waiting
+    if (!start(sink_main, 1, nullptr)) {
+      raise_error(std::runtime_error(
+          "Validation_pipeline: can't create threads"));
+    }
+
+    if (!start(validate_main, _options.validate_threads, &_validating)) {
+      _parsing.store(0);
+      finish();
+      raise_error(std::runtime_error(
+          "Validation_pipeline: can't create threads"));
+    }
+
+    if (!start(parse_main, _options.parse_threads, &_parsing)) {
+      finish();
+      raise_error(std::runtime_error(
+          "Validation_pipeline: can't create threads"));
+    }
+  }
+
+  Validation_pipeline(const Compiled_schema* schema,
+                      Validator<json_adapters::CJSON_adapter>* validator,
+                      Sink sink, const Options& options)
+      : _schema(schema), _validator(validator), _sink(std::move(sink)),
+        _options(checked(options)),
+        _input(power_of_2(options.queue_capacity * options.batch_size)),
+        _parsed(options.queue_capacity,
+                options.parse_threads == 1 && options.validate_threads == 1),
+        _validated(options.queue_capacity, options.validate_threads == 1),
+        _free_batches(power_of_2(2 * options.queue_capacity +
+                                 options.parse_threads +
+                                 options.validate_threads + 1)),
+        _finished(false), _closed(false), _parsing(options.parse_threads),
+        _validating(options.validate_threads), _submitted(0),
+        _submit_stalls(0), _completed(0), _parse_stalls(0),
+        _validate_stalls(0) {
+    start();
+  }
+
+  public:
+  /**
+   * The schema must outlive the pipeline.
+   *
+   * @throws std::invalid_argument if a stage has no thread, the batch size
+   *  is 0 or the queue capacity isn't a power of 2
+   */
+  Validation_pipeline(const Compiled_schema* schema, Sink sink,
+                      const Options& options = Options())
+      : Validation_pipeline(schema, nullptr, std::move(sink), options) { }
+
+  /**
+   * Builder validators can be shared by the validate threads as long as
+   *  nothing adds validators to them meanwhile.
+   */
+  Validation_pipeline(Validator<json_adapters::CJSON_adapter>* validator,
+                      Sink sink, const Options& options = Options())
+      : Validation_pipeline(nullptr, validator, std::move(sink), options) { }
+
+  Validation_pipeline(const Validation_pipeline&) = delete;
+  Validation_pipeline& operator=(const Validation_pipeline&) = delete;
+
+  ~Validation_pipeline() {
+    finish();
+
+    Batch* batch;
+    while (_free_batches.try_pop(&batch)) {
+      delete batch;
+    }
+  }
+
+  /**
+   * Queues a payload, waiting while the pipeline is full. Thread-safe, but
+   *  must not race with finish().
+   *
+   * @throws std::invalid_argument after finish()
+   */
+  void submit(uint64_t id, string payload) {
+    if (_closed.load(std::memory_order_relaxed)) {
+      raise_error(std::invalid_argument(
+          "Validation_pipeline: submit after finish"));
+    }
+
+    Pipeline_record* record =
+        new Pipeline_record{id, std::move(payload), nullptr, nullptr};
+    if (!_input.try_push(record)) {
+      _submit_stalls.fetch_add(1, std::memory_order_relaxed);
+      Backoff backoff;
+      while (!_input.try_push(record)) {
+        backoff.pause();
+      }
+    }
+
+    _submitted.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /**
+   * Same as submit(), but gives up (load shedding) if the pipeline is full
+   *
+   * @return false if the payload wasn't queued
+   */
+  bool try_submit(uint64_t id, const string& payload) {
+    if (_closed.load(std::memory_order_relaxed)) {
+      raise_error(std::invalid_argument(
+          "Validation_pipeline: submit after finish"));
+    }
+
+    Pipeline_record* record = new Pipeline_record{id, payload, nullptr,
+                                                  nullptr};
+    if (!_input.try_push(record)) {
+      _submit_stalls.fetch_add(1, std::memory_order_relaxed);
+      delete record;
+      return false;
+    }
+
+    _submitted.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  /**
+   * Waits until every submitted payload went through the sink and stops
+   *  the threads. The pipeline can't be used afterwards.
+   */
+  void finish() {
+    if (_finished) {
+      return;
+    }
+
+    _finished = true;
+    _closed.store(true, std::memory_order_release);
+    for (pthread_t thread : _threads) {
+      pthread_join(thread, nullptr);
+    }
+
+    _threads.clear();
+  }
+
+  const Options& options() const {
+    return _options;
+  }
+
+  Statistics statistics() const {
+    Statistics statistics;
+    statistics.submitted = _submitted.load(std::memory_order_relaxed);
+    statistics.completed = _completed.load(std::memory_order_relaxed);
+    statistics.submit_stalls = _submit_stalls.load(std::memory_order_relaxed);
+    statistics.parse_stalls = _parse_stalls.load(std::memory_order_relaxed);
+    statistics.validate_stalls =
+        _validate_stalls.load(std::memory_order_relaxed);
+    return statistics;
+  }
+};
+}  // namespace json_validator
+#endif
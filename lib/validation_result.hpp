@@ -1,59 +1,350 @@
 #ifndef CJSON_VALIDATOR_VALIDATION_RESULT_HPP
 #define CJSON_VALIDATOR_VALIDATION_RESULT_HPP
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <string>
 #include <vector>
-#include <sstream>
 
 namespace json_validator {
+class Subtree_memo;
+class Validation_budget;
+
 using std::string;
 using std::vector;
-using std::stringstream;
+
+/**
+ * Machine readable reason of a failure (message() tells where it happened)
+ */
+enum Validation_error_code : uint8_t {
+  VALIDATION_OK = 0,
+  VALIDATION_FAILED,                //  no specific reason
+  VALIDATION_WRONG_TYPE,
+  VALIDATION_NOT_ALLOWED,           //  value not in the enum
+  VALIDATION_BELOW_MINIMUM,         //  minimum, minimum length
+  VALIDATION_ABOVE_MAXIMUM,         //  maximum, maximum length
+  VALIDATION_WRONG_LENGTH,          //  exact array length
+  VALIDATION_DUPLICATED_ITEM,
+  VALIDATION_REQUIRED,
+  VALIDATION_FORBIDDEN_KEY,
+  VALIDATION_TOO_DEEP,              //  nesting, see Document_limits
+  VALIDATION_SYNTAX_ERROR,
+  VALIDATION_TOO_MANY_NODES,        //  see Document_limits
+  VALIDATION_STRING_TOO_LONG,
+  VALIDATION_ARRAY_TOO_LONG,
+  VALIDATION_TOO_MANY_KEYS,
+  VALIDATION_BUDGET_EXCEEDED        //  see Validation_budget
+};
+
+/**
+ * Stable name of a code, as written in JSON errors
+ */
+inline const char* validation_error_name(Validation_error_code code) {
+  static const char* const names[] = {
+    "ok", "failed", "wrong_type", "not_allowed", "below_minimum",
+    "above_maximum", "wrong_length", "duplicated_item", "required",
+    "forbidden_key", "too_deep", "syntax_error", "too_many_nodes",
+    "string_too_long", "array_too_long", "too_many_keys", "budget_exceeded"
+  };
+
+  return code < sizeof(names) / sizeof(names[0]) ? names[code] : "failed";
+}
+
+/**
+ * A failure as data (see Validation_result::error)
+ */
+struct Validation_error {
+  Validation_error_code code;
+  string pointer;           //  JSON Pointer (RFC 6901) to the failed value
+  const void* schema_node;  //  validator (or compiled node) that failed it
+  string reason;            //  the text after ':' in message()
+  string expected;          //  the constraint, eg: "<= 10", "integer"
+  string actual;            //  what was found instead, eg: "11", "string"
+};
 
 /**
  * Simple wrapper to validation errors
+ *
+ * The position of the failure is a path of keys and array indices, added
+ * innermost first by the containers while the error goes up. Keys are
+ * copied into a single buffer, so a result reused across validations
+ * (see reset) doesn't allocate for paths once it has grown.
  */
 class Validation_result {
   protected:
+  struct Path_segment {
+    uint64_t index;
+    uint32_t key_offset;
+    uint32_t key_size;      //  INDEX for array indices
+  };
+
+  static const uint32_t INDEX = UINT32_MAX;
+
   bool _success;
-  vector<string> _error_stack;
+  Validation_error_code _code;
+  bool _has_reason;
+  string _reason;
+  const void* _schema_node;
+  string _expected;
+  string _actual;
+  vector<Path_segment> _path;
+  string _keys;
+  Subtree_memo* _memo;
+  Validation_budget* _budget;
+
+  static bool is_index(const string& segment) {
+    if (segment.empty() || segment.size() > 19) {
+      return false;
+    }
+
+    for (char c : segment) {
+      if (c < '0' || c > '9') {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  static void append_json_char(string* out, char c) {
+    if (c == '"' || c == '\\') {
+      out->push_back('\\');
+      out->push_back(c);
+    } else if ((unsigned char)c < 0x20) {
+      char escaped[8];
+      snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+      out->append(escaped);
+    } else {
+      out->push_back(c);
+    }
+  }
+
+  static void append_json_string(string* out, const string& value) {
+    out->push_back('"');
+    for (char c : value) {
+      append_json_char(out, c);
+    }
+
+    out->push_back('"');
+  }
+
+  /**
+   * Outermost segment first; 'json' escapes it for a JSON string
+   */
+  void append_pointer(string* out, bool json) const {
+    char index[24];
+    for (size_t i = _path.size(); i-- > 0;) {
+      out->push_back('/');
+      const Path_segment& segment = _path[i];
+      if (segment.key_size == INDEX) {
+        snprintf(index, sizeof(index), "%" PRIu64, segment.index);
+        out->append(index);
+        continue;
+      }
+
+      const char* key = _keys.data() + segment.key_offset;
+      for (uint32_t c = 0; c < segment.key_size; ++c) {
+        if (key[c] == '~') {
+          out->append("~0");
+        } else if (key[c] == '/') {
+          out->append("~1");
+        } else if (json) {
+          append_json_char(out, key[c]);
+        } else {
+          out->push_back(key[c]);
+        }
+      }
+    }
+  }
 
   public:
   Validation_result(bool success, const string& error)
-      : _success(success) {
-    this->_error_stack.push_back(error);
+      : _success(success), _code(success ? VALIDATION_OK : VALIDATION_FAILED),
+        _has_reason(true), _reason(error), _schema_node(nullptr),
+        _memo(nullptr), _budget(nullptr) {
+  }
+  explicit Validation_result(bool success)
+      : _success(success), _code(success ? VALIDATION_OK : VALIDATION_FAILED),
+        _has_reason(false), _schema_node(nullptr), _memo(nullptr),
+        _budget(nullptr) {
   }
-  explicit Validation_result(bool success) : _success(success) { }
-  Validation_result() : _success(true) { }
+  Validation_result()
+      : _success(true), _code(VALIDATION_OK), _has_reason(false),
+        _schema_node(nullptr), _memo(nullptr), _budget(nullptr) { }
 
   virtual ~Validation_result() = default;
 
+  /**
+   * Adds an error (or, once the reason was set, a position in the
+   *  document: "'key'" or an index). Prefer add_key and add_index.
+   */
   virtual void set_error(const string& error) {
     this->_success = false;
-    this->_error_stack.push_back(error);
+    if (this->_code == VALIDATION_OK) {
+      this->_code = VALIDATION_FAILED;
+    }
+
+    if (!this->_has_reason) {
+      this->_has_reason = true;
+      this->_reason = error;
+    } else if (error.size() >= 2 && error.front() == '\'' &&
+               error.back() == '\'') {
+      add_key(error.data() + 1, error.size() - 2);
+    } else if (is_index(error)) {
+      add_index(strtoull(error.c_str(), nullptr, 10));
+    } else {
+      add_key(error);
+    }
+  }
+
+  virtual void set_error(Validation_error_code code, const string& error) {
+    this->_success = false;
+    this->_code = code;
+    this->_has_reason = true;
+    this->_reason = error;
+    this->_schema_node = nullptr;
+    this->_expected.clear();
+    this->_actual.clear();
+  }
+
+  /**
+   * Same as above, with the schema node that failed and the expected and
+   *  actual values
+   */
+  virtual void set_error(Validation_error_code code, const string& error,
+                         const void* schema_node, const string& expected,
+                         const string& actual) {
+    set_error(code, error);
+    this->_schema_node = schema_node;
+    this->_expected = expected;
+    this->_actual = actual;
+  }
+
+  /**
+   * The failure is below 'key' of an object (the key is copied)
+   */
+  void add_key(const char* key, size_t size) {
+    this->_path.push_back({0, (uint32_t)this->_keys.size(), (uint32_t)size});
+    this->_keys.append(key, size);
+  }
+
+  void add_key(const string& key) {
+    add_key(key.data(), key.size());
+  }
+
+  /**
+   * The failure is below item 'index' of an array
+   */
+  void add_index(uint64_t index) {
+    this->_path.push_back({index, 0, INDEX});
   }
 
   virtual void reset() {
+    //  Called before every check: a clean result is left as is
+    if (_success && !_has_reason && _path.empty()) {
+      return;
+    }
+
     _success = true;
-    _error_stack.clear();
+    _code = VALIDATION_OK;
+    _has_reason = false;
+    _reason.clear();
+    _schema_node = nullptr;
+    _expected.clear();
+    _actual.clear();
+    _path.clear();
+    _keys.clear();
+  }
+
+  Validation_error_code code() const {
+    return _code;
+  }
+
+  /**
+   * Per-call scratch handed down to nested validators along with the
+   *  result (see Subtree_memo); reset() keeps it
+   */
+  Subtree_memo* memo() const {
+    return _memo;
+  }
+
+  void memo(Subtree_memo* memo) {
+    _memo = memo;
+  }
+
+  /**
+   * Deadline and cancellation of the validation (see Validation_budget);
+   *  reset() keeps it
+   */
+  Validation_budget* budget() const {
+    return _budget;
+  }
+
+  void budget(Validation_budget* budget) {
+    _budget = budget;
+  }
+
+  /**
+   * JSON Pointer to the failed value ("" for the root)
+   */
+  string pointer() const {
+    string pointer;
+    append_pointer(&pointer, false);
+    return pointer;
+  }
+
+  Validation_error error() const {
+    return {_code, pointer(), _schema_node, _reason, _expected, _actual};
+  }
+
+  /**
+   * Appends the members of the error as JSON, without the braces:
+   *  "code":"above_maximum","pointer":"/a/0","message":"...",
+   *  "expected":"<= 10","actual":"11"
+   *
+   * Only 'out' grows (keep it between calls to not allocate). The schema
+   * node is left out: it is only meaningful inside the process.
+   */
+  void append_json_members(string* out) const {
+    out->append("\"code\":\"");
+    out->append(validation_error_name(_code));
+    out->append("\",\"pointer\":\"");
+    append_pointer(out, true);
+    out->append("\",\"message\":");
+    append_json_string(out, _reason);
+    out->append(",\"expected\":");
+    append_json_string(out, _expected);
+    out->append(",\"actual\":");
+    append_json_string(out, _actual);
+  }
+
+  void append_json(string* out) const {
+    out->push_back('{');
+    append_json_members(out);
+    out->push_back('}');
   }
 
   virtual string message() {
-    stringstream ss;
-    ss << "json";
-    for (auto reverse_it = this->_error_stack.rbegin(); reverse_it !=
-        this->_error_stack.rend();) {
-      auto current_symbol = *reverse_it;
-
-      //  If next symbol is not the last, add '[]' to show nested objects/arrays
-      ++reverse_it;
-      if (reverse_it != this->_error_stack.rend()) {
-        ss << "[" << current_symbol << "]";
-      } else {  //  Next symbol will be the last so add ':'
-        ss << ": " << current_symbol;
+    string message = "[ERROR] json";
+    char index[24];
+    for (size_t i = _path.size(); i-- > 0;) {
+      const Path_segment& segment = _path[i];
+      if (segment.key_size == INDEX) {
+        snprintf(index, sizeof(index), "[%" PRIu64 "]", segment.index);
+        message += index;
+      } else {
+        message += "['";
+        message.append(_keys, segment.key_offset, segment.key_size);
+        message += "']";
       }
     }
 
-    return "[ERROR] " + ss.str();
+    if (_has_reason) {
+      message += ": " + _reason;
+    }
+
+    return message;
   }
 
   virtual bool success() {
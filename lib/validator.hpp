@@ -1,12 +1,19 @@
 #ifndef CJSON_VALIDATOR_VALIDATOR_HPP
 #define CJSON_VALIDATOR_VALIDATOR_HPP
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <set>
+#include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 
+#include "error_handling.hpp"
+#include "subtree_memo.hpp"
+#include "validation_budget.hpp"
 #include "validation_result.hpp"
 #include "json_adapters/adapter.hpp"
 
@@ -16,18 +23,84 @@ using std::unique_ptr;
 using std::vector;
 using Validation_result_ptr = unique_ptr<Validation_result>;
 
+/**
+ * Nodes of a document that changed since it was found valid, by identity
+ *  (see JSON_adapter::identity), for Validator::revalidate.
+ */
+class Touched_nodes {
+  public:
+  enum Flags : uint8_t {
+    WHOLE = 1,          //  new or replaced node
+    DESCENDANTS = 2,    //  something below the node changed
+    MEMBERS = 4         //  members (keys or items) were added or removed
+  };
+
+  void mark(const void* node, uint8_t flags) {
+    _nodes[node] |= flags;
+  }
+
+  /**
+   * Nodes of adapters without identity are always WHOLE
+   */
+  uint8_t flags(const void* node) const {
+    if (node == nullptr) {
+      return WHOLE;
+    }
+
+    auto it = _nodes.find(node);
+    return it == _nodes.end() ? 0 : it->second;
+  }
+
+  size_t size() const {
+    return _nodes.size();
+  }
+
+  void clear() {
+    _nodes.clear();
+  }
+
+  private:
+  std::unordered_map<const void*, uint8_t> _nodes;
+};
+
+/**
+ * Instrumentation policy of the validators (see Node_counters): every
+ *  validator keeps a Node, and a Probe brackets each of its validate()
+ *  calls. This one does nothing and compiles away.
+ */
+struct No_instrumentation {
+  struct Node { };
+
+  class Probe {
+    public:
+    explicit Probe(Node* node) { }
+
+    void finish(bool success) { }
+  };
+};
+
 /**
  *  Forward declaration of Object_validator template class
  *  needed for friendship with Validator template class
  */
-template<typename T>
+template<typename T, typename Instrumentation = No_instrumentation>
 class Object_validator;
 
+/**
+ *  Forward declaration of Iterative_validator, which runs the validations
+ *   of containers itself
+ */
+template<typename T, typename Instrumentation = No_instrumentation>
+class Iterative_validator;
+
 /**
  * Validator base class.
  *  New validators must always extend this interface.
+ *
+ * Instrumentation is a policy shared by a whole tree of validators (eg:
+ *  Object_validator<CJSON_adapter, Node_counters<>>).
  */
-template<typename AdapterType>
+template<typename AdapterType, typename Instrumentation = No_instrumentation>
 class Validator {
   public:
   using JSON_token = json_adapters::JSON_adapter<AdapterType>;
@@ -40,11 +113,12 @@ class Validator {
    *   can access protected members from Validator in their method
    *   implementations
    */
-  friend class Object_validator<AdapterType>;
+  friend class Object_validator<AdapterType, Instrumentation>;
+  friend class Iterative_validator<AdapterType, Instrumentation>;
 
   private:
   bool _required;
-  bool _used;
+  typename Instrumentation::Node _instrumentation;
 
   protected:
   std::vector<validation_func_t> _valdations;
@@ -58,13 +132,51 @@ class Validator {
     const_cast<JSON_token&>(json).add_field(key, std::forward<Args>(args)...);
   }
 
-  virtual void set_default_value(const JSON_token& json, const string& key) {
-    throw(std::invalid_argument("Trying to set default value for a type "
-                                "that doesn't support this operation"));
+  /**
+   * Expected value of enum errors: one of [1, 2] or one of ["a", "b"]
+   */
+  static string one_of(const std::set<int>& values) {
+    string expected = "one of [";
+    for (int value : values) {
+      expected += (expected.size() > 8 ? ", " : "") + std::to_string(value);
+    }
+
+    return expected + "]";
+  }
+
+  static string one_of(const std::set<string>& values) {
+    string expected = "one of [";
+    for (const string& value : values) {
+      expected += (expected.size() > 8 ? ", \"" : "\"") + value + "\"";
+    }
+
+    return expected + "]";
+  }
+
+  /**
+   * Adds 'key' with the default value to the object 'json'
+   *
+   * @return false (or throws std::invalid_argument with exceptions) if the
+   *  type has no default value
+   */
+  virtual bool set_default_value(const JSON_token& json, const string& key) {
+    return raise_error_or_fail(std::invalid_argument(
+        "Trying to set default value for a type that doesn't support this "
+        "operation"));
+  }
+
+  /**
+   * Revalidates a token with some touched descendants (flags tells how it
+   *  changed itself). Validators without members validate it again.
+   */
+  virtual Validation_result_ptr revalidate_members(
+      const JSON_token& token, const Touched_nodes& touched, uint8_t flags,
+      Validation_result_ptr result) {
+    return validate(token, std::move(result));
   }
 
   public:
-  Validator() : _required(false), _used(false), _has_default_value(false) { }
+  Validator() : _required(false), _has_default_value(false) { }
 
   virtual ~Validator() = default;
 
@@ -73,9 +185,19 @@ class Validator {
     return validate(token, std::move(result));
   }
 
+  /**
+   * Same as above, reusing 'result' and whatever it hands down (a memo, a
+   *  Validation_budget)
+   */
   Validation_result_ptr validate(const JSON_token& token,
                                  Validation_result_ptr result) {
-    this->used(true);
+    Validation_budget* budget = result->budget();
+    if (budget != nullptr && !budget->spend()) {
+      budget->set_error(result.get());
+      return result;
+    }
+
+    typename Instrumentation::Probe probe(&this->_instrumentation);
     for (auto& validation_func : this->_valdations) {
       result = validation_func(token, std::move(result));
       if (!result->success()) {
@@ -83,9 +205,62 @@ class Validator {
       }
     }
 
+    probe.finish(result->success());
+    return result;
+  }
+
+  /**
+   * Same as validate(), through the Subtree_memo handed down by 'result'
+   *  if there is one: a subtree already found valid for this validator
+   *  isn't validated again.
+   */
+  Validation_result_ptr validate_memoized(const JSON_token& token,
+                                          Validation_result_ptr result) {
+    Subtree_memo* memo = result->memo();
+    if (memo == nullptr || !(token.is_object() || token.is_array())) {
+      return validate(token, std::move(result));
+    }
+
+    Subtree_memo::Node* node = memo->node(this);
+    if (node == nullptr) {
+      return validate(token, std::move(result));
+    }
+
+    Subtree_memo::Key key = Subtree_memo::key(this, token);
+    if (memo->find(node, key)) {
+      result->reset();
+      return result;
+    }
+
+    result = validate(token, std::move(result));
+    if (result->success()) {
+      memo->insert(node, key, Subtree_memo::count_nodes(token));
+    }
+
     return result;
   }
 
+  /**
+   * Validates a token that was valid before its 'touched' nodes changed.
+   *  The result is the one validate() would give (defaults included), but
+   *  containers skip the members that didn't change.
+   */
+  Validation_result_ptr revalidate(const JSON_token& token,
+                                   const Touched_nodes& touched,
+                                   Validation_result_ptr result) {
+    uint8_t flags = touched.flags(token.identity());
+    if (flags == 0) {
+      result->reset();
+      return result;
+    }
+
+    if (flags & Touched_nodes::WHOLE) {
+      return validate(token, std::move(result));
+    }
+
+    return revalidate_members(token, touched, flags, std::move(result));
+  }
+
   virtual Validator* required(bool required) {
     this->_required = required;
     return this;
@@ -95,17 +270,13 @@ class Validator {
     return this->_required;
   }
 
-  virtual void used(bool used) {
-    this->_used = used;
-  }
-
-  virtual bool used() {
-    return this->_used;
-  }
-
   virtual bool has_default_value() {
     return _has_default_value;
   }
+
+  const typename Instrumentation::Node& instrumentation() const {
+    return _instrumentation;
+  }
 };
 }  // namespace json_validator
 
@@ -0,0 +1,577 @@
+#ifndef CJSON_VALIDATOR_WORK_STEALING_POOL_HPP
+#define CJSON_VALIDATOR_WORK_STEALING_POOL_HPP
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "error_handling.hpp"
+
+namespace json_validator {
+using std::vector;
+
+/**
+ * Work stealing pool runs the parallel parts of the library (batches,
+ *  large arrays, object subtrees) on a fixed set of worker threads.
+ *
+ * Every worker owns a Chase-Lev deque: it pushes and pops its own tasks at
+ * the bottom (LIFO, no atomic read-modify-write unless the deque is about to
+ * get empty) while idle workers steal from the top of a random victim.
+ * Tasks spawned by threads that are not workers of the pool go to a shared
+ * injection queue.
+ *
+ * Fork-join: a Task_group counts its pending tasks and wait() executes
+ * tasks (its own or anybody's) until they are done, so a task can spawn and
+ * wait for subtasks without blocking a worker and nested parallel features
+ * never start more threads than the pool has. Idle workers spin a little,
+ * then sleep until a task is pushed.
+ *
+ *    Work_stealing_pool::Task_group group(&Work_stealing_pool::shared());
+ *    group.spawn([&]() { validate(left); });
+ *    validate(right);
+ *    group.wait();
+ */
+class Work_stealing_pool {
+  public:
+  class Task_group;
+
+  struct Statistics {
+    uint64_t executed;                    //  tasks run by workers
+    uint64_t stolen;                      //  ... that were stolen
+    uint64_t external;                    //  tasks run by waiting threads
+  };
+
+  private:
+  static const size_t CACHE_LINE_SIZE = 64;
+  static const int SPINS_BEFORE_SLEEP = 64;
+
+  struct Task {
+    explicit Task(Task_group* group) : group(group) { }
+    virtual ~Task() = default;
+    virtual void run() = 0;
+
+    Task_group* group;
+  };
+
+  template<typename Function>
+  struct Function_task : Task {
+    Function_task(Task_group* group, Function&& function)
+        : Task(group), function(std::move(function)) { }
+    Function_task(Task_group* group, const Function& function)
+        : Task(group), function(function) { }
+
+    void run() override {
+      function();
+    }
+
+    Function function;
+  };
+
+  /**
+   * Chase-Lev deque ("Correct and efficient work-stealing for weak memory
+   *  models", Le et al.). Only the owner calls push/take, anybody can steal.
+   * A full buffer is replaced by one twice its size; replaced buffers are
+   * kept until the deque is destroyed since a thief may still read them.
+   */
+  class Deque {
+    private:
+    struct Buffer {
+      explicit Buffer(int64_t capacity)
+          : capacity(capacity), tasks(new std::atomic<Task*>[capacity]) { }
+
+      Task* get(int64_t index) const {
+        return tasks[index & (capacity - 1)].load(std::memory_order_relaxed);
+      }
+
+      void put(int64_t index, Task* task) {
+        tasks[index & (capacity - 1)].store(task, std::memory_order_relaxed);
+      }
+
+      int64_t capacity;
+      std::unique_ptr<std::atomic<Task*>[]> tasks;
+    };
+
+    std::atomic<int64_t> _top;
+    char _top_padding[CACHE_LINE_SIZE - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t> _bottom;
+    std::atomic<Buffer*> _buffer;
+    vector<std::unique_ptr<Buffer>> _buffers;
+
+    public:
+    Deque() : _top(0), _bottom(0) {
+      _buffers.emplace_back(new Buffer(256));
+      _buffer.store(_buffers.back().get());
+    }
+
+    Deque(const Deque&) = delete;
+    Deque& operator=(const Deque&) = delete;
+
+    void push(Task* task) {
+      int64_t bottom = _bottom.load(std::memory_order_relaxed);
+      int64_t top = _top.load(std::memory_order_acquire);
+      Buffer* buffer = _buffer.load(std::memory_order_relaxed);
+      if (bottom - top >= buffer->capacity) {
+        Buffer* bigger = new Buffer(buffer->capacity * 2);
+        for (int64_t i = top; i < bottom; ++i) {
+          bigger->put(i, buffer->get(i));
+        }
+
+        _buffers.emplace_back(bigger);
+        _buffer.store(bigger, std::memory_order_release);
+        buffer = bigger;
+      }
+
+      buffer->put(bottom, task);
+      //  seq_cst so a worker going to sleep either sees the task or is seen
+      _bottom.store(bottom + 1, std::memory_order_seq_cst);
+    }
+
+    Task* take() {
+      int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+      Buffer* buffer = _buffer.load(std::memory_order_relaxed);
+      _bottom.store(bottom, std::memory_order_seq_cst);
+      int64_t top = _top.load(std::memory_order_seq_cst);
+      if (top > bottom) {
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+      }
+
+      Task* task = buffer->get(bottom);
+      if (top == bottom) {
+        //  Last task: race thieves for it
+        if (!_top.compare_exchange_strong(top, top + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+          task = nullptr;
+        }
+
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+      }
+
+      return task;
+    }
+
+    Task* steal() {
+      int64_t top = _top.load(std::memory_order_seq_cst);
+      int64_t bottom = _bottom.load(std::memory_order_seq_cst);
+      if (top >= bottom) {
+        return nullptr;
+      }
+
+      Task* task = _buffer.load(std::memory_order_acquire)->get(top);
+      if (!_top.compare_exchange_strong(top, top + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        return nullptr;                   //  lost the race, try elsewhere
+      }
+
+      return task;
+    }
+
+    bool empty() const {
+      return _top.load(std::memory_order_seq_cst) >=
+             _bottom.load(std::memory_order_seq_cst);
+    }
+  };
+
+  struct Worker {
+    Work_stealing_pool* pool;
+    size_t index;
+    pthread_t thread;
+    uint64_t random;                      //  xorshift state to pick victims
+    std::atomic<uint64_t> executed;
+    std::atomic<uint64_t> stolen;
+    Deque deque;
+    char padding[CACHE_LINE_SIZE];
+  };
+
+  class Spin_guard {
+    private:
+    std::atomic_flag* _lock;
+
+    public:
+    explicit Spin_guard(std::atomic_flag* lock) : _lock(lock) {
+      while (_lock->test_and_set(std::memory_order_acquire)) {
+        sched_yield();
+      }
+    }
+
+    ~Spin_guard() {
+      _lock->clear(std::memory_order_release);
+    }
+  };
+
+  vector<std::unique_ptr<Worker>> _workers;
+  bool _pin_threads;
+
+  //  Tasks spawned from threads that are not workers of this pool
+  std::atomic_flag _injection_lock;
+  std::deque<Task*> _injection;
+  std::atomic<size_t> _injected;
+
+  std::atomic<bool> _stopping;
+  std::atomic<size_t> _sleeping;
+  std::atomic<uint64_t> _external;
+  pthread_mutex_t _sleep_mutex;
+  pthread_cond_t _sleep_condition;
+
+  static Worker*& current_worker() {
+    static thread_local Worker* worker = nullptr;
+    return worker;
+  }
+
+  Worker* current() const {
+    Worker* worker = current_worker();
+    return worker != nullptr && worker->pool == this ? worker : nullptr;
+  }
+
+  void push(Task* task) {
+    Worker* worker = current();
+    if (worker != nullptr) {
+      worker->deque.push(task);
+    } else {
+      Spin_guard guard(&_injection_lock);
+      _injection.push_back(task);
+      _injected.fetch_add(1, std::memory_order_seq_cst);
+    }
+
+    if (_sleeping.load(std::memory_order_seq_cst) > 0) {
+      pthread_mutex_lock(&_sleep_mutex);
+      pthread_cond_signal(&_sleep_condition);
+      pthread_mutex_unlock(&_sleep_mutex);
+    }
+  }
+
+  Task* pop_injected() {
+    if (_injected.load(std::memory_order_seq_cst) == 0) {
+      return nullptr;
+    }
+
+    Spin_guard guard(&_injection_lock);
+    if (_injection.empty()) {
+      return nullptr;
+    }
+
+    Task* task = _injection.front();
+    _injection.pop_front();
+    _injected.fetch_sub(1, std::memory_order_seq_cst);
+    return task;
+  }
+
+  Task* steal(uint64_t* random, bool* stolen) {
+    size_t count = _workers.size();
+    if (count == 0) {
+      return nullptr;
+    }
+
+    *random ^= *random << 13;
+    *random ^= *random >> 7;
+    *random ^= *random << 17;
+    size_t first = *random % count;
+    for (size_t i = 0; i < count; ++i) {
+      Task* task = _workers[(first + i) % count]->deque.steal();
+      if (task != nullptr) {
+        *stolen = true;
+        return task;
+      }
+    }
+
+    return nullptr;
+  }
+
+  /**
+   * Own deque first (hot in cache), then the injection queue, then others
+   */
+  Task* find_task(Worker* worker, uint64_t* random, bool* stolen) {
+    *stolen = false;
+    Task* task = worker != nullptr ? worker->deque.take() : nullptr;
+    if (task == nullptr) {
+      task = pop_injected();
+    }
+
+    if (task == nullptr) {
+      task = steal(random, stolen);
+    }
+
+    return task;
+  }
+
+  void execute(Task* task);
+
+  bool has_work() const {
+    if (_injected.load(std::memory_order_seq_cst) > 0) {
+      return true;
+    }
+
+    for (auto& worker : _workers) {
+      if (!worker->deque.empty()) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void sleep() {
+    pthread_mutex_lock(&_sleep_mutex);
+    _sleeping.fetch_add(1, std::memory_order_seq_cst);
+    if (!has_work() && !_stopping.load()) {
+      pthread_cond_wait(&_sleep_condition, &_sleep_mutex);
+    }
+
+    _sleeping.fetch_sub(1, std::memory_order_seq_cst);
+    pthread_mutex_unlock(&_sleep_mutex);
+  }
+
+  void run_worker(Worker* worker) {
+    current_worker() = worker;
+    if (_pin_threads) {
+      long cpus = sysconf(_SC_NPROCESSORS_ONLN);  // NOLINT(runtime/int)
+      cpu_set_t cpu_set;
+      CPU_ZERO(&cpu_set);
+      CPU_SET(worker->index % (cpus > 0 ? cpus : 1), &cpu_set);
+      pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+    }
+
+    int idle = 0;
+    while (!_stopping.load(std::memory_order_acquire)) {
+      bool stolen;
+      Task* task = find_task(worker, &worker->random, &stolen);
+      if (task != nullptr) {
+        execute(task);
+        worker->executed.fetch_add(1, std::memory_order_relaxed);
+        worker->stolen.fetch_add(stolen, std::memory_order_relaxed);
+        idle = 0;
+      } else if (++idle < SPINS_BEFORE_SLEEP) {
+        sched_yield();
+      } else {
+        sleep();
+        idle = 0;
+      }
+    }
+
+    current_worker() = nullptr;
+  }
+
+  static void* thread_main(void* argument) {
+    Worker* worker = static_cast<Worker*>(argument);
+    worker->pool->run_worker(worker);
+    return nullptr;
+  }
+
+  public:
+  /**
+   * Fork-join scope: tasks spawned in a group must be done before the group
+   *  is destroyed (the destructor waits for them).
+   */
+  class Task_group {
+    private:
+    friend class Work_stealing_pool;
+
+    Work_stealing_pool* _pool;
+    std::atomic<size_t> _pending;
+    std::atomic_flag _exception_lock;
+    std::exception_ptr _exception;
+
+    void set_exception(std::exception_ptr exception) {
+      Spin_guard guard(&_exception_lock);
+      if (!_exception) {
+        _exception = exception;
+      }
+    }
+
+    void wait_pending() {
+      Worker* worker = _pool->current();
+      uint64_t random = reinterpret_cast<uintptr_t>(this) | 1;
+      while (_pending.load(std::memory_order_acquire) != 0) {
+        bool stolen;
+        Task* task = _pool->find_task(worker, worker != nullptr ?
+                                      &worker->random : &random, &stolen);
+        if (task == nullptr) {
+          sched_yield();
+          continue;
+        }
+
+        _pool->execute(task);
+        if (worker != nullptr) {
+          worker->executed.fetch_add(1, std::memory_order_relaxed);
+          worker->stolen.fetch_add(stolen, std::memory_order_relaxed);
+        } else {
+          _pool->_external.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    }
+
+    public:
+    explicit Task_group(Work_stealing_pool* pool) : _pool(pool), _pending(0) {
+      _exception_lock.clear();
+    }
+
+    ~Task_group() {
+      wait_pending();
+    }
+
+    Task_group(const Task_group&) = delete;
+    Task_group& operator=(const Task_group&) = delete;
+
+    template<typename Function>
+    void spawn(Function&& function) {
+      using Task_type = Function_task<typename std::decay<Function>::type>;
+      _pending.fetch_add(1, std::memory_order_relaxed);
+      _pool->push(new Task_type(this, std::forward<Function>(function)));
+    }
+
+    /**
+     * Runs tasks until every task of the group is done.
+     *
+     * @throws the first exception thrown by a task of the group (tasks
+     *  can't throw without exceptions)
+     */
+    void wait() {
+      wait_pending();
+      if (_exception) {
+        std::exception_ptr exception = _exception;
+        _exception = nullptr;
+        std::rethrow_exception(exception);
+      }
+    }
+  };
+
+  /**
+   * @param threads worker threads (threads waiting on a group also run
+   *  tasks, so hardware_threads() - 1 keeps every core busy)
+   * @param pin_threads pin worker i to core i % hardware_threads()
+   */
+  explicit Work_stealing_pool(size_t threads, bool pin_threads = false)
+      : _pin_threads(pin_threads), _injected(0), _stopping(false),
+        _sleeping(0), _external(0) {
+    _injection_lock.clear();
+    pthread_mutex_init(&_sleep_mutex, nullptr);
+    pthread_cond_init(&_sleep_condition, nullptr);
+
+    for (size_t i = 0; i < threads; ++i) {
+      _workers.emplace_back(new Worker());
+      Worker* worker = _workers.back().get();
+      worker->pool = this;
+      worker->index = i;
+      worker->random = 0x9e3779b97f4a7c15ULL * (i + 1);
+      worker->executed.store(0);
+      worker->stolen.store(0);
+    }
+
+    for (size_t i = 0; i < threads; ++i) {
+      if (pthread_create(&_workers[i]->thread, nullptr, thread_main,
+                         _workers[i].get()) != 0) {
+        stop(i);
+        raise_error(std::runtime_error(
+            "Work_stealing_pool: can't create threads"));
+      }
+    }
+  }
+
+  ~Work_stealing_pool() {
+    stop(_workers.size());
+  }
+
+  Work_stealing_pool(const Work_stealing_pool&) = delete;
+  Work_stealing_pool& operator=(const Work_stealing_pool&) = delete;
+
+  static size_t hardware_threads() {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);  // NOLINT(runtime/int)
+    return cpus > 0 ? cpus : 1;
+  }
+
+  /**
+   * Pool shared by the library by default (hardware_threads() - 1 workers)
+   */
+  static Work_stealing_pool& shared() {
+    static Work_stealing_pool pool(hardware_threads() - 1);
+    return pool;
+  }
+
+  /**
+   * Number of workers, not counting threads that help while waiting
+   */
+  size_t threads() const {
+    return _workers.size();
+  }
+
+  /**
+   * Calls function(first, last) on chunks of at most 'grain' indexes of
+   *  [begin, end), splitting the range in halves so thieves take big parts.
+   */
+  template<typename Function>
+  void parallel_for(size_t begin, size_t end, size_t grain,
+                    const Function& function) {
+    Task_group group(this);
+    split(&group, begin, end, grain == 0 ? 1 : grain, function);
+    group.wait();
+  }
+
+  Statistics statistics() const {
+    Statistics statistics = {0, 0, _external.load()};
+    for (auto& worker : _workers) {
+      statistics.executed += worker->executed.load();
+      statistics.stolen += worker->stolen.load();
+    }
+
+    return statistics;
+  }
+
+  private:
+  template<typename Function>
+  void split(Task_group* group, size_t begin, size_t end, size_t grain,
+             const Function& function) {
+    while (end - begin > grain) {
+      size_t middle = begin + (end - begin) / 2;
+      group->spawn([this, group, middle, end, grain, &function]() {
+        split(group, middle, end, grain, function);
+      });
+      end = middle;
+    }
+
+    function(begin, end);
+  }
+
+  void stop(size_t started) {
+    pthread_mutex_lock(&_sleep_mutex);
+    _stopping.store(true);
+    pthread_cond_broadcast(&_sleep_condition);
+    pthread_mutex_unlock(&_sleep_mutex);
+
+    for (size_t i = 0; i < started; ++i) {
+      pthread_join(_workers[i]->thread, nullptr);
+    }
+
+    pthread_cond_destroy(&_sleep_condition);
+    pthread_mutex_destroy(&_sleep_mutex);
+  }
+};
+
+inline void Work_stealing_pool::execute(Task* task) {
+  Task_group* group = task->group;
+#if JSON_VALIDATOR_EXCEPTIONS
+  try {
+    task->run();
+  } catch (...) {
+    group->set_exception(std::current_exception());
+  }
+#else
+  task->run();
+#endif
+
+  delete task;
+  group->_pending.fetch_sub(1, std::memory_order_release);
+}
+}  // namespace json_validator
+#endif
@@ -0,0 +1,83 @@
+#ifndef CJSON_VALIDATOR_ALLOCATION_COUNTER_HPP
+#define CJSON_VALIDATOR_ALLOCATION_COUNTER_HPP
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+namespace benchmark {
+
+/**
+ * Heap traffic since the start of the process (see counted_malloc)
+ */
+struct Allocation_counters {
+  uint64_t allocations;
+  uint64_t bytes;               //  requested, not what malloc rounds up to
+  uint64_t live_bytes;
+  uint64_t peak_live_bytes;     //  lowered by hand to measure a phase
+};
+
+/**
+ * Constant initialised: usable by operator new before main
+ */
+inline Allocation_counters& allocation_counters() {
+  static Allocation_counters counters;
+  return counters;
+}
+
+/**
+ * Every block starts with its size, so frees know what they give back.
+ *  The header keeps the alignment malloc gives.
+ */
+static const size_t ALLOCATION_HEADER = 16;
+
+/**
+ * malloc that counts. Not thread safe: the benchmark validates from one
+ *  thread.
+ *
+ * Replacements of operator new/delete (in a single translation unit, see
+ * benchmark.cpp) and cJSON (count_cjson_allocations) go through it.
+ */
+inline void* counted_malloc(size_t size) {
+  char* block = static_cast<char*>(malloc(size + ALLOCATION_HEADER));
+  if (block == nullptr) {
+    return nullptr;
+  }
+
+  *reinterpret_cast<size_t*>(block) = size;
+  Allocation_counters& counters = allocation_counters();
+  ++counters.allocations;
+  counters.bytes += size;
+  counters.live_bytes += size;
+  counters.peak_live_bytes = std::max(counters.peak_live_bytes,
+                                      counters.live_bytes);
+  return block + ALLOCATION_HEADER;
+}
+
+inline void counted_free(void* pointer) {
+  if (pointer == nullptr) {
+    return;
+  }
+
+  char* block = static_cast<char*>(pointer) - ALLOCATION_HEADER;
+  allocation_counters().live_bytes -= *reinterpret_cast<size_t*>(block);
+  free(block);
+}
+
+/**
+ * Must be called before cJSON allocates anything: what it allocated
+ *  before can't be freed through the hooks anymore (and whatever cJSON
+ *  returns must now be freed with counted_free)
+ */
+inline void count_cjson_allocations() {
+  cJSON_Hooks hooks = {counted_malloc, counted_free};
+  cJSON_InitHooks(&hooks);
+}
+
+}  // namespace benchmark
+
+#endif
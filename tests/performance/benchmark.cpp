@@ -0,0 +1,465 @@
+#include <iostream>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "benchmark.hpp"
+#include "document_generator.hpp"
+#include "document_limits.hpp"
+#include "iterative_validator.hpp"
+#include "json_validator.hpp"
+#include "node_counters.hpp"
+#include "schema_compiler.hpp"
+#include "schema_loader.hpp"
+#include "streaming_validator.hpp"
+#include "subtree_memo.hpp"
+#include "performance_validator.hpp"
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+// Every allocation of the process is counted (cJSON's too, see main)
+void* operator new(size_t size) {
+  void* pointer = benchmark::counted_malloc(size);
+  if (pointer == nullptr) {
+    raise_error(std::bad_alloc());
+  }
+
+  return pointer;
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept {
+  benchmark::counted_free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+  benchmark::counted_free(pointer);
+}
+
+/**
+ * Synthetic corpus: an object {"records": [...]} whose records nest 'depth' levels of objects ("child"), each one with
+ * an "id" and 'width' scalar fields (integers, strings of 'string_length' chars, booleans and enums)
+ */
+struct Shape {
+  string scenario;
+  size_t records;
+  size_t depth;
+  size_t width;
+  size_t string_length;
+  string failure;           // none, first, middle or last record fails (an "id" of its deepest level is below 0)
+};
+
+static string level_schema(const Shape& shape, size_t depth) {
+  string properties = "\"id\": {\"type\": \"integer\", \"minimum\": 0}";
+  for (size_t f = 0; f < shape.width; ++f) {
+    string field = "\"f" + to_string(f) + "\": ";
+    switch (f % 4) {
+      case 0: field += "{\"type\": \"integer\", \"minimum\": 0, \"maximum\": 1000000}"; break;
+      case 1: field += "{\"type\": \"string\", \"maxLength\": " + to_string(shape.string_length) + "}"; break;
+      case 2: field += "{\"type\": \"boolean\"}"; break;
+      default: field += "{\"type\": \"string\", \"enum\": [\"alpha\", \"beta\", \"gamma\"]}"; break;
+    }
+
+    properties += ", " + field;
+  }
+
+  if (depth > 1) {
+    properties += ", \"child\": " + level_schema(shape, depth - 1);
+  }
+
+  return "{\"type\": \"object\", \"required\": [\"id\"], \"properties\": {" + properties + "}}";
+}
+
+static string schema(const Shape& shape) {
+  return "{\"type\": \"object\", \"required\": [\"records\"], \"properties\": {\"records\": {\"type\": \"array\", "
+         "\"items\": " + level_schema(shape, shape.depth) + "}}}";
+}
+
+static void append_level(const Shape& shape, size_t seed, size_t depth, bool fails, string* json) {
+  static const char* const kinds[] = {"alpha", "beta", "gamma"};
+  *json += "{\"id\": " + (fails && depth == 1 ? string("-1") : to_string(seed));
+  for (size_t f = 0; f < shape.width; ++f) {
+    *json += ", \"f" + to_string(f) + "\": ";
+    switch (f % 4) {
+      case 0: *json += to_string((seed * 7 + f) % 1000000); break;
+      case 1: *json += "\"" + string(shape.string_length, (char)('a' + (seed + f) % 26)) + "\""; break;
+      case 2: *json += (seed + f) % 2 ? "true" : "false"; break;
+      default: *json += "\"" + string(kinds[(seed + f) % 3]) + "\""; break;
+    }
+  }
+
+  if (depth > 1) {
+    *json += ", \"child\": ";
+    append_level(shape, seed + 1, depth - 1, fails, json);
+  }
+
+  *json += "}";
+}
+
+static string document(const Shape& shape, size_t seed) {
+  size_t failing = shape.failure == "first" ? 0 :
+                   shape.failure == "middle" ? shape.records / 2 :
+                   shape.failure == "last" ? shape.records - 1 : shape.records;
+  string json = "{\"records\": [";
+  for (size_t r = 0; r < shape.records; ++r) {
+    if (r > 0) {
+      json += ", ";
+    }
+
+    append_level(shape, seed + r, shape.depth, r == failing, &json);
+  }
+
+  return json + "]}";
+}
+
+/**
+ * Texts and parsed trees of a corpus (parsing is timed by the engines that do it only)
+ */
+struct Corpus {
+  vector<string> texts;
+  vector<cJSON_ptr> roots;
+  benchmark::Corpus_info info;
+
+  Corpus(const string& scenario, vector<string> documents, double valid, cJSON* parameters)
+      : texts(std::move(documents)) {
+    double bytes = 0;
+    double nodes = 0;
+    for (const string& text : texts) {
+      roots.emplace_back(cJSON_Parse(text.c_str()), cJSON_Delete);
+      bytes += text.size();
+      nodes += Subtree_memo::count_nodes(CJSON_adapter(roots.back().get()));
+    }
+
+    info = {scenario, texts.size(), bytes / texts.size(), nodes / texts.size(), valid, parameters};
+  }
+
+  ~Corpus() {
+    cJSON_Delete(info.parameters);
+  }
+};
+
+/**
+ * Every engine that can validate with 'json_schema' (the loader doesn't read $ref, the compiler does)
+ */
+static void run_engines(benchmark::Runner* runner, const Corpus& corpus, const string& json_schema,
+                        const vector<pair<string, std::function<bool(cJSON*)>>>& extra_engines = {}) {
+  const vector<cJSON_ptr>& roots = corpus.roots;
+  const vector<string>& texts = corpus.texts;
+
+  // Engines validating parsed documents are timed on the corpus, their allocations are counted on a fresh copy
+  cJSON* fresh = nullptr;
+  auto parse = [&](size_t i) { fresh = cJSON_Parse(texts[i].c_str()); };
+  auto teardown = [&](size_t) { cJSON_Delete(fresh); };
+  auto run_parsed = [&](const string& engine, const std::function<bool(cJSON*)>& validate) {
+    runner->run(corpus.info, engine, [&](size_t i) { return validate(roots[i].get()); },
+                {parse, [&](size_t) { validate(fresh); }, teardown});
+  };
+
+  // Parsing only (the baseline of streaming): every document is well formed
+  benchmark::Corpus_info parsed = corpus.info;
+  parsed.valid = 1;
+  runner->run(parsed, "parse", [&](size_t i) {
+    cJSON* root = cJSON_Parse(texts[i].c_str());
+    cJSON_Delete(root);
+    return root != nullptr;
+  }, {parse, nullptr, teardown});
+
+  auto validator = Schema_loader<CJSON_adapter>::load(json_schema);
+  Validation_result_ptr result(new Validation_result());
+  run_parsed("builder", [&](cJSON* root) {
+    result->reset();
+    result = validator->validate(CJSON_adapter(root), std::move(result));
+    return result->success();
+  });
+
+  // Same tree with a deadline (an hour away: never reached) restarted for each document
+  Validation_budget budget;
+  run_parsed("budgeted", [&](cJSON* root) {
+    budget.restart(3600000000000);
+    result->reset();
+    result->budget(&budget);
+    result = validator->validate(CJSON_adapter(root), std::move(result));
+    result->budget(nullptr);
+    return result->success();
+  });
+
+  // Same tree walked from an explicit stack
+  Iterative_validator<CJSON_adapter> iterative(validator.get());
+  run_parsed("iterative", [&](cJSON* root) {
+    result->reset();
+    result = iterative.validate(CJSON_adapter(root), std::move(result));
+    return result->success();
+  });
+
+  // Same tree counting the calls of every node, timing one call out of 64
+  auto counted = Schema_loader<CJSON_adapter, Node_counters<64>>::load(json_schema);
+  run_parsed("counted", [&](cJSON* root) {
+    result->reset();
+    result = counted->validate(CJSON_adapter(root), std::move(result));
+    return result->success();
+  });
+
+  const string blob = Schema_compiler::compile(json_schema);
+  Compiled_schema compiled(blob);
+  Compiled_schema_stack<CJSON_adapter> stack;
+  run_parsed("compiled", [&](cJSON* root) {
+    result = compiled.validate(CJSON_adapter(root), &stack, std::move(result));
+    return result->success();
+  });
+
+  for (auto& engine : extra_engines) {
+    run_parsed(engine.first, engine.second);
+  }
+
+  Streaming_validator stream(validator.get());
+  auto stream_document = [&](size_t i) {
+    stream.feed(texts[i]);
+    return stream.finish()->success();
+  };
+
+  runner->run(corpus.info, "streaming", stream_document, {nullptr, stream_document, nullptr});
+}
+
+static cJSON* shape_parameters(const Shape& shape) {
+  cJSON* parameters = cJSON_CreateObject();
+  cJSON_AddNumberToObject(parameters, "records", shape.records);
+  cJSON_AddNumberToObject(parameters, "depth", shape.depth);
+  cJSON_AddNumberToObject(parameters, "width", shape.width);
+  cJSON_AddNumberToObject(parameters, "string_length", shape.string_length);
+  cJSON_AddStringToObject(parameters, "failure", shape.failure.c_str());
+  return parameters;
+}
+
+static void run_shape(benchmark::Runner* runner, const Shape& shape) {
+  // Enough distinct documents to not validate the same bytes from L1 only
+  size_t documents = 1;
+  const size_t corpus_bytes = 256 * 1024;
+  vector<string> texts = {document(shape, 0)};
+  while (documents < 32 && documents * texts[0].size() < corpus_bytes) {
+    texts.push_back(document(shape, documents++ * shape.records * shape.depth));
+  }
+
+  Corpus corpus(shape.scenario, std::move(texts), shape.failure == "none" ? 1 : 0, shape_parameters(shape));
+  run_engines(runner, corpus, schema(shape));
+}
+
+/**
+ * Documents generated from performance.json (the only corpus schema_codegen has a class for): valid ones, then ones
+ * with a value of the wrong type at increasing depths (in the middle of the values at that depth: every engine checks
+ * types, streaming doesn't check unique items)
+ */
+static void run_performance_json(benchmark::Runner* runner) {
+  ifstream file(PERFORMANCE_SCHEMAS_PATH "/performance.json");
+  stringstream json_schema;
+  json_schema << file.rdbuf();
+
+  const size_t documents = 32;
+  Document_generator generator(json_schema.str());
+  for (int depth = -1; depth <= 3; ++depth) {
+    vector<string> texts;
+    for (uint64_t i = 0; texts.size() < documents; ++i) {
+      string text;
+      if (depth < 0) {
+        generator.append_valid(i, &text);
+      } else if (!generator.append_invalid(i, {(size_t)depth, 0.5, MUTATE_WRONG_TYPE}, &text)) {
+        continue;
+      }
+
+      texts.push_back(std::move(text));
+    }
+
+    string scenario = depth < 0 ? "performance.json" : "performance.json/failure_depth=" + to_string(depth);
+    cJSON* parameters = cJSON_CreateObject();
+    cJSON_AddStringToObject(parameters, "schema", "performance.json");
+    cJSON_AddNumberToObject(parameters, "failure_depth", depth);
+    Corpus corpus(scenario, std::move(texts), depth < 0 ? 1 : 0, parameters);
+    run_engines(runner, corpus, json_schema.str(), {{"generated", [](cJSON* root) {
+      return generated::Performance_validator::is_valid(root);
+    }}});
+  }
+}
+
+/**
+ * Payloads we've seen monopolise a worker, each one at two sizes 10x apart: with Document_limits the time per document
+ * is bounded by the limits, so it must not grow with the size (the documents are rejected before being parsed)
+ */
+static void run_adversarial(benchmark::Runner* runner) {
+  Document_limits limits;
+  limits.max_depth = 64;
+  limits.max_nodes = 100000;
+  limits.max_string_bytes = 1 << 20;
+  limits.max_array_length = 10000;
+  limits.max_object_keys = 1000;
+
+  auto deep = [](size_t size) { return string(size, '[') + string(size, ']'); };
+  auto long_string = [](size_t size) { return "[\"" + string(size, 'a') + "\"]"; };
+  auto long_array = [](size_t size) {
+    string json = "[0";
+    for (size_t i = 1; i < size; ++i) {
+      json += ",0";
+    }
+
+    return json + "]";
+  };
+
+  auto many_keys = [](size_t size) {
+    string json = "{";
+    for (size_t i = 0; i < size; ++i) {
+      json += (i ? ",\"k" : "\"k") + to_string(i) + "\":0";
+    }
+
+    return json + "}";
+  };
+
+  // Arrays of 1000 items, so that only the count of nodes is past its limit
+  auto many_nodes = [](size_t size) {
+    string json = "[";
+    for (size_t i = 0; i < size / 1000; ++i) {
+      json += i ? ",[0" : "[0";
+      for (size_t j = 1; j < 1000; ++j) {
+        json += ",0";
+      }
+
+      json += "]";
+    }
+
+    return json + "]";
+  };
+
+  const vector<tuple<string, std::function<string(size_t)>, size_t>> shapes = {
+    make_tuple("depth", deep, 10000), make_tuple("string_bytes", long_string, 5000000),
+    make_tuple("array_length", long_array, 500000), make_tuple("object_keys", many_keys, 100000),
+    make_tuple("nodes", many_nodes, 500000)
+  };
+
+  Object_validator<CJSON_adapter> anything({});
+  Array_validator<CJSON_adapter> any_array;
+  for (auto& shape : shapes) {
+    for (size_t size : {get<2>(shape), 10 * get<2>(shape)}) {
+      vector<string> texts = {get<1>(shape)(size)};
+      cJSON* parameters = cJSON_CreateObject();
+      cJSON_AddStringToObject(parameters, "shape", get<0>(shape).c_str());
+      cJSON_AddNumberToObject(parameters, "size", size);
+      benchmark::Corpus_info info = {"adversarial/" + get<0>(shape) + "=" + to_string(size), 1,
+                                     (double)texts[0].size(), (double)size, 0, parameters};
+
+      Document_scanner scanner(limits);
+      Validation_result result;
+      runner->run(info, "limits", [&](size_t i) {
+        result.reset();
+        return scanner.check(texts[i], &result);
+      });
+
+      Streaming_validator stream(texts[0][0] == '{' ? (Validator<CJSON_adapter>*)&anything : &any_array, limits);
+      auto stream_document = [&](size_t i) {
+        stream.feed(texts[i]);
+        return stream.finish()->success();
+      };
+
+      runner->run(info, "streaming", stream_document, {nullptr, stream_document, nullptr});
+      cJSON_Delete(parameters);
+    }
+  }
+}
+
+static bool option(const string& argument, const string& name, string* value) {
+  if (argument.compare(0, name.size() + 3, "--" + name + "=") != 0) {
+    return false;
+  }
+
+  *value = argument.substr(name.size() + 3);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  benchmark::count_cjson_allocations();
+  benchmark::Options options;
+  string output;
+  string baseline;
+  for (int i = 1; i < argc; ++i) {
+    string argument = argv[i];
+    string value;
+    if (option(argument, "repetitions", &value)) {
+      options.repetitions = std::max(1, stoi(value));
+    } else if (option(argument, "warm-up", &value)) {
+      options.warm_up = stoi(value);
+    } else if (option(argument, "min-time-ms", &value)) {
+      options.min_repetition_ms = stod(value);
+    } else if (option(argument, "filter", &value)) {
+      options.filter = value;
+    } else if (option(argument, "output", &value)) {
+      output = value;
+    } else if (option(argument, "baseline", &value)) {
+      baseline = value;
+    } else if (argument == "--quick") {
+      options.warm_up = 1;
+      options.repetitions = 5;
+      options.min_repetition_ms = 5;
+    } else {
+      cerr << "usage: " << argv[0] << " [--repetitions=N] [--warm-up=N] [--min-time-ms=N] [--filter=scenario/engine]"
+           << " [--output=results.json] [--baseline=previous.json] [--quick]" << endl;
+      return 1;
+    }
+  }
+
+  benchmark::Runner runner(options);
+  run_performance_json(&runner);
+
+  // One dimension varies at a time, around 64 records of depth 2, width 8 and strings of 16 chars
+  for (size_t records : {1, 16, 256, 4096}) {
+    run_shape(&runner, {"size/records=" + to_string(records), records, 2, 8, 16, "none"});
+  }
+
+  for (size_t depth : {1, 4, 16, 64}) {
+    run_shape(&runner, {"depth/" + to_string(depth), 64, depth, 8, 16, "none"});
+  }
+
+  for (size_t width : {2, 16, 64}) {
+    run_shape(&runner, {"width/" + to_string(width), 64, 2, width, 16, "none"});
+  }
+
+  for (size_t length : {1, 256, 4096}) {
+    run_shape(&runner, {"string_length/" + to_string(length), 64, 2, 8, length, "none"});
+  }
+
+  for (const char* failure : {"first", "middle", "last"}) {
+    run_shape(&runner, {string("failure/") + failure, 1024, 2, 8, 16, failure});
+  }
+
+  run_adversarial(&runner);
+
+  cJSON_ptr results(runner.to_json(), cJSON_Delete);
+  char* printed = cJSON_Print(results.get());
+  if (output.empty()) {
+    cout << printed << endl;
+  } else {
+    ofstream(output) << printed << endl;
+  }
+
+  benchmark::counted_free(printed);
+
+  if (!baseline.empty()) {
+    ifstream file(baseline);
+    stringstream previous;
+    previous << file.rdbuf();
+    cJSON_ptr previous_results(cJSON_Parse(previous.str().c_str()), cJSON_Delete);
+    if (previous_results == nullptr) {
+      cerr << "can't read " << baseline << endl;
+      return 1;
+    }
+
+    cerr << endl << "median ns/doc against " << baseline << endl;
+    runner.compare(stderr, previous_results.get());
+  }
+
+  return 0;
+}
@@ -0,0 +1,489 @@
+#ifndef CJSON_VALIDATOR_BENCHMARK_HPP
+#define CJSON_VALIDATOR_BENCHMARK_HPP
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "allocation_counter.hpp"
+#include "latency_histogram.hpp"
+#include "perf_counters.hpp"
+
+namespace benchmark {
+
+using std::string;
+using std::vector;
+
+/**
+ * Size of one document of a corpus, used to turn times into throughputs
+ *  (of the whole document: failing early shows as a higher throughput)
+ */
+struct Corpus_info {
+  string scenario;
+  size_t documents;       //  distinct documents, validated in turn
+  double bytes_per_doc;   //  average size of the text
+  double nodes_per_doc;   //  average count of json values
+  double valid;           //  expected fraction of valid documents
+  cJSON* parameters;      //  what the scenario varies (copied by run)
+};
+
+/**
+ * A validation split in the steps whose heap traffic is accounted apart,
+ *  on document i of the corpus (steps an engine doesn't have are empty)
+ */
+struct Phases {
+  std::function<void(size_t)> parse;
+  std::function<void(size_t)> validate;
+  std::function<void(size_t)> teardown;
+};
+
+enum Phase { PARSE, VALIDATE, TEARDOWN, PHASES };
+
+static const char* const PHASE_NAMES[PHASES] = {
+  "parse", "validate", "teardown"
+};
+
+/**
+ * Heap traffic of one phase, averaged over the documents of the corpus
+ */
+struct Allocations {
+  bool measured;              //  the engine has this phase
+  double allocations_per_doc;
+  double bytes_per_doc;
+  uint64_t peak_live_bytes;   //  above what was live before parsing (max)
+};
+
+/**
+ * Times of the repetitions of one scenario on one engine
+ */
+struct Measurement {
+  Corpus_info corpus;
+  string engine;
+  size_t documents_per_repetition;
+  double valid;                     //  fraction accepted by the engine
+  vector<double> ns_per_doc;        //  one per repetition, sorted
+  bool accounted;                   //  the engine had phases
+  Allocations allocations[PHASES];
+  //  of each document, in one more repetition
+  std::shared_ptr<json_validator::Latency_histogram> latencies;
+  Hardware_counts hardware;         //  per document, timed repetitions
+};
+
+/**
+ * Columns of the percentile tables
+ */
+static const double LATENCY_PERCENTILES[] = {
+  50, 75, 90, 95, 99, 99.9, 99.99, 100
+};
+
+struct Options {
+  size_t warm_up = 3;               //  untimed repetitions
+  size_t repetitions = 15;
+  double min_repetition_ms = 20;    //  whole corpus passes are added up to it
+  string filter;                    //  only "scenario/engine" containing it
+};
+
+/**
+ * Nearest rank on sorted values
+ */
+inline double percentile(const vector<double>& sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0;
+  }
+
+  size_t rank = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+/**
+ * Runs every (scenario, engine) pair the same way: warm-up repetitions
+ * (which also calibrate how many passes over the corpus a repetition
+ * needs to last min_repetition_ms), then timed repetitions. A repetition
+ * gives one ns/doc sample, summarised as median and percentiles.
+ *
+ * Hardware counters (see Perf_counters), when there are, count the timed
+ * repetitions as a whole.
+ *
+ * One more repetition times each document apart, for a latency histogram
+ * (clock reads included: tens of ns).
+ *
+ * 'validate(i)' validates document i of the corpus and tells whether it
+ * was accepted. When phases are given, they are run once more per
+ * document afterwards, counting the allocations of each one (so the
+ * counts are those of a warm engine, whose buffers already grew).
+ */
+class Runner {
+  using Clock = std::chrono::steady_clock;
+
+  Options _options;
+  vector<Measurement> _measurements;
+  Perf_counters _counters;
+
+  public:
+  explicit Runner(const Options& options) : _options(options) {
+    if (!_counters.reason().empty()) {
+      fprintf(stderr, "%s counters (%s)\n",
+              _counters.available() ? "missing some" : "no",
+              _counters.reason().c_str());
+    }
+  }
+
+  ~Runner() {
+    for (Measurement& measurement : _measurements) {
+      cJSON_Delete(measurement.corpus.parameters);
+    }
+  }
+
+  const Options& options() const {
+    return _options;
+  }
+
+  bool selected(const string& scenario, const string& engine) const {
+    return (scenario + "/" + engine).find(_options.filter) != string::npos;
+  }
+
+  const vector<Measurement>& measurements() const {
+    return _measurements;
+  }
+
+  void run(const Corpus_info& corpus, const string& engine,
+           const std::function<bool(size_t)>& validate,
+           const Phases& phases = Phases()) {
+    if (!selected(corpus.scenario, engine) || corpus.documents == 0) {
+      return;
+    }
+
+    size_t passes = 1;
+    double valid = 0;
+    for (size_t i = 0; i < _options.warm_up || i == 0; ++i) {
+      Clock::time_point start = Clock::now();
+      size_t accepted = 0;
+      for (size_t pass = 0; pass < passes; ++pass) {
+        for (size_t d = 0; d < corpus.documents; ++d) {
+          accepted += validate(d);
+        }
+      }
+
+      valid = (double)accepted / (passes * corpus.documents);
+
+      double ms = std::chrono::duration<double, std::milli>(
+          Clock::now() - start).count();
+      if (ms < _options.min_repetition_ms) {
+        double scale = _options.min_repetition_ms / std::max(ms, 1e-3);
+        passes = std::max(passes + 1, (size_t)(passes * scale * 1.1));
+      }
+    }
+
+    Measurement measurement{corpus, engine, passes * corpus.documents, valid,
+                            {}, false, {}};
+    measurement.corpus.parameters =
+        cJSON_Duplicate(corpus.parameters, 1);
+    _counters.start();
+    for (size_t r = 0; r < _options.repetitions; ++r) {
+      Clock::time_point start = Clock::now();
+      for (size_t pass = 0; pass < passes; ++pass) {
+        for (size_t d = 0; d < corpus.documents; ++d) {
+          validate(d);
+        }
+      }
+
+      double ns = std::chrono::duration<double, std::nano>(
+          Clock::now() - start).count();
+      measurement.ns_per_doc.push_back(
+          ns / measurement.documents_per_repetition);
+    }
+
+    measurement.hardware = _counters.stop();
+    for (double& count : measurement.hardware.counts) {
+      count /= _options.repetitions * measurement.documents_per_repetition;
+    }
+
+    std::sort(measurement.ns_per_doc.begin(), measurement.ns_per_doc.end());
+    measurement.latencies.reset(new json_validator::Latency_histogram());
+    for (size_t pass = 0; pass < passes; ++pass) {
+      for (size_t d = 0; d < corpus.documents; ++d) {
+        uint64_t start = json_validator::Latency_histogram::now_ns();
+        validate(d);
+        measurement.latencies->record(
+            json_validator::Latency_histogram::now_ns() - start);
+      }
+    }
+
+    account(corpus, phases, &measurement);
+    _measurements.push_back(measurement);
+    print(stderr, _measurements.back());
+  }
+
+  static void account(const Corpus_info& corpus, const Phases& phases,
+                      Measurement* measurement) {
+    const std::function<void(size_t)>* steps[PHASES] = {
+      &phases.parse, &phases.validate, &phases.teardown
+    };
+
+    Allocation_counters& counters = allocation_counters();
+    for (size_t d = 0; d < corpus.documents; ++d) {
+      uint64_t live_before = counters.live_bytes;
+      for (int phase = PARSE; phase < PHASES; ++phase) {
+        if (!*steps[phase]) {
+          continue;
+        }
+
+        measurement->accounted = true;
+        Allocation_counters before = counters;
+        counters.peak_live_bytes = counters.live_bytes;
+        (*steps[phase])(d);
+
+        Allocations& allocations = measurement->allocations[phase];
+        allocations.measured = true;
+        allocations.allocations_per_doc +=
+            (double)(counters.allocations - before.allocations) /
+            corpus.documents;
+        allocations.bytes_per_doc +=
+            (double)(counters.bytes - before.bytes) / corpus.documents;
+        allocations.peak_live_bytes = std::max(
+            allocations.peak_live_bytes,
+            counters.peak_live_bytes - std::min(counters.peak_live_bytes,
+                                                live_before));
+        counters.peak_live_bytes = std::max(counters.peak_live_bytes,
+                                            before.peak_live_bytes);
+      }
+    }
+  }
+
+  static void print(FILE* out, const Measurement& measurement) {
+    const vector<double>& ns = measurement.ns_per_doc;
+    double median = percentile(ns, 0.5);
+    fprintf(out, "%-28s %-10s %12.0f ns/doc (p10 %.0f, p90 %.0f)"
+            " %9.1f MB/s %8.2f Mnodes/s%s\n",
+            measurement.corpus.scenario.c_str(), measurement.engine.c_str(),
+            median, percentile(ns, 0.1), percentile(ns, 0.9),
+            measurement.corpus.bytes_per_doc * 1e3 / median,
+            measurement.corpus.nodes_per_doc * 1e3 / median,
+            measurement.valid == measurement.corpus.valid ? ""
+                                                          : " UNEXPECTED");
+    fprintf(out, "%-39s latency ns", "");
+    for (double percentile : LATENCY_PERCENTILES) {
+      fprintf(out, " p%g %" PRIu64, percentile,
+              measurement.latencies->value_at_percentile(percentile));
+    }
+
+    fprintf(out, "\n");
+    print_hardware(out, measurement.hardware);
+    if (!measurement.accounted) {
+      return;
+    }
+
+    fprintf(out, "%-39s allocations/doc", "");
+    for (int phase = PARSE; phase < PHASES; ++phase) {
+      const Allocations& allocations = measurement.allocations[phase];
+      if (!allocations.measured) {
+        continue;
+      }
+
+      fprintf(out, " %s %.1f (%.0f B, peak %" PRIu64 " B)",
+              PHASE_NAMES[phase], allocations.allocations_per_doc,
+              allocations.bytes_per_doc, allocations.peak_live_bytes);
+    }
+
+    fprintf(out, "\n");
+  }
+
+  /**
+   * Measured events per document, and instructions per cycle
+   */
+  static void print_hardware(FILE* out, const Hardware_counts& hardware) {
+    bool any = false;
+    for (int event = INSTRUCTIONS; event < HARDWARE_EVENTS; ++event) {
+      if (!hardware.measured[event]) {
+        continue;
+      }
+
+      if (!any) {
+        fprintf(out, "%-39s counters/doc", "");
+        any = true;
+      }
+
+      fprintf(out, " %s %.1f", HARDWARE_EVENT_NAMES[event],
+              hardware.counts[event]);
+    }
+
+    if (hardware.measured[INSTRUCTIONS] && hardware.measured[CYCLES] &&
+        hardware.counts[CYCLES] > 0) {
+      fprintf(out, " ipc %.2f",
+              hardware.counts[INSTRUCTIONS] / hardware.counts[CYCLES]);
+    }
+
+    if (any) {
+      fprintf(out, "\n");
+    }
+  }
+
+  static cJSON* to_json(const Measurement& measurement) {
+    const vector<double>& ns = measurement.ns_per_doc;
+    double median = percentile(ns, 0.5);
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "scenario",
+                            measurement.corpus.scenario.c_str());
+    cJSON_AddStringToObject(json, "engine", measurement.engine.c_str());
+    cJSON_AddItemToObject(json, "parameters",
+                          cJSON_Duplicate(measurement.corpus.parameters, 1));
+    cJSON_AddNumberToObject(json, "documents", measurement.corpus.documents);
+    cJSON_AddNumberToObject(json, "bytes_per_doc",
+                            measurement.corpus.bytes_per_doc);
+    cJSON_AddNumberToObject(json, "nodes_per_doc",
+                            measurement.corpus.nodes_per_doc);
+    cJSON_AddNumberToObject(json, "documents_per_repetition",
+                            measurement.documents_per_repetition);
+    cJSON_AddNumberToObject(json, "expected_valid", measurement.corpus.valid);
+    cJSON_AddNumberToObject(json, "valid", measurement.valid);
+
+    cJSON* summary = cJSON_CreateObject();
+    cJSON_AddNumberToObject(summary, "min", ns.front());
+    cJSON_AddNumberToObject(summary, "p10", percentile(ns, 0.1));
+    cJSON_AddNumberToObject(summary, "median", median);
+    cJSON_AddNumberToObject(summary, "p90", percentile(ns, 0.9));
+    cJSON_AddNumberToObject(summary, "p99", percentile(ns, 0.99));
+    cJSON_AddNumberToObject(summary, "max", ns.back());
+    cJSON_AddItemToObject(json, "ns_per_doc", summary);
+    cJSON_AddNumberToObject(json, "mb_per_s",
+                            measurement.corpus.bytes_per_doc * 1e3 / median);
+    cJSON_AddNumberToObject(json, "nodes_per_s",
+                            measurement.corpus.nodes_per_doc * 1e9 / median);
+
+    string latencies;
+    measurement.latencies->append_json(&latencies);
+    cJSON_AddItemToObject(json, "latency_ns", cJSON_Parse(latencies.c_str()));
+
+    cJSON* hardware = cJSON_CreateObject();
+    for (int event = INSTRUCTIONS; event < HARDWARE_EVENTS; ++event) {
+      if (measurement.hardware.measured[event]) {
+        cJSON_AddNumberToObject(hardware, HARDWARE_EVENT_NAMES[event],
+                                measurement.hardware.counts[event]);
+      }
+    }
+
+    cJSON_AddItemToObject(json, "counters_per_doc", hardware);
+    if (!measurement.accounted) {
+      return json;
+    }
+
+    cJSON* phases = cJSON_CreateObject();
+    for (int phase = PARSE; phase < PHASES; ++phase) {
+      const Allocations& allocations = measurement.allocations[phase];
+      if (!allocations.measured) {
+        continue;
+      }
+
+      cJSON* counts = cJSON_CreateObject();
+      cJSON_AddNumberToObject(counts, "allocations_per_doc",
+                              allocations.allocations_per_doc);
+      cJSON_AddNumberToObject(counts, "bytes_per_doc",
+                              allocations.bytes_per_doc);
+      cJSON_AddNumberToObject(counts, "peak_live_bytes",
+                              allocations.peak_live_bytes);
+      cJSON_AddItemToObject(phases, PHASE_NAMES[phase], counts);
+    }
+
+    cJSON_AddItemToObject(json, "allocations", phases);
+    return json;
+  }
+
+  /**
+   * {"options": {...}, "results": [...]}, compared by compare()
+   */
+  cJSON* to_json() const {
+    cJSON* json = cJSON_CreateObject();
+    cJSON* options = cJSON_CreateObject();
+    cJSON_AddNumberToObject(options, "warm_up", _options.warm_up);
+    cJSON_AddNumberToObject(options, "repetitions", _options.repetitions);
+    cJSON_AddNumberToObject(options, "min_repetition_ms",
+                            _options.min_repetition_ms);
+    cJSON_AddStringToObject(options, "filter", _options.filter.c_str());
+    cJSON_AddItemToObject(json, "options", options);
+
+    cJSON* results = cJSON_CreateArray();
+    for (const Measurement& measurement : _measurements) {
+      cJSON_AddItemToArray(results, to_json(measurement));
+    }
+
+    cJSON_AddItemToObject(json, "results", results);
+    return json;
+  }
+
+  /**
+   * Prints the change of the median (p99 and instructions too) of every
+   *  pair also found in the output of a previous run, and of its
+   *  allocations when they changed
+   */
+  void compare(FILE* out, cJSON* baseline) const {
+    cJSON* results = cJSON_GetObjectItem(baseline, "results");
+    for (const Measurement& measurement : _measurements) {
+      for (cJSON* old = results ? results->child : nullptr;
+           old != nullptr; old = old->next) {
+        cJSON* scenario = cJSON_GetObjectItem(old, "scenario");
+        cJSON* engine = cJSON_GetObjectItem(old, "engine");
+        cJSON* ns = cJSON_GetObjectItem(old, "ns_per_doc");
+        cJSON* median = ns ? cJSON_GetObjectItem(ns, "median") : nullptr;
+        if (scenario == nullptr || engine == nullptr || median == nullptr ||
+            measurement.corpus.scenario != scenario->valuestring ||
+            measurement.engine != engine->valuestring) {
+          continue;
+        }
+
+        double now = percentile(measurement.ns_per_doc, 0.5);
+        fprintf(out, "%-28s %-10s %12.0f -> %12.0f ns/doc %+7.1f%%",
+                scenario->valuestring, engine->valuestring,
+                median->valuedouble, now,
+                (now / median->valuedouble - 1) * 100);
+
+        cJSON* latencies = cJSON_GetObjectItem(old, "latency_ns");
+        cJSON* percentiles = latencies ? cJSON_GetObjectItem(latencies,
+                                                             "percentiles")
+                                       : nullptr;
+        cJSON* p99 = percentiles ? cJSON_GetObjectItem(percentiles, "99")
+                                 : nullptr;
+        if (p99 != nullptr) {
+          fprintf(out, ", p99 %.0f -> %" PRIu64 " ns", p99->valuedouble,
+                  measurement.latencies->value_at_percentile(99));
+        }
+
+        cJSON* counters = cJSON_GetObjectItem(old, "counters_per_doc");
+        cJSON* instructions = counters ? cJSON_GetObjectItem(
+            counters, HARDWARE_EVENT_NAMES[INSTRUCTIONS]) : nullptr;
+        if (instructions != nullptr &&
+            measurement.hardware.measured[INSTRUCTIONS]) {
+          fprintf(out, ", instructions %.0f -> %.0f",
+                  instructions->valuedouble,
+                  measurement.hardware.counts[INSTRUCTIONS]);
+        }
+
+        fprintf(out, "\n");
+
+        cJSON* allocations = cJSON_GetObjectItem(old, "allocations");
+        for (int phase = PARSE; allocations != nullptr && phase < PHASES;
+             ++phase) {
+          cJSON* counts = cJSON_GetObjectItem(allocations, PHASE_NAMES[phase]);
+          cJSON* count = counts ? cJSON_GetObjectItem(counts,
+                                                      "allocations_per_doc")
+                                : nullptr;
+          const Allocations& counted = measurement.allocations[phase];
+          double now_count = counted.allocations_per_doc;
+          if (counted.measured && count != nullptr &&
+              count->valuedouble != now_count) {
+            fprintf(out, "%-39s %s allocations/doc %.1f -> %.1f\n", "",
+                    PHASE_NAMES[phase], count->valuedouble, now_count);
+          }
+        }
+      }
+    }
+  }
+};
+
+}  // namespace benchmark
+
+#endif
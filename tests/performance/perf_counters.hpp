@@ -0,0 +1,174 @@
+#ifndef CJSON_VALIDATOR_PERF_COUNTERS_HPP
+#define CJSON_VALIDATOR_PERF_COUNTERS_HPP
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace benchmark {
+
+using std::string;
+
+enum Hardware_event {
+  INSTRUCTIONS, CYCLES, CACHE_REFERENCES, CACHE_MISSES, L1D_READ_MISSES,
+  BRANCH_MISSES, PAGE_FAULTS, HARDWARE_EVENTS
+};
+
+static const char* const HARDWARE_EVENT_NAMES[HARDWARE_EVENTS] = {
+  "instructions", "cycles", "cache_references", "cache_misses",
+  "l1d_read_misses", "branch_misses", "page_faults"
+};
+
+/**
+ * Counts of the events the kernel could count (not every PMU has every
+ * event, and virtual machines often have none), scaled up when the kernel
+ * had to multiplex them
+ */
+struct Hardware_counts {
+  bool measured[HARDWARE_EVENTS];
+  double counts[HARDWARE_EVENTS];
+};
+
+/**
+ * Linux perf_event_open counters of the calling thread, user space only:
+ *
+ *  Perf_counters counters;
+ *  counters.start();
+ *  ...
+ *  Hardware_counts counts = counters.stop();
+ *
+ * Events that can't be opened (no PMU, perf_event_paranoid, seccomp, not
+ * Linux) are left out; when none can, available() is false, reason() says
+ * why and stop() measures nothing.
+ */
+class Perf_counters {
+  int _fds[HARDWARE_EVENTS];
+  string _reason;
+
+#ifdef __linux__
+  static int open_event(uint32_t type, uint64_t config) {
+    perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = type;
+    attributes.config = config;
+    attributes.disabled = 1;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                             PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attributes, 0, -1, -1,
+                   PERF_FLAG_FD_CLOEXEC);
+  }
+#endif
+
+  public:
+  Perf_counters() {
+    for (int event = 0; event < HARDWARE_EVENTS; ++event) {
+      _fds[event] = -1;
+    }
+
+#ifdef __linux__
+    static const uint32_t types[HARDWARE_EVENTS] = {
+      PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+      PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE,
+      PERF_TYPE_SOFTWARE
+    };
+    static const uint64_t configs[HARDWARE_EVENTS] = {
+      PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_CACHE_REFERENCES, PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+      PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_SW_PAGE_FAULTS
+    };
+    for (int event = 0; event < HARDWARE_EVENTS; ++event) {
+      _fds[event] = open_event(types[event], configs[event]);
+      if (_fds[event] < 0 && _reason.empty()) {
+        _reason = string(HARDWARE_EVENT_NAMES[event]) + ": " +
+                  strerror(errno);
+      }
+    }
+#else
+    _reason = "perf_event_open is Linux only";
+#endif
+  }
+
+  Perf_counters(const Perf_counters&) = delete;
+  Perf_counters& operator=(const Perf_counters&) = delete;
+
+  ~Perf_counters() {
+#ifdef __linux__
+    for (int event = 0; event < HARDWARE_EVENTS; ++event) {
+      if (_fds[event] >= 0) {
+        close(_fds[event]);
+      }
+    }
+#endif
+  }
+
+  bool available() const {
+    for (int event = 0; event < HARDWARE_EVENTS; ++event) {
+      if (_fds[event] >= 0) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  /**
+   * Why the first missing event is missing, empty when none is
+   */
+  const string& reason() const {
+    return _reason;
+  }
+
+  void start() {
+#ifdef __linux__
+    for (int event = 0; event < HARDWARE_EVENTS; ++event) {
+      if (_fds[event] >= 0) {
+        ioctl(_fds[event], PERF_EVENT_IOC_RESET, 0);
+        ioctl(_fds[event], PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+
+  /**
+   * Counts since start()
+   */
+  Hardware_counts stop() {
+    Hardware_counts counts = {{false}, {0}};
+#ifdef __linux__
+    for (int event = 0; event < HARDWARE_EVENTS; ++event) {
+      if (_fds[event] >= 0) {
+        ioctl(_fds[event], PERF_EVENT_IOC_DISABLE, 0);
+      }
+    }
+
+    for (int event = 0; event < HARDWARE_EVENTS; ++event) {
+      uint64_t values[3];     //  value, time enabled, time running
+      if (_fds[event] < 0 ||
+          read(_fds[event], values, sizeof(values)) != sizeof(values)) {
+        continue;
+      }
+
+      counts.measured[event] = true;
+      counts.counts[event] = values[2] == 0 ? 0 :
+          static_cast<double>(values[0]) * values[1] / values[2];
+    }
+#endif
+    return counts;
+  }
+};
+
+}  // namespace benchmark
+
+#endif
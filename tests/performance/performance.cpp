@@ -1,7 +1,15 @@
 #include <iostream>
 #include <chrono>
+#include <fstream>
+#include <vector>
+#include <unistd.h>
 
 #include "json_validator.hpp"
+#include "batch_validator.hpp"
+#include "schema_compiler.hpp"
+#include "validation_cache.hpp"
+#include "validated_document.hpp"
+#include "performance_validator.hpp"
 
 using namespace std;
 using namespace json_validator;
@@ -96,5 +104,311 @@ int main() {
   auto result = validator.validate(apt2);
   cout << "invald json error: " << result->message() << endl;
 
+  // Same validator described as a json-schema
+  const string json_schema = "{ \"type\": \"object\", \"properties\": { \
+      \"anIntArray\": {\"type\": \"array\", \"items\": {\"type\": \"array\", \"minItems\": 2, \"maxItems\": 2, \"items\": {\"type\": \"integer\", \"minimum\": 0}}}, \
+      \"andIntValue\": {\"type\": \"integer\", \"minimum\": 0, \"maximum\": 200}, \
+      \"anotherIntValue\": {\"type\": \"integer\", \"minimum\": 0, \"maximum\": 100}, \
+      \"aString\": {\"type\": \"string\", \"enum\": [\"yes\", \"no\", \"both\"], \"default\": \"yes\"}, \
+      \"aBoolean\": {\"type\": \"boolean\", \"default\": false}, \
+      \"anotherBoolean\": {\"type\": \"boolean\", \"default\": false}, \
+      \"yetAnotherInt\": {\"type\": \"integer\", \"minimum\": 1, \"maximum\": 1000, \"default\": 12}, \
+      \"yetAnotherBoolean\": {\"type\": \"boolean\", \"default\": false}, \
+      \"yetAnotherAnotherBoolean\": {\"type\": \"boolean\", \"default\": false}, \
+      \"stringArray\": {\"type\": \"array\", \"uniqueItems\": true, \"items\": {\"type\": \"string\", \"enum\": [\"stringArrayValidValue1\", \"stringArrayValidValue2\", \"stringArrayValidValue3\"]}}, \
+      \"anotherStringArray\": {\"type\": \"array\", \"uniqueItems\": true, \"items\": {\"type\": \"string\", \"enum\": [\"impression\", \"click\", \"install\", \"fetch\"]}}, \
+      \"stringArrayValidValue1\": {\"type\": \"object\", \"properties\": { \
+        \"type\": {\"type\": \"string\", \"enum\": [\"OR\", \"AND\", \"NOT\", \"ORNOT\"]}, \
+        \"dimensionValues\": {\"type\": \"array\", \"items\": {\"type\": \"string\", \"enum\": [\"banner\", \"video\"]}}}} \
+    }, \"required\": [\"anIntArray\"] \
+  }";
+
+  int number_of_schemas = 500;
+  auto start3 = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < number_of_schemas; i++) {
+    auto loaded_validator = Schema_loader<CJSON_adapter>::load(json_schema);
+  }
+
+  using TimeUs = std::chrono::microseconds;
+  auto duration3 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start3);
+  cout << duration3.count() / 1000.0 << " ms to load " << number_of_schemas << " json-schemas" << endl;
+
+  // Startup with many tenant schemas: builder validators vs mmap'ed compiled bundle
+  int number_of_tenants = 10000;
+  vector<string> tenant_schemas;
+  const string properties = "\"properties\": {";
+  for (int i = 0; i < number_of_tenants; i++) {
+    string tenant_schema = json_schema;
+    tenant_schema.insert(tenant_schema.find(properties) + properties.size(),
+      "\"tenant\": {\"type\": \"integer\", \"maximum\": " + std::to_string(i) + "},");
+    tenant_schemas.push_back(tenant_schema);
+  }
+
+  Schema_bundle_writer bundle_writer;
+  for (int i = 0; i < number_of_tenants; i++) {
+    bundle_writer.add("tenant" + std::to_string(i), Schema_compiler::compile(tenant_schemas[i]));
+  }
+
+  const string bundle_path = "/tmp/json_validator_performance_bundle.bin";
+  {
+    string bundle_blob = bundle_writer.write();
+    std::ofstream bundle_file(bundle_path, std::ios::binary);
+    bundle_file.write(bundle_blob.data(), bundle_blob.size());
+  }
+
+  auto start4 = std::chrono::steady_clock::now();
+  {
+    vector<Schema_loader<CJSON_adapter>::Validator_ptr> validators;
+    for (int i = 0; i < number_of_tenants; i++) {
+      validators.push_back(Schema_loader<CJSON_adapter>::load(tenant_schemas[i]));
+    }
+
+    auto duration4 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start4);
+    cout << duration4.count() / 1000.0 << " ms to start " << number_of_tenants << " schemas from json-schema (builder validators)" << endl;
+  }
+
+  auto start5 = std::chrono::steady_clock::now();
+  {
+    Mapped_schema_file bundle_file(bundle_path);
+    Schema_bundle bundle = bundle_file.bundle();
+    bool all_valid = true;
+    for (int i = 0; i < number_of_tenants; i++) {
+      Compiled_schema tenant = bundle.find(("tenant" + std::to_string(i)).c_str());
+      all_valid &= tenant.header().node_count > 0;
+    }
+
+    auto duration5 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start5);
+    cout << duration5.count() / 1000.0 << " ms to start " << number_of_tenants << " schemas from an mmap'ed compiled bundle (" << all_valid << ")" << endl;
+
+    Compiled_schema compiled = bundle.find("tenant200");
+    Compiled_schema_stack<CJSON_adapter> stack;
+    auto start6 = std::chrono::steady_clock::now();
+    for (int i = 0; i < number_of_validations; i++) {
+      auto compiled_result = compiled.validate(apt, &stack);
+    }
+
+    auto duration6 = std::chrono::duration_cast<TimeT>(std::chrono::steady_clock::now() - start6);
+    cout << duration6.count() << " ms to validate a valid valid_json " << number_of_validations << " times with a compiled schema" << endl;
+  }
+
+  unlink(bundle_path.c_str());
+
+  // Code generated by schema_codegen from schemas/performance.json (same rules)
+  auto start7 = std::chrono::steady_clock::now();
+  for (int i = 0; i < number_of_validations; i++) {
+    auto generated_result = generated::Performance_validator::validate(root.get());
+  }
+
+  auto duration7 = std::chrono::duration_cast<TimeT>(std::chrono::steady_clock::now() - start7);
+  cout << duration7.count() << " ms to validate a valid valid_json " << number_of_validations << " times with generated code" << endl;
+
+  auto start8 = std::chrono::steady_clock::now();
+  int generated_valid = 0;
+  for (int i = 0; i < number_of_validations; i++) {
+    generated_valid += generated::Performance_validator::is_valid(root.get());
+  }
+
+  auto duration8 = std::chrono::duration_cast<TimeT>(std::chrono::steady_clock::now() - start8);
+  cout << duration8.count() << " ms to validate a valid valid_json " << number_of_validations << " times with generated code (is_valid, " << generated_valid << " valid)" << endl;
+
+  auto start9 = std::chrono::steady_clock::now();
+  for (int i = 0; i < number_of_validations; i++) {
+    auto generated_result = generated::Performance_validator::validate(root2.get());
+  }
+
+  auto duration9 = std::chrono::duration_cast<TimeT>(std::chrono::steady_clock::now() - start9);
+  cout << duration9.count() << " ms to validate an invalid_valid_json " << number_of_validations << " times with generated code: "
+       << generated::Performance_validator::validate(root2.get())->message() << endl;
+
+  // Raw payloads where 70% repeat one of 50 templates (retries, heartbeats)
+  vector<string> payloads;
+  for (int i = 0; i < number_of_validations; i++) {
+    int variant = i % 10 < 7 ? i % 50 : 1000 + i;
+    string payload = (i % 20 == 0) ? invalid_valid_json : valid_json;
+    payload.insert(1, "\"tenant\": " + std::to_string(variant) + ",");
+    payloads.push_back(payload);
+  }
+
+  const string payload_blob = Schema_compiler::compile(json_schema);
+  Compiled_schema payload_schema(payload_blob);
+  auto parse_and_validate = [&](const char* data, size_t) {
+    Compiled_schema_stack<CJSON_adapter> payload_stack;
+    cJSON_ptr payload_root(cJSON_Parse(data), cJSON_Delete);
+    return payload_root != nullptr && payload_schema.validate(CJSON_adapter(payload_root.get()), &payload_stack)->success();
+  };
+
+  auto start10 = std::chrono::steady_clock::now();
+  int uncached_valid = 0;
+  for (const auto& payload : payloads) {
+    uncached_valid += parse_and_validate(payload.data(), payload.size());
+  }
+
+  auto duration10 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start10);
+  cout << duration10.count() / 1000.0 << " ms to parse and validate " << number_of_validations << " raw payloads (" << uncached_valid << " valid)" << endl;
+
+  Validation_cache cache(1 << 16);
+  const auto payload_identity = Document_hash::schema(payload_blob);
+  auto start11 = std::chrono::steady_clock::now();
+  int cached_valid = 0;
+  for (const auto& payload : payloads) {
+    cached_valid += cache.validate(payload.data(), payload.size(), payload_identity, parse_and_validate);
+  }
+
+  auto duration11 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start11);
+  auto cache_statistics = cache.statistics();
+  cout << duration11.count() / 1000.0 << " ms to validate " << number_of_validations << " raw payloads with a validation cache ("
+       << cached_valid << " valid, " << cache_statistics.hit_rate() * 100 << "% hit rate, "
+       << (duration10.count() - duration11.count()) / 1000.0 << " ms saved)" << endl;
+
+  // The same payloads already parsed: one validate() per document vs validate_batch()
+  vector<cJSON_ptr> parsed_payloads;
+  vector<CJSON_adapter> batch_documents;
+  for (const auto& payload : payloads) {
+    parsed_payloads.emplace_back(cJSON_Parse(payload.c_str()), cJSON_Delete);
+    batch_documents.emplace_back(parsed_payloads.back().get());
+  }
+
+  auto start12 = std::chrono::steady_clock::now();
+  int single_valid = 0;
+  for (const auto& document : batch_documents) {
+    single_valid += validator.validate(document)->success();
+  }
+
+  auto duration12 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start12);
+  cout << duration12.count() / 1000.0 << " ms to validate " << batch_documents.size() << " documents one by one (" << single_valid << " valid)" << endl;
+
+  Batch_result batch_result;
+  for (size_t threads : {1, 4}) {
+    Batch_validator<CJSON_adapter> builder_batch(&validator, threads);
+    auto start13 = std::chrono::steady_clock::now();
+    builder_batch.validate_batch(batch_documents.data(), batch_documents.size(), &batch_result);
+    auto duration13 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start13);
+    cout << duration13.count() / 1000.0 << " ms to validate " << batch_documents.size() << " documents with validate_batch ("
+         << threads << " threads, " << batch_result.passed_count() << " valid)" << endl;
+  }
+
+  for (size_t threads : {1, 4}) {
+    Batch_validator<CJSON_adapter> compiled_batch(&payload_schema, threads);
+    auto start14 = std::chrono::steady_clock::now();
+    compiled_batch.validate_batch(batch_documents.data(), batch_documents.size(), &batch_result);
+    auto duration14 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start14);
+    cout << duration14.count() / 1000.0 << " ms to validate " << batch_documents.size() << " documents with validate_batch and a compiled schema ("
+         << threads << " threads, " << batch_result.passed_count() << " valid)" << endl;
+  }
+
+  // One large document: four keys holding big arrays of objects, validated sequentially and by subtree in parallel
+  auto large_validator = [](Work_stealing_pool* pool) {
+    auto object = new Object_validator({});
+    for (const char* key : {"a", "b", "c", "d"}) {
+      object->add_validator(key, (new Array_validator())->items(new Object_validator({
+        {"id", (new Int_validator())->min_value(0)->required(true)},
+        {"kind", (new String_validator())->valid({"impression", "click", "install", "fetch"})},
+        {"tags", (new Array_validator())->unique(true)->items(new String_validator())}
+      })));
+    }
+
+    if (pool != nullptr) {
+      object->parallel(pool);
+    }
+
+    return unique_ptr<Object_validator>(object);
+  };
+
+  string large_json = "{\"small\": 1";
+  for (const char* key : {"a", "b", "c", "d"}) {
+    large_json += string(", \"") + key + "\": [";
+    for (int i = 0; i < 20000; i++) {
+      large_json += string(i == 0 ? "" : ",") + "{\"id\": " + std::to_string(i) + ", \"kind\": \"click\", \"tags\": [\"x\", \"y\"]}";
+    }
+
+    large_json += "]";
+  }
+
+  large_json += "}";
+  cJSON_ptr large_root(cJSON_Parse(large_json.c_str()), cJSON_Delete);
+  auto large_sequential = large_validator(nullptr);
+  auto start15 = std::chrono::steady_clock::now();
+  bool large_valid = true;
+  for (int i = 0; i < 10; i++) {
+    large_valid &= large_sequential->validate(CJSON_adapter(large_root.get()))->success();
+  }
+
+  auto duration15 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start15);
+  cout << duration15.count() / 10000.0 << " ms to validate a " << large_json.size() / 1000000.0 << " MB document (" << large_valid << ")" << endl;
+
+  Work_stealing_pool large_pool(Work_stealing_pool::hardware_threads() - 1);
+  auto large_parallel = large_validator(&large_pool);
+  auto start16 = std::chrono::steady_clock::now();
+  for (int i = 0; i < 10; i++) {
+    large_valid &= large_parallel->validate(CJSON_adapter(large_root.get()))->success();
+  }
+
+  auto duration16 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start16);
+  cout << duration16.count() / 10000.0 << " ms to validate it by subtree in parallel (" << Work_stealing_pool::hardware_threads()
+       << " hardware threads, " << large_valid << ")" << endl;
+
+  cJSON_ptr patches(cJSON_Parse("[{\"op\": \"replace\", \"path\": \"/c/15000/kind\", \"value\": \"fetch\"},"
+                                "{\"op\": \"add\", \"path\": \"/c/15000/tags/-\", \"value\": \"z\"}]"), cJSON_Delete);
+  cJSON_ptr undo(cJSON_Parse("[{\"op\": \"replace\", \"path\": \"/c/15000/kind\", \"value\": \"click\"},"
+                             "{\"op\": \"remove\", \"path\": \"/c/15000/tags/2\"}]"), cJSON_Delete);
+  auto start17 = std::chrono::steady_clock::now();
+  for (int i = 0; i < 10; i++) {
+    cJSONUtils_ApplyPatches(large_root.get(), i % 2 ? undo.get() : patches.get());
+    large_valid &= large_sequential->validate(CJSON_adapter(large_root.get()))->success();
+  }
+
+  auto duration17 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start17);
+  cout << duration17.count() / 10000.0 << " ms to patch it and validate it again (" << large_valid << ")" << endl;
+
+  Validated_document stored(large_sequential.get(), large_root.get());
+  auto start18 = std::chrono::steady_clock::now();
+  for (int i = 0; i < 10000; i++) {
+    large_valid &= stored.patch(i % 2 ? undo.get() : patches.get())->success();
+  }
+
+  auto duration18 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start18);
+  cout << duration18.count() / 10000.0 << " us to patch it and revalidate the touched paths (" << large_valid << ")" << endl;
+
+  // Rules repeating the same dimensionValues object (or all different ones), with and without memoisation
+  auto rules_validator = [](bool memoize) {
+    auto dimension_values = new Object_validator({});
+    for (const char* key : {"country", "region", "device", "os", "browser", "channel"}) {
+      dimension_values->add_validator(key, (new Array_validator())->unique(true)->items(new String_validator()));
+    }
+
+    return unique_ptr<Array_validator>((new Array_validator())->memoize(memoize)->items(new Object_validator({
+      {"id", (new Int_validator())->min_value(0)->required(true)},
+      {"dimensionValues", dimension_values}
+    })));
+  };
+
+  for (bool repeated : {true, false}) {
+    string rules_json = "[";
+    for (int i = 0; i < 5000; i++) {
+      string values = repeated ? "\"v1\", \"v2\", \"v3\", \"v4\"" : "\"w" + std::to_string(i) + "\", \"v2\", \"v3\", \"v4\"";
+      rules_json += string(i == 0 ? "" : ",") + "{\"id\": " + std::to_string(i) + ", \"dimensionValues\": {";
+      for (const char* key : {"country", "region", "device", "os", "browser", "channel"}) {
+        rules_json += string(key[0] == 'c' && key[1] == 'o' ? "" : ",") + "\"" + key + "\": [" + values + "]";
+      }
+
+      rules_json += "}}";
+    }
+
+    cJSON_ptr rules_root(cJSON_Parse((rules_json + "]").c_str()), cJSON_Delete);
+    for (bool memoize : {false, true}) {
+      auto rules = rules_validator(memoize);
+      bool rules_valid = true;
+      auto start19 = std::chrono::steady_clock::now();
+      for (int i = 0; i < 20; i++) {
+        rules_valid &= rules->validate(CJSON_adapter(rules_root.get()))->success();
+      }
+
+      auto duration19 = std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start19);
+      cout << duration19.count() / 20000.0 << " ms to validate 5000 rules with " << (repeated ? "the same" : "distinct")
+           << " dimensionValues" << (memoize ? ", memoized (" : " (") << rules_valid << ")" << endl;
+    }
+  }
+
   return 0;
 }
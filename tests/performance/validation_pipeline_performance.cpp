@@ -0,0 +1,134 @@
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "schema_compiler.hpp"
+#include "validation_pipeline.hpp"
+#include "work_stealing_pool.hpp"
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using Clock = std::chrono::steady_clock;
+
+static const char* schema_json =
+  "{\"type\": \"object\", \"required\": [\"id\", \"events\"], \"properties\": {"
+  "\"id\": {\"type\": \"integer\", \"minimum\": 0},"
+  "\"tenant\": {\"type\": \"string\", \"enum\": [\"a\", \"b\", \"c\"]},"
+  "\"events\": {\"type\": \"array\", \"maxItems\": 16, \"items\": {"
+  "\"type\": \"object\", \"required\": [\"kind\"], \"properties\": {"
+  "\"kind\": {\"type\": \"string\", \"enum\": [\"click\", \"view\", \"install\"]},"
+  "\"count\": {\"type\": \"integer\", \"minimum\": 0, \"maximum\": 1000}}}}}}";
+
+static string payload(size_t i) {
+  string events;
+  for (size_t e = 0; e < 8; ++e) {
+    events += string(e == 0 ? "" : ",") + "{\"kind\": \"" + (e % 2 ? "view" : "click") + "\", \"count\": " +
+              to_string((i + e) % (i % 20 == 0 ? 2000 : 1000)) + "}";
+  }
+
+  return "{\"id\": " + to_string(i) + ", \"tenant\": \"b\", \"events\": [" + events + "]}";
+}
+
+static int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+static int64_t percentile(vector<int64_t> values, double fraction) {
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, (size_t)(fraction * values.size()))];
+}
+
+/**
+ * Saturated throughput and latency percentiles under bursts of 'burst' payloads separated by 'pause_us'
+ */
+static void run(const Compiled_schema& schema, const vector<string>& payloads, Validation_pipeline::Options options,
+                size_t burst, int pause_us) {
+  vector<int64_t> submitted(payloads.size());
+  vector<int64_t> latencies(payloads.size());
+  size_t valid = 0;
+
+  // Saturated: everything submitted back to back
+  int64_t start = now_ns();
+  {
+    Validation_pipeline pipeline(&schema, [&](Pipeline_record* record) { valid += record->result->success(); }, options);
+    for (size_t i = 0; i < payloads.size(); ++i) {
+      pipeline.submit(i, payloads[i]);
+    }
+  }
+
+  double seconds = (now_ns() - start) / 1e9;
+
+  // Bursty: the sink records each payload's latency
+  Validation_pipeline::Statistics statistics;
+  {
+    Validation_pipeline pipeline(&schema, [&](Pipeline_record* record) {
+      latencies[record->id] = now_ns() - submitted[record->id];
+    }, options);
+
+    for (size_t i = 0; i < payloads.size(); ++i) {
+      if (i % burst == 0 && i != 0) {
+        std::this_thread::sleep_for(std::chrono::microseconds(pause_us));
+      }
+
+      submitted[i] = now_ns();
+      pipeline.submit(i, payloads[i]);
+    }
+
+    pipeline.finish();
+    statistics = pipeline.statistics();
+  }
+
+  cout << options.parse_threads << " parse / " << options.validate_threads << " validate threads, batches of "
+       << options.batch_size << ", queues of " << options.queue_capacity << ": " << payloads.size() / seconds / 1000
+       << " k docs/s saturated (" << valid << " valid); bursts of " << burst << ": p50 " << percentile(latencies, 0.5) / 1000.0 << " us, p99 "
+       << percentile(latencies, 0.99) / 1000.0 << " us, max " << percentile(latencies, 1.0) / 1000.0
+       << " us (stalls: " << statistics.submit_stalls << " submit, " << statistics.parse_stalls << " parse, "
+       << statistics.validate_stalls << " validate)" << endl;
+}
+
+int main() {
+  size_t threads = Work_stealing_pool::hardware_threads();
+  cout << threads << " hardware threads" << endl;
+
+  const string blob = Schema_compiler::compile(schema_json);
+  Compiled_schema schema(blob);
+
+  vector<string> payloads;
+  for (size_t i = 0; i < 100000; ++i) {
+    payloads.push_back(payload(i));
+  }
+
+  // Baseline: parse and validate inline in the submitting thread
+  Compiled_schema_stack<CJSON_adapter> stack;
+  size_t valid = 0;
+  int64_t start = now_ns();
+  for (const auto& data : payloads) {
+    cJSON* document = cJSON_Parse(data.c_str());
+    valid += schema.validate(CJSON_adapter(document), &stack)->success();
+    cJSON_Delete(document);
+  }
+
+  cout << "inline: " << payloads.size() / ((now_ns() - start) / 1e9) / 1000 << " k docs/s (" << valid << " valid)" << endl;
+
+  vector<size_t> stage_threads = {1, 2};
+  if (threads / 2 > 2) {
+    stage_threads.push_back(threads / 2);
+  }
+
+  for (size_t stage : stage_threads) {
+    // Latency grows with the records in flight (batch_size * queue_capacity)
+    for (auto shape : vector<pair<size_t, size_t>>{{1, 64}, {32, 4}, {32, 64}}) {
+      Validation_pipeline::Options options;
+      options.parse_threads = stage;
+      options.validate_threads = stage;
+      options.batch_size = shape.first;
+      options.queue_capacity = shape.second;
+      run(schema, payloads, options, 2000, 5000);
+    }
+  }
+
+  return 0;
+}
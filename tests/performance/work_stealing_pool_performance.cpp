@@ -0,0 +1,127 @@
+#include <iostream>
+#include <chrono>
+#include <atomic>
+#include <vector>
+
+#include "work_stealing_pool.hpp"
+
+using namespace std;
+using namespace json_validator;
+using TimeUs = std::chrono::microseconds;
+using Task_group = Work_stealing_pool::Task_group;
+
+/**
+ * Busy work that the compiler can't remove
+ */
+static uint64_t spin(uint64_t iterations) {
+  volatile uint64_t value = 0;
+  for (uint64_t i = 0; i < iterations; ++i) {
+    value = value + i;
+  }
+
+  return value;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<TimeUs>(std::chrono::steady_clock::now() - start).count() / 1000.0;
+}
+
+int main() {
+  size_t threads = Work_stealing_pool::hardware_threads();
+  cout << threads << " hardware threads" << endl;
+
+  vector<size_t> pool_sizes = {0, 3};
+  if (threads - 1 != 0 && threads - 1 != 3) {
+    pool_sizes.push_back(threads - 1);
+  }
+
+  for (size_t workers : pool_sizes) {
+    Work_stealing_pool pool(workers);
+
+    // Spawn overhead: empty tasks spawned by an external thread (injection queue)
+    int number_of_tasks = 1000000;
+    auto start1 = std::chrono::steady_clock::now();
+    {
+      Task_group group(&pool);
+      for (int i = 0; i < number_of_tasks; i++) {
+        group.spawn([]() { });
+      }
+
+      group.wait();
+    }
+
+    double duration1 = elapsed_ms(start1);
+    cout << workers << " workers: " << duration1 * 1e6 / number_of_tasks << " ns per empty task spawned by an external thread" << endl;
+
+    // Spawn overhead: empty tasks spawned by a worker (its own deque)
+    auto start2 = std::chrono::steady_clock::now();
+    {
+      Task_group outer(&pool);
+      outer.spawn([&]() {
+        Task_group group(&pool);
+        for (int i = 0; i < number_of_tasks; i++) {
+          group.spawn([]() { });
+        }
+
+        group.wait();
+      });
+      outer.wait();
+    }
+
+    double duration2 = elapsed_ms(start2);
+    cout << workers << " workers: " << duration2 * 1e6 / number_of_tasks << " ns per empty task spawned by a task" << endl;
+
+    // Skewed work: 1% of the items hold 50% of the work; one task spawns them all
+    int number_of_items = 20000;
+    vector<uint64_t> costs;
+    for (int i = 0; i < number_of_items; i++) {
+      costs.push_back(i % 100 == 0 ? 10000 : 100);
+    }
+
+    auto start3 = std::chrono::steady_clock::now();
+    uint64_t sequential = 0;
+    for (auto cost : costs) {
+      sequential += spin(cost);
+    }
+
+    double duration3 = elapsed_ms(start3);
+
+    auto before = pool.statistics();
+    std::atomic<uint64_t> parallel(0);
+    auto start4 = std::chrono::steady_clock::now();
+    {
+      Task_group outer(&pool);
+      outer.spawn([&]() {
+        Task_group group(&pool);
+        for (auto cost : costs) {
+          group.spawn([&parallel, cost]() { parallel += spin(cost); });
+        }
+
+        group.wait();
+      });
+      outer.wait();
+    }
+
+    double duration4 = elapsed_ms(start4);
+    auto after = pool.statistics();
+    cout << workers << " workers: skewed work " << duration3 << " ms sequential, " << duration4 << " ms with the pool ("
+         << after.stolen - before.stolen << " of " << after.executed - before.executed << " tasks stolen, "
+         << after.external - before.external << " run by the waiting thread, " << (sequential == parallel) << ")" << endl;
+
+    // parallel_for over the same items
+    std::atomic<uint64_t> ranged(0);
+    auto start5 = std::chrono::steady_clock::now();
+    pool.parallel_for(0, costs.size(), 64, [&](size_t first, size_t last) {
+      uint64_t sum = 0;
+      for (size_t i = first; i < last; i++) {
+        sum += spin(costs[i]);
+      }
+
+      ranged += sum;
+    });
+
+    cout << workers << " workers: skewed work " << elapsed_ms(start5) << " ms with parallel_for (" << (sequential == ranged) << ")" << endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,177 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/batch_validator.hpp"
+#include "../lib/schema_compiler.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Array_validator = Array_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+using String_validator = String_validator<CJSON_adapter>;
+
+static const char* batch_schema =
+  "{\"type\": \"object\", \"required\": [\"id\"], \"properties\": {"
+  "\"id\": {\"type\": \"integer\", \"minimum\": 0, \"maximum\": 1000},"
+  "\"kind\": {\"type\": \"string\", \"enum\": [\"a\", \"b\"]},"
+  "\"tags\": {\"type\": \"array\", \"uniqueItems\": true,"
+  "\"items\": {\"type\": \"string\"}}}}";
+
+static Object_validator* batch_validator() {
+  return new Object_validator({
+    {"id", (new Int_validator())->min_value(0)->max_value(1000)
+                                ->required(true)},
+    {"kind", (new String_validator())->valid({"a", "b"})},
+    {"tags", (new Array_validator())->unique(true)
+                                    ->items(new String_validator())}
+  });
+}
+
+/**
+ * Document i is valid unless i % 7 == 0; the failure reason depends on i
+ */
+static string batch_document(size_t i) {
+  if (i % 7 != 0) {
+    return "{\"id\": " + to_string(i % 1000) + ", \"kind\": \"a\","
+           "\"tags\": [\"x\", \"y\"]}";
+  }
+
+  switch (i % 5) {
+    case 0:
+      return "{\"id\": 1001}";
+    case 1:
+      return "{\"kind\": \"a\"}";
+    case 2:
+      return "{\"id\": 1, \"kind\": \"c\"}";
+    case 3:
+      return "{\"id\": 1, \"tags\": [\"x\", \"x\"]}";
+    default:
+      return "{\"id\": \"1\"}";
+  }
+}
+
+static Validation_error_code batch_code(size_t i) {
+  if (i % 7 != 0) {
+    return VALIDATION_OK;
+  }
+
+  const Validation_error_code codes[] = {
+    VALIDATION_ABOVE_MAXIMUM, VALIDATION_REQUIRED, VALIDATION_NOT_ALLOWED,
+    VALIDATION_DUPLICATED_ITEM, VALIDATION_WRONG_TYPE
+  };
+  return codes[i % 5];
+}
+
+class BATCH_VALIDATOR : public ::testing::Test {
+  protected:
+  vector<cJSON_ptr> _roots;
+  vector<CJSON_adapter> _documents;
+
+  void SetUp() override {
+    for (size_t i = 0; i < 3000; ++i) {
+      _roots.emplace_back(cJSON_Parse(batch_document(i).c_str()),
+                          cJSON_Delete);
+      _documents.emplace_back(_roots.back().get());
+    }
+  }
+
+  void expect_verdicts(const Batch_result& result, bool kept_failures) {
+    ASSERT_EQ(_documents.size(), result.size());
+    size_t failures = 0;
+    for (size_t i = 0; i < result.size(); ++i) {
+      EXPECT_EQ(i % 7 != 0, result.passed(i)) << i;
+      EXPECT_EQ(batch_code(i), result.code(i)) << i;
+      if (kept_failures && i % 7 == 0) {
+        ASSERT_NE(nullptr, result.failure(i));
+        EXPECT_EQ(batch_code(i), result.failure(i)->code());
+      } else {
+        EXPECT_EQ(nullptr, result.failure(i));
+      }
+
+      failures += i % 7 == 0;
+    }
+
+    EXPECT_EQ(result.size() - failures, result.passed_count());
+  }
+};
+
+TEST_F(BATCH_VALIDATOR, BUILDER_VALIDATOR) {
+  unique_ptr<Object_validator> validator(batch_validator());
+  for (size_t threads : {1, 4}) {
+    Batch_validator<CJSON_adapter> batch(validator.get(), threads);
+    expect_verdicts(batch.validate_batch(_documents), false);
+    expect_verdicts(batch.validate_batch(_documents, true), true);
+  }
+}
+
+TEST_F(BATCH_VALIDATOR, COMPILED_SCHEMA) {
+  const string blob = Schema_compiler::compile(batch_schema);
+  Compiled_schema schema(blob);
+  for (size_t threads : {1, 3, 8}) {
+    Batch_validator<CJSON_adapter> batch(&schema, threads);
+    expect_verdicts(batch.validate_batch(_documents), false);
+    expect_verdicts(batch.validate_batch(_documents, true), true);
+  }
+}
+
+TEST_F(BATCH_VALIDATOR, SAME_RESULTS_AS_VALIDATE) {
+  unique_ptr<Object_validator> validator(batch_validator());
+  Batch_validator<CJSON_adapter> batch(validator.get(), 4);
+  Batch_result result;
+  batch.validate_batch(_documents.data(), _documents.size(), &result, true);
+
+  for (size_t i = 0; i < _documents.size(); i += 7) {
+    auto expected = validator->validate(_documents[i]);
+    EXPECT_EQ(expected->message(), result.failure(i)->message());
+  }
+
+  //  The result is reused by the next batch
+  batch.validate_batch(_documents.data(), 10, &result);
+  EXPECT_EQ(10u, result.size());
+  EXPECT_EQ(8u, result.passed_count());
+  EXPECT_EQ(nullptr, result.failure(0));
+
+  batch.validate_batch(_documents.data(), 0, &result);
+  EXPECT_EQ(0u, result.size());
+}
+
+TEST_F(BATCH_VALIDATOR, SHARED_BUILDER_VALIDATOR) {
+  unique_ptr<Object_validator> validator(batch_validator());
+  vector<std::thread> threads;
+  vector<Batch_result> results(4);
+  for (size_t t = 0; t < results.size(); ++t) {
+    threads.emplace_back([&, t]() {
+      Batch_validator<CJSON_adapter> batch(validator.get(), 2);
+      batch.validate_batch(_documents.data(), _documents.size(),
+                           &results[t]);
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (auto& result : results) {
+    expect_verdicts(result, false);
+  }
+}
+
+#if JSON_VALIDATOR_EXCEPTIONS
+TEST(BATCH_VALIDATOR_ERRORS, ZERO_THREADS) {
+  unique_ptr<Object_validator> validator(batch_validator());
+  EXPECT_THROW((Batch_validator<CJSON_adapter>(validator.get(), 0)),
+               std::invalid_argument);
+}
+#endif
+}  // namespace unit_tests
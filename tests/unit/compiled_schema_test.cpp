@@ -0,0 +1,283 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/schema_compiler.hpp"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Schema_loader = Schema_loader<CJSON_adapter>;
+
+const string schema = "{"
+  "\"type\": \"object\","
+  "\"properties\": {"
+    "\"anInt\": {\"type\": \"integer\", \"minimum\": 0, \"maximum\": 60},"
+    "\"aNumber\": {\"type\": \"integer\", \"enum\": [5, 1, 3]},"
+    "\"aString\": {\"type\": \"string\", \"enum\": [\"yes\", \"no\"],"
+                  "\"maxLength\": 3, \"default\": \"no\"},"
+    "\"aBool\": {\"type\": \"boolean\", \"enum\": [true]},"
+    "\"anArray\": {\"type\": \"array\", \"minItems\": 1, \"maxItems\": 3,"
+                  "\"uniqueItems\": true,"
+                  "\"items\": {\"type\": \"integer\", \"maximum\": 10}},"
+    "\"anObject\": {\"type\": \"object\", \"required\": [\"inner\"],"
+      "\"properties\": {\"inner\": {\"type\": \"string\"},"
+                       "\"anotherInt\": {\"type\": \"integer\","
+                                        "\"default\": 7}}}"
+  "},"
+  "\"required\": [\"anInt\", \"anArray\"]"
+"}";
+
+const string jsons[] = {
+  "{\"anInt\": 60, \"aNumber\": 3, \"aString\": \"yes\", \"aBool\": true,"
+  "\"anArray\": [1, 2, 10], \"anObject\": {\"inner\": \"value\"},"
+  "\"notInSchema\": [true]}",
+  "{\"anArray\": [1]}",
+  "{\"anInt\": \"1\", \"anArray\": [1]}",
+  "{\"anInt\": 61, \"anArray\": [1]}",
+  "{\"anInt\": -1, \"anArray\": [1]}",
+  "{\"anInt\": 1, \"anArray\": [1], \"aNumber\": 2}",
+  "{\"anInt\": 1, \"anArray\": [1], \"aString\": \"maybe\"}",
+  "{\"anInt\": 1, \"anArray\": [1], \"aString\": 1}",
+  "{\"anInt\": 1, \"anArray\": [1], \"aBool\": false}",
+  "{\"anInt\": 1, \"anArray\": [1], \"aBool\": 1}",
+  "{\"anInt\": 1, \"anArray\": []}",
+  "{\"anInt\": 1, \"anArray\": [1, 2, 3, 4]}",
+  "{\"anInt\": 1, \"anArray\": [1, 11]}",
+  "{\"anInt\": 1, \"anArray\": [1, 2, 1]}",
+  "{\"anInt\": 1, \"anArray\": {}}",
+  "{\"anInt\": 1, \"anArray\": [1], \"anObject\": {}}",
+  "{\"anInt\": 1, \"anArray\": [1], \"anObject\": []}",
+  "{\"anInt\": 1, \"anArray\": [1], \"anObject\": {\"inner\": 1}}",
+  "[]",
+};
+
+TEST(COMPILED_SCHEMA, SAME_RESULTS_AS_LOADER) {
+  auto validator = Schema_loader::load(schema);
+  string blob = Schema_compiler::compile(schema);
+  Compiled_schema compiled(blob);
+
+  for (auto& json : jsons) {
+    cJSON_ptr root = cJSON_ptr(cJSON_Parse(json.c_str()), cJSON_Delete);
+    cJSON_ptr root2 = cJSON_ptr(cJSON_Parse(json.c_str()), cJSON_Delete);
+    auto expected = validator->validate(CJSON_adapter(root.get()));
+    auto result = compiled.validate(CJSON_adapter(root2.get()));
+
+    EXPECT_EQ(result->success(), expected->success()) << json;
+    EXPECT_EQ(result->message(), expected->message()) << json;
+    EXPECT_EQ(result->code(), expected->code()) << json;
+    EXPECT_EQ(result->pointer(), expected->pointer()) << json;
+    EXPECT_EQ(result->error().expected, expected->error().expected) << json;
+    EXPECT_EQ(result->error().actual, expected->error().actual) << json;
+  }
+}
+
+TEST(COMPILED_SCHEMA, DEFAULT_VALUES) {
+  string blob = Schema_compiler::compile(schema);
+  Compiled_schema compiled(blob);
+
+  cJSON_ptr root = cJSON_ptr(cJSON_Parse(
+    "{\"anInt\": 1, \"anArray\": [1], \"anObject\": {\"inner\": \"\"}}"),
+    cJSON_Delete);
+  EXPECT_TRUE(compiled.validate(CJSON_adapter(root.get()))->success());
+  EXPECT_STREQ(cJSON_GetObjectItem(root.get(), "aString")->valuestring, "no");
+  EXPECT_EQ(cJSON_GetObjectItem(cJSON_GetObjectItem(root.get(), "anObject"),
+                                "anotherInt")->valueint, 7);
+}
+
+#if JSON_VALIDATOR_EXCEPTIONS
+TEST(COMPILED_SCHEMA, INVALID_BLOBS) {
+  string blob = Schema_compiler::compile(schema);
+
+  EXPECT_THROW(Compiled_schema(blob.data(), 8), std::invalid_argument);
+  EXPECT_THROW(Compiled_schema(blob.data(), blob.size() - 8),
+               std::invalid_argument);
+
+  string bad_magic = blob;
+  bad_magic[0] = 'X';
+  EXPECT_THROW(Compiled_schema{bad_magic}, std::invalid_argument);
+
+  string bad_root = blob;
+  reinterpret_cast<Compiled_schema_header*>(&bad_root[0])->root = 1000;
+  EXPECT_THROW(Compiled_schema{bad_root}, std::invalid_argument);
+
+  EXPECT_THROW(Schema_compiler::compile("{\"type\": \"null\"}"),
+               std::invalid_argument);
+}
+
+TEST(COMPILED_SCHEMA, INVALID_SCHEMAS) {
+  const string invalid_schemas[] = {
+    "{\"type\": \"integer\", \"enum\": [\"a\"]}",
+    "{\"type\": \"integer\", \"enum\": [1.5]}",
+    "{\"type\": \"integer\", \"minimum\": 0.5}",
+    "{\"type\": \"number\", \"maximum\": 1.5}",
+    "{\"type\": \"boolean\", \"enum\": [1]}",
+    "{\"type\": \"boolean\", \"enum\": [false, \"true\"]}",
+  };
+
+  for (auto& schema : invalid_schemas) {
+    EXPECT_THROW(Schema_compiler::compile(schema), std::invalid_argument)
+        << schema;
+  }
+}
+#endif
+
+TEST(COMPILED_SCHEMA, MAPPED_BUNDLE) {
+  Schema_bundle_writer writer;
+  writer.add("tenant-b", Schema_compiler::compile(schema));
+  writer.add("tenant-a", Schema_compiler::compile(
+    "{\"type\": \"array\", \"items\": {\"type\": \"string\"}}"));
+
+  char path[] = "/tmp/compiled_schema_testXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  string blob = writer.write();
+  ASSERT_EQ(write(fd, blob.data(), blob.size()), (ssize_t)blob.size());
+  close(fd);
+
+  {
+    Mapped_schema_file file(path);
+    Schema_bundle bundle = file.bundle();
+    EXPECT_EQ(bundle.size(), 2u);
+    EXPECT_STREQ(bundle.name(0), "tenant-a");
+
+    cJSON_ptr root = cJSON_ptr(cJSON_Parse("[\"a\", 1]"), cJSON_Delete);
+    auto result = bundle.find("tenant-a").validate(CJSON_adapter(root.get()));
+    EXPECT_FALSE(result->success());
+    EXPECT_EQ(result->message(), "[ERROR] json[1]: must be a string");
+
+    cJSON_ptr root2 = cJSON_ptr(cJSON_Parse(jsons[0].c_str()), cJSON_Delete);
+    EXPECT_TRUE(bundle.find("tenant-b").validate(
+                  CJSON_adapter(root2.get()))->success());
+#if JSON_VALIDATOR_EXCEPTIONS
+    EXPECT_THROW(bundle.find("tenant-c"), std::out_of_range);
+#endif
+  }
+
+  unlink(path);
+#if JSON_VALIDATOR_EXCEPTIONS
+  EXPECT_THROW(Mapped_schema_file{path}, std::runtime_error);
+#endif
+}
+
+const string comment_thread = "{"
+  "\"definitions\": {"
+    "\"comment\": {\"type\": \"object\", \"required\": [\"text\"],"
+      "\"properties\": {\"text\": {\"type\": \"string\"},"
+                       "\"replies\": {\"type\": \"array\","
+                         "\"items\": {\"$ref\": \"#/definitions/comment\"}}}}"
+  "},"
+  "\"type\": \"object\","
+  "\"properties\": {\"title\": {\"type\": \"string\"},"
+                   "\"comments\": {\"type\": \"array\","
+                     "\"items\": {\"$ref\": \"#/definitions/comment\"}},"
+                   "\"related\": {\"$ref\": \"#\"}}"
+"}";
+
+static Validation_result_ptr validate(const Compiled_schema& compiled,
+                                      const string& json) {
+  cJSON_ptr root = cJSON_ptr(cJSON_Parse(json.c_str()), cJSON_Delete);
+  return compiled.validate(CJSON_adapter(root.get()));
+}
+
+TEST(COMPILED_SCHEMA, RECURSIVE_REF) {
+  string blob = Schema_compiler::compile(comment_thread);
+  Compiled_schema compiled(blob);
+
+  //  Every $ref to the comment definition shares the same node
+  EXPECT_EQ(compiled.header().node_count, 6u);
+
+  EXPECT_TRUE(validate(compiled, "{\"comments\": [{\"text\": \"a\", "
+    "\"replies\": [{\"text\": \"b\", \"replies\": [{\"text\": \"c\"}]}]}],"
+    "\"related\": {\"title\": \"t\", \"related\": {}}}")->success());
+
+  auto result = validate(compiled, "{\"comments\": [{\"text\": \"a\", "
+    "\"replies\": [{\"text\": \"b\", \"replies\": [{\"text\": 1}]}]}]}");
+  EXPECT_EQ(result->message(), "[ERROR] json['comments'][0]['replies'][0]"
+                               "['replies'][0]['text']: must be a string");
+
+  result = validate(compiled, "{\"related\": {\"related\": "
+                              "{\"comments\": [{\"replies\": []}]}}}");
+  EXPECT_EQ(result->message(), "[ERROR] json['related']['related']"
+                               "['comments'][0]: text is required");
+}
+
+TEST(COMPILED_SCHEMA, MAX_DEPTH) {
+  string blob = Schema_compiler::compile(
+    "{\"type\": \"array\", \"items\": {\"$ref\": \"#\"}}");
+  Compiled_schema compiled(blob);
+
+  //  Far deeper than the C++ stack would allow with one call per level.
+  //  cJSON parses and deletes recursively, so the document is built and
+  //  released by hand.
+  const int depth = 200000;
+  cJSON* root = cJSON_CreateArray();
+  cJSON* leaf = root;
+  for (int i = 1; i < depth; ++i) {
+    cJSON* child = cJSON_CreateArray();
+    cJSON_AddItemToArray(leaf, child);
+    leaf = child;
+  }
+
+  Compiled_schema_stack<CJSON_adapter> stack(depth);
+  EXPECT_TRUE(compiled.validate(CJSON_adapter(root), &stack)->success());
+
+  Compiled_schema_stack<CJSON_adapter> shallow_stack(3);
+  auto result = compiled.validate(CJSON_adapter(root), &shallow_stack);
+  EXPECT_EQ(result->message(),
+            "[ERROR] json[0][0][0]: exceeds the maximum depth of 3");
+
+  while (root != nullptr) {
+    cJSON* child = cJSON_DetachItemFromArray(root, 0);
+    cJSON_Delete(root);
+    root = child;
+  }
+}
+
+TEST(COMPILED_SCHEMA, ESCAPED_PATHS) {
+  //  A property named like the path of another one gets its own node
+  string blob = Schema_compiler::compile("{\"type\": \"object\","
+    "\"properties\": {\"x\": {\"type\": \"object\", \"properties\": {"
+                   "\"y\": {\"type\": \"integer\"}}},"
+                   "\"x/properties/y\": {\"type\": \"string\"},"
+                   "\"a~b\": {\"type\": \"boolean\"},"
+                   "\"ref\": {\"$ref\": \"#/properties/x~1properties~1y\"},"
+                   "\"tilde\": {\"$ref\": \"#/properties/a~0b\"}}}");
+  Compiled_schema compiled(blob);
+
+  EXPECT_TRUE(validate(compiled, "{\"x\": {\"y\": 1}, "
+    "\"x/properties/y\": \"a\", \"ref\": \"b\", \"a~b\": true,"
+    "\"tilde\": false}")->success());
+  EXPECT_EQ(VALIDATION_WRONG_TYPE,
+            validate(compiled, "{\"x/properties/y\": 1}")->code());
+  EXPECT_EQ(VALIDATION_WRONG_TYPE,
+            validate(compiled, "{\"ref\": 1}")->code());
+  EXPECT_EQ(VALIDATION_WRONG_TYPE,
+            validate(compiled, "{\"tilde\": 1}")->code());
+}
+
+#if JSON_VALIDATOR_EXCEPTIONS
+TEST(COMPILED_SCHEMA, REF_ERRORS) {
+  EXPECT_THROW(Schema_compiler::compile(
+    "{\"type\": \"array\", \"items\": {\"$ref\": \"#/definitions/x\"}}"),
+    std::invalid_argument);
+  EXPECT_THROW(Schema_compiler::compile(
+    "{\"type\": \"array\", \"items\": {\"$ref\": \"other.json#\"}}"),
+    std::invalid_argument);
+  EXPECT_THROW(Schema_compiler::compile(
+    "{\"definitions\": {\"a\": {\"$ref\": \"#/definitions/b\"},"
+    "\"b\": {\"$ref\": \"#/definitions/a\"}}, \"$ref\": \"#/definitions/a\"}"),
+    std::invalid_argument);
+  EXPECT_THROW(Schema_loader::load(comment_thread), std::invalid_argument);
+}
+#endif
+}
@@ -0,0 +1,198 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/document_generator.hpp"
+#include "../lib/latency_histogram.hpp"
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Array_validator = Array_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+using String_validator = String_validator<CJSON_adapter>;
+using Boolean_validator = Boolean_validator<CJSON_adapter>;
+
+static const char* const SCHEMA = "{\"type\": \"object\","
+  "\"required\": [\"ids\", \"name\"], \"properties\": {"
+  "\"ids\": {\"type\": \"array\", \"minItems\": 1, \"maxItems\": 4,"
+  "  \"items\": {\"type\": \"array\", \"minItems\": 2, \"maxItems\": 2,"
+  "    \"items\": {\"type\": \"integer\", \"minimum\": 0}}},"
+  "\"name\": {\"type\": \"string\", \"maxLength\": 8},"
+  "\"kind\": {\"type\": \"string\", \"enum\": [\"a\", \"b\"],"
+  "  \"default\": \"a\"},"
+  "\"tags\": {\"type\": \"array\", \"uniqueItems\": true,"
+  "  \"items\": {\"type\": \"string\", \"enum\": [\"x\", \"y\", \"z\"]}},"
+  "\"level\": {\"type\": \"integer\", \"minimum\": 1, \"maximum\": 5},"
+  "\"flag\": {\"type\": \"boolean\", \"enum\": [true]},"
+  "\"old\": false}}";
+
+static Validation_result_ptr validate(Validator<CJSON_adapter>* validator,
+                                      const string& json) {
+  cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+  EXPECT_NE(nullptr, root) << json;
+  if (root == nullptr) {
+    return Validation_result_ptr(new Validation_result(false));
+  }
+
+  return validator->validate(CJSON_adapter(root.get()));
+}
+
+TEST(DOCUMENT_GENERATOR, VALID_AND_DETERMINISTIC) {
+  auto validator = Schema_loader<CJSON_adapter>::load(SCHEMA);
+  Generator_options options;
+  options.optional_keys = 0.5;
+  Document_generator generator(SCHEMA, options);
+
+  vector<string> documents;
+  for (uint64_t i = 0; i < 500; ++i) {
+    string document;
+    generator.append_valid(i, &document);
+    auto result = validate(validator.get(), document);
+    ASSERT_TRUE(result->success()) << document << " " << result->message();
+    documents.push_back(document);
+  }
+
+  //  Document i doesn't depend on the ones before it, nor on the generator
+  Document_generator same(validator.get(), options);
+  string last;
+  same.append_valid(499, &last);
+  EXPECT_EQ(documents[499], last);
+  EXPECT_NE(documents[498], documents[499]);
+
+  options.seed = 1;
+  Document_generator other(SCHEMA, options);
+  string reseeded;
+  other.append_valid(499, &reseeded);
+  EXPECT_NE(documents[499], reseeded);
+}
+
+TEST(DOCUMENT_GENERATOR, SIZES) {
+  Generator_options options;
+  options.min_items = 3;
+  options.max_items = 3;
+  options.min_string_length = 5;
+  options.max_string_length = 5;
+  Document_generator generator(SCHEMA, options);
+
+  string document;
+  generator.append_valid(7, &document);
+  cJSON_ptr root(cJSON_Parse(document.c_str()), cJSON_Delete);
+  ASSERT_NE(nullptr, root);
+  EXPECT_EQ(3, cJSON_GetArraySize(cJSON_GetObjectItem(root.get(), "ids")));
+  EXPECT_EQ(5u, strlen(cJSON_GetObjectItem(root.get(), "name")->valuestring));
+  //  What the schema says wins
+  EXPECT_EQ(2, cJSON_GetArraySize(cJSON_GetArrayItem(
+      cJSON_GetObjectItem(root.get(), "ids"), 0)));
+
+  options.min_items = 10;
+  options.max_items = 20;
+  options.max_string_length = 100;
+  Document_generator clamped(SCHEMA, options);
+  document.clear();
+  clamped.append_valid(7, &document);
+  root.reset(cJSON_Parse(document.c_str()));
+  EXPECT_EQ(4, cJSON_GetArraySize(cJSON_GetObjectItem(root.get(), "ids")));
+  EXPECT_EQ(3, cJSON_GetArraySize(cJSON_GetObjectItem(root.get(), "tags")));
+  EXPECT_GE(8u, strlen(cJSON_GetObjectItem(root.get(), "name")->valuestring));
+}
+
+TEST(DOCUMENT_GENERATOR, BUILDER_TREES) {
+  Object_validator validator({
+    {"a\"/b", (new Array_validator())->length(3)->items(
+        (new Int_validator())->valid({2, 4, 8}))},
+    {"on", (new Boolean_validator())->is(true)->required(true)},
+    {"nested", (new Object_validator({
+      {"s", (new String_validator())->valid({"q\\"})}
+    }))->forbidden_keys({"never"})}
+  });
+
+  Document_generator generator(&validator);
+  string document;
+  generator.append_valid(0, &document);
+  EXPECT_TRUE(validate(&validator, document)->success()) << document;
+  EXPECT_NE(string::npos, document.find("\"a\\\"/b\":[")) << document;
+  EXPECT_NE(string::npos, document.find("\"s\":\"q\\\\\"")) << document;
+
+#if JSON_VALIDATOR_EXCEPTIONS
+  //  Validators it doesn't know
+  Latency_histogram latencies;
+  Object_validator timed({
+    {"t", new Timed_validator<CJSON_adapter>(new Int_validator(), &latencies)}
+  });
+  EXPECT_THROW(Document_generator generator(&timed), std::invalid_argument);
+#endif
+}
+
+TEST(DOCUMENT_GENERATOR, MUTATIONS) {
+  auto validator = Schema_loader<CJSON_adapter>::load(SCHEMA);
+  Object_validator builder({
+    {"nested", (new Object_validator({
+      {"n", (new Int_validator())->required(true)}
+    }))->forbidden_keys({"never"})}
+  });
+
+  Document_generator generator(SCHEMA);
+  Document_generator forbidding(&builder);
+  for (int kind = MUTATE_ANY; kind < MUTATION_KINDS; ++kind) {
+    int found = 0;
+    for (size_t depth = 0; depth < 4; ++depth) {
+      for (uint64_t i = 0; i < 20; ++i) {
+        Mutation mutation = {depth, (i % 5) / 4.0, (Mutation_kind)kind};
+        for (auto pair : {make_pair(&generator, validator.get()),
+                          make_pair(&forbidding,
+                                    (Validator<CJSON_adapter>*)&builder)}) {
+          string document = "untouched";
+          string pointer;
+          if (!pair.first->append_invalid(i, mutation, &document, &pointer)) {
+            EXPECT_EQ("untouched", document);
+            continue;
+          }
+
+          ++found;
+          auto result = validate(pair.second, document.substr(9));
+          EXPECT_FALSE(result->success()) << kind << " " << document;
+          EXPECT_EQ(pointer, result->pointer()) << kind << " " << document;
+        }
+      }
+    }
+
+    EXPECT_LT(0, found) << kind;
+  }
+}
+
+TEST(DOCUMENT_GENERATOR, POSITIONS) {
+  Generator_options options;
+  options.min_items = 4;
+  options.max_items = 4;
+  Document_generator generator(SCHEMA, options);
+
+  //  Arrays with a minimum at depth 2 are ids/0 to ids/3 (not the items of
+  //  tags): the first, the last and the one closest to 40%
+  string document;
+  string pointer;
+  ASSERT_TRUE(generator.append_invalid(
+      3, {2, 0, MUTATE_BELOW_MINIMUM}, &document, &pointer));
+  EXPECT_EQ("/ids/0", pointer);
+  ASSERT_TRUE(generator.append_invalid(
+      3, {2, 1, MUTATE_BELOW_MINIMUM}, &document, &pointer));
+  EXPECT_EQ("/ids/3", pointer);
+  ASSERT_TRUE(generator.append_invalid(
+      3, {2, 0.4, MUTATE_BELOW_MINIMUM}, &document, &pointer));
+  EXPECT_EQ("/ids/1", pointer);
+
+  ASSERT_TRUE(generator.append_invalid(
+      3, {3, 1, MUTATE_BELOW_MINIMUM}, &document, &pointer));
+  EXPECT_EQ("/ids/3/1", pointer);
+  EXPECT_FALSE(generator.append_invalid(
+      3, {7, 0, MUTATE_ANY}, &document, &pointer));
+}
+}  // namespace unit_tests
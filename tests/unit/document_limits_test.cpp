@@ -0,0 +1,172 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/document_limits.hpp"
+#include "../lib/streaming_validator.hpp"
+#include "../lib/validation_pipeline.hpp"
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Array_validator = Array_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+using String_validator = String_validator<CJSON_adapter>;
+
+static Document_limits small_limits() {
+  Document_limits limits;
+  limits.max_depth = 3;
+  limits.max_nodes = 20;
+  limits.max_string_bytes = 4;
+  limits.max_array_length = 3;
+  limits.max_object_keys = 2;
+  return limits;
+}
+
+struct Limit_case {
+  string json;
+  Validation_error_code code;
+  string pointer;
+};
+
+//  Within the limits, then past each one of them
+static const vector<Limit_case> limit_cases = {
+  {"{\"a\": [[1, 2, 3]], \"bc\": \"\\\"xy\"}", VALIDATION_OK, ""},
+  {"{\"a\": [[[1]]]}", VALIDATION_TOO_DEEP, "/a/0/0"},
+  {"{\"a\": [[1, 2, 3], [1, 2, 3], [1, 2, 3]], \"b\": [[1, 2, 3], [1]]}",
+   VALIDATION_TOO_MANY_NODES, "/b/1/0"},
+  {"{\"a\": \"abcde\"}", VALIDATION_STRING_TOO_LONG, "/a"},
+  {"[\"ab\\\"cd\"]", VALIDATION_STRING_TOO_LONG, "/0"},
+  {"{\"abcde\": 1}", VALIDATION_STRING_TOO_LONG, ""},
+  {"{\"a\": [1, [], {}, true]}", VALIDATION_ARRAY_TOO_LONG, "/a"},
+  {"[{\"a\": 1, \"b\": 2, \"c\": 3}]", VALIDATION_TOO_MANY_KEYS, "/0"}
+};
+
+TEST(DOCUMENT_LIMITS, SCANNER) {
+  Document_scanner scanner(small_limits());
+  for (auto& test : limit_cases) {
+    Validation_result result;
+    EXPECT_EQ(test.code == VALIDATION_OK, scanner.check(test.json, &result))
+        << test.json;
+    EXPECT_EQ(test.code, result.code()) << test.json;
+  }
+
+  Validation_result result;
+  ASSERT_FALSE(scanner.check("{\"a\": [[[1]]]}", &result));
+  EXPECT_EQ(result.message(), "[ERROR] json: exceeds the limit of 3 nested "
+                              "containers at byte 8");
+
+  //  Unlimited by default, syntax is the parser's business
+  Document_scanner unlimited;
+  EXPECT_TRUE(unlimited.check(string(100000, '[') + "\"", &result));
+}
+
+TEST(DOCUMENT_LIMITS, SCANNER_STOPS_EARLY) {
+  Document_limits limits;
+  limits.max_depth = 64;
+  limits.max_string_bytes = 1024;
+  limits.max_array_length = 1000;
+  Document_scanner scanner(limits);
+
+  Validation_result result;
+  EXPECT_FALSE(scanner.check(string(100000, '['), &result));
+  EXPECT_EQ(VALIDATION_TOO_DEEP, result.code());
+  EXPECT_NE(string::npos, result.message().find("at byte 64")) <<
+      result.message();
+
+  result.reset();
+  EXPECT_FALSE(scanner.check("[\"" + string(1 << 20, 'a'), &result));
+  EXPECT_EQ(VALIDATION_STRING_TOO_LONG, result.code());
+
+  string items = "[0";
+  for (int i = 0; i < 2000; ++i) {
+    items += ",0";
+  }
+
+  result.reset();
+  EXPECT_FALSE(scanner.check(items + "]", &result));
+  EXPECT_EQ(VALIDATION_ARRAY_TOO_LONG, result.code());
+  EXPECT_NE(string::npos, result.message().find("at byte 2001"));
+}
+
+TEST(DOCUMENT_LIMITS, PARSED_DOCUMENTS) {
+  Document_limits limits = small_limits();
+  for (auto& test : limit_cases) {
+    cJSON_ptr root(cJSON_Parse(test.json.c_str()), cJSON_Delete);
+    ASSERT_NE(nullptr, root) << test.json;
+
+    Validation_result result;
+    EXPECT_EQ(test.code == VALIDATION_OK,
+              limits.check(CJSON_adapter(root.get()), &result)) << test.json;
+    EXPECT_EQ(test.code, result.code()) << test.json;
+    EXPECT_EQ(test.pointer, result.pointer()) << test.json;
+  }
+
+  Limited_validator<CJSON_adapter> validator(new Object_validator({
+    {"a", (new Array_validator())->items(new Int_validator())}
+  }), limits);
+
+  cJSON_ptr root(cJSON_Parse("{\"a\": [1, \"b\"]}"), cJSON_Delete);
+  auto result = validator.validate(CJSON_adapter(root.get()));
+  EXPECT_EQ(VALIDATION_WRONG_TYPE, result->code());
+  EXPECT_EQ("/a/1", result->pointer());
+
+  root.reset(cJSON_Parse("{\"a\": [1, 2, 3, 4]}"));
+  result = validator.validate(CJSON_adapter(root.get()));
+  EXPECT_EQ(VALIDATION_ARRAY_TOO_LONG, result->code());
+  EXPECT_EQ("/a", result->pointer());
+}
+
+TEST(DOCUMENT_LIMITS, STREAMING) {
+  Object_validator any({});
+  Array_validator any_array;
+  Streaming_validator object_stream(&any, small_limits());
+  Streaming_validator array_stream(&any_array, small_limits());
+
+  for (auto& test : limit_cases) {
+    Streaming_validator& stream =
+        test.json[0] == '{' ? object_stream : array_stream;
+    for (char c : test.json) {
+      stream.feed(&c, 1);
+    }
+
+    auto result = stream.finish();
+    EXPECT_EQ(test.code, result->code()) << test.json;
+    EXPECT_EQ(test.pointer, result->pointer()) << test.json;
+  }
+
+  //  Rejected as soon as the limit is passed
+  EXPECT_FALSE(array_stream.feed(string(100000, '[')));
+  EXPECT_EQ(4u, array_stream.offset());
+  EXPECT_EQ(VALIDATION_TOO_DEEP, array_stream.finish()->code());
+}
+
+TEST(DOCUMENT_LIMITS, PIPELINE) {
+  Object_validator validator({{"a", new String_validator()}});
+  vector<Validation_error_code> codes(3);
+  Validation_pipeline::Options options;
+  options.limits = small_limits();
+  Validation_pipeline pipeline(&validator, [&](Pipeline_record* record) {
+    codes[record->id] = record->result->code();
+    EXPECT_EQ(record->result->code() == VALIDATION_OK,
+              record->document != nullptr);
+  }, options);
+
+  pipeline.submit(0, "{\"a\": \"abc\"}");
+  pipeline.submit(1, "{\"a\": \"abcdefgh\"}");
+  pipeline.submit(2, string(100000, '[') + string(100000, ']'));
+  pipeline.finish();
+
+  EXPECT_EQ(VALIDATION_OK, codes[0]);
+  EXPECT_EQ(VALIDATION_STRING_TOO_LONG, codes[1]);
+  EXPECT_EQ(VALIDATION_TOO_DEEP, codes[2]);
+}
+}  // namespace unit_tests
@@ -0,0 +1,148 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/compiled_schema.hpp"
+#include "../lib/error_handling.hpp"
+#include "../lib/lock_free_queue.hpp"
+#include "../lib/schema_compiler.hpp"
+#include "../lib/schema_loader.hpp"
+#include "../lib/schema_registry.hpp"
+#include <string>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+
+/**
+ * Claims a default value without being able to set one
+ */
+class No_default_validator : public Validator<CJSON_adapter> {
+  public:
+  No_default_validator() {
+    this->_has_default_value = true;
+  }
+};
+
+TEST(ERROR_HANDLING, NULL_DOCUMENT) {
+#if JSON_VALIDATOR_EXCEPTIONS
+  EXPECT_THROW(CJSON_adapter(nullptr), std::invalid_argument);
+#else
+  //  What cJSON_Parse returns for a malformed document
+  cJSON* document = cJSON_Parse("{\"a\": ");
+  ASSERT_EQ(nullptr, document);
+
+  Object_validator validator({{"a", new Int_validator()}});
+  auto result = validator.validate(CJSON_adapter(document));
+  EXPECT_EQ(VALIDATION_WRONG_TYPE, result->code());
+  EXPECT_EQ("null", result->error().actual);
+
+  string blob = Schema_compiler::compile("{\"type\": \"integer\"}");
+  result = Compiled_schema(blob).validate(CJSON_adapter(document));
+  EXPECT_EQ(VALIDATION_WRONG_TYPE, result->code());
+#endif
+}
+
+TEST(ERROR_HANDLING, DEFAULT_VALUE) {
+  Object_validator validator({
+    {"a", new Int_validator()},
+    {"b", new No_default_validator()}
+  });
+
+  cJSON_ptr root(cJSON_Parse("{\"a\": 1}"), cJSON_Delete);
+#if JSON_VALIDATOR_EXCEPTIONS
+  EXPECT_THROW(validator.validate(CJSON_adapter(root.get())),
+               std::invalid_argument);
+#else
+  auto result = validator.validate(CJSON_adapter(root.get()));
+  EXPECT_EQ(VALIDATION_FAILED, result->code());
+  EXPECT_EQ("[ERROR] json: can't set the default value of b",
+            result->message());
+  EXPECT_EQ(nullptr, cJSON_GetObjectItem(root.get(), "b"));
+#endif
+}
+
+TEST(ERROR_HANDLING, NO_RESULT) {
+#if JSON_VALIDATOR_EXCEPTIONS
+  EXPECT_THROW(Spsc_queue<int>(3), std::invalid_argument);
+#else
+  //  Nothing can carry it: printed, then abort()
+  EXPECT_DEATH(Spsc_queue<int>(3),
+               "json_validator: Spsc_queue: capacity must be a power of 2");
+#endif
+}
+
+TEST(ERROR_HANDLING, MALFORMED_SCHEMAS) {
+  //  Reported the same way with or without exceptions, nothing raised
+  const string malformed_schemas[] = {
+    "not json",
+    "[]",
+    "{\"type\": \"number\"}",
+    "{\"type\": \"object\", \"properties\": [{\"type\": \"integer\"}]}",
+    "{\"type\": \"object\", \"properties\": {\"a\": 1}}",
+    "{\"type\": \"object\", \"required\": [1]}",
+    "{\"type\": \"object\", \"required\": [\"missing\"]}",
+    "{\"type\": \"object\", \"properties\": {"
+    "\"a\": {\"type\": \"string\", \"enum\": [1]},"
+    "\"b\": {\"type\": \"string\", \"default\": 1}}}",
+    "{\"type\": \"array\", \"items\": {\"type\": \"integer\","
+    "\"enum\": {\"a\": 1}}}",
+    "{\"type\": \"array\", \"items\": {\"$ref\": \"#/nowhere\"}}",
+    "{\"type\": \"array\", \"items\": {\"$ref\": 1}}",
+    "{\"definitions\": {\"a\": {\"$ref\": \"#/definitions/b\"},"
+    "\"b\": {\"$ref\": \"#/definitions/a\"}}, \"$ref\": \"#/definitions/a\"}",
+  };
+
+  for (auto& schema : malformed_schemas) {
+    Validation_result result;
+    auto validator = Schema_loader<CJSON_adapter>::load(schema, &result);
+    EXPECT_EQ(nullptr, validator) << schema;
+    EXPECT_EQ(VALIDATION_FAILED, result.code()) << schema;
+    EXPECT_EQ(0u, result.message().find("[ERROR] json: json-schema error"))
+        << result.message();
+
+    string error;
+    EXPECT_EQ("", Schema_compiler::compile(schema, &error)) << schema;
+    EXPECT_EQ(0u, error.find("json-schema error")) << schema;
+  }
+
+  //  The first error is the one reported
+  Validation_result result;
+  Schema_loader<CJSON_adapter>::load("{\"type\": \"integer\", \"minimum\": "
+                                     "\"a\", \"maximum\": 1.5}", &result);
+  EXPECT_EQ("[ERROR] json: json-schema error at '#': 'minimum' must be an "
+            "integer", result.message());
+
+  //  Valid schemas load as usual (and the error is cleared)
+  auto validator = Schema_loader<CJSON_adapter>::load(
+      "{\"type\": \"integer\", \"maximum\": 3}", &result);
+  ASSERT_NE(nullptr, validator);
+  EXPECT_TRUE(result.success());
+  string error = "stale";
+  string blob = Schema_compiler::compile("{\"type\": \"integer\"}", &error);
+  EXPECT_EQ("", error);
+
+  //  Blobs
+  EXPECT_TRUE(Compiled_schema::is_valid(blob));
+  EXPECT_FALSE(Compiled_schema::is_valid(blob.substr(0, 8), &error));
+  EXPECT_EQ("Compiled_schema: buffer too small", error);
+  string corrupted = blob;
+  corrupted[0] = 'X';
+  EXPECT_FALSE(Compiled_schema::is_valid(corrupted, &error));
+  EXPECT_EQ("Compiled_schema: invalid magic", error);
+
+  Schema_registry registry;
+  Schema_registry::Reader reader(&registry);
+  EXPECT_FALSE(registry.publish("a", 1, corrupted, &error));
+  EXPECT_EQ(nullptr, reader.lock().find("a", 1));
+  EXPECT_TRUE(registry.publish("a", 1, blob, &error));
+  EXPECT_NE(nullptr, reader.lock().find("a", 1));
+}
+}  // namespace unit_tests
@@ -0,0 +1,247 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/schema_compiler.hpp"
+#include "complete_functionality_validators.hpp"
+#include <fstream>
+#include <sstream>
+#include <string>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+/**
+ *  Same cases as complete_functionality_test.cpp, validated by the classes
+ *   schema_codegen generated from schemas/complete_functionality.json
+ */
+namespace unit_tests {
+template<typename Generated>
+static bool validate(cJSON* json) {
+  bool success = Generated::validate(json)->success();
+  EXPECT_EQ(Generated::is_valid(json), success);
+  return success;
+}
+
+template<typename Generated>
+static bool validate(const string& json) {
+  cJSON_ptr root = cJSON_ptr(cJSON_Parse(json.c_str()), cJSON_Delete);
+  return validate<Generated>(root.get());
+}
+
+TEST(GENERATED_VALIDATOR, INT_VALIDATOR) {
+  EXPECT_FALSE(validate<generated::Int_max_40>("{\"anInt\": 44}"));
+  EXPECT_FALSE(validate<generated::Int_min_50>("{\"anInt\": 44}"));
+  EXPECT_TRUE(validate<generated::Int_ranges>(
+    "{\"anInt\": 44, \"anotherInt\": 5000}"));
+}
+
+TEST(GENERATED_VALIDATOR, STRING_VALIDATOR) {
+  const string json = "{\"aString\": \"Valid string\"}";
+  EXPECT_FALSE(validate<generated::String_not_valid>(json));
+  EXPECT_FALSE(validate<generated::String_max_length_4>(json));
+  EXPECT_TRUE(validate<generated::String_valid>(json));
+}
+
+TEST(GENERATED_VALIDATOR, ARRAY_STRING_VALIDATOR) {
+  const string json = "{\"anArray\": [\"Value1\", \"Value2\", \"Value3\"]}";
+  EXPECT_FALSE(validate<generated::Array_of_string_values_error>(json));
+  EXPECT_TRUE(validate<generated::Array_of_string_values>(json));
+  EXPECT_TRUE(validate<generated::Any_array>("{\"anArray\": []}"));
+}
+
+TEST(GENERATED_VALIDATOR, MISSING_REQUIRED_FIELD) {
+  EXPECT_FALSE(validate<generated::Missing_required_field>(
+    "{\"anArray\": [], \"anInt\": 44, \"aString\": \"stringvalue\"}"));
+}
+
+TEST(GENERATED_VALIDATOR, ARRAY_INT_VALIDATOR) {
+  const string json = "{\"anArray\": [1, 2, 3, 4, 5]}";
+  EXPECT_FALSE(validate<generated::Array_of_ints_2_5>(json));
+  EXPECT_FALSE(validate<generated::Array_of_ints_max_3>(json));
+  EXPECT_TRUE(validate<generated::Array_of_ints_1_5>(json));
+  EXPECT_FALSE(validate<generated::Array_of_ints>(
+    "{\"anArray\": [1, 2, 3, 4, null]}"));
+}
+
+TEST(GENERATED_VALIDATOR, ARRAY_OF_ARRAYS) {
+  EXPECT_FALSE(validate<generated::Array_of_arrays>(
+    "{\"anArrayOfArrays\": [[1, 2, 3, 4], [5, 6, 7, 8, 11]]}"));
+  EXPECT_TRUE(validate<generated::Array_of_arrays>(
+    "{\"anArrayOfArrays\": [[1, 2, 3, 4], [5, 6, 7, 8]]}"));
+}
+
+TEST(GENERATED_VALIDATOR, ARRAY_OF_OBJECTS) {
+  EXPECT_TRUE(validate<generated::Array_of_objects>(
+    "{\"anArrayOfObjects\": [{\"anInt\": 1}, {\"anInt\": 60}]}"));
+}
+
+TEST(GENERATED_VALIDATOR, ERROR_VALIDATING_OBJECT_AS_ARRAY) {
+  EXPECT_FALSE(validate<generated::Object_as_array>(
+    "{\"anObject\": {\"anInt\": 1}}"));
+}
+
+TEST(GENERATED_VALIDATOR, NESTED_OBJECTS) {
+  EXPECT_FALSE(validate<generated::Nested_objects>(
+    "{\"obj1\": {\"obj2\": {\"obj3\": 4}}}"));
+  EXPECT_FALSE(validate<generated::Nested_array_of_arrays>(
+    "{\"obj1\": {\"obj2\": {\"obj3\": [[1, 2, 3, 4, -1], [5, 6, 7]]}}}"));
+}
+
+TEST(GENERATED_VALIDATOR, MULTIPLE_TIME_VALIDATION) {
+  const string valid_json = "{\"anObject\": {\"anInt\": 1, \"anotherInt\": 2}}";
+  const string invalid_json = "{\"anObject\": {\"anInt\": 1}}";
+  EXPECT_TRUE(validate<generated::Required_ints>(valid_json));
+  EXPECT_FALSE(validate<generated::Required_ints>(invalid_json));
+  EXPECT_TRUE(validate<generated::Required_ints>(valid_json));
+
+  EXPECT_TRUE(validate<generated::Array_of_required_ints>(
+    "[" + valid_json + "]"));
+  EXPECT_FALSE(validate<generated::Array_of_required_ints>(
+    "[" + invalid_json + "]"));
+  EXPECT_TRUE(validate<generated::Array_of_required_ints>(
+    "[" + valid_json + "]"));
+}
+
+TEST(GENERATED_VALIDATOR, ARRAY_MIN_MAX) {
+  const string json = "{\"anArray\": [\"Value1\", \"Value2\", \"Value3\"]}";
+  EXPECT_TRUE(validate<generated::Array_min_0>(json));
+  EXPECT_FALSE(validate<generated::Array_min_4>(json));
+  EXPECT_TRUE(validate<generated::Array_max_4>(json));
+  EXPECT_FALSE(validate<generated::Array_max_2>(json));
+  EXPECT_TRUE(validate<generated::Array_length_3>(json));
+}
+
+TEST(GENERATED_VALIDATOR, OBJECT_FORBIDDEN_KEYS) {
+  auto result = generated::Forbidden_key::validate(cJSON_ptr(cJSON_Parse(
+    "{\"anObject\": {\"anInt\": 1, \"anotherInt\": 2, \"forbiddenKey\": 123}}"),
+    cJSON_Delete).get());
+  EXPECT_EQ(result->message(),
+            "[ERROR] json['anObject']: 'forbiddenKey' key is not allowed");
+}
+
+TEST(GENERATED_VALIDATOR, DEFAULT_VALUES) {
+  cJSON_ptr root = cJSON_ptr(cJSON_Parse(
+    "{\"anObject\": {\"anotherInt\": 2, \"forbiddenKey\": 123}}"),
+    cJSON_Delete);
+  EXPECT_TRUE(validate<generated::Int_default>(root.get()));
+  EXPECT_TRUE(validate<generated::Int_is_66>(root.get()));
+
+  root = cJSON_ptr(cJSON_Parse("{\"anObject\": {\"anInt\": 80, "
+                               "\"anotherInt\": 2, \"forbiddenKey\": 123}}"),
+                   cJSON_Delete);
+  EXPECT_TRUE(validate<generated::Int_default>(root.get()));
+  EXPECT_TRUE(validate<generated::Int_is_80>(root.get()));
+
+  root = cJSON_ptr(cJSON_Parse("{\"anObject\": {\"anInt\": 33}}"),
+                   cJSON_Delete);
+  EXPECT_TRUE(validate<generated::Boolean_default>(root.get()));
+  EXPECT_TRUE(validate<generated::Boolean_is_true>(root.get()));
+
+  root = cJSON_ptr(cJSON_Parse("{\"anObject\": {\"aBool\": false, "
+                               "\"anInt\": 33}}"), cJSON_Delete);
+  EXPECT_TRUE(validate<generated::Boolean_default>(root.get()));
+  EXPECT_TRUE(validate<generated::Boolean_is_false>(root.get()));
+
+  root = cJSON_ptr(cJSON_Parse("{\"anObject\": {\"anInt\": 33}}"),
+                   cJSON_Delete);
+  EXPECT_TRUE(validate<generated::String_default>(root.get()));
+  EXPECT_TRUE(validate<generated::String_is_simple>(root.get()));
+
+  root = cJSON_ptr(cJSON_Parse("{\"anObject\": {\"aString\": "
+                               "\"a simple string\", \"anInt\": 33}}"),
+                   cJSON_Delete);
+  EXPECT_TRUE(validate<generated::Another_string_default>(root.get()));
+  EXPECT_TRUE(validate<generated::String_is_simple>(root.get()));
+}
+
+TEST(GENERATED_VALIDATOR, SAME_RESULTS_AS_COMPILED_SCHEMA) {
+  ifstream file(UNIT_TEST_SCHEMAS_PATH "/complete_functionality.json");
+  stringstream schemas;
+  schemas << file.rdbuf();
+  cJSON_ptr document = cJSON_ptr(cJSON_Parse(schemas.str().c_str()),
+                                 cJSON_Delete);
+  ASSERT_NE(document, nullptr);
+
+  struct Generated {
+    string name;
+    unique_ptr<Validation_result> (*validate)(cJSON*);
+  };
+
+  const Generated validators[] = {
+    {"All_keywords", &generated::All_keywords::validate},
+    {"Comment", &generated::Comment::validate},
+    {"Forbidden_key", &generated::Forbidden_key::validate},
+    {"Int_default", &generated::Int_default::validate},
+    {"Array_of_required_ints", &generated::Array_of_required_ints::validate},
+  };
+
+  const string jsons[] = {
+    "{\"anInt\": 60, \"aNumber\": 3, \"aString\": \"yes\", \"aBool\": true,"
+    "\"anArray\": [1, 2, 10], \"anObject\": {\"inner\": \"value\"},"
+    "\"notInSchema\": [true]}",
+    "{\"anArray\": [1]}",
+    "{\"anInt\": \"1\", \"anArray\": [1]}",
+    "{\"anInt\": 61, \"anArray\": [1]}",
+    "{\"anInt\": 1, \"anArray\": [1], \"aNumber\": 2}",
+    "{\"anInt\": 1, \"anArray\": [1], \"aString\": \"maybe\"}",
+    "{\"anInt\": 1, \"anArray\": [1], \"aString\": \"\\u00e9t\\u00e9\"}",
+    "{\"anInt\": 1, \"anArray\": [1], \"aBool\": false}",
+    "{\"anInt\": 1, \"anArray\": [1, 2, 3, 4]}",
+    "{\"anInt\": 1, \"anArray\": [1, 2, 1]}",
+    "{\"anInt\": 1, \"anArray\": [1], \"anObject\": {\"forbidden\": 1}}",
+    "{\"anInt\": 1, \"anArray\": [1], \"anObject\": []}",
+    "{\"anObject\": {\"anInt\": 1, \"anotherInt\": 2, \"forbiddenKey\": 1}}",
+    "{\"anObject\": {\"anotherInt\": 2}}",
+    "{\"text\": \"a\", \"replies\": [{\"text\": \"b\", \"replies\": "
+    "[{\"text\": 1}]}]}",
+    "{\"text\": \"a\", \"replies\": [{\"replies\": []}]}",
+    "[{\"anObject\": {\"anInt\": 1}}]",
+    "{\"\": {}}",
+    "[]",
+  };
+
+  for (auto& validator : validators) {
+    string blob = Schema_compiler::compile(
+      document.get(), "#/definitions/" + validator.name);
+    Compiled_schema compiled(blob);
+
+    for (auto& json : jsons) {
+      cJSON_ptr root = cJSON_ptr(cJSON_Parse(json.c_str()), cJSON_Delete);
+      cJSON_ptr root2 = cJSON_ptr(cJSON_Parse(json.c_str()), cJSON_Delete);
+      auto expected = compiled.validate(CJSON_adapter(root.get()));
+      auto result = validator.validate(root2.get());
+
+      EXPECT_EQ(result->message(), expected->message())
+        << validator.name << " " << json;
+      EXPECT_EQ(result->pointer(), expected->pointer()) << json;
+      EXPECT_EQ(result->error().expected, expected->error().expected) << json;
+      EXPECT_EQ(result->error().actual, expected->error().actual) << json;
+
+      //  Same defaults
+      unique_ptr<char, void(*)(void*)> printed(
+        cJSON_PrintUnformatted(root.get()), free);
+      unique_ptr<char, void(*)(void*)> printed2(
+        cJSON_PrintUnformatted(root2.get()), free);
+      EXPECT_STREQ(printed2.get(), printed.get()) << validator.name;
+    }
+  }
+}
+
+TEST(GENERATED_VALIDATOR, MAX_DEPTH) {
+  string json = "{\"text\": \"\"}";
+  for (int i = 0; i < 1100; ++i) {
+    json = "{\"text\": \"\", \"replies\": [" + json + "]}";
+  }
+
+  auto result = generated::Comment::validate(cJSON_ptr(cJSON_Parse(
+    json.c_str()), cJSON_Delete).get());
+  EXPECT_FALSE(result->success());
+  EXPECT_NE(result->message().find("exceeds the maximum depth of 1024"),
+            string::npos);
+}
+}
@@ -0,0 +1,231 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/document_generator.hpp"
+#include "../lib/iterative_validator.hpp"
+#include "../lib/node_counters.hpp"
+#include "../lib/validation_budget.hpp"
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Array_validator = Array_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+using String_validator = String_validator<CJSON_adapter>;
+
+static const char* const SCHEMA = "{\"type\": \"object\","
+  "\"required\": [\"ids\", \"name\"], \"properties\": {"
+  "\"ids\": {\"type\": \"array\", \"minItems\": 1, \"maxItems\": 4,"
+  "  \"items\": {\"type\": \"array\", \"minItems\": 2, \"maxItems\": 2,"
+  "    \"items\": {\"type\": \"integer\", \"minimum\": 0}}},"
+  "\"name\": {\"type\": \"string\", \"maxLength\": 8},"
+  "\"kind\": {\"type\": \"string\", \"enum\": [\"a\", \"b\"],"
+  "  \"default\": \"a\"},"
+  "\"tags\": {\"type\": \"array\", \"uniqueItems\": true,"
+  "  \"items\": {\"type\": \"string\", \"enum\": [\"x\", \"y\", \"z\"]}},"
+  "\"level\": {\"type\": \"integer\", \"minimum\": 1, \"maximum\": 5},"
+  "\"flag\": {\"type\": \"boolean\", \"enum\": [true]},"
+  "\"old\": false}}";
+
+static void expect_same(Validation_result* expected,
+                        Validation_result* actual, const string& json) {
+  EXPECT_EQ(expected->code(), actual->code()) << json;
+  EXPECT_EQ(expected->message(), actual->message()) << json;
+  EXPECT_EQ(expected->pointer(), actual->pointer()) << json;
+  EXPECT_EQ(expected->error().expected, actual->error().expected) << json;
+  EXPECT_EQ(expected->error().actual, actual->error().actual) << json;
+}
+
+/**
+ * Validates 'json' recursively and iteratively (documents with defaults
+ *  included)
+ */
+static void expect_same(Validator<CJSON_adapter>* validator,
+                        Iterative_validator<CJSON_adapter>* iterative,
+                        const string& json) {
+  cJSON_ptr recursive_root(cJSON_Parse(json.c_str()), cJSON_Delete);
+  cJSON_ptr iterative_root(cJSON_Parse(json.c_str()), cJSON_Delete);
+  ASSERT_NE(nullptr, recursive_root) << json;
+
+  auto expected = validator->validate(CJSON_adapter(recursive_root.get()));
+  auto actual = iterative->validate(CJSON_adapter(iterative_root.get()));
+  expect_same(expected.get(), actual.get(), json);
+
+  unique_ptr<char, void(*)(void*)> expected_json(
+      cJSON_PrintUnformatted(recursive_root.get()), free);
+  unique_ptr<char, void(*)(void*)> actual_json(
+      cJSON_PrintUnformatted(iterative_root.get()), free);
+  EXPECT_STREQ(expected_json.get(), actual_json.get());
+}
+
+TEST(ITERATIVE_VALIDATOR, SAME_RESULTS) {
+  auto loaded = Schema_loader<CJSON_adapter>::load(SCHEMA);
+  Object_validator builder({
+    {"nested", (new Object_validator({
+      {"n", (new Int_validator())->required(true)},
+      {"", new Int_validator()}
+    }))->forbidden_keys({"never"})},
+    {"list", (new Array_validator())->min(1)->items(
+        (new Array_validator())->unique(true)->items(
+            new String_validator())->max(2))},
+    {"d", (new Int_validator())->default_value(7)}
+  });
+
+  Document_generator generator(SCHEMA);
+  Document_generator forbidding(&builder);
+  vector<pair<Document_generator*, Validator<CJSON_adapter>*>> pairs = {
+    {&generator, loaded.get()}, {&forbidding, &builder}
+  };
+
+  for (auto& pair : pairs) {
+    Iterative_validator<CJSON_adapter> iterative(pair.second);
+    for (uint64_t i = 0; i < 50; ++i) {
+      string document;
+      pair.first->append_valid(i, &document);
+      expect_same(pair.second, &iterative, document);
+
+      for (int kind = MUTATE_ANY; kind < MUTATION_KINDS; ++kind) {
+        for (size_t depth = 0; depth < 4; ++depth) {
+          Mutation mutation = {depth, (i % 5) / 4.0, (Mutation_kind)kind};
+          document.clear();
+          string pointer;
+          if (pair.first->append_invalid(i, mutation, &document, &pointer)) {
+            expect_same(pair.second, &iterative, document);
+          }
+        }
+      }
+    }
+  }
+
+  Iterative_validator<CJSON_adapter> iterative(&builder);
+  for (const string json : {"[]", "{\"nested\": {\"\": \"a\", \"n\": 1}}",
+                            "{\"list\": [[\"a\"], [\"b\", 1]]}",
+                            "{\"list\": [[\"a\", \"b\", \"c\"]]}",
+                            "{\"list\": [[\"a\"], [\"b\", \"b\"]]}",
+                            "{\"list\": []}", "{\"nested\": {}}"}) {
+    expect_same(&builder, &iterative, json);
+  }
+}
+
+TEST(ITERATIVE_VALIDATOR, DEEP_NESTING) {
+  //  A validator per level, which recursive validate() would need several
+  //  C++ frames for. cJSON parses and deletes recursively, so the document
+  //  is built and released by hand.
+  const int depth = 20000;
+  Array_validator validator;
+  Array_validator* innermost = &validator;
+  cJSON* root = cJSON_CreateArray();
+  cJSON* leaf = root;
+  string pointer;
+  for (int i = 1; i < depth; ++i) {
+    auto items = new Array_validator();
+    innermost->items(items);
+    innermost = items;
+
+    cJSON* child = cJSON_CreateArray();
+    cJSON_AddItemToArray(leaf, child);
+    leaf = child;
+    pointer += "/0";
+  }
+
+  innermost->items(new Int_validator());
+  cJSON_AddItemToArray(leaf, cJSON_CreateNumber(1));
+  cJSON_AddItemToArray(leaf, cJSON_CreateString("a"));
+
+  Iterative_validator<CJSON_adapter> iterative(&validator, depth);
+  auto result = iterative.validate(CJSON_adapter(root));
+  EXPECT_EQ(VALIDATION_WRONG_TYPE, result->code());
+  EXPECT_EQ(pointer + "/1", result->pointer());
+
+  cJSON_DeleteItemFromArray(leaf, 1);
+  EXPECT_TRUE(iterative.validate(CJSON_adapter(root))->success());
+
+  //  One level too deep: the innermost array is rejected
+  Iterative_validator<CJSON_adapter> shallow(&validator, depth - 1);
+  result = shallow.validate(CJSON_adapter(root));
+  EXPECT_EQ(VALIDATION_TOO_DEEP, result->code());
+  EXPECT_EQ(pointer, result->pointer());
+  EXPECT_EQ("depth " + to_string(depth), result->error().actual);
+
+  Iterative_validator<CJSON_adapter> three(&validator, 3);
+  result = three.validate(CJSON_adapter(root));
+  EXPECT_EQ(result->message(),
+            "[ERROR] json[0][0][0]: exceeds the maximum depth of 3");
+
+  while (root != nullptr) {
+    cJSON* child = cJSON_DetachItemFromArray(root, 0);
+    cJSON_Delete(root);
+    root = child;
+  }
+}
+
+TEST(ITERATIVE_VALIDATOR, BUDGET_AND_COUNTERS) {
+  using Counted = Node_counters<>;
+  using Counted_object = json_validator::Object_validator<CJSON_adapter,
+                                                          Counted>;
+  using Counted_array = json_validator::Array_validator<CJSON_adapter,
+                                                        Counted>;
+  using Counted_int = json_validator::Int_validator<CJSON_adapter, Counted>;
+  auto counted = [] () {
+    return new Counted_object({
+      {"a", (new Counted_array())->items(new Counted_object({
+        {"n", (new Counted_int())->max_value(10)}
+      }))->max(3)}
+    });
+  };
+
+  unique_ptr<Counted_object> recursive(counted());
+  unique_ptr<Counted_object> walked(counted());
+  Iterative_validator<CJSON_adapter, Counted> iterative(walked.get());
+  for (const string json : {"{\"a\": [{\"n\": 1}, {\"n\": 2}]}",
+                            "{\"a\": [{\"n\": 1}, {\"n\": 11}]}",
+                            "{\"a\": [{}, {}, {}, {}]}", "{\"a\": 1}"}) {
+    cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+    for (uint32_t check_every : {1, 3}) {
+      //  Cancelled right away: stops at the next check
+      Validation_budget expected_budget(Validation_budget::NO_DEADLINE,
+                                        check_every);
+      Validation_budget actual_budget(Validation_budget::NO_DEADLINE,
+                                      check_every);
+      for (auto budget : {&expected_budget, &actual_budget}) {
+        budget->spend();
+        budget->cancel();
+      }
+
+      Validation_result_ptr expected(new Validation_result());
+      expected->budget(&expected_budget);
+      expected = recursive->validate(CJSON_adapter(root.get()),
+                                     std::move(expected));
+      Validation_result_ptr actual(new Validation_result());
+      actual->budget(&actual_budget);
+      actual = iterative.validate(CJSON_adapter(root.get()),
+                                  std::move(actual));
+      expect_same(expected.get(), actual.get(), json);
+      EXPECT_EQ(expected_budget.nodes(), actual_budget.nodes()) << json;
+    }
+
+    expect_same(recursive->validate(CJSON_adapter(root.get())).get(),
+                iterative.validate(CJSON_adapter(root.get())).get(), json);
+  }
+
+  auto expected = Counted::by_path<CJSON_adapter>(recursive.get());
+  auto actual = Counted::by_path<CJSON_adapter>(walked.get());
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i].first, actual[i].first);
+    EXPECT_EQ(expected[i].second.invocations, actual[i].second.invocations)
+        << expected[i].first;
+    EXPECT_EQ(expected[i].second.failures, actual[i].second.failures)
+        << expected[i].first;
+  }
+}
+}  // namespace unit_tests
@@ -0,0 +1,140 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/latency_histogram.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+
+TEST(LATENCY_HISTOGRAM, BUCKETS) {
+  //  Contiguous, exact below 128, then within 1/64 of their values
+  EXPECT_EQ(0u, Latency_histogram::bucket(0));
+  EXPECT_EQ(127u, Latency_histogram::bucket(127));
+  EXPECT_EQ(Latency_histogram::BUCKETS - 1,
+            Latency_histogram::bucket(UINT64_MAX));
+  for (size_t i = 0; i + 1 < Latency_histogram::BUCKETS; ++i) {
+    uint64_t low = Latency_histogram::bucket_low(i);
+    uint64_t high = Latency_histogram::bucket_high(i);
+    ASSERT_EQ(i, Latency_histogram::bucket(low));
+    ASSERT_EQ(i, Latency_histogram::bucket(high));
+    ASSERT_EQ(high + 1, Latency_histogram::bucket_low(i + 1));
+    ASSERT_LE(high - low, low / 64);
+  }
+}
+
+TEST(LATENCY_HISTOGRAM, PERCENTILES) {
+  Latency_histogram histogram;
+  EXPECT_EQ(0u, histogram.value_at_percentile(99));
+
+  //  1..10000 us and a few huge ones
+  for (uint64_t value = 1; value <= 10000; ++value) {
+    histogram.record(value * 1000);
+  }
+
+  histogram.record(5000000000, 10);
+  EXPECT_EQ(10010u, histogram.count());
+  EXPECT_EQ(1000u, histogram.min());
+  EXPECT_EQ(5000000000u, histogram.max());
+  EXPECT_NEAR((50005000.0 * 1000 + 50000000000.0) / 10010, histogram.mean(),
+              1);
+
+  EXPECT_NEAR(5005000, histogram.value_at_percentile(50), 5005000 / 64);
+  EXPECT_NEAR(9910000, histogram.value_at_percentile(99), 9910000 / 64);
+  EXPECT_EQ(5000000000u, histogram.value_at_percentile(99.99));
+  EXPECT_EQ(1000u, histogram.value_at_percentile(0));
+  EXPECT_EQ(5000000000u, histogram.value_at_percentile(100));
+
+  histogram.reset();
+  EXPECT_EQ(0u, histogram.count());
+  EXPECT_EQ(0u, histogram.min());
+}
+
+TEST(LATENCY_HISTOGRAM, THREADS_AND_MERGE) {
+  //  Shared by the threads, or one per thread merged afterwards
+  Latency_histogram shared;
+  vector<unique_ptr<Latency_histogram>> own;
+  vector<thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    own.emplace_back(new Latency_histogram());
+    Latency_histogram* mine = own.back().get();
+    threads.emplace_back([&shared, mine, t]() {
+      for (uint64_t i = 0; i < 10000; ++i) {
+        shared.record(t * 10000 + i);
+        mine->record(t * 10000 + i);
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  Latency_histogram merged;
+  for (auto& histogram : own) {
+    merged.merge(*histogram);
+  }
+
+  for (const Latency_histogram* histogram : {&shared, &merged}) {
+    EXPECT_EQ(40000u, histogram->count());
+    EXPECT_EQ(0u, histogram->min());
+    EXPECT_EQ(39999u, histogram->max());
+    EXPECT_DOUBLE_EQ(19999.5, histogram->mean());
+  }
+
+  for (double percentile : {1.0, 25.0, 50.0, 99.0, 99.9}) {
+    EXPECT_EQ(shared.value_at_percentile(percentile),
+              merged.value_at_percentile(percentile));
+  }
+}
+
+TEST(LATENCY_HISTOGRAM, JSON) {
+  Latency_histogram histogram;
+  histogram.record(10);
+  histogram.record(20);
+  histogram.record(1000, 2);
+
+  string json;
+  histogram.append_json(&json);
+  EXPECT_EQ("{\"count\":4,\"min\":10,\"mean\":507.5,\"max\":1000,"
+            "\"percentiles\":{\"50\":20,\"90\":1000,\"99\":1000,"
+            "\"99.9\":1000,\"99.99\":1000},"
+            "\"buckets\":[[10,10,1],[20,20,1],[1000,1007,2]]}", json);
+}
+
+TEST(LATENCY_HISTOGRAM, TIMED_VALIDATOR) {
+  Latency_histogram latencies;
+  Object_validator validator({
+    {"timed", new Timed_validator<CJSON_adapter>(
+        (new Int_validator())->max_value(10), &latencies)},
+  });
+  validator.add_validator("required", new Timed_validator<CJSON_adapter>(
+      (new Int_validator())->required(true), &latencies));
+
+  cJSON_ptr valid(cJSON_Parse("{\"timed\": 1, \"required\": 2}"),
+                  cJSON_Delete);
+  cJSON_ptr invalid(cJSON_Parse("{\"timed\": 11, \"required\": 2}"),
+                    cJSON_Delete);
+  cJSON_ptr missing(cJSON_Parse("{\"timed\": 1}"), cJSON_Delete);
+  EXPECT_TRUE(validator.validate(CJSON_adapter(valid.get()))->success());
+  auto result = validator.validate(CJSON_adapter(invalid.get()));
+  EXPECT_EQ("/timed", result->pointer());
+  EXPECT_EQ(VALIDATION_ABOVE_MAXIMUM, result->code());
+  EXPECT_EQ(VALIDATION_REQUIRED,
+            validator.validate(CJSON_adapter(missing.get()))->code());
+
+  EXPECT_EQ(4u, latencies.count());
+  EXPECT_LT(0u, latencies.max());
+}
+}  // namespace unit_tests
@@ -0,0 +1,157 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/node_counters.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Counted = Node_counters<>;
+using Object_validator = Object_validator<CJSON_adapter, Counted>;
+using Array_validator = Array_validator<CJSON_adapter, Counted>;
+using Int_validator = Int_validator<CJSON_adapter, Counted>;
+using String_validator = String_validator<CJSON_adapter, Counted>;
+
+static Object_validator* counted_validator() {
+  return new Object_validator({
+    {"n", (new Int_validator())->max_value(10)},
+    {"a/b", (new Array_validator())->items(
+        (new String_validator())->valid({"x", "y"}))}
+  });
+}
+
+static void validate(Object_validator* validator, const string& json) {
+  cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+  validator->validate(CJSON_adapter(root.get()));
+}
+
+static Node_stats stats(const vector<pair<string, Node_stats>>& nodes,
+                        const string& path) {
+  for (auto& node : nodes) {
+    if (node.first == path) {
+      return node.second;
+    }
+  }
+
+  ADD_FAILURE() << "no " << path;
+  return Node_stats();
+}
+
+TEST(NODE_COUNTERS, CALLS_AND_FAILURES) {
+  unique_ptr<Object_validator> validator(counted_validator());
+  validate(validator.get(), "{\"n\": 1, \"a/b\": [\"x\", \"y\"]}");
+  validate(validator.get(), "{\"n\": 11}");
+  validate(validator.get(), "{\"a/b\": [\"x\", \"z\", \"x\"]}");
+  validate(validator.get(), "[]");
+
+  auto nodes = Counted::by_path<CJSON_adapter>(validator.get());
+  ASSERT_EQ(4u, nodes.size());
+  EXPECT_EQ(4u, stats(nodes, "").invocations);
+  EXPECT_EQ(3u, stats(nodes, "").failures);
+  EXPECT_EQ(2u, stats(nodes, "/properties/n").invocations);
+  EXPECT_EQ(1u, stats(nodes, "/properties/n").failures);
+  EXPECT_EQ(2u, stats(nodes, "/properties/a~1b").invocations);
+  EXPECT_EQ(1u, stats(nodes, "/properties/a~1b").failures);
+  //  items stop at the first failure
+  EXPECT_EQ(4u, stats(nodes, "/properties/a~1b/items").invocations);
+  EXPECT_EQ(1u, stats(nodes, "/properties/a~1b/items").failures);
+  EXPECT_EQ(0u, stats(nodes, "").samples);
+
+  //  Another tree (or a copy) counts apart
+  unique_ptr<Object_validator> other(counted_validator());
+  EXPECT_EQ(0u, Counted::by_path<CJSON_adapter>(other.get())[0]
+                    .second.invocations);
+
+  Counted::reset();
+  EXPECT_EQ(0u, Counted::by_path<CJSON_adapter>(validator.get())[0]
+                    .second.invocations);
+}
+
+TEST(NODE_COUNTERS, THREADS) {
+  unique_ptr<Object_validator> validator(counted_validator());
+  cJSON_ptr root(cJSON_Parse("{\"n\": 1, \"a/b\": [\"x\"]}"), cJSON_Delete);
+  cJSON_ptr failing(cJSON_Parse("{\"n\": 12}"), cJSON_Delete);
+
+  //  Tables of the first threads are reused by the next ones
+  for (int round = 0; round < 2; ++round) {
+    vector<thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&]() {
+        for (int i = 0; i < 1000; ++i) {
+          validator->validate(CJSON_adapter(i % 4 ? root.get()
+                                                  : failing.get()));
+        }
+      });
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  auto nodes = Counted::by_path<CJSON_adapter>(validator.get());
+  EXPECT_EQ(8000u, stats(nodes, "").invocations);
+  EXPECT_EQ(2000u, stats(nodes, "").failures);
+  EXPECT_EQ(8000u, stats(nodes, "/properties/n").invocations);
+  EXPECT_EQ(6000u, stats(nodes, "/properties/a~1b/items").invocations);
+}
+
+TEST(NODE_COUNTERS, SAMPLED_TIME_AND_JSON) {
+  //  One call out of 4 is timed, trees loaded from a schema too
+  using Timed = Node_counters<4>;
+  auto validator = Schema_loader<CJSON_adapter, Timed>::load(
+      "{\"type\": \"object\", \"properties\": {"
+      "\"q\\\"\": {\"type\": \"integer\", \"minimum\": 0}}}");
+  cJSON_ptr root(cJSON_Parse("{\"q\\\"\": -1}"), cJSON_Delete);
+  for (int i = 0; i < 10; ++i) {
+    validator->validate(CJSON_adapter(root.get()));
+  }
+
+  auto nodes = Timed::by_path<CJSON_adapter>(validator.get());
+  ASSERT_EQ(2u, nodes.size());
+  EXPECT_EQ("/properties/q\"", nodes[1].first);
+  EXPECT_EQ(10u, nodes[0].second.invocations);
+  EXPECT_EQ(3u, nodes[0].second.samples);
+  EXPECT_LT(0u, nodes[0].second.ticks);
+  EXPECT_LT(0, nodes[0].second.ticks_per_call());
+
+  string json = Timed::json<CJSON_adapter>(validator.get());
+  cJSON_ptr parsed(cJSON_Parse(json.c_str()), cJSON_Delete);
+  ASSERT_NE(nullptr, parsed) << json;
+  ASSERT_EQ(2, cJSON_GetArraySize(parsed.get()));
+  cJSON* property = cJSON_GetArrayItem(parsed.get(), 1);
+  EXPECT_STREQ("/properties/q\"",
+               cJSON_GetObjectItem(property, "path")->valuestring);
+  EXPECT_EQ(10, cJSON_GetObjectItem(property, "failures")->valueint);
+  EXPECT_EQ(3, cJSON_GetObjectItem(property, "samples")->valueint);
+}
+
+TEST(NODE_COUNTERS, RECYCLED_IDS) {
+  unique_ptr<Object_validator> validator(counted_validator());
+  validate(validator.get(), "{\"n\": 11}");
+
+  //  A new tree takes the ids back, counts zeroed
+  validator.reset();
+  validator.reset(counted_validator());
+  for (auto& node : Counted::by_path<CJSON_adapter>(validator.get())) {
+    EXPECT_EQ(0u, node.second.invocations) << node.first;
+  }
+
+  //  Rebuilding trees for ever doesn't run out of ids
+  for (uint32_t i = 0; i < Counted::MAX_NODES + 1; ++i) {
+    Int_validator node;
+  }
+  Int_validator node;
+  EXPECT_LT(node.instrumentation().id(), Counted::MAX_NODES);
+  EXPECT_EQ(0u, Counted::untracked());
+}
+}  // namespace unit_tests
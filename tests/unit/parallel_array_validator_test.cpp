@@ -0,0 +1,112 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/iterative_validator.hpp"
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Array_validator = Array_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+using Boolean_validator = Boolean_validator<CJSON_adapter>;
+
+/**
+ * Items of objects with a required and a default key; pool == nullptr
+ *  builds the sequential validator
+ */
+static Array_validator* items_validator(Work_stealing_pool* pool) {
+  auto validator = (new Array_validator())->max(5000)->items(
+    new Object_validator({
+      {"v", (new Int_validator())->min_value(0)->max_value(50)
+                                 ->required(true)},
+      {"flag", (new Boolean_validator())->default_value(true)}
+    }));
+
+  if (pool != nullptr) {
+    validator->parallel(pool, 64, 16);
+  }
+
+  return validator;
+}
+
+/**
+ * 'count' items, 'bad' ones holding 'bad_value' ({} if it is negative)
+ */
+static string items(size_t count, const vector<size_t>& bad, int bad_value) {
+  string json = "[";
+  for (size_t i = 0; i < count; ++i) {
+    json += i == 0 ? "" : ",";
+    bool is_bad = std::find(bad.begin(), bad.end(), i) != bad.end();
+    if (is_bad && bad_value < 0) {
+      json += "{}";
+    } else {
+      json += "{\"v\": " + to_string(is_bad ? bad_value : (int)(i % 50)) +
+              "}";
+    }
+  }
+
+  return json + "]";
+}
+
+TEST(PARALLEL_ARRAY_VALIDATOR, SAME_RESULTS_AS_SEQUENTIAL) {
+  unique_ptr<Array_validator> sequential(items_validator(nullptr));
+  const vector<string> documents = {
+    items(3000, {}, 0),
+    //  small arrays stay sequential
+    items(10, {3}, 51),
+    //  several failures: the first index wins, wherever its chunk is
+    items(3000, {2999, 1500, 40}, 51),
+    items(3000, {2999}, -1),
+    items(3000, {0}, 51),
+    items(5001, {}, 0)
+  };
+
+  for (size_t workers : {0, 3}) {
+    Work_stealing_pool pool(workers);
+    unique_ptr<Array_validator> parallel(items_validator(&pool));
+    for (const string& json : documents) {
+      cJSON_ptr expected_root(cJSON_Parse(json.c_str()), cJSON_Delete);
+      cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+      ASSERT_NE(nullptr, root);
+
+      auto expected =
+          sequential->validate(CJSON_adapter(expected_root.get()));
+      for (int repeat = 0; repeat < 10; ++repeat) {
+        auto result = parallel->validate(CJSON_adapter(root.get()));
+        ASSERT_EQ(expected->success(), result->success()) << json.size();
+        ASSERT_EQ(expected->message(), result->message()) << json.size();
+        ASSERT_EQ(expected->pointer(), result->pointer()) << json.size();
+      }
+    }
+  }
+}
+
+TEST(PARALLEL_ARRAY_VALIDATOR, DEFAULTS_AND_ITERATIVE) {
+  Work_stealing_pool pool(2);
+  unique_ptr<Array_validator> parallel(items_validator(&pool));
+  string json = items(1000, {}, 0);
+  cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+
+  EXPECT_TRUE(parallel->validate(CJSON_adapter(root.get()))->success());
+  for (int i = 0; i < 1000; ++i) {
+    cJSON* item = cJSON_GetArrayItem(root.get(), i);
+    ASSERT_NE(nullptr, cJSON_GetObjectItem(item, "flag")) << i;
+  }
+
+  //  The iterative engine leaves parallel arrays to validate()
+  root.reset(cJSON_Parse(items(1000, {700}, 51).c_str()));
+  Iterative_validator<CJSON_adapter> iterative(parallel.get());
+  auto result = iterative.validate(CJSON_adapter(root.get()));
+  EXPECT_EQ(VALIDATION_ABOVE_MAXIMUM, result->code());
+  EXPECT_EQ("/700/v", result->pointer());
+}
+}  // namespace unit_tests
@@ -0,0 +1,170 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Array_validator = Array_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+using String_validator = String_validator<CJSON_adapter>;
+using Boolean_validator = Boolean_validator<CJSON_adapter>;
+
+/**
+ * Two large arrays ("first" and, nested, "second") between small keys;
+ *  pool == nullptr builds the sequential validator
+ */
+static Object_validator* subtree_validator(Work_stealing_pool* pool) {
+  auto items = [](int maximum) {
+    return (new Array_validator())->items(new Object_validator({
+      {"v", (new Int_validator())->min_value(0)->max_value(maximum)
+                                 ->required(true)}
+    }));
+  };
+
+  auto nested = new Object_validator({
+    {"second", items(100)},
+    {"flag", (new Boolean_validator())->default_value(true)}
+  });
+
+  auto validator = new Object_validator({
+    {"head", (new Int_validator())->max_value(10)},
+    {"first", items(50)},
+    {"nested", nested},
+    {"tail", (new String_validator())->valid({"end"})},
+    {"id", (new Int_validator())->required(true)}
+  });
+
+  if (pool != nullptr) {
+    nested->parallel(pool, 16);
+    validator->parallel(pool, 16)->forbidden_keys({"forbidden"});
+  } else {
+    validator->forbidden_keys({"forbidden"});
+  }
+
+  return validator;
+}
+
+static string items(size_t count, size_t bad_index, int bad_value) {
+  string json = "[";
+  for (size_t i = 0; i < count; ++i) {
+    json += string(i == 0 ? "" : ",") + "{\"v\": " +
+            to_string(i == bad_index ? bad_value : (int)(i % 50)) + "}";
+  }
+
+  return json + "]";
+}
+
+/**
+ * Documents failing in different places (or not at all)
+ */
+static vector<string> subtree_documents() {
+  const size_t none = (size_t)-1;
+  return {
+    //  valid, defaults added to "nested"
+    "{\"head\": 1, \"first\": " + items(500, none, 0) +
+    ", \"nested\": {\"second\": " + items(300, none, 0) +
+    "}, \"tail\": \"end\", \"id\": 1}",
+    //  small key fails before both large ones
+    "{\"head\": 11, \"first\": " + items(500, 3, 51) +
+    ", \"nested\": {\"second\": " + items(300, 4, 101) + "}, \"id\": 1}",
+    //  both large keys fail: the first one in document order wins
+    "{\"head\": 1, \"first\": " + items(500, 499, 51) +
+    ", \"nested\": {\"second\": " + items(300, 0, -1) + "}, \"id\": 1}",
+    //  only the nested one fails
+    "{\"first\": " + items(500, none, 0) +
+    ", \"nested\": {\"second\": " + items(300, 150, 101) + "}, \"id\": 1}",
+    //  small key after the large ones
+    "{\"first\": " + items(500, none, 0) +
+    ", \"nested\": {\"second\": " + items(300, none, 0) +
+    "}, \"tail\": \"x\", \"id\": 1}",
+    //  forbidden key after a failing large key, then before it
+    "{\"first\": " + items(500, 10, 51) + ", \"forbidden\": 1, \"id\": 1}",
+    "{\"forbidden\": 1, \"first\": " + items(500, 10, 51) + ", \"id\": 1}",
+    //  missing required key
+    "{\"first\": " + items(500, none, 0) + "}",
+    //  required key missing in an item of a large array
+    "{\"first\": [{\"v\": 1}, {}], \"nested\": {\"second\": " +
+    items(300, none, 0) + "}, \"id\": 1}"
+  };
+}
+
+TEST(PARALLEL_OBJECT_VALIDATOR, SAME_RESULTS_AS_SEQUENTIAL) {
+  unique_ptr<Object_validator> sequential(subtree_validator(nullptr));
+  for (size_t workers : {0, 3}) {
+    Work_stealing_pool pool(workers);
+    unique_ptr<Object_validator> parallel(subtree_validator(&pool));
+
+    for (const string& json : subtree_documents()) {
+      cJSON_ptr expected_root(cJSON_Parse(json.c_str()), cJSON_Delete);
+      cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+      ASSERT_NE(nullptr, root);
+
+      auto expected =
+          sequential->validate(CJSON_adapter(expected_root.get()));
+      for (int repeat = 0; repeat < 20; ++repeat) {
+        auto result = parallel->validate(CJSON_adapter(root.get()));
+        ASSERT_EQ(expected->success(), result->success()) << json;
+        ASSERT_EQ(expected->message(), result->message()) << json;
+        ASSERT_EQ(expected->code(), result->code()) << json;
+      }
+    }
+  }
+}
+
+TEST(PARALLEL_OBJECT_VALIDATOR, DEFAULTS) {
+  Work_stealing_pool pool(2);
+  unique_ptr<Object_validator> parallel(subtree_validator(&pool));
+  string json = subtree_documents()[0];
+  cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+
+  EXPECT_TRUE(parallel->validate(CJSON_adapter(root.get()))->success());
+  cJSON* nested = cJSON_GetObjectItem(root.get(), "nested");
+  ASSERT_NE(nullptr, cJSON_GetObjectItem(nested, "flag"));
+}
+
+TEST(PARALLEL_OBJECT_VALIDATOR, SHARED_BY_THREADS) {
+  Work_stealing_pool pool(2);
+  unique_ptr<Object_validator> sequential(subtree_validator(nullptr));
+  unique_ptr<Object_validator> parallel(subtree_validator(&pool));
+  auto documents = subtree_documents();
+
+  //  Parsed up front: cJSON_Parse isn't thread-safe (global error pointer)
+  vector<string> expected;
+  vector<vector<cJSON_ptr>> roots(3);
+  for (const string& json : documents) {
+    cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+    expected.push_back(sequential->validate(CJSON_adapter(root.get()))
+                                 ->message());
+    for (auto& thread_roots : roots) {
+      thread_roots.emplace_back(cJSON_Parse(json.c_str()), cJSON_Delete);
+    }
+  }
+
+  vector<std::thread> threads;
+  for (size_t t = 0; t < roots.size(); ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = 0; i < documents.size(); ++i) {
+        size_t document = (i + t) % documents.size();
+        auto result = parallel->validate(
+            CJSON_adapter(roots[t][document].get()));
+        EXPECT_EQ(expected[document], result->message());
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+}  // namespace unit_tests
@@ -0,0 +1,149 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/schema_compiler.hpp"
+#include <string>
+#include <stdexcept>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Schema_loader = Schema_loader<CJSON_adapter>;
+
+static bool validate(const string& schema, const string& json) {
+  auto validator = Schema_loader::load(schema);
+  cJSON_ptr root = cJSON_ptr(cJSON_Parse(json.c_str()), cJSON_Delete);
+  return validator->validate(CJSON_adapter(root.get()))->success();
+}
+
+const string complete_schema = "{"
+  "\"$schema\": \"http://json-schema.org/draft-04/schema#\","
+  "\"type\": \"object\","
+  "\"properties\": {"
+    "\"anInt\": {\"type\": \"integer\", \"minimum\": 0, \"maximum\": 60},"
+    "\"aNumber\": {\"type\": \"integer\", \"enum\": [1, 3, 5]},"
+    "\"aString\": {\"type\": \"string\", \"enum\": [\"yes\", \"no\"],"
+                  "\"maxLength\": 3},"
+    "\"aBool\": {\"type\": \"boolean\", \"enum\": [true]},"
+    "\"anArray\": {\"type\": \"array\", \"minItems\": 1, \"maxItems\": 3,"
+                  "\"uniqueItems\": true,"
+                  "\"items\": {\"type\": \"integer\", \"maximum\": 10}},"
+    "\"anObject\": {\"type\": \"object\", \"required\": [\"inner\"],"
+      "\"properties\": {\"inner\": {\"type\": \"string\"}}}"
+  "},"
+  "\"required\": [\"anInt\", \"anArray\"]"
+"}";
+
+TEST(SCHEMA_LOADER, SUCCESS) {
+  EXPECT_TRUE(validate(complete_schema,
+    "{\"anInt\": 60, \"aNumber\": 3, \"aString\": \"yes\", \"aBool\": true,"
+    "\"anArray\": [1, 2, 10], \"anObject\": {\"inner\": \"value\"},"
+    "\"notInSchema\": [true]}"));
+}
+
+TEST(SCHEMA_LOADER, ERRORS) {
+  const string invalid_jsons[] = {
+    "{\"anArray\": [1]}",
+    "{\"anInt\": 61, \"anArray\": [1]}",
+    "{\"anInt\": 1, \"anArray\": [1], \"aNumber\": 2}",
+    "{\"anInt\": 1, \"anArray\": [1], \"aString\": \"maybe\"}",
+    "{\"anInt\": 1, \"anArray\": [1], \"aBool\": false}",
+    "{\"anInt\": 1, \"anArray\": []}",
+    "{\"anInt\": 1, \"anArray\": [1, 2, 3, 4]}",
+    "{\"anInt\": 1, \"anArray\": [1, 11]}",
+    "{\"anInt\": 1, \"anArray\": [1, 2, 1]}",
+    "{\"anInt\": 1, \"anArray\": [1], \"anObject\": {}}",
+    "{\"anInt\": 1, \"anArray\": [1], \"anObject\": []}",
+  };
+
+  for (auto& json : invalid_jsons) {
+    EXPECT_FALSE(validate(complete_schema, json)) << json;
+  }
+}
+
+TEST(SCHEMA_LOADER, DEFAULT_VALUES) {
+  const string schema = "{\"type\": \"object\", \"properties\": {"
+    "\"anInt\": {\"type\": \"integer\", \"default\": 66},"
+    "\"aString\": {\"type\": \"string\", \"default\": \"a string\"},"
+    "\"aBool\": {\"type\": \"boolean\", \"default\": true}}}";
+
+  auto validator = Schema_loader::load(schema);
+  cJSON_ptr root = cJSON_ptr(cJSON_Parse("{}"), cJSON_Delete);
+  EXPECT_TRUE(validator->validate(CJSON_adapter(root.get()))->success());
+  EXPECT_EQ(cJSON_GetObjectItem(root.get(), "anInt")->valueint, 66);
+  EXPECT_STREQ(cJSON_GetObjectItem(root.get(), "aString")->valuestring,
+               "a string");
+  EXPECT_EQ(cJSON_GetObjectItem(root.get(), "aBool")->type, cJSON_True);
+}
+
+TEST(SCHEMA_LOADER, UNIQUE_ITEMS_COMPARES_VALUES) {
+  const string schema = "{\"type\": \"array\", \"uniqueItems\": true,"
+                        "\"items\": {\"type\": \"object\"}}";
+
+  EXPECT_TRUE(validate(schema, "[{\"a\": 1, \"b\": 2}, {\"a\": 2, \"b\": 1}]"));
+  EXPECT_FALSE(validate(schema, "[{\"a\": 1, \"b\": 2}, {\"b\": 2, \"a\": 1}]"));
+}
+
+TEST(SCHEMA_LOADER, FORBIDDEN_KEYS) {
+  const string schema = "{\"type\": \"object\", \"properties\": {"
+                        "\"a\": {\"type\": \"integer\"}, \"b\": false,"
+                        "\"c\": true}}";
+
+  EXPECT_TRUE(validate(schema, "{\"a\": 1, \"c\": [true]}"));
+  auto validator = Schema_loader::load(schema);
+  cJSON_ptr root = cJSON_ptr(cJSON_Parse("{\"a\": 1, \"b\": 2}"),
+                             cJSON_Delete);
+  EXPECT_EQ(validator->validate(CJSON_adapter(root.get()))->message(),
+            "[ERROR] json: 'b' key is not allowed");
+
+  string blob = Schema_compiler::compile(schema);
+  EXPECT_EQ(Compiled_schema(blob).validate(CJSON_adapter(root.get()))
+              ->message(), "[ERROR] json: 'b' key is not allowed");
+}
+
+#if JSON_VALIDATOR_EXCEPTIONS
+TEST(SCHEMA_LOADER, INVALID_SCHEMAS) {
+  const string invalid_schemas[] = {
+    "not json",
+    "[]",
+    "{}",
+    "{\"type\": \"null\"}",
+    "{\"type\": [\"string\", \"null\"]}",
+    "{\"type\": \"integer\", \"minimum\": \"0\"}",
+    "{\"type\": \"array\", \"maxItems\": -1}",
+    "{\"type\": \"array\", \"items\": {}}",
+    "{\"type\": \"string\", \"enum\": [1]}",
+    "{\"type\": \"integer\", \"enum\": [\"a\"]}",
+    "{\"type\": \"integer\", \"enum\": [1.5]}",
+    "{\"type\": \"integer\", \"maximum\": 1.5}",
+    "{\"type\": \"integer\", \"default\": 0.5}",
+    "{\"type\": \"number\"}",
+    "{\"type\": \"boolean\", \"enum\": [1]}",
+    "{\"type\": \"boolean\", \"enum\": [true, 1]}",
+    "{\"type\": \"object\", \"required\": [\"missing\"]}",
+    "{\"type\": \"object\", \"default\": {}}",
+    "{\"type\": \"object\", \"properties\": {\"a\": false},"
+    "\"required\": [\"a\"]}",
+  };
+
+  for (auto& schema : invalid_schemas) {
+    EXPECT_THROW(Schema_loader::load(schema), std::invalid_argument) << schema;
+  }
+
+  //  enum items have no name: the keyword is reported
+  try {
+    Schema_loader::load("{\"type\": \"boolean\", \"enum\": [1]}");
+    FAIL();
+  } catch (const std::invalid_argument& error) {
+    EXPECT_STREQ("json-schema error at '#': 'enum' must contain only booleans",
+                 error.what());
+  }
+}
+#endif
+}
@@ -0,0 +1,153 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/schema_compiler.hpp"
+#include "../lib/schema_registry.hpp"
+#include <atomic>
+#include <string>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+/**
+ * A schema that only accepts {"version": version}
+ */
+static string versioned_schema(uint32_t version) {
+  return Schema_compiler::compile(
+    "{\"type\": \"object\", \"required\": [\"version\"],"
+    "\"properties\": {\"version\": {\"type\": \"integer\","
+    "\"minimum\": " + to_string(version) + ","
+    "\"maximum\": " + to_string(version) + "}}}");
+}
+
+static bool validate(const Compiled_schema* schema, uint32_t version) {
+  cJSON_ptr root = cJSON_ptr(cJSON_CreateObject(), cJSON_Delete);
+  cJSON_AddNumberToObject(root.get(), "version", version);
+  return schema->validate(CJSON_adapter(root.get()))->success();
+}
+
+TEST(SCHEMA_REGISTRY, FIND_AND_REMOVE) {
+  Schema_registry registry;
+  Schema_registry::Reader reader(&registry);
+
+  EXPECT_EQ(reader.lock().find_latest("tenant"), nullptr);
+
+  registry.publish("tenant", 1, versioned_schema(1));
+  registry.publish("tenant", 2, versioned_schema(2));
+  registry.publish("other", 7, versioned_schema(7));
+
+  {
+    auto guard = reader.lock();
+    uint32_t version = 0;
+    const Compiled_schema* latest = guard.find_latest("tenant", &version);
+    ASSERT_NE(latest, nullptr);
+    EXPECT_EQ(version, 2u);
+    EXPECT_TRUE(validate(latest, 2));
+    EXPECT_FALSE(validate(latest, 1));
+
+    ASSERT_NE(guard.find("tenant", 1), nullptr);
+    EXPECT_TRUE(validate(guard.find("tenant", 1), 1));
+    EXPECT_EQ(guard.find("tenant", 3), nullptr);
+    EXPECT_EQ(guard.find("unknown", 1), nullptr);
+  }
+
+  EXPECT_TRUE(registry.remove("tenant", 2));
+  EXPECT_FALSE(registry.remove("tenant", 2));
+  EXPECT_TRUE(validate(reader.lock().find_latest("tenant"), 1));
+  EXPECT_TRUE(registry.remove("tenant", 1));
+  EXPECT_EQ(reader.lock().find_latest("tenant"), nullptr);
+  EXPECT_EQ(registry.retired(), 0u);
+}
+
+TEST(SCHEMA_REGISTRY, GUARD_KEEPS_SCHEMA_ALIVE) {
+  Schema_registry registry;
+  Schema_registry::Reader reader(&registry);
+  registry.publish("tenant", 1, versioned_schema(1));
+
+  {
+    auto guard = reader.lock();
+    const Compiled_schema* schema = guard.find("tenant", 1);
+    registry.publish("tenant", 1, versioned_schema(2));
+    registry.remove("tenant", 1);
+
+    EXPECT_EQ(registry.retired(), 2u);
+    EXPECT_TRUE(validate(schema, 1));
+  }
+
+  registry.reclaim();
+  EXPECT_EQ(registry.retired(), 0u);
+}
+
+#if JSON_VALIDATOR_EXCEPTIONS
+TEST(SCHEMA_REGISTRY, ERRORS) {
+  Schema_registry registry(2);
+  EXPECT_THROW(registry.publish("tenant", 1, "not a compiled schema"),
+               std::invalid_argument);
+
+  Schema_registry::Reader first(&registry);
+  {
+    Schema_registry::Reader second(&registry);
+    EXPECT_THROW(Schema_registry::Reader{&registry}, std::runtime_error);
+  }
+
+  Schema_registry::Reader third(&registry);
+}
+#endif
+
+TEST(SCHEMA_REGISTRY, RELOAD_WHILE_READING) {
+  const int readers = 4;
+  const uint32_t versions = 300;
+  Schema_registry registry(readers);
+  registry.publish("tenant", 1, versioned_schema(1));
+
+  vector<string> blobs;
+  for (uint32_t version = 0; version <= versions; ++version) {
+    blobs.push_back(versioned_schema(version));
+  }
+
+  std::atomic<bool> done(false);
+  std::atomic<int> failures(0);
+  vector<std::thread> threads;
+  for (int i = 0; i < readers; ++i) {
+    threads.emplace_back([&]() {
+      Schema_registry::Reader reader(&registry);
+      uint32_t last_version = 0;
+      while (!done.load()) {
+        auto guard = reader.lock();
+        uint32_t version = 0;
+        const Compiled_schema* schema = guard.find_latest("tenant", &version);
+        //  Versions only go forward and always match their schema
+        if (schema == nullptr || version < last_version ||
+            !validate(schema, version) || validate(schema, version + 1)) {
+          failures++;
+        }
+
+        last_version = version;
+      }
+    });
+  }
+
+  for (uint32_t version = 2; version <= versions; ++version) {
+    registry.publish("tenant", version, blobs[version]);
+    registry.remove("tenant", version - 1);
+  }
+
+  done.store(true);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(failures.load(), 0);
+  registry.reclaim();
+  EXPECT_EQ(registry.retired(), 0u);
+}
+}
@@ -0,0 +1,191 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/streaming_validator.hpp"
+#include <string>
+#include <map>
+#include <iostream>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Array_validator = Array_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+using String_validator = String_validator<CJSON_adapter>;
+using Boolean_validator = Boolean_validator<CJSON_adapter>;
+
+/**
+ *  Feeds json to the stream in chunks of chunk_size bytes
+ */
+static Validation_result_ptr feed_in_chunks(Streaming_validator& stream,
+                                            const string& json,
+                                            size_t chunk_size) {
+  for (size_t i = 0; i < json.size(); i += chunk_size) {
+    if (!stream.feed(json.substr(i, chunk_size))) {
+      break;
+    }
+  }
+
+  return stream.finish();
+}
+
+/**
+ *  Validates json both with the streaming validator (for every chunk size)
+ *   and with the regular validator and checks that both agree.
+ */
+static void expect_same_result(Validator<CJSON_adapter>& validator,
+                               const string& json, bool success) {
+  cJSON_ptr root = cJSON_ptr(cJSON_Parse(json.c_str()), cJSON_Delete);
+  ASSERT_NE(root.get(), nullptr);
+  auto expected = validator.validate(CJSON_adapter(root.get()));
+  EXPECT_EQ(expected->success(), success);
+
+  Streaming_validator stream(&validator);
+  for (size_t chunk_size = 1; chunk_size <= json.size(); ++chunk_size) {
+    auto result = feed_in_chunks(stream, json, chunk_size);
+    EXPECT_EQ(result->success(), success) << json << " / " << chunk_size;
+    EXPECT_EQ(result->message(), expected->message());
+    EXPECT_EQ(result->pointer(), expected->pointer());
+    EXPECT_EQ(result->error().schema_node, expected->error().schema_node);
+    EXPECT_EQ(result->error().actual, expected->error().actual);
+  }
+}
+
+TEST(STREAMING_VALIDATOR, NESTED_SUCCESS) {
+  auto validator = Object_validator({
+    {"anInt", (new Int_validator())->min_value(0)->max_value(100)},
+    {"aString", (new String_validator())->valid({"yes", "n\"o"})},
+    {"aBool", (new Boolean_validator())->is(true)->required(true)},
+    {"anArray", (new Array_validator())->min(1)->items(
+      (new Array_validator())->length(2)->items(new Int_validator()))},
+    {"anObject", new Object_validator({
+      {"inner", (new String_validator())->max_length(5)->required(true)}
+    })}
+  });
+
+  expect_same_result(validator,
+    "{\"anInt\": 42, \"aString\": \"n\\\"o\", \"aBool\": true, "
+    "\"unknown\": {\"a\": [1, 2, {\"b\": null}]}, "
+    "\"anArray\": [[1, 2], [-3, 4e2]], \"anObject\": {\"inner\": \"abc\"}}",
+    true);
+}
+
+TEST(STREAMING_VALIDATOR, SCALAR_ERRORS) {
+  auto validator = Object_validator({
+    {"anObject", new Object_validator({
+      {"anArray", (new Array_validator())->items(
+        (new Int_validator())->max_value(10))}
+    })}
+  });
+
+  expect_same_result(validator,
+                     "{\"anObject\": {\"anArray\": [1, 2, 30]}}", false);
+  expect_same_result(validator,
+                     "{\"anObject\": {\"anArray\": [1, \"2\"]}}", false);
+  expect_same_result(validator, "{\"anObject\": [1]}", false);
+  expect_same_result(validator, "{\"anObject\": {\"anArray\": {}}}", false);
+}
+
+TEST(STREAMING_VALIDATOR, CONTAINER_ERRORS) {
+  auto validator = Object_validator({
+    {"anArray", (new Array_validator())->min(2)->max(3)},
+    {"required", (new Int_validator())->required(true)},
+    {"withDefault", (new Int_validator())->default_value(3)->required(true)}
+  });
+  validator.forbidden_keys({"forbidden"});
+
+  expect_same_result(validator, "{\"anArray\": [1], \"required\": 1}", false);
+  expect_same_result(validator, "{\"anArray\": [1, 2, 3, 4]}", false);
+  expect_same_result(validator, "{\"anArray\": [1, 2]}", false);
+  expect_same_result(validator, "{\"required\": 1, \"forbidden\": 1}", false);
+  expect_same_result(validator, "{\"anArray\": [], \"required\": 1}", false);
+  expect_same_result(validator, "{\"anArray\": [1, 2], \"required\": 1}",
+                     true);
+}
+
+TEST(STREAMING_VALIDATOR, REJECTS_EARLY) {
+  auto validator = Object_validator({
+    {"anInt", (new Int_validator())->max_value(10)}
+  });
+
+  Streaming_validator stream(&validator);
+  EXPECT_TRUE(stream.feed("{\"anInt\": 1"));
+  EXPECT_FALSE(stream.feed("1, \"another"));
+  EXPECT_TRUE(stream.rejected());
+  EXPECT_EQ(stream.offset(), 13u);
+
+  auto result = stream.finish();
+  EXPECT_FALSE(result->success());
+  EXPECT_EQ(result->message(), "[ERROR] json['anInt']: max_value = 10 "
+                               "received = 11");
+}
+
+TEST(STREAMING_VALIDATOR, REJECTS_LONG_VALUES_EARLY) {
+  auto validator = Object_validator({
+    {"anArray", (new Array_validator())->max(2)},
+    {"aString", (new String_validator())->max_length(3)}
+  });
+
+  //  The third item starts: the array is rejected before it closes
+  Streaming_validator stream(&validator);
+  EXPECT_TRUE(stream.feed("{\"anArray\": [1, 2"));
+  EXPECT_FALSE(stream.feed(", 3"));
+  EXPECT_EQ(stream.offset(), 20u);
+  auto result = stream.finish();
+  EXPECT_EQ(VALIDATION_ABOVE_MAXIMUM, result->code());
+  EXPECT_EQ("/anArray", result->pointer());
+
+  //  An escape counts for one byte at least (the string is rejected once
+  //  it surely has more than 3)
+  EXPECT_TRUE(stream.feed("{\"aString\": \"\\u00e9a"));
+  EXPECT_FALSE(stream.feed("bc"));
+  EXPECT_EQ(stream.offset(), 22u);
+  result = stream.finish();
+  EXPECT_EQ(VALIDATION_ABOVE_MAXIMUM, result->code());
+  EXPECT_EQ("/aString", result->pointer());
+  EXPECT_EQ("length > 3", result->error().actual);
+  EXPECT_EQ("[ERROR] json['aString']: has length over 3 but max_length is 3",
+            result->message());
+
+  EXPECT_TRUE(stream.feed("{\"aString\": \"\\n\\u0041b"));
+  EXPECT_TRUE(stream.feed("\", \"anArray\": [1, 2]}"));
+  EXPECT_TRUE(stream.finish()->success());
+}
+
+TEST(STREAMING_VALIDATOR, SYNTAX_ERRORS) {
+  auto validator = Object_validator({});
+  Streaming_validator stream(&validator);
+
+  const string invalid_jsons[] = {
+    "", "{", "{\"a\" 1}", "{\"a\": 1,}", "[1 2]", "{\"a\": tru}", "{} {}",
+    "{\"a\": \"unterminated}", "{\"a\": 1]", "{1: 2}", "{\"a\": -}"
+  };
+
+  for (auto& json : invalid_jsons) {
+    stream.feed(json);
+    auto result = stream.finish();
+    EXPECT_FALSE(result->success()) << json;
+  }
+
+  stream.feed(" {\"a\": [true, false, null, -1.5e3, \"\\u0041\"]} ");
+  EXPECT_TRUE(stream.finish()->success());
+}
+
+TEST(STREAMING_VALIDATOR, TOP_LEVEL_ARRAY_AND_REUSE) {
+  auto validator = Array_validator();
+  validator.items(new Object_validator({
+    {"anInt", (new Int_validator())->required(true)}
+  }));
+
+  expect_same_result(validator, "[{\"anInt\": 1}, {\"anInt\": 2}]", true);
+  expect_same_result(validator, "[{\"anInt\": 1}, {}]", false);
+  expect_same_result(validator, "[]", true);
+}
+}
@@ -0,0 +1,168 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Array_validator = Array_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+using String_validator = String_validator<CJSON_adapter>;
+using Boolean_validator = Boolean_validator<CJSON_adapter>;
+
+/**
+ * Rules sharing the same dimensionValues object
+ */
+static Array_validator* rules_validator(bool memoize) {
+  auto dimension_values = new Object_validator({
+    {"country", (new String_validator())->valid({"br", "us", "de"})},
+    {"weights", (new Array_validator())->unique(true)->max(8)
+                                       ->items((new Int_validator())
+                                               ->min_value(0))},
+    {"scope", (new Object_validator({
+      {"level", (new Int_validator())->max_value(3)->required(true)},
+      {"strict", (new Boolean_validator())->default_value(false)}
+    }))}
+  });
+
+  return (new Array_validator())->memoize(memoize)->items(
+      new Object_validator({
+        {"id", (new Int_validator())->required(true)},
+        {"dimensionValues", dimension_values}
+      }));
+}
+
+static string rules(size_t count, const string& shared, size_t odd_index,
+                    const string& odd) {
+  string json = "[";
+  for (size_t i = 0; i < count; ++i) {
+    json += string(i == 0 ? "" : ",") + "{\"id\": " + to_string(i) +
+            ", \"dimensionValues\": " + (i == odd_index ? odd : shared) + "}";
+  }
+
+  return json + "]";
+}
+
+static string print(cJSON* json) {
+  char* printed = cJSON_PrintUnformatted(json);
+  string result(printed);
+  free(printed);
+  return result;
+}
+
+static vector<string> rules_documents() {
+  const string shared = "{\"country\": \"br\", \"weights\": [1, 2, 3],"
+                        "\"scope\": {\"level\": 1, \"strict\": true}}";
+  const size_t none = (size_t)-1;
+  return {
+    rules(200, shared, none, ""),
+    //  a different copy fails after many hits
+    rules(200, shared, 150, "{\"country\": \"xx\"}"),
+    rules(200, shared, 150, "{\"country\": \"br\", \"weights\": [1, 1]}"),
+    //  the same value with another key order, then as a double
+    rules(200, shared, 10, "{\"weights\": [1, 2, 3], \"country\": \"br\","
+                           "\"scope\": {\"strict\": true, \"level\": 1}}"),
+    rules(200, shared, 10, "{\"country\": \"br\", \"weights\": [1, 2, 3],"
+                           "\"scope\": {\"level\": 1.5, \"strict\": true}}"),
+    //  defaults are added to every copy
+    rules(200, "{\"country\": \"de\", \"scope\": {\"level\": 2}}", none, ""),
+    rules(200, "{\"scope\": {}}", none, ""),
+    "[{\"id\": 1}, {}]"
+  };
+}
+
+TEST(SUBTREE_MEMO, SAME_RESULTS_AS_PLAIN_VALIDATION) {
+  unique_ptr<Array_validator> plain(rules_validator(false));
+  unique_ptr<Array_validator> memoized(rules_validator(true));
+
+  for (const string& json : rules_documents()) {
+    cJSON_ptr expected_root(cJSON_Parse(json.c_str()), cJSON_Delete);
+    cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+    ASSERT_NE(nullptr, root);
+
+    auto expected = plain->validate(CJSON_adapter(expected_root.get()));
+    auto result = memoized->validate(CJSON_adapter(root.get()));
+    EXPECT_EQ(expected->success(), result->success()) << json;
+    EXPECT_EQ(expected->message(), result->message()) << json;
+    EXPECT_EQ(expected->code(), result->code()) << json;
+    EXPECT_EQ(print(expected_root.get()), print(root.get())) << json;
+    EXPECT_EQ(nullptr, result->memo());
+  }
+}
+
+TEST(SUBTREE_MEMO, REPEATED_SUBTREES_ARE_VALIDATED_ONCE) {
+  unique_ptr<Array_validator> memoized(rules_validator(true));
+  string json = rules_documents()[0];
+  cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+
+  //  A memo handed in is used instead of the validator's own one
+  Subtree_memo memo;
+  Validation_result_ptr result(new Validation_result());
+  result->memo(&memo);
+  result = memoized->validate(CJSON_adapter(root.get()), std::move(result));
+  EXPECT_TRUE(result->success());
+
+  //  The rules differ by id: hashing them stops after the warm-up, while
+  //  dimensionValues is found every time after the first one (whose
+  //  scope and weights were looked up too)
+  auto rule_validator = memoized->items_validator();
+  auto dimension_validator =
+      static_cast<Object_validator*>(rule_validator)
+          ->key_validator("dimensionValues");
+  EXPECT_EQ(nullptr, memo.node(rule_validator));
+  EXPECT_NE(nullptr, memo.node(dimension_validator));
+  EXPECT_LE(199u, memo.hits());
+  EXPECT_GE(Subtree_memo::WARM_UP + 3, memo.misses());
+}
+
+TEST(SUBTREE_MEMO, DEFAULTS_ARE_NOT_REMEMBERED) {
+  unique_ptr<Array_validator> memoized(rules_validator(true));
+  string json = rules_documents()[5];
+  cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+
+  Subtree_memo memo;
+  Validation_result_ptr result(new Validation_result());
+  result->memo(&memo);
+  result = memoized->validate(CJSON_adapter(root.get()), std::move(result));
+  EXPECT_TRUE(result->success());
+  EXPECT_EQ(0u, memo.hits());
+
+  for (cJSON* rule = root->child; rule != nullptr; rule = rule->next) {
+    cJSON* scope = cJSON_GetObjectItem(
+        cJSON_GetObjectItem(rule, "dimensionValues"), "scope");
+    ASSERT_NE(nullptr, cJSON_GetObjectItem(scope, "strict"));
+  }
+}
+
+TEST(SUBTREE_MEMO, KEYS) {
+  cJSON_ptr first(cJSON_Parse("{\"a\": [1, \"x\", true, null, {}]}"),
+                  cJSON_Delete);
+  cJSON_ptr same(cJSON_Parse("{\"a\": [1, \"x\", true, null, {}]}"),
+                 cJSON_Delete);
+  cJSON_ptr other(cJSON_Parse("{\"a\": [1, \"x\", true, null, []]}"),
+                  cJSON_Delete);
+  cJSON_ptr renamed(cJSON_Parse("{\"b\": [1, \"x\", true, null, {}]}"),
+                    cJSON_Delete);
+  int schema_node = 0;
+
+  auto key = Subtree_memo::key(&schema_node, CJSON_adapter(first.get()));
+  EXPECT_EQ(7u, key.nodes);
+  EXPECT_EQ(7u, Subtree_memo::count_nodes(CJSON_adapter(first.get())));
+  EXPECT_TRUE(key == Subtree_memo::key(&schema_node,
+                                       CJSON_adapter(same.get())));
+  EXPECT_FALSE(key == Subtree_memo::key(&schema_node,
+                                        CJSON_adapter(other.get())));
+  EXPECT_FALSE(key == Subtree_memo::key(&schema_node,
+                                        CJSON_adapter(renamed.get())));
+  EXPECT_FALSE(key == Subtree_memo::key(&key, CJSON_adapter(same.get())));
+}
+}  // namespace unit_tests
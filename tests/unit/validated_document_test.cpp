@@ -0,0 +1,295 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/validated_document.hpp"
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+#include "cJSON/cJSON_Utils.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Array_validator = Array_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+using String_validator = String_validator<CJSON_adapter>;
+using Boolean_validator = Boolean_validator<CJSON_adapter>;
+
+static Object_validator* patched_validator() {
+  auto validator = new Object_validator({
+    {"id", (new Int_validator())->min_value(0)->max_value(1000)
+                                ->required(true)},
+    {"name", (new String_validator())->valid({"a", "b", "c"})
+                                     ->default_value("a")},
+    {"flag", (new Boolean_validator())->default_value(false)},
+    {"tags", (new Array_validator())->unique(true)->max(5)
+                                    ->items(new String_validator())},
+    {"items", (new Array_validator())->min(1)->items(new Object_validator({
+      {"v", (new Int_validator())->max_value(100)->required(true)},
+      {"w", (new Array_validator())->items(new Int_validator())->length(2)},
+      {"on", (new Boolean_validator())->default_value(true)}
+    }))},
+    {"meta", (new Object_validator({
+      {"owner", (new String_validator())->required(true)},
+      {"extra", new Object_validator({{"n", new Int_validator()}})}
+    }))->forbidden_keys({"bad"})}
+  });
+
+  validator->forbidden_keys({"secret"});
+  return validator;
+}
+
+static const char* patched_json =
+  "{\"id\": 1, \"tags\": [\"x\", \"y\"], \"items\": [{\"v\": 1, \"w\": [1, 2]},"
+  "{\"v\": 2}, {\"v\": 3, \"w\": [3, 4]}], \"meta\": {\"owner\": \"me\","
+  "\"extra\": {\"n\": 5}}}";
+
+static cJSON* parse(const string& json) {
+  return cJSON_Parse(json.c_str());
+}
+
+static string print(cJSON* json) {
+  char* printed = cJSON_PrintUnformatted(json);
+  string result(printed);
+  free(printed);
+  return result;
+}
+
+/**
+ * Deterministic random patches over the paths of a document
+ */
+class Patch_generator {
+  private:
+  std::mt19937 _random;
+
+  void collect(cJSON* node, const string& path,
+               vector<pair<string, cJSON*>>* nodes) {
+    nodes->push_back({path, node});
+    int index = 0;
+    for (cJSON* child = node->child; child != nullptr;
+         child = child->next, ++index) {
+      if (node->type == cJSON_Object) {
+        collect(child, path + "/" + child->string, nodes);
+      } else if (node->type == cJSON_Array) {
+        collect(child, path + "/" + to_string(index), nodes);
+      }
+    }
+  }
+
+  size_t pick(size_t count) {
+    return std::uniform_int_distribution<size_t>(0, count - 1)(_random);
+  }
+
+  /**
+   * A place to add a value: a new (or existing) key or an array position
+   */
+  string add_path(const vector<pair<string, cJSON*>>& nodes) {
+    const char* keys[] = {"id", "name", "flag", "tags", "items", "meta", "v",
+                          "w", "on", "owner", "extra", "n", "secret", "bad",
+                          "zz"};
+    vector<const pair<string, cJSON*>*> containers;
+    for (auto& node : nodes) {
+      if (node.second->type == cJSON_Object ||
+          node.second->type == cJSON_Array) {
+        containers.push_back(&node);
+      }
+    }
+
+    auto container = containers[pick(containers.size())];
+    if (container->second->type == cJSON_Object) {
+      return container->first + "/" + keys[pick(15)];
+    }
+
+    size_t size = cJSON_GetArraySize(container->second);
+    size_t index = pick(size + 2);
+    return container->first + "/" +
+           (index > size ? string("-") : to_string(index));
+  }
+
+  public:
+  explicit Patch_generator(unsigned seed) : _random(seed) { }
+
+  string patch(cJSON* document, size_t operations) {
+    const char* values[] = {"1", "50", "2000", "-1", "\"a\"", "\"z\"",
+                            "\"x\"", "true", "[]", "[1, 2]", "[\"x\", \"y\"]",
+                            "{\"v\": 5, \"w\": [1, 2]}", "{\"v\": 500}", "{}",
+                            "{\"owner\": \"me\"}", "null"};
+    cJSON_ptr copy(cJSON_Duplicate(document, 1), cJSON_Delete);
+    string patch = "[";
+    for (size_t i = 0; i < operations; ++i) {
+      vector<pair<string, cJSON*>> nodes;
+      collect(copy.get(), "", &nodes);
+      string path = nodes.size() > 1 ? nodes[1 + pick(nodes.size() - 1)].first
+                                     : "";
+      string operation;
+      switch (path == "" ? 0 : pick(5)) {
+        case 0:
+          operation = "{\"op\": \"add\", \"path\": \"" + add_path(nodes) +
+                      "\", \"value\": " + values[pick(16)] + "}";
+          break;
+        case 1:
+          operation = "{\"op\": \"remove\", \"path\": \"" + path + "\"}";
+          break;
+        case 2:
+          operation = "{\"op\": \"replace\", \"path\": \"" + path +
+                      "\", \"value\": " + values[pick(16)] + "}";
+          break;
+        default: {
+          //  Into a container that isn't below the moved value
+          string to = add_path(nodes);
+          if (to.compare(0, path.size() + 1, path + "/") == 0 || to == path) {
+            to = "/zz";
+          }
+
+          operation = string("{\"op\": \"") + (pick(2) ? "move" : "copy") +
+                      "\", \"from\": \"" + path + "\", \"path\": \"" + to +
+                      "\"}";
+        }
+      }
+
+      //  A failed move has already detached 'from': tried on a duplicate
+      cJSON_ptr single(parse("[" + operation + "]"), cJSON_Delete);
+      cJSON_ptr trial(cJSON_Duplicate(copy.get(), 1), cJSON_Delete);
+      if (cJSONUtils_ApplyPatches(trial.get(), single.get()) != 0) {
+        continue;
+      }
+
+      copy = std::move(trial);
+
+      patch += (patch.size() > 1 ? "," : "") + operation;
+    }
+
+    return patch + "]";
+  }
+};
+
+TEST(VALIDATED_DOCUMENT, SAME_RESULTS_AS_FULL_VALIDATION) {
+  unique_ptr<Object_validator> validator(patched_validator());
+  Patch_generator generator(42);
+
+  cJSON_ptr document(nullptr, cJSON_Delete);
+  cJSON_ptr mirror(nullptr, cJSON_Delete);
+  unique_ptr<Validated_document> stored;
+  size_t incremental = 0;
+  for (int step = 0; step < 4000; ++step) {
+    if (stored == nullptr || !stored->valid()) {
+      document.reset(parse(patched_json));
+      mirror.reset(parse(patched_json));
+      stored.reset(new Validated_document(validator.get(), document.get()));
+      ASSERT_TRUE(stored->valid());
+      validator->validate(CJSON_adapter(mirror.get()));
+    }
+
+    string patch = generator.patch(document.get(), 1 + step % 3);
+    cJSON_ptr patches(parse(patch), cJSON_Delete);
+    ASSERT_NE(nullptr, patches) << patch;
+    ASSERT_EQ(0, cJSONUtils_ApplyPatches(mirror.get(), patches.get()));
+
+    auto expected = validator->validate(CJSON_adapter(mirror.get()));
+    auto result = stored->patch(patches.get());
+    ASSERT_EQ(expected->success(), result->success()) << patch;
+    ASSERT_EQ(expected->message(), result->message()) << patch;
+    ASSERT_EQ(expected->code(), result->code()) << patch;
+    ASSERT_EQ(print(mirror.get()), print(document.get())) << patch;
+    incremental++;
+  }
+
+  EXPECT_EQ(4000u, incremental);
+}
+
+TEST(VALIDATED_DOCUMENT, ANCESTOR_CONSTRAINTS) {
+  unique_ptr<Object_validator> validator(patched_validator());
+  cJSON_ptr document(parse(patched_json), cJSON_Delete);
+  Validated_document stored(validator.get(), document.get());
+  ASSERT_TRUE(stored.valid());
+
+  //  Defaults were added by the first validation, and again when removed
+  cJSON_ptr remove_name(parse("[{\"op\": \"remove\", \"path\": \"/name\"}]"),
+                        cJSON_Delete);
+  EXPECT_TRUE(stored.patch(remove_name.get())->success());
+  EXPECT_NE(nullptr, cJSON_GetObjectItem(document.get(), "name"));
+
+  //  A duplicated item makes the array fail although the item is valid
+  cJSON_ptr duplicate(parse("[{\"op\": \"add\", \"path\": \"/tags/-\","
+                            "\"value\": \"x\"}]"), cJSON_Delete);
+  auto result = stored.patch(duplicate.get());
+  EXPECT_EQ(VALIDATION_DUPLICATED_ITEM, result->code());
+  EXPECT_EQ("[ERROR] json['tags'][2]: duplicated item", result->message());
+  EXPECT_FALSE(stored.valid());
+
+  cJSON_ptr fix(parse("[{\"op\": \"replace\", \"path\": \"/tags/2\","
+                      "\"value\": \"z\"}]"), cJSON_Delete);
+  EXPECT_TRUE(stored.patch(fix.get())->success());
+
+  //  Required key removed deep down, array length broken
+  cJSON_ptr owner(parse("[{\"op\": \"remove\", \"path\": \"/meta/owner\"}]"),
+                  cJSON_Delete);
+  result = stored.patch(owner.get());
+  EXPECT_EQ(VALIDATION_REQUIRED, result->code());
+  EXPECT_EQ("[ERROR] json['meta']: owner is required", result->message());
+
+  cJSON_ptr restore(parse("[{\"op\": \"add\", \"path\": \"/meta/owner\","
+                          "\"value\": \"you\"}]"), cJSON_Delete);
+  EXPECT_TRUE(stored.patch(restore.get())->success());
+
+  cJSON_ptr length(parse("[{\"op\": \"add\", \"path\": \"/items/0/w/-\","
+                         "\"value\": 3}]"), cJSON_Delete);
+  result = stored.patch(length.get());
+  EXPECT_EQ(VALIDATION_WRONG_LENGTH, result->code());
+}
+
+TEST(VALIDATED_DOCUMENT, TOUCHES_ONLY_THE_PATCHED_PATHS) {
+  unique_ptr<Object_validator> validator(patched_validator());
+  string json = "{\"id\": 1, \"items\": [";
+  for (int i = 0; i < 5000; ++i) {
+    json += string(i == 0 ? "" : ",") + "{\"v\": " + to_string(i % 100) + "}";
+  }
+
+  cJSON_ptr document(parse(json + "], \"meta\": {\"owner\": \"me\"}}"),
+                     cJSON_Delete);
+  Validated_document stored(validator.get(), document.get());
+  cJSON_ptr patches(parse("[{\"op\": \"replace\", \"path\": \"/items/4000/v\","
+                          "\"value\": 7}]"), cJSON_Delete);
+  EXPECT_TRUE(stored.patch(patches.get())->success());
+
+  //  root, items, items/4000 and the new value
+  EXPECT_EQ(4u, stored.touched_nodes());
+}
+
+TEST(VALIDATED_DOCUMENT, ERRORS) {
+  unique_ptr<Object_validator> validator(patched_validator());
+  cJSON_ptr document(parse(patched_json), cJSON_Delete);
+  Validated_document stored(validator.get(), document.get());
+
+  cJSON_ptr not_array(parse("{}"), cJSON_Delete);
+  cJSON_ptr root(parse("[{\"op\": \"remove\", \"path\": \"\"}]"),
+                 cJSON_Delete);
+
+  //  The first operation stays applied, the verdict follows it
+  cJSON_ptr failing(parse("[{\"op\": \"replace\", \"path\": \"/id\","
+                          "\"value\": -1}, {\"op\": \"add\", \"path\":"
+                          "\"/nothing/here\", \"value\": 1}]"), cJSON_Delete);
+#if JSON_VALIDATOR_EXCEPTIONS
+  EXPECT_THROW(stored.patch(not_array.get()), std::invalid_argument);
+  EXPECT_THROW(stored.patch(root.get()), std::invalid_argument);
+  EXPECT_THROW(stored.patch(failing.get()), std::invalid_argument);
+#else
+  for (cJSON* patches : {not_array.get(), root.get(), failing.get()}) {
+    EXPECT_EQ(VALIDATION_FAILED, stored.patch(patches)->code());
+  }
+
+  EXPECT_EQ("[ERROR] json: Validated_document: operation 0 needs a 'path' "
+            "below the root", stored.patch(root.get())->message());
+#endif
+  EXPECT_FALSE(stored.valid());
+}
+}  // namespace unit_tests
@@ -0,0 +1,188 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/schema_compiler.hpp"
+#include "../lib/validation_budget.hpp"
+#include <string>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Array_validator = Array_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+
+/**
+ * Accepts anything, but cancels the budget (as another thread would)
+ */
+class Cancelling_validator : public Validator<CJSON_adapter> {
+  public:
+  explicit Cancelling_validator(Validation_budget* budget) {
+    this->_valdations.push_back([budget] (const JSON_token& token,
+                                Validation_result_ptr result) {
+      budget->cancel();
+      result->reset();
+      return result;
+    });
+  }
+};
+
+static Validation_result_ptr validate(Validator<CJSON_adapter>* validator,
+                                      const string& json,
+                                      Validation_budget* budget) {
+  cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+  Validation_result_ptr result(new Validation_result());
+  result->budget(budget);
+  return validator->validate(CJSON_adapter(root.get()), std::move(result));
+}
+
+TEST(VALIDATION_BUDGET, CANCELLED) {
+  const string json = "[{\"a\": 1, \"c\": 0}, {\"a\": 2, \"c\": 0}]";
+  for (uint32_t check_every : {1, 3}) {
+    Validation_budget budget(Validation_budget::NO_DEADLINE, check_every);
+    Array_validator validator;
+    validator.items(new Object_validator({
+      {"a", new Int_validator()},
+      {"c", new Cancelling_validator(&budget)}
+    }));
+
+    //  Checked on the first node, then every check_every nodes: the root,
+    //  /0, /0/a, /0/c (cancels), /1, /1/a, /1/c
+    auto result = validate(&validator, json, &budget);
+    EXPECT_EQ(VALIDATION_BUDGET_EXCEEDED, result->code());
+    EXPECT_TRUE(budget.exceeded());
+    if (check_every == 1) {
+      EXPECT_EQ("/1", result->pointer());
+      EXPECT_EQ(4u, budget.nodes());
+      EXPECT_EQ("[ERROR] json[1]: cancelled after 4 nodes",
+                result->message());
+    } else {
+      EXPECT_EQ("/1/c", result->pointer());
+      EXPECT_EQ(6u, budget.nodes());
+    }
+
+    EXPECT_EQ(to_string(budget.nodes()) + " nodes validated",
+              result->error().actual);
+
+    //  Reusable
+    budget.restart();
+    Object_validator any({});
+    result = validate(&any, "{\"a\": 1}", &budget);
+    EXPECT_TRUE(result->success());
+    EXPECT_EQ(1u, budget.nodes());
+  }
+}
+
+TEST(VALIDATION_BUDGET, DEADLINE) {
+  Array_validator validator;
+  validator.items(new Int_validator());
+  string json = "[0";
+  for (int i = 1; i < 300000; ++i) {
+    json += ",0";
+  }
+
+  json += "]";
+  cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+  Validation_result_ptr result(new Validation_result());
+  Validation_budget budget(1000000);
+  result->budget(&budget);
+  result = validator.validate(CJSON_adapter(root.get()), std::move(result));
+  ASSERT_EQ(VALIDATION_BUDGET_EXCEEDED, result->code());
+  ASSERT_LT(0u, budget.nodes());
+  EXPECT_GT(300001u, budget.nodes());
+  EXPECT_EQ("/" + to_string(budget.nodes() - 1), result->pointer());
+  EXPECT_EQ(0u, budget.nodes() % Validation_budget::CHECK_EVERY);
+
+  //  Already passed: not even the root
+  Validation_budget passed(0);
+  result = validate(&validator, "[1]", &passed);
+  EXPECT_EQ(VALIDATION_BUDGET_EXCEEDED, result->code());
+  EXPECT_EQ("", result->pointer());
+  EXPECT_EQ(0u, passed.nodes());
+  EXPECT_NE(string::npos, result->message().find("deadline exceeded"));
+
+  //  A deadline far away changes nothing
+  Validation_budget hour(3600000000000);
+  EXPECT_TRUE(validate(&validator, json, &hour)->success());
+  EXPECT_EQ(300001u, hour.nodes());
+  EXPECT_FALSE(hour.exceeded());
+}
+
+TEST(VALIDATION_BUDGET, COMPILED_SCHEMA) {
+  const string blob = Schema_compiler::compile(
+      "{\"type\": \"array\", \"items\": {\"type\": \"object\","
+      "\"properties\": {\"a\": {\"type\": \"integer\"}}}}");
+  Compiled_schema schema(blob);
+  Compiled_schema_stack<CJSON_adapter> stack;
+  cJSON_ptr root(cJSON_Parse("[{\"a\": 1}, {\"a\": 2}]"), cJSON_Delete);
+
+  Validation_budget budget;
+  Validation_result_ptr result(new Validation_result());
+  result->budget(&budget);
+  result = schema.validate(CJSON_adapter(root.get()), &stack,
+                           std::move(result));
+  EXPECT_TRUE(result->success());
+  EXPECT_EQ(5u, budget.nodes());
+
+  //  One node spent (and checked) beforehand, so the next check falls on
+  //  the third node: /0/a
+  Validation_budget cancelled(Validation_budget::NO_DEADLINE, 3);
+  result->budget(&cancelled);
+  cancelled.spend();
+  cancelled.cancel();
+  result = schema.validate(CJSON_adapter(root.get()), &stack,
+                           std::move(result));
+  EXPECT_EQ(VALIDATION_BUDGET_EXCEEDED, result->code());
+  EXPECT_EQ("/0/a", result->pointer());
+  EXPECT_EQ(3u, cancelled.nodes());
+}
+
+TEST(VALIDATION_BUDGET, UNIQUE_ITEMS) {
+  //  Comparing the items spends the budget too, before any of them is
+  //  validated
+  string json = "[0";
+  for (int i = 1; i < 300000; ++i) {
+    json += "," + to_string(i);
+  }
+
+  json += "]";
+  cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+  Array_validator validator;
+  validator.unique(true);
+  Validation_result_ptr result(new Validation_result());
+  Validation_budget budget(1000000);
+  result->budget(&budget);
+  result = validator.validate(CJSON_adapter(root.get()), std::move(result));
+  ASSERT_EQ(VALIDATION_BUDGET_EXCEEDED, result->code());
+  ASSERT_LT(0u, budget.nodes());
+  EXPECT_GT(300001u, budget.nodes());
+  EXPECT_EQ("/" + to_string(budget.nodes() - 1), result->pointer());
+
+  //  The root, /0, then stopped at /1
+  const string blob = Schema_compiler::compile(
+      "{\"type\": \"array\", \"uniqueItems\": true}");
+  Compiled_schema schema(blob);
+  Compiled_schema_stack<CJSON_adapter> stack;
+  Validation_budget cancelled(Validation_budget::NO_DEADLINE, 3);
+  result->budget(&cancelled);
+  cancelled.spend();
+  cancelled.cancel();
+  result = schema.validate(CJSON_adapter(root.get()), &stack,
+                           std::move(result));
+  EXPECT_EQ(VALIDATION_BUDGET_EXCEEDED, result->code());
+  EXPECT_EQ("/1", result->pointer());
+  EXPECT_EQ(3u, cancelled.nodes());
+
+  Validation_budget hour(3600000000000);
+  result->budget(&hour);
+  result = validator.validate(CJSON_adapter(root.get()), std::move(result));
+  EXPECT_TRUE(result->success());
+  EXPECT_EQ(300001u, hour.nodes());
+}
+}  // namespace unit_tests
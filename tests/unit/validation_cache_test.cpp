@@ -0,0 +1,193 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/schema_compiler.hpp"
+#include "../lib/schema_registry.hpp"
+#include "../lib/validation_cache.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+TEST(VALIDATION_CACHE, DOCUMENT_HASH) {
+  const string document = "{\"id\": 1, \"name\": \"a long enough name\"}";
+  const auto schema = Document_hash::schema("tenant", 1);
+  auto hash = Document_hash::of(document, schema);
+
+  EXPECT_TRUE(hash == Document_hash::of(document, schema));
+  EXPECT_FALSE(hash == Document_hash::of(document,
+                                         Document_hash::schema("tenant", 2)));
+  EXPECT_FALSE(hash == Document_hash::of(document,
+                                         Document_hash::schema("other", 1)));
+
+  //  Every byte (including those of the tail) changes the hash
+  for (size_t i = 0; i < document.size(); ++i) {
+    string changed = document;
+    changed[i] ^= 1;
+    EXPECT_FALSE(hash == Document_hash::of(changed, schema)) << i;
+  }
+
+  EXPECT_FALSE(hash == Document_hash::of(document + " ", schema));
+  EXPECT_FALSE(Document_hash::of("", Document_hash()) ==
+               Document_hash::of(string(1, 0), Document_hash()));
+}
+
+TEST(VALIDATION_CACHE, CACHES_VERDICTS_PER_SCHEMA_VERSION) {
+  const string blob = Schema_compiler::compile(
+    "{\"type\": \"object\", \"properties\": {"
+    "\"count\": {\"type\": \"integer\", \"maximum\": 10}}}");
+  Compiled_schema schema(blob);
+
+  Validation_cache cache(1024);
+  int validations = 0;
+  auto validate = [&](const char* data, size_t) {
+    ++validations;
+    cJSON_ptr root(cJSON_Parse(data), cJSON_Delete);
+    return root != nullptr && schema.validate(CJSON_adapter(root.get()))->success();
+  };
+
+  const string valid = "{\"count\": 1}";
+  const string invalid = "{\"count\": 11}";
+  const auto version_1 = Document_hash::schema("counter", 1);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(cache.validate(valid.c_str(), valid.size(), version_1,
+                               validate));
+    EXPECT_FALSE(cache.validate(invalid.c_str(), invalid.size(), version_1,
+                                validate));
+  }
+
+  EXPECT_EQ(2, validations);
+  EXPECT_TRUE(cache.validate(valid.c_str(), valid.size(),
+                             Document_hash::schema("counter", 2), validate));
+  EXPECT_EQ(3, validations);
+
+  auto statistics = cache.statistics();
+  EXPECT_EQ(4u, statistics.hits);
+  EXPECT_EQ(3u, statistics.misses);
+  EXPECT_EQ(0u, statistics.evictions);
+
+  cache.clear();
+  bool verdict;
+  EXPECT_FALSE(cache.find(Document_hash::of(valid, version_1), &verdict));
+}
+
+TEST(VALIDATION_CACHE, SCHEMAS_WITH_THE_SAME_VERSION) {
+  const string blobs[] = {
+    Schema_compiler::compile("{\"type\": \"object\", \"properties\": {"
+      "\"count\": {\"type\": \"integer\", \"maximum\": 10}}}"),
+    Schema_compiler::compile("{\"type\": \"object\", \"properties\": {"
+      "\"count\": {\"type\": \"integer\", \"maximum\": 20}}}")
+  };
+
+  Schema_registry registry;
+  registry.publish("small", 1, blobs[0]);
+  registry.publish("large", 1, blobs[1]);
+
+  Validation_cache cache(1024);
+  Schema_registry::Reader reader(&registry);
+  const string document = "{\"count\": 15}";
+  auto validate = [&](const string& id, const Document_hash& schema) {
+    return cache.validate(document.data(), document.size(), schema,
+                          [&](const char* data, size_t) {
+      auto guard = reader.lock();
+      cJSON_ptr root(cJSON_Parse(data), cJSON_Delete);
+      return guard.find(id, 1)->validate(CJSON_adapter(root.get()))
+          ->success();
+    });
+  };
+
+  //  By id and version, or by blob: each schema gets its own verdict
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_FALSE(validate("small", Document_hash::schema("small", 1)));
+    EXPECT_TRUE(validate("large", Document_hash::schema("large", 1)));
+    EXPECT_FALSE(validate("small", Document_hash::schema(blobs[0])));
+    EXPECT_TRUE(validate("large", Document_hash::schema(blobs[1])));
+  }
+
+  //  A replaced version has another blob (the one of "large" here, whose
+  //  verdicts it shares), while its id and version need a clear()
+  registry.publish("small", 1, blobs[1]);
+  EXPECT_TRUE(validate("small", Document_hash::schema(blobs[1])));
+  EXPECT_FALSE(validate("small", Document_hash::schema("small", 1)));
+  cache.clear();
+  EXPECT_TRUE(validate("small", Document_hash::schema("small", 1)));
+  EXPECT_EQ(5u, cache.statistics().misses);
+}
+
+TEST(VALIDATION_CACHE, BOUNDED_WITH_CLOCK_EVICTION) {
+  Validation_cache cache(100, 4);
+  EXPECT_EQ(128u, cache.capacity());
+
+  size_t documents = 10 * cache.capacity();
+  for (size_t i = 0; i < documents; ++i) {
+    cache.insert(Document_hash::of(to_string(i), Document_hash()),
+                 i % 2 == 0);
+  }
+
+  size_t cached = 0;
+  bool valid;
+  for (size_t i = 0; i < documents; ++i) {
+    if (cache.find(Document_hash::of(to_string(i), Document_hash()),
+                   &valid)) {
+      EXPECT_EQ(i % 2 == 0, valid);
+      ++cached;
+    }
+  }
+
+  EXPECT_LE(cached, cache.capacity());
+  EXPECT_EQ(documents - cached, cache.statistics().misses);
+  EXPECT_GE(cache.statistics().evictions, documents - cache.capacity());
+
+  //  A document that keeps being hit survives a stream of new ones
+  Validation_cache small_cache(4, 1);
+  auto hot = Document_hash::of("hot", Document_hash());
+  small_cache.insert(hot, true);
+  for (size_t i = 0; i < 100; ++i) {
+    ASSERT_TRUE(small_cache.find(hot, &valid));
+    small_cache.insert(Document_hash::of(to_string(i), Document_hash()),
+                       false);
+  }
+}
+
+TEST(VALIDATION_CACHE, CONCURRENT_ACCESS) {
+  Validation_cache cache(256);
+  vector<string> documents;
+  for (int i = 0; i < 1000; ++i) {
+    documents.push_back("{\"id\": " + to_string(i) + "}");
+  }
+
+  std::atomic<int> wrong_verdicts(0);
+  vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int round = 0; round < 20; ++round) {
+        for (size_t i = 0; i < documents.size(); ++i) {
+          const string& document = documents[(i * (t + 1)) % documents.size()];
+          bool expected = document.size() % 2 == 0;
+          bool valid = cache.validate(document.data(), document.size(),
+                                      Document_hash(),
+            [](const char*, size_t size) { return size % 2 == 0; });
+          wrong_verdicts += valid != expected;
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(0, wrong_verdicts.load());
+  auto statistics = cache.statistics();
+  EXPECT_EQ(4u * 20 * documents.size(), statistics.hits + statistics.misses);
+}
+}  // namespace unit_tests
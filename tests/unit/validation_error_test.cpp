@@ -0,0 +1,166 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/batch_validator.hpp"
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+using cJSON_ptr = unique_ptr<cJSON, std::function<void(cJSON*)>>;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Array_validator = Array_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+using String_validator = String_validator<CJSON_adapter>;
+
+static Validation_result_ptr validate(Validator<CJSON_adapter>* validator,
+                                      const string& json) {
+  cJSON_ptr root(cJSON_Parse(json.c_str()), cJSON_Delete);
+  return validator->validate(CJSON_adapter(root.get()));
+}
+
+TEST(VALIDATION_ERROR, STRUCTURED_ERROR) {
+  auto value = (new Int_validator())->max_value(100);
+  auto kind = (new String_validator())->valid({"a", "b"});
+  Object_validator validator({
+    {"a/b", (new Array_validator())->items(new Object_validator({
+      {"v", value},
+      {"kind", kind}
+    }))},
+    {"x~y", (new Object_validator({
+      {"req", (new Int_validator())->required(true)}
+    }))}
+  });
+
+  auto result = validate(&validator, "{\"a/b\": [{}, {\"v\": 1}, {\"v\": 500}]}");
+  EXPECT_EQ("[ERROR] json['a/b'][2]['v']: max_value = 100 received = 500",
+            result->message());
+  Validation_error error = result->error();
+  EXPECT_EQ(VALIDATION_ABOVE_MAXIMUM, error.code);
+  EXPECT_EQ("/a~1b/2/v", error.pointer);
+  EXPECT_EQ(value, error.schema_node);
+  EXPECT_EQ("max_value = 100 received = 500", error.reason);
+  EXPECT_EQ("<= 100", error.expected);
+  EXPECT_EQ("500", error.actual);
+
+  result = validate(&validator, "{\"a/b\": [{\"kind\": \"c\"}]}");
+  EXPECT_EQ(kind, result->error().schema_node);
+  EXPECT_EQ("one of [\"a\", \"b\"]", result->error().expected);
+  EXPECT_EQ("\"c\"", result->error().actual);
+
+  result = validate(&validator, "{\"a/b\": [{\"v\": \"1\"}]}");
+  EXPECT_EQ(VALIDATION_WRONG_TYPE, result->code());
+  EXPECT_EQ("integer", result->error().expected);
+  EXPECT_EQ("string", result->error().actual);
+
+  result = validate(&validator, "{\"x~y\": {}}");
+  EXPECT_EQ("/x~0y", result->pointer());
+  EXPECT_EQ(VALIDATION_REQUIRED, result->code());
+  EXPECT_EQ("key 'req'", result->error().expected);
+
+  //  Failures of the root itself
+  result = validate(&validator, "[]");
+  EXPECT_EQ("", result->pointer());
+  EXPECT_EQ(&validator, result->error().schema_node);
+  EXPECT_EQ("array", result->error().actual);
+
+  result = validate(&validator, "{}");
+  EXPECT_TRUE(result->success());
+  EXPECT_EQ(VALIDATION_OK, result->error().code);
+  EXPECT_EQ(nullptr, result->error().schema_node);
+}
+
+TEST(VALIDATION_ERROR, POSITIONS_AS_STRINGS) {
+  //  What set_error(string) callers (eg: older generated code) push
+  Validation_result result;
+  result.set_error(VALIDATION_NOT_ALLOWED, "no");
+  result.set_error("'key'");
+  result.set_error("12");
+  result.set_error("raw");
+  EXPECT_EQ("[ERROR] json['raw'][12]['key']: no", result.message());
+  EXPECT_EQ("/raw/12/key", result.pointer());
+
+  Validation_result legacy;
+  legacy.set_error("reason first");
+  EXPECT_EQ(VALIDATION_FAILED, legacy.code());
+  EXPECT_EQ("[ERROR] json: reason first", legacy.message());
+
+  legacy.reset();
+  EXPECT_TRUE(legacy.success());
+  EXPECT_EQ("[ERROR] json", legacy.message());
+}
+
+TEST(VALIDATION_ERROR, JSON) {
+  Validation_result result;
+  result.set_error(VALIDATION_NOT_ALLOWED, "Value \"q\\\" not allowed",
+                   nullptr, "one of [\"a\"]", "\"q\\\"\n");
+  result.add_key("k\"/~");
+  result.add_index(3);
+
+  string json;
+  result.append_json(&json);
+  EXPECT_EQ("{\"code\":\"not_allowed\",\"pointer\":\"/3/k\\\"~1~0\","
+            "\"message\":\"Value \\\"q\\\\\\\" not allowed\","
+            "\"expected\":\"one of [\\\"a\\\"]\","
+            "\"actual\":\"\\\"q\\\\\\\"\\u000a\"}", json);
+
+  cJSON_ptr parsed(cJSON_Parse(json.c_str()), cJSON_Delete);
+  ASSERT_NE(nullptr, parsed);
+  EXPECT_STREQ("/3/k\"~1~0",
+               cJSON_GetObjectItem(parsed.get(), "pointer")->valuestring);
+  EXPECT_STREQ("\"q\\\"\n",
+               cJSON_GetObjectItem(parsed.get(), "actual")->valuestring);
+}
+
+TEST(VALIDATION_ERROR, BATCH_JSON) {
+  Object_validator validator({
+    {"n", (new Int_validator())->min_value(0)},
+    {"tags", (new Array_validator())->unique(true)}
+  });
+
+  vector<string> jsons = {"{\"n\": 1}", "{\"n\": -1}", "{\"tags\": [1, 1]}",
+                          "{}", "[]"};
+  vector<cJSON_ptr> roots;
+  vector<CJSON_adapter> documents;
+  for (const string& json : jsons) {
+    roots.emplace_back(cJSON_Parse(json.c_str()), cJSON_Delete);
+    documents.emplace_back(roots.back().get());
+  }
+
+  Batch_validator<CJSON_adapter> batch(&validator, 1);
+  Batch_result verdicts;
+  batch.validate_batch(documents.data(), documents.size(), &verdicts, true);
+
+  string json;
+  verdicts.append_errors_json(&json);
+  EXPECT_EQ("[{\"index\":1,\"code\":\"below_minimum\",\"pointer\":\"/n\","
+            "\"message\":\"min_value = 0 received = -1\","
+            "\"expected\":\">= 0\",\"actual\":\"-1\"},"
+            "{\"index\":2,\"code\":\"duplicated_item\",\"pointer\":\"/tags/1\","
+            "\"message\":\"duplicated item\",\"expected\":\"unique items\","
+            "\"actual\":\"a repeated item\"},"
+            "{\"index\":4,\"code\":\"wrong_type\",\"pointer\":\"\","
+            "\"message\":\"field must be an object\",\"expected\":\"object\","
+            "\"actual\":\"array\"}]", json);
+
+  //  The buffer is reused as is
+  const char* data = json.data();
+  json.clear();
+  verdicts.append_errors_json(&json);
+  EXPECT_EQ(data, json.data());
+
+  //  Without the failures, only what the codes tell
+  batch.validate_batch(documents.data(), documents.size(), &verdicts);
+  json.clear();
+  verdicts.append_errors_json(&json);
+  EXPECT_EQ("[{\"index\":1,\"code\":\"below_minimum\"},"
+            "{\"index\":2,\"code\":\"duplicated_item\"},"
+            "{\"index\":4,\"code\":\"wrong_type\"}]", json);
+}
+}  // namespace unit_tests
@@ -0,0 +1,304 @@
+#include "gtest/gtest.h"
+#include "../lib/json_validator.hpp"
+#include "../lib/schema_compiler.hpp"
+#include "../lib/validation_pipeline.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace json_validator;
+using namespace json_adapters;
+
+namespace unit_tests {
+using Object_validator = Object_validator<CJSON_adapter>;
+using Int_validator = Int_validator<CJSON_adapter>;
+using String_validator = String_validator<CJSON_adapter>;
+using Options = Validation_pipeline::Options;
+
+static const char* pipeline_schema =
+  "{\"type\": \"object\", \"required\": [\"id\"], \"properties\": {"
+  "\"id\": {\"type\": \"integer\", \"minimum\": 0},"
+  "\"kind\": {\"type\": \"string\", \"enum\": [\"a\", \"b\"]}}}";
+
+/**
+ * Payload i is valid unless i % 5 == 0 (wrong kind) or i % 11 == 0 (not
+ *  json at all)
+ */
+static string pipeline_payload(size_t i) {
+  if (i % 11 == 0) {
+    return "{\"id\": " + to_string(i);
+  }
+
+  return "{\"id\": " + to_string(i) + ", \"kind\": \"" +
+         (i % 5 == 0 ? "c" : "a") + "\"}";
+}
+
+static Validation_error_code pipeline_code(size_t i) {
+  if (i % 11 == 0) {
+    return VALIDATION_SYNTAX_ERROR;
+  }
+
+  return i % 5 == 0 ? VALIDATION_NOT_ALLOWED : VALIDATION_OK;
+}
+
+/**
+ * Sink checking each record and counting them by id
+ */
+struct Checking_sink {
+  explicit Checking_sink(size_t count) : seen(count) { }
+
+  vector<int> seen;
+  size_t calls = 0;
+
+  void operator()(Pipeline_record* record) {
+    ++calls;
+    ASSERT_LT(record->id, seen.size());
+    seen[record->id]++;
+    ASSERT_NE(nullptr, record->result);
+    EXPECT_EQ(pipeline_code(record->id), record->result->code())
+        << record->id;
+    EXPECT_EQ(record->result->code() == VALIDATION_SYNTAX_ERROR,
+              record->document == nullptr);
+  }
+
+  void expect_all_seen() {
+    for (size_t i = 0; i < seen.size(); ++i) {
+      ASSERT_EQ(1, seen[i]) << i;
+    }
+  }
+};
+
+TEST(LOCK_FREE_QUEUE, SPSC) {
+  Spsc_queue<int> queue(4);
+  EXPECT_EQ(4u, queue.capacity());
+  EXPECT_TRUE(queue.empty());
+
+  int item;
+  EXPECT_FALSE(queue.try_pop(&item));
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(queue.try_push(i));
+  }
+
+  EXPECT_FALSE(queue.try_push(4));
+  EXPECT_TRUE(queue.try_pop(&item));
+  EXPECT_EQ(0, item);
+  EXPECT_TRUE(queue.try_push(4));
+
+  //  Items come out in order across threads
+  const int count = 200000;
+  std::thread producer([&]() {
+    for (int i = 5; i < count; ++i) {
+      while (!queue.try_push(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  for (int expected = 1; expected < count; ++expected) {
+    while (!queue.try_pop(&item)) {
+      std::this_thread::yield();
+    }
+
+    ASSERT_EQ(expected, item);
+  }
+
+  producer.join();
+  EXPECT_TRUE(queue.empty());
+}
+
+TEST(LOCK_FREE_QUEUE, MPMC) {
+  Mpmc_queue<int> queue(64);
+  const int producers = 3;
+  const int per_producer = 50000;
+  vector<std::atomic<int>> seen(producers * per_producer);
+  std::atomic<int> popped(0);
+
+  vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p]() {
+      for (int i = 0; i < per_producer; ++i) {
+        while (!queue.try_push(p * per_producer + i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  for (int c = 0; c < 2; ++c) {
+    threads.emplace_back([&]() {
+      int item;
+      while (popped.load() < producers * per_producer) {
+        if (queue.try_pop(&item)) {
+          seen[item]++;
+          popped++;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (auto& count : seen) {
+    ASSERT_EQ(1, count.load());
+  }
+
+  EXPECT_TRUE(queue.empty());
+}
+
+#if JSON_VALIDATOR_EXCEPTIONS
+TEST(LOCK_FREE_QUEUE, CAPACITY) {
+  EXPECT_THROW(Spsc_queue<int>(3), std::invalid_argument);
+  EXPECT_THROW(Spsc_queue<int>(0), std::invalid_argument);
+  EXPECT_THROW(Mpmc_queue<int>(1), std::invalid_argument);
+  EXPECT_THROW(Mpmc_queue<int>(12), std::invalid_argument);
+}
+#endif
+
+TEST(VALIDATION_PIPELINE, COMPILED_SCHEMA) {
+  const string blob = Schema_compiler::compile(pipeline_schema);
+  Compiled_schema schema(blob);
+
+  //  Single threaded stages (spsc queues) and parallel stages (mpmc)
+  for (size_t threads : {1, 3}) {
+    Options options;
+    options.parse_threads = threads;
+    options.validate_threads = threads;
+    options.batch_size = 8;
+    options.queue_capacity = 4;
+
+    const size_t count = 5000;
+    Checking_sink sink(count);
+    Validation_pipeline pipeline(&schema, std::ref(sink), options);
+    for (size_t i = 0; i < count; ++i) {
+      pipeline.submit(i, pipeline_payload(i));
+    }
+
+    pipeline.finish();
+    sink.expect_all_seen();
+    EXPECT_EQ(count, sink.calls);
+
+    auto statistics = pipeline.statistics();
+    EXPECT_EQ(count, statistics.submitted);
+    EXPECT_EQ(count, statistics.completed);
+  }
+}
+
+TEST(VALIDATION_PIPELINE, BUILDER_VALIDATOR) {
+  unique_ptr<Object_validator> validator(new Object_validator({
+    {"id", (new Int_validator())->min_value(0)->required(true)},
+    {"kind", (new String_validator())->valid({"a", "b"})}
+  }));
+
+  const size_t count = 2000;
+  Checking_sink sink(count);
+  Options options;
+  options.validate_threads = 2;
+  Validation_pipeline pipeline(validator.get(), std::ref(sink), options);
+
+  //  Several submitting threads
+  vector<std::thread> threads;
+  for (size_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = t; i < count; i += 4) {
+        pipeline.submit(i, pipeline_payload(i));
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  pipeline.finish();
+  sink.expect_all_seen();
+#if JSON_VALIDATOR_EXCEPTIONS
+  EXPECT_THROW(pipeline.submit(0, "{}"), std::invalid_argument);
+#endif
+}
+
+TEST(VALIDATION_PIPELINE, BACKPRESSURE) {
+  const string blob = Schema_compiler::compile(pipeline_schema);
+  Compiled_schema schema(blob);
+
+  //  A slow sink fills the small queues: producers stall, try_submit sheds
+  std::atomic<bool> release(false);
+  std::atomic<size_t> sunk(0);
+  Options options;
+  options.batch_size = 1;
+  options.queue_capacity = 2;
+  Validation_pipeline pipeline(&schema, [&](Pipeline_record* record) {
+    while (!release.load()) {
+      std::this_thread::yield();
+    }
+
+    sunk++;
+  }, options);
+
+  size_t accepted = 0;
+  for (size_t i = 0; i < 100; ++i) {
+    accepted += pipeline.try_submit(i, pipeline_payload(i));
+  }
+
+  EXPECT_LT(accepted, 100u);
+  EXPECT_GT(pipeline.statistics().submit_stalls, 0u);
+
+  release.store(true);
+  for (size_t i = 0; i < 100; ++i) {
+    pipeline.submit(i, pipeline_payload(i));
+  }
+
+  pipeline.finish();
+  EXPECT_EQ(accepted + 100, sunk.load());
+  EXPECT_EQ(accepted + 100, pipeline.statistics().completed);
+}
+
+TEST(VALIDATION_PIPELINE, SINK_TAKES_DOCUMENT) {
+  const string blob = Schema_compiler::compile(pipeline_schema);
+  Compiled_schema schema(blob);
+  vector<cJSON*> documents;
+  {
+    Validation_pipeline pipeline(&schema, [&](Pipeline_record* record) {
+      documents.push_back(record->document);
+      record->document = nullptr;
+    });
+
+    pipeline.submit(1, pipeline_payload(1));
+    pipeline.submit(2, pipeline_payload(2));
+  }
+
+  ASSERT_EQ(2u, documents.size());
+  for (cJSON* document : documents) {
+    EXPECT_NE(nullptr, cJSON_GetObjectItem(document, "id"));
+    cJSON_Delete(document);
+  }
+}
+
+#if JSON_VALIDATOR_EXCEPTIONS
+TEST(VALIDATION_PIPELINE, INVALID_OPTIONS) {
+  const string blob = Schema_compiler::compile(pipeline_schema);
+  Compiled_schema schema(blob);
+  auto sink = [](Pipeline_record*) { };
+
+  Options no_threads;
+  no_threads.validate_threads = 0;
+  EXPECT_THROW((Validation_pipeline(&schema, sink, no_threads)),
+               std::invalid_argument);
+
+  Options no_batch;
+  no_batch.batch_size = 0;
+  EXPECT_THROW((Validation_pipeline(&schema, sink, no_batch)),
+               std::invalid_argument);
+
+  Options odd_capacity;
+  odd_capacity.queue_capacity = 3;
+  EXPECT_THROW((Validation_pipeline(&schema, sink, odd_capacity)),
+               std::invalid_argument);
+}
+#endif
+}  // namespace unit_tests
@@ -0,0 +1,128 @@
+#include "gtest/gtest.h"
+#include "../lib/work_stealing_pool.hpp"
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace json_validator;
+
+namespace unit_tests {
+using Task_group = Work_stealing_pool::Task_group;
+
+static uint64_t fibonacci(Work_stealing_pool* pool, int n) {
+  if (n < 12) {
+    return n < 2 ? n : fibonacci(pool, n - 1) + fibonacci(pool, n - 2);
+  }
+
+  uint64_t left = 0;
+  Task_group group(pool);
+  group.spawn([&]() { left = fibonacci(pool, n - 1); });
+  uint64_t right = fibonacci(pool, n - 2);
+  group.wait();
+  return left + right;
+}
+
+TEST(WORK_STEALING_POOL, SPAWN_AND_WAIT) {
+  Work_stealing_pool pool(3);
+  EXPECT_EQ(3u, pool.threads());
+
+  std::atomic<int> done(0);
+  {
+    Task_group group(&pool);
+    for (int i = 0; i < 10000; ++i) {
+      group.spawn([&]() { done++; });
+    }
+
+    group.wait();
+    EXPECT_EQ(10000, done.load());
+  }
+
+  auto statistics = pool.statistics();
+  EXPECT_EQ(10000u, statistics.executed + statistics.external);
+  EXPECT_LE(statistics.stolen, statistics.executed);
+}
+
+TEST(WORK_STEALING_POOL, NESTED_FORK_JOIN) {
+  //  Tasks spawned by workers go to their deques and get stolen
+  Work_stealing_pool pool(3);
+  EXPECT_EQ(832040u, fibonacci(&pool, 30));
+
+  //  Without workers the waiting thread runs everything
+  Work_stealing_pool no_workers(0);
+  EXPECT_EQ(6765u, fibonacci(&no_workers, 20));
+}
+
+TEST(WORK_STEALING_POOL, PARALLEL_FOR) {
+  Work_stealing_pool pool(2, true);
+  for (size_t grain : {0, 1, 7, 1000, 5000}) {
+    vector<std::atomic<int>> visits(3000);
+    pool.parallel_for(0, visits.size(), grain, [&](size_t first, size_t last) {
+      EXPECT_LE(last - first, grain == 0 ? 1 : grain);
+      for (size_t i = first; i < last; ++i) {
+        visits[i]++;
+      }
+    });
+
+    for (auto& visit : visits) {
+      ASSERT_EQ(1, visit.load());
+    }
+  }
+
+  int calls = 0;
+  pool.parallel_for(5, 5, 10, [&](size_t first, size_t last) {
+    calls += last - first;
+  });
+  EXPECT_EQ(0, calls);
+}
+
+TEST(WORK_STEALING_POOL, MANY_EXTERNAL_THREADS) {
+  Work_stealing_pool pool(2);
+  std::atomic<int> done(0);
+  vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&]() {
+      for (int round = 0; round < 50; ++round) {
+        Task_group group(&pool);
+        for (int i = 0; i < 20; ++i) {
+          group.spawn([&]() { done++; });
+        }
+
+        group.wait();
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(4 * 50 * 20, done.load());
+}
+
+#if JSON_VALIDATOR_EXCEPTIONS
+TEST(WORK_STEALING_POOL, EXCEPTIONS) {
+  Work_stealing_pool pool(2);
+  std::atomic<int> done(0);
+  Task_group group(&pool);
+  for (int i = 0; i < 100; ++i) {
+    group.spawn([&, i]() {
+      if (i == 50) {
+        throw std::runtime_error("task failed");
+      }
+
+      done++;
+    });
+  }
+
+  EXPECT_THROW(group.wait(), std::runtime_error);
+  EXPECT_EQ(99, done.load());
+
+  //  The group can be reused once the exception was reported
+  group.spawn([&]() { done++; });
+  group.wait();
+  EXPECT_EQ(100, done.load());
+}
+#endif
+}  // namespace unit_tests
@@ -0,0 +1,189 @@
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "document_generator.hpp"
+
+using namespace std;
+using namespace json_validator;
+
+/**
+ * Writes a corpus of json documents, one per line, generated from a
+ *  json-schema (see Document_generator).
+ */
+static void usage() {
+  cerr << "usage: corpus_generator [options] <schema> <output>" << endl
+       << endl
+       << "  --bytes=<n>[k|m|g]   stop after the document reaching n bytes"
+          " (default: 1m)" << endl
+       << "  --documents=<n>      or after n documents" << endl
+       << "  --seed=<n>           (default: 0)" << endl
+       << "  --items=<min>:<max>  length of arrays (default: 0:8)" << endl
+       << "  --strings=<min>:<max>  length of strings (default: 1:16)"
+       << endl
+       << "  --optional=<p>       chance of each optional key"
+          " (default: 1)" << endl
+       << "  --invalid=<p>        fraction of invalid documents"
+          " (default: 0)" << endl
+       << "  --depth=<n>          depth of their failure (default: 1)"
+       << endl
+       << "  --position=<p>       among the values at that depth, 0 the"
+          " first, 1 the last (default: 0.5)" << endl;
+}
+
+static string read_file(const string& path) {
+  ifstream file(path, ios::binary);
+  if (!file) {
+    throw runtime_error("can't read " + path);
+  }
+
+  stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+static uint64_t size(const string& value) {
+  size_t end = 0;
+  uint64_t size = stoull(value, &end);
+  string unit = value.substr(end);
+  if (unit == "k") {
+    return size << 10;
+  } else if (unit == "m") {
+    return size << 20;
+  } else if (unit == "g") {
+    return size << 30;
+  } else if (!unit.empty()) {
+    throw invalid_argument("unknown unit in " + value);
+  }
+
+  return size;
+}
+
+template<typename T>
+static void range(const string& value, T* low, T* high) {
+  size_t colon = value.find(':');
+  if (colon == string::npos) {
+    throw invalid_argument("expected <min>:<max>, not " + value);
+  }
+
+  *low = stoull(value.substr(0, colon));
+  *high = stoull(value.substr(colon + 1));
+}
+
+static bool option(const string& argument, const string& name,
+                   string* value) {
+  if (argument.compare(0, name.size() + 3, "--" + name + "=") != 0) {
+    return false;
+  }
+
+  *value = argument.substr(name.size() + 3);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  Generator_options options;
+  uint64_t bytes = 1 << 20;
+  uint64_t documents = UINT64_MAX;
+  double invalid = 0;
+  Mutation mutation = {1, 0.5, MUTATE_ANY};
+  vector<string> paths;
+
+  try {
+    for (int i = 1; i < argc; ++i) {
+      string argument = argv[i];
+      string value;
+      if (option(argument, "bytes", &value)) {
+        bytes = size(value);
+      } else if (option(argument, "documents", &value)) {
+        documents = stoull(value);
+        bytes = UINT64_MAX;
+      } else if (option(argument, "seed", &value)) {
+        options.seed = stoull(value);
+      } else if (option(argument, "items", &value)) {
+        range(value, &options.min_items, &options.max_items);
+      } else if (option(argument, "strings", &value)) {
+        range(value, &options.min_string_length, &options.max_string_length);
+      } else if (option(argument, "optional", &value)) {
+        options.optional_keys = stod(value);
+      } else if (option(argument, "invalid", &value)) {
+        invalid = stod(value);
+      } else if (option(argument, "depth", &value)) {
+        mutation.depth = stoull(value);
+      } else if (option(argument, "position", &value)) {
+        mutation.position = stod(value);
+      } else if (argument.compare(0, 2, "--") == 0) {
+        usage();
+        return 1;
+      } else {
+        paths.push_back(argument);
+      }
+    }
+  } catch (const exception& e) {
+    cerr << "corpus_generator: " << e.what() << endl;
+    usage();
+    return 1;
+  }
+
+  if (paths.size() != 2) {
+    usage();
+    return 1;
+  }
+
+  try {
+    Document_generator generator(read_file(paths[0]), options);
+    FILE* output = fopen(paths[1].c_str(), "wb");
+    if (output == nullptr) {
+      throw runtime_error("can't write " + paths[1]);
+    }
+
+    //  Invalid documents are spread evenly: one every 1/invalid
+    auto start = chrono::steady_clock::now();
+    uint64_t written = 0;
+    uint64_t count = 0;
+    uint64_t broken = 0;
+    uint64_t missed = 0;
+    double owed = 0;
+    string buffer;
+    for (; count < documents && written + buffer.size() < bytes; ++count) {
+      owed += invalid;
+      if (owed >= 1 && generator.append_invalid(count, mutation, &buffer)) {
+        owed -= 1;
+        ++broken;
+      } else {
+        missed += owed >= 1;
+        generator.append_valid(count, &buffer);
+      }
+
+      buffer.push_back('\n');
+      if (buffer.size() >= (1 << 20)) {
+        written += fwrite(buffer.data(), 1, buffer.size(), output);
+        buffer.clear();
+      }
+    }
+
+    written += fwrite(buffer.data(), 1, buffer.size(), output);
+    if (fclose(output) != 0) {
+      throw runtime_error("can't write " + paths[1]);
+    }
+
+    double seconds = chrono::duration<double>(
+        chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "%" PRIu64 " documents (%" PRIu64 " invalid), %" PRIu64
+            " bytes in %.2f s (%.0f MB/s)\n", count, broken, written, seconds,
+            written / seconds / 1e6);
+    if (missed > 0) {
+      fprintf(stderr, "%" PRIu64 " documents had no value to break at depth"
+              " %zu\n", missed, mutation.depth);
+    }
+  } catch (const exception& e) {
+    cerr << "corpus_generator: " << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,140 @@
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "schema_compiler.hpp"
+#include "schema_codegen.hpp"
+
+extern "C" {
+#include "cJSON/cJSON.h"
+}
+
+using namespace std;
+using namespace json_validator;
+
+/**
+ * Generates a C++ header with specialised validators (see Schema_codegen)
+ *  from a json-schema or a compiled schema.
+ */
+static void usage() {
+  cerr << "usage: schema_codegen [options] <schema> <output header>" << endl
+       << endl
+       << "  <schema> is a json-schema document or a compiled schema" << endl
+       << endl
+       << "  --name=<class>       class validating the root schema"
+          " (default: Schema_validator)" << endl
+       << "  --namespace=<name>   namespace of the generated classes"
+          " (default: generated)" << endl
+       << "  --definitions        also generate one class per entry of"
+          " 'definitions'" << endl;
+}
+
+static string identifier(const string& name) {
+  string result;
+  for (char c : name) {
+    result.push_back(isalnum(static_cast<unsigned char>(c)) ? c : '_');
+  }
+
+  if (result.empty() || isdigit(static_cast<unsigned char>(result[0]))) {
+    result = "_" + result;
+  }
+
+  return result;
+}
+
+static string include_guard(const string& path) {
+  string file = path.substr(path.find_last_of('/') + 1);
+  string guard = "GENERATED_";
+  for (char c : file) {
+    guard.push_back(isalnum(static_cast<unsigned char>(c)) ?
+                    toupper(static_cast<unsigned char>(c)) : '_');
+  }
+
+  return guard;
+}
+
+static string read_file(const string& path) {
+  ifstream file(path, ios::binary);
+  if (!file) {
+    throw runtime_error("can't read " + path);
+  }
+
+  stringstream content;
+  content << file.rdbuf();
+  return content.str();
+}
+
+int main(int argc, char** argv) {
+  string name = "Schema_validator";
+  string name_space = "generated";
+  bool definitions = false;
+  vector<string> paths;
+
+  for (int i = 1; i < argc; ++i) {
+    string argument = argv[i];
+    if (argument.compare(0, 7, "--name=") == 0) {
+      name = argument.substr(7);
+    } else if (argument.compare(0, 12, "--namespace=") == 0) {
+      name_space = argument.substr(12);
+    } else if (argument == "--definitions") {
+      definitions = true;
+    } else if (argument.compare(0, 2, "--") == 0) {
+      usage();
+      return 1;
+    } else {
+      paths.push_back(argument);
+    }
+  }
+
+  if (paths.size() != 2) {
+    usage();
+    return 1;
+  }
+
+  try {
+    string input = read_file(paths[0]);
+    Schema_codegen codegen(name_space);
+
+    if (input.compare(0, 4, string(COMPILED_SCHEMA_MAGIC, 4)) == 0) {
+      codegen.add(name, Compiled_schema(input), "Validator of " + paths[0]);
+    } else {
+      unique_ptr<cJSON, void(*)(cJSON*)> document(cJSON_Parse(input.c_str()),
+                                                  cJSON_Delete);
+      if (document == nullptr) {
+        throw invalid_argument("json-schema error: invalid json");
+      }
+
+      //  A document may hold only definitions
+      cJSON* root = document.get();
+      if (cJSON_GetObjectItem(root, "type") != nullptr ||
+          cJSON_GetObjectItem(root, "$ref") != nullptr || !definitions) {
+        string blob = Schema_compiler::compile(root);
+        codegen.add(name, Compiled_schema(blob), "Validator of " + paths[0]);
+      }
+
+      cJSON* entries = cJSON_GetObjectItem(root, "definitions");
+      for (cJSON* entry = definitions && entries ? entries->child : nullptr;
+           entry != nullptr; entry = entry->next) {
+        string pointer = string("#/definitions/") + entry->string;
+        string blob = Schema_compiler::compile(root, pointer);
+        codegen.add(identifier(entry->string), Compiled_schema(blob),
+                    "Validator of " + paths[0] + pointer);
+      }
+    }
+
+    ofstream output(paths[1], ios::binary);
+    output << codegen.write(include_guard(paths[1]), paths[0]);
+    if (!output) {
+      throw runtime_error("can't write " + paths[1]);
+    }
+  } catch (const exception& e) {
+    cerr << "schema_codegen: " << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}